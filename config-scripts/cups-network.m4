@@ -48,6 +48,31 @@ AC_CHECK_HEADER([sys/sockio.h], [
     AC_DEFINE([HAVE_SYS_SOCKIO_H], [1], [Have <sys/sockio.h> header?])
 ])
 
+dnl Check for epoll and accept4...
+AC_CHECK_HEADER([sys/epoll.h], [
+    AC_DEFINE([HAVE_EPOLL], [1], [Have the epoll functions?])
+])
+AC_CHECK_FUNCS([accept4])
+
+dnl Check for sendfile...
+AC_CHECK_HEADER([sys/sendfile.h], [
+    AC_DEFINE([HAVE_SENDFILE], [1], [Have the Linux sendfile function?])
+])
+
+dnl Check for splice and fallocate...
+AC_CHECK_FUNCS([splice fallocate])
+
+dnl Check for io_uring support in the scheduler...
+AC_ARG_ENABLE([io_uring], AS_HELP_STRING([--enable-io-uring], [use io_uring in the scheduler on Linux]))
+
+AS_IF([test x$enable_io_uring = xyes], [
+    AC_CHECK_HEADER([linux/io_uring.h], [
+	AC_DEFINE([HAVE_IO_URING], [1], [Use io_uring in the scheduler?])
+    ], [
+	AC_MSG_ERROR([Unable to enable io_uring support.])
+    ])
+])
+
 dnl Domain socket support...
 CUPS_DEFAULT_DOMAINSOCKET=""
 
@@ -255,6 +255,8 @@ extern char		*_httpDecodeURI(char *dst, const char *src, size_t dstsize) _CUPS_P
 extern void		_httpDisconnect(http_t *http) _CUPS_PRIVATE;
 extern char		*_httpEncodeURI(char *dst, const char *src, size_t dstsize) _CUPS_PRIVATE;
 extern void		_httpFreeCredentials(_http_tls_credentials_t *hcreds) _CUPS_PRIVATE;
+extern ssize_t		_httpReadPipe(http_t *http, int fd, size_t length) _CUPS_PRIVATE;
+extern ssize_t		_httpSendFile(http_t *http, int fd, size_t length) _CUPS_PRIVATE;
 extern int		_httpSetDigestAuthString(http_t *http, const char *nonce, const char *method, const char *resource) _CUPS_PRIVATE;
 extern const char	*_httpStatusString(cups_lang_t *lang, http_status_t status) _CUPS_PRIVATE;
 extern void		_httpTLSInitialize(void) _CUPS_PRIVATE;
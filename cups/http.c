@@ -22,6 +22,9 @@
 #  include <signal.h>
 #  include <sys/time.h>
 #  include <sys/resource.h>
+#  ifdef HAVE_SENDFILE
+#    include <sys/sendfile.h>
+#  endif // HAVE_SENDFILE
 #endif // _WIN32
 #include <zlib.h>
 
@@ -41,7 +44,9 @@ static void		http_debug_hex(const char *prefix, const char *buffer, int bytes);
 static ssize_t		http_read(http_t *http, char *buffer, size_t length, int timeout);
 static ssize_t		http_read_buffered(http_t *http, char *buffer, size_t length);
 static ssize_t		http_read_chunk(http_t *http, char *buffer, size_t length);
+static bool		http_read_chunk_length(http_t *http);
 static bool		http_send(http_t *http, http_state_t request, const char *uri);
+static bool		http_wait_write(http_t *http);
 static ssize_t		http_write(http_t *http, const char *buffer, size_t length);
 static ssize_t		http_write_chunk(http_t *http, const char *buffer, size_t length);
 static off_t		http_set_length(http_t *http);
@@ -133,14 +138,24 @@ httpAcceptConnection(int fd,		// I - Listen socket file descriptor
   if ((http = http_create(NULL, 0, &addrlist, AF_UNSPEC, HTTP_ENCRYPTION_IF_REQUESTED, blocking, _HTTP_MODE_SERVER)) == NULL)
     return (NULL);
 
-  // Accept the client and get the remote address...
+  // Accept the client and get the remote address.  The new socket is always
+  // in blocking mode since the read, write, and TLS code depends on it, even
+  // when the listening socket is non-blocking...
   addrlen = sizeof(http_addr_t);
 
+#ifdef HAVE_ACCEPT4
+  if ((http->fd = accept4(fd, (struct sockaddr *)&(http->addrlist->addr), &addrlen, SOCK_CLOEXEC)) < 0)
+#else
   if ((http->fd = accept(fd, (struct sockaddr *)&(http->addrlist->addr), &addrlen)) < 0)
+#endif // HAVE_ACCEPT4
   {
-    _cupsSetError(IPP_STATUS_ERROR_INTERNAL, strerror(errno), 0);
+    int error = errno;			// accept() error
+
+    _cupsSetError(IPP_STATUS_ERROR_INTERNAL, strerror(error), 0);
     httpClose(http);
 
+    errno = error;
+
     return (NULL);
   }
 
@@ -163,10 +178,16 @@ httpAcceptConnection(int fd,		// I - Listen socket file descriptor
   val = 1;
   setsockopt(http->fd, IPPROTO_TCP, TCP_NODELAY, CUPS_SOCAST &val, sizeof(val));
 
-#ifdef FD_CLOEXEC
+#if !defined(HAVE_ACCEPT4) && !defined(_WIN32)
+  // Some platforms copy O_NONBLOCK from the listening socket...
+  if ((val = fcntl(http->fd, F_GETFL)) >= 0 && (val & O_NONBLOCK))
+    fcntl(http->fd, F_SETFL, val & ~O_NONBLOCK);
+
+#  ifdef FD_CLOEXEC
   // Close this socket when starting another process...
   fcntl(http->fd, F_SETFD, FD_CLOEXEC);
-#endif // FD_CLOEXEC
+#  endif // FD_CLOEXEC
+#endif // !HAVE_ACCEPT4 && !_WIN32
 
   return (http);
 }
@@ -2306,6 +2327,153 @@ httpRead2(http_t *http,			// I - HTTP connection
 }
 
 
+//
+// '_httpReadPipe()' - Read message body data into a pipe.
+//
+// This function moves up to "length" bytes of message body data into the
+// pipe "fd" using `splice`, which avoids copying the data into the HTTP
+// buffers.  The pipe must be empty and able to hold "length" bytes.  It is
+// only available for unencrypted connections without a content coding.
+// Otherwise -1 is returned with `errno` set to `ENOTSUP` and the caller should
+// use @link httpRead2@.
+//
+
+ssize_t					// O - Number of bytes read or -1 on error
+_httpReadPipe(http_t *http,		// I - HTTP connection
+              int    fd,		// I - Pipe file descriptor
+	      size_t length)		// I - Maximum number of bytes
+{
+#ifdef HAVE_SPLICE
+  ssize_t	bytes;			// Bytes read
+
+
+  DEBUG_printf("_httpReadPipe(http=%p, fd=%d, length=" CUPS_LLFMT ") data_encoding=%d data_remaining=" CUPS_LLFMT, (void *)http, fd, CUPS_LLCAST length, http ? http->data_encoding : 0, CUPS_LLCAST (http ? http->data_remaining : -1));
+
+  if (!http || fd < 0 || http->tls || http->coding != _HTTP_CODING_IDENTITY)
+  {
+    errno = ENOTSUP;
+    return (-1);
+  }
+
+  http->activity = time(NULL);
+  http->error    = 0;
+
+  if (length <= 0)
+    return (0);
+
+  if (http->data_remaining <= 0 && http->data_encoding == HTTP_ENCODING_CHUNKED)
+  {
+    // Start the next chunk...
+    if (!http_read_chunk_length(http))
+      http->data_remaining = 0;
+  }
+
+  if (http->data_remaining <= 0)
+  {
+    // No more data to read...
+    bytes = 0;
+  }
+  else
+  {
+    if (length > (size_t)http->data_remaining)
+      length = (size_t)http->data_remaining;
+
+    if (http->used > 0)
+    {
+      // Copy buffered data to the pipe...
+      if (length > (size_t)http->used)
+        length = (size_t)http->used;
+
+      while ((bytes = write(fd, http->buffer, length)) < 0)
+      {
+        if (errno != EINTR)
+        {
+          http->error = errno;
+          return (-1);
+        }
+      }
+
+      http->used -= (int)bytes;
+
+      if (http->used > 0)
+        memmove(http->buffer, http->buffer + bytes, (size_t)http->used);
+    }
+    else
+    {
+      // Splice data from the socket to the pipe...
+      do
+      {
+	if (!http->blocking || http->timeout_value > 0.0)
+	{
+	  while (!_httpWait(http, http->wait_value, 1))
+	  {
+	    if (http->timeout_cb && (*http->timeout_cb)(http, http->timeout_data))
+	      continue;
+
+	    DEBUG_puts("2_httpReadPipe: Timeout.");
+	    return (0);
+	  }
+	}
+
+        if ((bytes = splice(http->fd, NULL, fd, NULL, length, SPLICE_F_MOVE | SPLICE_F_NONBLOCK)) < 0)
+        {
+          DEBUG_printf("2_httpReadPipe: %s", strerror(errno));
+
+          if (errno == EINVAL)
+          {
+            // The socket cannot be used with splice(), use httpRead2()...
+            errno = ENOTSUP;
+            return (-1);
+          }
+          else if (errno != EINTR && errno != EAGAIN && errno != EWOULDBLOCK)
+          {
+	    http->error = errno;
+	    return (-1);
+	  }
+        }
+      }
+      while (bytes < 0);
+
+      if (bytes == 0)
+      {
+        http->error = EPIPE;
+        return (0);
+      }
+    }
+
+    http->data_remaining -= bytes;
+
+    if (http->data_remaining <= 0 && http->data_encoding == HTTP_ENCODING_CHUNKED)
+    {
+      // Read the trailing blank line now...
+      char	len[32];		// Length string
+
+      httpGets2(http, len, sizeof(len));
+    }
+  }
+
+  if ((http->data_remaining <= 0 && http->data_encoding == HTTP_ENCODING_LENGTH) || (http->data_encoding == HTTP_ENCODING_CHUNKED && bytes == 0))
+  {
+    http_advance_state(http);
+
+    DEBUG_printf("1_httpReadPipe: End of content, set state to %s.", httpStateString(http->state));
+  }
+
+  DEBUG_printf("1_httpReadPipe: Returning " CUPS_LLFMT ".", CUPS_LLCAST bytes);
+
+  return (bytes);
+
+#else
+  (void)http;
+  (void)fd;
+  (void)length;
+
+  errno = ENOTSUP;
+  return (-1);
+#endif // HAVE_SPLICE
+}
+
+
 //
 // 'httpReadRequest()' - Read a HTTP request from a connection.
 //
@@ -2523,6 +2691,110 @@ httpSaveCredentials(
 }
 
 
+//
+// '_httpSendFile()' - Send message body data from a file.
+//
+// This function sends up to "length" bytes from the current position of "fd"
+// using `sendfile`, which avoids copying the data into the HTTP buffers.  It
+// is only available for unencrypted connections whose message body is sent
+// with a Content-Length and no content coding.  Otherwise -1 is returned with
+// `errno` set to `ENOTSUP` and the caller should use @link httpWrite2@.
+//
+
+ssize_t					// O - Number of bytes sent, 0 at end of file, or -1 on error
+_httpSendFile(http_t *http,		// I - HTTP connection
+              int    fd,		// I - File descriptor
+	      size_t length)		// I - Maximum number of bytes to send
+{
+#ifdef HAVE_SENDFILE
+  ssize_t	tbytes,			// Total bytes sent
+		bytes;			// Bytes sent
+
+
+  DEBUG_printf("_httpSendFile(http=%p, fd=%d, length=" CUPS_LLFMT ")", (void *)http, fd, CUPS_LLCAST length);
+
+  if (!http || fd < 0 || http->tls || http->data_encoding != HTTP_ENCODING_LENGTH || http->coding != _HTTP_CODING_IDENTITY)
+  {
+    errno = ENOTSUP;
+    return (-1);
+  }
+
+  if (length > (size_t)http->data_remaining)
+    length = (size_t)http->data_remaining;
+
+  // Mark activity on the connection and send any buffered data first...
+  http->activity = time(NULL);
+
+  if (http->wused && httpFlushWrite(http) < 0)
+    return (-1);
+
+  http->error = 0;
+  tbytes      = 0;
+
+  while (length > 0)
+  {
+    if (http->timeout_value > 0.0 && !http_wait_write(http))
+      return (-1);
+
+    if ((bytes = sendfile(http->fd, fd, NULL, length)) < 0)
+    {
+      if (errno == EINTR)
+      {
+        continue;
+      }
+      else if ((errno == EINVAL || errno == ENOSYS) && tbytes == 0)
+      {
+        // The file cannot be used with sendfile(), use httpWrite2()...
+        errno = ENOTSUP;
+        return (-1);
+      }
+      else if (errno == EWOULDBLOCK || errno == EAGAIN)
+      {
+	if (http->timeout_cb && (*http->timeout_cb)(http, http->timeout_data))
+          continue;
+        else if (!http->timeout_cb && errno == EAGAIN)
+	  continue;
+      }
+
+      http->error = errno;
+
+      DEBUG_printf("1_httpSendFile: error sending data (%s).", strerror(http->error));
+
+      return (-1);
+    }
+    else if (bytes == 0)
+    {
+      // End of file...
+      break;
+    }
+
+    tbytes += bytes;
+    length -= (size_t)bytes;
+  }
+
+  http->data_remaining -= tbytes;
+
+  if (http->data_remaining == 0)
+  {
+    http_advance_state(http);
+    DEBUG_printf("2_httpSendFile: Changed state to %s.", httpStateString(http->state));
+  }
+
+  DEBUG_printf("1_httpSendFile: Returning " CUPS_LLFMT ".", CUPS_LLCAST tbytes);
+
+  return (tbytes);
+
+#else
+  (void)http;
+  (void)fd;
+  (void)length;
+
+  errno = ENOTSUP;
+  return (-1);
+#endif // HAVE_SENDFILE
+}
+
+
 //
 // 'httpSetAuthString()' - Set the current authorization string.
 //
@@ -4287,51 +4559,63 @@ http_read_chunk(http_t *http,		// I - HTTP connection
 {
   DEBUG_printf("7http_read_chunk(http=%p, buffer=%p, length=" CUPS_LLFMT ")", (void *)http, (void *)buffer, CUPS_LLCAST length);
 
+  if (http->data_remaining <= 0 && !http_read_chunk_length(http))
+    return (0);
+
+  DEBUG_printf("8http_read_chunk: data_remaining=" CUPS_LLFMT, CUPS_LLCAST http->data_remaining);
+
   if (http->data_remaining <= 0)
-  {
-    char	len[32];		// Length string
+    return (0);
+  else if (length > (size_t)http->data_remaining)
+    length = (size_t)http->data_remaining;
 
-    if (!httpGets2(http, len, sizeof(len)))
-    {
-      DEBUG_puts("8http_read_chunk: Could not get chunk length.");
-      return (0);
-    }
+  return (http_read_buffered(http, buffer, length));
+}
 
-    if (!len[0])
-    {
-      DEBUG_puts("8http_read_chunk: Blank chunk length, trying again...");
-      if (!httpGets2(http, len, sizeof(len)))
-      {
-	DEBUG_puts("8http_read_chunk: Could not get chunk length.");
-	return (0);
-      }
-    }
 
-    http->data_remaining = strtoll(len, NULL, 16);
+//
+// 'http_read_chunk_length()' - Read the length of the next chunk.
+//
 
-    if (http->data_remaining < 0)
-    {
-      DEBUG_printf("8http_read_chunk: Negative chunk length \"%s\" (" CUPS_LLFMT ")", len, CUPS_LLCAST http->data_remaining);
-      return (0);
-    }
+static bool				// O - `true` on success, `false` on error
+http_read_chunk_length(http_t *http)	// I - HTTP connection
+{
+  char	len[32];			// Length string
 
-    DEBUG_printf("8http_read_chunk: Got chunk length \"%s\" (" CUPS_LLFMT ")", len, CUPS_LLCAST http->data_remaining);
 
-    if (http->data_remaining == 0)
+  if (!httpGets2(http, len, sizeof(len)))
+  {
+    DEBUG_puts("8http_read_chunk_length: Could not get chunk length.");
+    return (false);
+  }
+
+  if (!len[0])
+  {
+    DEBUG_puts("8http_read_chunk_length: Blank chunk length, trying again...");
+    if (!httpGets2(http, len, sizeof(len)))
     {
-      // 0-length chunk, grab trailing blank line...
-      httpGets2(http, len, sizeof(len));
+      DEBUG_puts("8http_read_chunk_length: Could not get chunk length.");
+      return (false);
     }
   }
 
-  DEBUG_printf("8http_read_chunk: data_remaining=" CUPS_LLFMT, CUPS_LLCAST http->data_remaining);
+  http->data_remaining = strtoll(len, NULL, 16);
 
-  if (http->data_remaining <= 0)
-    return (0);
-  else if (length > (size_t)http->data_remaining)
-    length = (size_t)http->data_remaining;
+  if (http->data_remaining < 0)
+  {
+    DEBUG_printf("8http_read_chunk_length: Negative chunk length \"%s\" (" CUPS_LLFMT ")", len, CUPS_LLCAST http->data_remaining);
+    return (false);
+  }
 
-  return (http_read_buffered(http, buffer, length));
+  DEBUG_printf("8http_read_chunk_length: Got chunk length \"%s\" (" CUPS_LLFMT ")", len, CUPS_LLCAST http->data_remaining);
+
+  if (http->data_remaining == 0)
+  {
+    // 0-length chunk, grab trailing blank line...
+    httpGets2(http, len, sizeof(len));
+  }
+
+  return (true);
 }
 
 
@@ -4664,6 +4948,53 @@ http_tls_upgrade(http_t *http)		// I - HTTP connection
 }
 
 
+//
+// 'http_wait_write()' - Wait for a HTTP connection to become writable.
+//
+
+static bool				// O - `true` when writable, `false` on error or timeout
+http_wait_write(http_t *http)		// I - HTTP connection
+{
+  struct pollfd	pfd;			// Polled file descriptor
+  int		nfds;			// Result from select()/poll()
+
+
+  do
+  {
+    pfd.fd     = http->fd;
+    pfd.events = POLLOUT;
+
+    do
+    {
+      nfds = poll(&pfd, 1, http->wait_value);
+    }
+#ifdef _WIN32
+    while (nfds < 0 && (WSAGetLastError() == WSAEINTR || WSAGetLastError() == WSAEWOULDBLOCK));
+#else
+    while (nfds < 0 && (errno == EINTR || errno == EAGAIN));
+#endif // _WIN32
+
+    if (nfds < 0)
+    {
+      http->error = errno;
+      return (false);
+    }
+    else if (nfds == 0 && (!http->timeout_cb || !(*http->timeout_cb)(http, http->timeout_data)))
+    {
+#ifdef _WIN32
+      http->error = WSAEWOULDBLOCK;
+#else
+      http->error = EWOULDBLOCK;
+#endif // _WIN32
+      return (false);
+    }
+  }
+  while (nfds <= 0);
+
+  return (true);
+}
+
+
 //
 // 'http_write()' - Write a buffer to a HTTP connection.
 //
@@ -4685,43 +5016,8 @@ http_write(http_t     *http,		// I - HTTP connection
   {
     DEBUG_printf("8http_write: About to write %d bytes.", (int)length);
 
-    if (http->timeout_value > 0.0)
-    {
-      struct pollfd	pfd;		// Polled file descriptor
-      int		nfds;		// Result from select()/poll()
-
-      do
-      {
-	pfd.fd     = http->fd;
-	pfd.events = POLLOUT;
-
-        do
-        {
-          nfds = poll(&pfd, 1, http->wait_value);
-        }
-#  ifdef _WIN32
-	while (nfds < 0 && (WSAGetLastError() == WSAEINTR || WSAGetLastError() == WSAEWOULDBLOCK));
-#  else
-	while (nfds < 0 && (errno == EINTR || errno == EAGAIN));
-#  endif // _WIN32
-
-        if (nfds < 0)
-	{
-	  http->error = errno;
-	  return (-1);
-	}
-	else if (nfds == 0 && (!http->timeout_cb || !(*http->timeout_cb)(http, http->timeout_data)))
-	{
-#ifdef _WIN32
-	  http->error = WSAEWOULDBLOCK;
-#else
-	  http->error = EWOULDBLOCK;
-#endif // _WIN32
-	  return (-1);
-	}
-      }
-      while (nfds <= 0);
-    }
+    if (http->timeout_value > 0.0 && !http_wait_write(http))
+      return (-1);
 
     if (http->tls)
       bytes = _httpTLSWrite(http, buffer, (int)length);
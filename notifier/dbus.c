@@ -18,6 +18,7 @@
 #include <cups/cups.h>
 #include <cups/string-private.h>
 #include <fcntl.h>
+#include <poll.h>
 #include <signal.h>
 #include <sys/stat.h>
 #include <sys/types.h>
@@ -156,6 +157,7 @@ static char		lock_filename[1024];	/* Lock filename */
  */
 
 static int	acquire_lock(int *fd, char *lockfile, size_t locksize);
+static int	input_ready(void);
 static void	release_lock(void);
 
 
@@ -547,7 +549,14 @@ main(int  argc,				/* I - Number of command-line args */
     }
 
     dbus_connection_send(con, message, NULL);
-    dbus_connection_flush(con);
+
+   /*
+    * Only flush once we have sent all of the events the scheduler wrote
+    * together...
+    */
+
+    if (!input_ready())
+      dbus_connection_flush(con);
 
    /*
     * Cleanup...
@@ -566,6 +575,13 @@ main(int  argc,				/* I - Number of command-line args */
     ippDelete(msg);
   }
 
+ /*
+  * Send any signals that are still queued...
+  */
+
+  if (con && dbus_connection_get_is_connected(con))
+    dbus_connection_flush(con);
+
  /*
   * Remove lock file...
   */
@@ -640,6 +656,23 @@ acquire_lock(int    *fd,		/* O - Lock file descriptor */
 
   return (0);
 }
+
+
+/*
+ * 'input_ready()' - See if more events are waiting to be read.
+ */
+
+static int				/* O - 1 if ready, 0 otherwise */
+input_ready(void)
+{
+  struct pollfd	pfd;			/* Polled file descriptor */
+
+
+  pfd.fd     = 0;
+  pfd.events = POLLIN;
+
+  return (poll(&pfd, 1, 0) > 0);
+}
 #else /* !HAVE_DBUS */
 int
 main(void)
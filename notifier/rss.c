@@ -19,6 +19,7 @@
 #include <cups/string-private.h>
 #include <cups/array.h>
 #include <sys/select.h>
+#include <poll.h>
 #include <cups/ipp-private.h>	/* TODO: Update so we don't need this */
 
 
@@ -49,6 +50,7 @@ static char		*rss_password;	/* Password for remote RSS */
 
 static int		compare_rss(_cups_rss_t *a, _cups_rss_t *b, void *data);
 static void		delete_message(_cups_rss_t *msg);
+static int		input_ready(void);
 static void		load_rss(cups_array_t *rss, const char *filename);
 static _cups_rss_t	*new_message(int sequence_number, char *subject,
 			             char *text, char *link_url,
@@ -241,10 +243,11 @@ main(int  argc,				/* I - Number of command-line arguments */
 
   for (exit_status = 0, event = NULL;;)
   {
-    if (changed)
+    if (changed && !input_ready())
     {
      /*
-      * Save the messages to the file again, uploading as needed...
+      * Save the messages to the file again, uploading as needed, once we have
+      * read all of the events the scheduler sent together...
       */
 
       if (save_rss(rss, newname, baseurl))
@@ -436,6 +439,23 @@ delete_message(_cups_rss_t *msg)	/* I - RSS message */
 }
 
 
+/*
+ * 'input_ready()' - See if more events are waiting to be read.
+ */
+
+static int				/* O - 1 if ready, 0 otherwise */
+input_ready(void)
+{
+  struct pollfd	pfd;			/* Polled file descriptor */
+
+
+  pfd.fd     = 0;
+  pfd.events = POLLIN;
+
+  return (poll(&pfd, 1, 0) > 0);
+}
+
+
 /*
  * 'load_rss()' - Load an existing RSS feed file.
  */
@@ -96,6 +96,16 @@ cupsdAddPrinterToClass(
   c->num_printers ++;
 
   *temp = p;
+
+ /*
+  * Keep track of the classes the printer is in, so that jobs for them can be
+  * checked when the printer becomes available...
+  */
+
+  if (!p->classes)
+    p->classes = cupsArrayNew(NULL, NULL);
+
+  cupsArrayAdd(p->classes, c);
 }
 
 
@@ -111,6 +121,8 @@ cupsdDeletePrinterFromClass(
   int	i;				/* Looping var */
 
 
+  cupsArrayRemove(p->classes, c);
+
  /*
   * See if the printer is in the class...
   */
@@ -160,15 +172,15 @@ cupsdDeletePrinterFromClasses(
 
 
  /*
-  * Loop through the printer/class list and remove the printer
-  * from each class listed...
+  * Remove the printer from each class it is in, which also removes the class
+  * from the printer's list...
   */
 
-  for (c = (cupsd_printer_t *)cupsArrayFirst(Printers);
-       c;
-       c = (cupsd_printer_t *)cupsArrayNext(Printers))
-    if (c->type & CUPS_PTYPE_CLASS)
-      changed |= cupsdDeletePrinterFromClass(c, p);
+  while ((c = (cupsd_printer_t *)cupsArrayFirst(p->classes)) != NULL)
+    changed |= cupsdDeletePrinterFromClass(c, p);
+
+  cupsArrayDelete(p->classes);
+  p->classes = NULL;
 
   return (changed);
 }
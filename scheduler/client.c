@@ -24,474 +24,223 @@
 #endif /* HAVE_TCPD_H */
 
 
+/*
+ * Local constants...
+ */
+
+#define CUPSD_SENDFILE_MAX	65536	/* Maximum file data to send per write */
+#define CUPSD_SPLICE_MAX	65536	/* Maximum request data to splice per read */
+
+
+/*
+ * Local globals...
+ */
+
+#ifdef HAVE_SPLICE
+static int		splice_pipe[2] = { -1, -1 };
+					/* Pipe for splicing request data,
+					 * shared by all clients since only
+					 * the main thread reads request data
+					 * and the pipe is always emptied
+					 * before cupsdReadClient returns */
+#endif /* HAVE_SPLICE */
+
+
 /*
  * Local functions...
  */
 
+static int		accept_client(cupsd_listener_t *lis);
 static int		check_if_modified(cupsd_client_t *con,
 			                  struct stat *filestats);
 static int		check_start_tls(cupsd_client_t *con);
+static int		check_stream(cupsd_client_t *con);
 static int		compare_clients(cupsd_client_t *a, cupsd_client_t *b, void *data);
+static int		compare_deadlines(cupsd_client_t *a, cupsd_client_t *b, void *data);
+static int		compare_notify_waits(cupsd_client_t *a, cupsd_client_t *b, void *data);
+static void		discard_data(int spliced);
 static char		*get_file(cupsd_client_t *con, struct stat *filestats, char *filename, size_t len);
 static http_status_t	install_cupsd_conf(cupsd_client_t *con);
 static int		is_cgi(cupsd_client_t *con, const char *filename, struct stat *filestats, mime_type_t *type);
 static int		is_path_absolute(const char *path);
 static int		pipe_command(cupsd_client_t *con, int infile, int *outfile, char *command, char *options, int root);
+static void		preallocate_file(cupsd_client_t *con);
+static ssize_t		read_data(cupsd_client_t *con, char *buffer, size_t bufsize, int *spliced);
 static int		valid_host(cupsd_client_t *con);
+static ssize_t		write_data(cupsd_client_t *con, const char *buffer, ssize_t bytes, int spliced);
 static int		write_file(cupsd_client_t *con, http_status_t code, char *filename, char *type, struct stat *filestats);
 static void		write_pipe(cupsd_client_t *con);
 
 
 /*
- * 'cupsdAcceptClient()' - Accept a new client.
+ * 'cupsdAcceptClient()' - Accept new clients.
+ *
+ * Connections are accepted until accept() fails with EAGAIN or MaxAccepts
+ * connections have been accepted, so that one busy listener can't starve
+ * the existing clients and jobs.
  */
 
 void
 cupsdAcceptClient(cupsd_listener_t *lis)/* I - Listener socket */
 {
-  const char		*hostname;	/* Hostname of client */
-  char			name[256];	/* Hostname of client */
-  int			count;		/* Count of connections on a host */
-  cupsd_client_t	*con,		/* New client pointer */
-			*tempcon;	/* Temporary client pointer */
-  socklen_t		addrlen;	/* Length of address */
-  http_addr_t		temp;		/* Temporary address variable */
-  static time_t		last_dos = 0;	/* Time of last DoS attack */
-#ifdef HAVE_TCPD_H
-  struct request_info	wrap_req;	/* TCP wrappers request information */
-#endif /* HAVE_TCPD_H */
+  int	count;				/* Number of connections accepted */
 
 
   cupsdLogMessage(CUPSD_LOG_DEBUG2, "cupsdAcceptClient(lis=%p(%d)) Clients=%d", (void *)lis, lis->fd, cupsArrayGetCount(Clients));
 
+  for (count = 0; count < MaxAccepts; count ++)
+  {
+    if (!accept_client(lis))
+      return;
+  }
+
  /*
-  * Make sure we don't have a full set of clients already...
+  * Accept any remaining connections the next time through the main loop...
   */
 
-  if (MaxClients && cupsArrayGetCount(Clients) >= MaxClients)
-    return;
-
-  cupsdSetBusyState(1);
+  cupsdSetSelectPending(lis->fd);
+}
 
- /*
-  * Get a pointer to the next available client...
-  */
 
-  if (!Clients)
-    Clients = cupsArrayNew3(NULL, NULL, NULL, 0, NULL, NULL);
+/*
+ * 'cupsdCloseAllClients()' - Close all remote clients immediately.
+ */
 
-  if (!Clients)
-  {
-    cupsdLogMessage(CUPSD_LOG_ERROR,
-                    "Unable to allocate memory for clients array!");
-    cupsdPauseListening();
-    return;
-  }
+void
+cupsdCloseAllClients(void)
+{
+  cupsd_client_t	*con;		/* Current client */
 
-  if (!ActiveClients)
-    ActiveClients = cupsArrayNew3((cups_array_func_t)compare_clients, NULL, NULL, 0, NULL, NULL);
 
-  if (!ActiveClients)
-  {
-    cupsdLogMessage(CUPSD_LOG_ERROR,
-                    "Unable to allocate memory for active clients array!");
-    cupsdPauseListening();
-    return;
-  }
+  cupsdLogMessage(CUPSD_LOG_DEBUG2, "cupsdCloseAllClients() Clients=%d", cupsArrayGetCount(Clients));
 
-  if ((con = calloc(1, sizeof(cupsd_client_t))) == NULL)
-  {
-    cupsdLogMessage(CUPSD_LOG_ERROR, "Unable to allocate memory for client!");
-    cupsdPauseListening();
-    return;
-  }
+  for (con = (cupsd_client_t *)cupsArrayGetFirst(Clients);
+       con;
+       con = (cupsd_client_t *)cupsArrayGetNext(Clients))
+    if (cupsdCloseClient(con))
+      cupsdCloseClient(con);
+}
 
- /*
-  * Accept the client and get the remote address...
-  */
 
-  con->number = ++ LastClientNumber;
-  con->file   = -1;
+/*
+ * 'cupsdCloseClient()' - Close a remote client.
+ */
 
-  if ((con->http = httpAcceptConnection(lis->fd, 0)) == NULL)
-  {
-    if (errno == ENFILE || errno == EMFILE)
-      cupsdPauseListening();
+int					/* O - 1 if partial close, 0 if fully closed */
+cupsdCloseClient(cupsd_client_t *con)	/* I - Client to close */
+{
+  int		partial;		/* Do partial close for SSL? */
 
-    cupsdLogMessage(CUPSD_LOG_ERROR, "Unable to accept client connection - %s.",
-                    strerror(errno));
-    free(con);
 
-    return;
-  }
+  cupsdLogClient(con, CUPSD_LOG_INFO, "Closing connection.");
 
  /*
-  * Save the connected address and port number...
+  * Flush pending writes before closing...
   */
 
-  addrlen = sizeof(con->clientaddr);
+  httpFlushWrite(con->http);
 
-  if (getsockname(httpGetFd(con->http), (struct sockaddr *)&con->clientaddr, &addrlen) || addrlen == 0)
-    con->clientaddr = lis->address;
+  partial = 0;
 
-  cupsdLogClient(con, CUPSD_LOG_DEBUG, "Server address is \"%s\".", httpAddrGetString(&con->clientaddr, name, sizeof(name)));
+  if (con->notify_wait)
+  {
+   /*
+    * Stop waiting for events...
+    */
 
- /*
-  * Check the number of clients on the same address...
-  */
+    cupsdEndNotifyWait(con);
+  }
 
-  for (count = 0, tempcon = (cupsd_client_t *)cupsArrayGetFirst(Clients);
-       tempcon;
-       tempcon = (cupsd_client_t *)cupsArrayGetNext(Clients))
-    if (httpAddrIsEqual(httpGetAddress(tempcon->http), httpGetAddress(con->http)))
-    {
-      count ++;
-      if (count >= MaxClientsPerHost)
-	break;
-    }
+  if (con->pipe_pid != 0)
+  {
+   /*
+    * Stop any CGI process...
+    */
 
-  if (count >= MaxClientsPerHost)
+    cupsdEndProcess(con->pipe_pid, 1);
+    con->pipe_pid = 0;
+  }
+
+  if (con->file >= 0)
   {
-    if ((time(NULL) - last_dos) >= 60)
-    {
-      last_dos = time(NULL);
-      cupsdLogMessage(CUPSD_LOG_WARN,
-                      "Possible DoS attack - more than %d clients connecting "
-		      "from %s.",
-	              MaxClientsPerHost,
-		      httpGetHostname(con->http, name, sizeof(name)));
-    }
+    cupsdRemoveSelect(con->file);
 
-    httpClose(con->http);
-    free(con);
-    return;
+    close(con->file);
+    con->file = -1;
   }
 
- /*
-  * Get the hostname or format the IP address as needed...
-  */
+  if (con->streaming)
+  {
+   /*
+    * Abort any job that was receiving its document...
+    */
 
-  if (HostNameLookups)
-    hostname = httpResolveHostname(con->http, NULL, 0);
-  else
-    hostname = httpGetHostname(con->http, NULL, 0);
+    cupsdFinishStreamingRequest(con, 1);
+  }
 
-  if (hostname == NULL && HostNameLookups == 2)
+  if (con->bg_pending)
   {
    /*
-    * Can't have an unresolved IP address with double-lookups enabled...
+    * Don't close connection when there is a background thread pending
     */
-    cupsdLogClient(con, CUPSD_LOG_WARN,
-                    "Name lookup failed - closing connection from %s!",
-                    httpGetHostname(con->http, NULL, 0));
 
-    httpClose(con->http);
-    free(con);
-    return;
+    partial = 1;
   }
 
-  if (HostNameLookups == 2)
+ /*
+  * Close the socket and clear the file from the input set for select()...
+  */
+
+  if (httpGetFd(con->http) >= 0)
   {
+    cupsArrayRemove(ActiveClients, con);
+    cupsdSetBusyState(0);
+
    /*
-    * Do double lookups as needed...
+    * Shutdown encryption as needed...
     */
 
-    http_addrlist_t	*addrlist,	/* List of addresses */
-			*addr;		/* Current address */
+    if (httpIsEncrypted(con->http))
+      partial = 1;
 
-    if ((addrlist = httpAddrGetList(hostname, AF_UNSPEC, NULL)) != NULL)
+    if (partial && !httpGetError(con->http))
     {
      /*
-      * See if the hostname maps to the same IP address...
+      * Only do a partial close so that the encrypted client gets everything.
       */
 
-      for (addr = addrlist; addr; addr = addr->next)
-        if (httpAddrIsEqual(httpGetAddress(con->http), &(addr->addr)))
-          break;
+      httpShutdown(con->http);
+      cupsdAddSelect(httpGetFd(con->http), (cupsd_selfunc_t)cupsdReadClient,
+                     NULL, con);
+
+      cupsdLogClient(con, CUPSD_LOG_DEBUG, "Waiting for socket close.");
     }
     else
-      addr = NULL;
-
-    httpAddrFreeList(addrlist);
-
-    if (!addr)
     {
      /*
-      * Can't have a hostname that doesn't resolve to the same IP address
-      * with double-lookups enabled...
+      * Shut the socket down fully...
       */
 
-      cupsdLogClient(con, CUPSD_LOG_WARN,
-                      "IP lookup failed - closing connection from %s!",
-                      httpGetHostname(con->http, NULL, 0));
-
+      cupsdRemoveSelect(httpGetFd(con->http));
       httpClose(con->http);
-      free(con);
-      return;
+      con->http = NULL;
     }
   }
 
-#ifdef HAVE_TCPD_H
- /*
-  * See if the connection is denied by TCP wrappers...
-  */
-
-  request_init(&wrap_req, RQ_DAEMON, "cupsd", RQ_FILE, httpGetFd(con->http),
-               NULL);
-  fromhost(&wrap_req);
-
-  if (!hosts_access(&wrap_req))
+  if (!partial)
   {
-    cupsdLogClient(con, CUPSD_LOG_WARN,
-                    "Connection from %s refused by /etc/hosts.allow and "
-		    "/etc/hosts.deny rules.", httpGetHostname(con->http, NULL, 0));
+   /*
+    * Free memory...
+    */
 
-    httpClose(con->http);
-    free(con);
-    return;
-  }
-#endif /* HAVE_TCPD_H */
+    cupsdRemoveSelect(httpGetFd(con->http));
 
-#ifdef AF_LOCAL
-  if (httpAddrGetFamily(httpGetAddress(con->http)) == AF_LOCAL)
-  {
-#  ifdef __APPLE__
-    socklen_t	peersize;		/* Size of peer credentials */
-    pid_t	peerpid;		/* Peer process ID */
-    char	peername[256];		/* Name of process */
+    httpClose(con->http);
 
-    peersize = sizeof(peerpid);
-    if (!getsockopt(httpGetFd(con->http), SOL_LOCAL, LOCAL_PEERPID, &peerpid,
-                    &peersize))
+    if (con->filename)
     {
-      if (!proc_name((int)peerpid, peername, sizeof(peername)))
-	cupsdLogClient(con, CUPSD_LOG_INFO,
-	               "Accepted from %s (Domain ???[%d])",
-                       httpGetHostname(con->http, NULL, 0), (int)peerpid);
-      else
-	cupsdLogClient(con, CUPSD_LOG_INFO,
-                       "Accepted from %s (Domain %s[%d])",
-                       httpGetHostname(con->http, NULL, 0), peername, (int)peerpid);
-    }
-    else
-#  endif /* __APPLE__ */
-
-    cupsdLogClient(con, CUPSD_LOG_INFO, "Accepted from %s (Domain)",
-                   httpGetHostname(con->http, NULL, 0));
-  }
-  else
-#endif /* AF_LOCAL */
-  cupsdLogClient(con, CUPSD_LOG_INFO, "Accepted from %s:%d (IPv%d)",
-                 httpGetHostname(con->http, NULL, 0),
-		 httpAddrGetPort(httpGetAddress(con->http)),
-		 httpAddrGetFamily(httpGetAddress(con->http)) == AF_INET ? 4 : 6);
-
- /*
-  * Get the local address the client connected to...
-  */
-
-  addrlen = sizeof(temp);
-  if (getsockname(httpGetFd(con->http), (struct sockaddr *)&temp, &addrlen))
-  {
-    cupsdLogClient(con, CUPSD_LOG_ERROR, "Unable to get local address - %s",
-                   strerror(errno));
-
-    cupsCopyString(con->servername, "localhost", sizeof(con->servername));
-    con->serverport = LocalPort;
-  }
-#ifdef AF_LOCAL
-  else if (httpAddrGetFamily(&temp) == AF_LOCAL)
-  {
-    cupsCopyString(con->servername, "localhost", sizeof(con->servername));
-    con->serverport = LocalPort;
-  }
-#endif /* AF_LOCAL */
-  else
-  {
-    if (httpAddrIsLocalhost(&temp))
-      cupsCopyString(con->servername, "localhost", sizeof(con->servername));
-    else if (HostNameLookups)
-      httpAddrLookup(&temp, con->servername, sizeof(con->servername));
-    else
-      httpAddrGetString(&temp, con->servername, sizeof(con->servername));
-
-    con->serverport = httpAddrGetPort(&(lis->address));
-  }
-
- /*
-  * Apply ServerHeader if any...
-  */
-
-  if (ServerHeader)
-    httpSetDefaultField(con->http, HTTP_FIELD_SERVER, ServerHeader);
-
- /*
-  * Add the connection to the array of active clients...
-  */
-
-  cupsArrayAdd(Clients, con);
-
- /*
-  * Add the socket to the server select.
-  */
-
-  cupsdAddSelect(httpGetFd(con->http), (cupsd_selfunc_t)cupsdReadClient, NULL,
-                 con);
-
-  cupsdLogClient(con, CUPSD_LOG_DEBUG, "Waiting for request.");
-
- /*
-  * Temporarily suspend accept()'s until we lose a client...
-  */
-
-  if (cupsArrayGetCount(Clients) == MaxClients)
-    cupsdPauseListening();
-
- /*
-  * See if we are connecting on a secure port...
-  */
-
-  if (lis->encryption == HTTP_ENCRYPTION_ALWAYS)
-  {
-   /*
-    * HTTPS connection, force TLS negotiation...
-    */
-
-    con->tls_start     = time(NULL);
-    con->encryption = HTTP_ENCRYPTION_ALWAYS;
-  }
-  else
-  {
-   /*
-    * HTTP connection, but check for HTTPS negotiation on first data...
-    */
-
-    con->auto_ssl = 1;
-  }
-}
-
-
-/*
- * 'cupsdCloseAllClients()' - Close all remote clients immediately.
- */
-
-void
-cupsdCloseAllClients(void)
-{
-  cupsd_client_t	*con;		/* Current client */
-
-
-  cupsdLogMessage(CUPSD_LOG_DEBUG2, "cupsdCloseAllClients() Clients=%d", cupsArrayGetCount(Clients));
-
-  for (con = (cupsd_client_t *)cupsArrayGetFirst(Clients);
-       con;
-       con = (cupsd_client_t *)cupsArrayGetNext(Clients))
-    if (cupsdCloseClient(con))
-      cupsdCloseClient(con);
-}
-
-
-/*
- * 'cupsdCloseClient()' - Close a remote client.
- */
-
-int					/* O - 1 if partial close, 0 if fully closed */
-cupsdCloseClient(cupsd_client_t *con)	/* I - Client to close */
-{
-  int		partial;		/* Do partial close for SSL? */
-
-
-  cupsdLogClient(con, CUPSD_LOG_INFO, "Closing connection.");
-
- /*
-  * Flush pending writes before closing...
-  */
-
-  httpFlushWrite(con->http);
-
-  partial = 0;
-
-  if (con->pipe_pid != 0)
-  {
-   /*
-    * Stop any CGI process...
-    */
-
-    cupsdEndProcess(con->pipe_pid, 1);
-    con->pipe_pid = 0;
-  }
-
-  if (con->file >= 0)
-  {
-    cupsdRemoveSelect(con->file);
-
-    close(con->file);
-    con->file = -1;
-  }
-
-  if (con->bg_pending)
-  {
-   /*
-    * Don't close connection when there is a background thread pending
-    */
-
-    partial = 1;
-  }
-
- /*
-  * Close the socket and clear the file from the input set for select()...
-  */
-
-  if (httpGetFd(con->http) >= 0)
-  {
-    cupsArrayRemove(ActiveClients, con);
-    cupsdSetBusyState(0);
-
-   /*
-    * Shutdown encryption as needed...
-    */
-
-    if (httpIsEncrypted(con->http))
-      partial = 1;
-
-    if (partial && !httpGetError(con->http))
-    {
-     /*
-      * Only do a partial close so that the encrypted client gets everything.
-      */
-
-      httpShutdown(con->http);
-      cupsdAddSelect(httpGetFd(con->http), (cupsd_selfunc_t)cupsdReadClient,
-                     NULL, con);
-
-      cupsdLogClient(con, CUPSD_LOG_DEBUG, "Waiting for socket close.");
-    }
-    else
-    {
-     /*
-      * Shut the socket down fully...
-      */
-
-      cupsdRemoveSelect(httpGetFd(con->http));
-      httpClose(con->http);
-      con->http = NULL;
-    }
-  }
-
-  if (!partial)
-  {
-   /*
-    * Free memory...
-    */
-
-    cupsdRemoveSelect(httpGetFd(con->http));
-
-    httpClose(con->http);
-
-    if (con->filename)
-    {
-      unlink(con->filename);
-      cupsdClearString(&con->filename);
+      unlink(con->filename);
+      cupsdClearString(&con->filename);
     }
 
     cupsdClearString(&con->command);
@@ -510,6 +259,9 @@ cupsdCloseClient(cupsd_client_t *con)	/* I - Client to close */
       con->response = NULL;
     }
 
+    cupsArrayDelete(con->response_attrs);
+    con->response_attrs = NULL;
+
     if (con->language)
     {
       cupsLangFree(con->language);
@@ -537,6 +289,7 @@ cupsdCloseClient(cupsd_client_t *con)	/* I - Client to close */
     */
 
     cupsArrayRemove(Clients, con);
+    cupsArrayRemove(ClientDeadlines, con);
 
     free(con);
   }
@@ -559,6 +312,7 @@ cupsdReadClient(cupsd_client_t *con)	/* I - Client to read from */
   http_status_t		status;		/* Transfer status */
   ipp_state_t		ipp_state;	/* State of IPP transfer */
   int			bytes;		/* Number of bytes to POST */
+  int			spliced;	/* Was POST data spliced? */
   char			*filename;	/* Name of file for GET/HEAD */
   char			buf[1024];	/* Buffer for real filename */
   struct stat		filestats;	/* File information */
@@ -712,6 +466,9 @@ cupsdReadClient(cupsd_client_t *con)	/* I - Client to read from */
 	  con->response = NULL;
 	}
 
+	cupsArrayDelete(con->response_attrs);
+	con->response_attrs = NULL;
+
 	if (con->language)
 	{
 	  cupsLangFree(con->language);
@@ -788,6 +545,11 @@ cupsdReadClient(cupsd_client_t *con)	/* I - Client to read from */
 
         gettimeofday(&(con->start), NULL);
 
+        con->start_time     = cupsGetClock();
+        con->header_time    = 0.0;
+        con->ipp_start_time = 0.0;
+        con->ipp_end_time   = 0.0;
+
         cupsdLogClient(con, CUPSD_LOG_DEBUG, "%s %s HTTP/%d.%d",
 	               httpStateString(con->operation), con->uri,
 		       httpGetVersion(con->http) / 100,
@@ -850,6 +612,8 @@ cupsdReadClient(cupsd_client_t *con)	/* I - Client to read from */
 
   if (status == HTTP_STATUS_OK)
   {
+    con->header_time = cupsGetClock();
+
    /*
     * Record whether the client is a web browser.  "Mozilla" was the original
     * and it seems that every web browser in existence now uses that as the
@@ -1049,7 +813,21 @@ cupsdReadClient(cupsd_client_t *con)	/* I - Client to read from */
 	case HTTP_STATE_GET_SEND :
             cupsdLogClient(con, CUPSD_LOG_DEBUG, "Processing GET %s", con->uri);
 
-            if ((filename = get_file(con, &filestats, buf, sizeof(buf))) != NULL)
+            if (!strcmp(con->uri, "/metrics"))
+	    {
+	     /*
+	      * Send scheduler metrics...
+	      */
+
+	      if (!cupsdSendMetrics(con))
+	      {
+		cupsdCloseClient(con);
+		return;
+	      }
+
+	      cupsdLogRequest(con, HTTP_STATUS_OK);
+	    }
+            else if ((filename = get_file(con, &filestats, buf, sizeof(buf))) != NULL)
             {
 	      cupsRWLockRead(&MimeLock);
 
@@ -1743,13 +1521,15 @@ cupsdReadClient(cupsd_client_t *con)	/* I - Client to read from */
 	    fchmod(con->file, 0640);
 	    fchown(con->file, RunUser, Group);
             fcntl(con->file, F_SETFD, fcntl(con->file, F_GETFD) | FD_CLOEXEC);
+
+            preallocate_file(con);
 	  }
 
 	  if (httpGetState(con->http) != HTTP_STATE_POST_SEND)
 	  {
 	    if (!httpWait(con->http, 0))
 	      return;
-            else if ((bytes = httpRead2(con->http, line, sizeof(line))) < 0)
+            else if ((bytes = read_data(con, line, sizeof(line), &spliced)) < 0)
 	    {
 	      if (httpGetError(con->http) && httpGetError(con->http) != EPIPE)
 		cupsdLogClient(con, CUPSD_LOG_DEBUG,
@@ -1768,19 +1548,20 @@ cupsdReadClient(cupsd_client_t *con)	/* I - Client to read from */
 
               if (MaxRequestSize > 0 && con->bytes > MaxRequestSize)
               {
+                discard_data(spliced);
+
                 close(con->file);
                 con->file = -1;
                 unlink(con->filename);
                 cupsdClearString(&con->filename);
+                cupsdFinishStreamingRequest(con, 1);
 
                 if (!cupsdSendError(con, HTTP_STATUS_REQUEST_TOO_LARGE, CUPSD_AUTH_NONE))
-                {
                   cupsdCloseClient(con);
-                  return;
-                }
-              }
 
-              if (write(con->file, line, (size_t)bytes) < bytes)
+                return;
+              }
+              else if (write_data(con, line, bytes, spliced) < bytes)
 	      {
         	cupsdLogClient(con, CUPSD_LOG_ERROR,
 	                       "Unable to write %d bytes to \"%s\": %s",
@@ -1790,6 +1571,7 @@ cupsdReadClient(cupsd_client_t *con)	/* I - Client to read from */
 		con->file = -1;
 		unlink(con->filename);
 		cupsdClearString(&con->filename);
+		cupsdFinishStreamingRequest(con, 1);
 
         	if (!cupsdSendError(con, HTTP_STATUS_REQUEST_TOO_LARGE,
 		                    CUPSD_AUTH_NONE))
@@ -1798,6 +1580,13 @@ cupsdReadClient(cupsd_client_t *con)	/* I - Client to read from */
 		  return;
 		}
 	      }
+	      else
+	      {
+	        cupsdAddMetric(MetricsBytesSpooled, bytes);
+
+	        if (!check_stream(con))
+		  return;
+	      }
 	    }
 	    else if (httpGetState(con->http) == HTTP_STATE_POST_RECV)
               return;
@@ -1813,20 +1602,44 @@ cupsdReadClient(cupsd_client_t *con)	/* I - Client to read from */
         }
 	while (httpGetState(con->http) == HTTP_STATE_POST_RECV && httpGetReady(con->http));
 
-	if (httpGetState(con->http) == HTTP_STATE_POST_SEND)
+	if (httpGetState(con->http) == HTTP_STATE_POST_SEND && con->streaming)
 	{
-	  if (con->file >= 0)
-	  {
-	    if (fstat(con->file, &filestats))
-	      filestats.st_size = 0;
+	 /*
+	  * Send the response to a Print-Job request that was processed while
+	  * receiving the document...
+	  */
 
-	    close(con->file);
-	    con->file = -1;
+	  close(con->file);
+	  con->file = -1;
 
-            if (filestats.st_size > MaxRequestSize &&
-	        MaxRequestSize > 0)
-	    {
-	     /*
+	  if (!cupsdFinishStreamingRequest(con, 0))
+	  {
+	    cupsdCloseClient(con);
+	    return;
+	  }
+
+	  if (con->filename)
+	  {
+	    unlink(con->filename);
+	    cupsdClearString(&con->filename);
+	  }
+
+	  return;
+	}
+	else if (httpGetState(con->http) == HTTP_STATE_POST_SEND)
+	{
+	  if (con->file >= 0)
+	  {
+	    if (fstat(con->file, &filestats))
+	      filestats.st_size = 0;
+
+	    close(con->file);
+	    con->file = -1;
+
+            if (filestats.st_size > MaxRequestSize &&
+	        MaxRequestSize > 0)
+	    {
+	     /*
 	      * Request is too big; remove it and send an error...
 	      */
 
@@ -2313,6 +2126,39 @@ cupsdUpdateCGI(void)
 }
 
 
+/*
+ * 'cupsdUpdateClientDeadline()' - Reschedule the inactivity timeout for a client.
+ *
+ * The deadline is computed from the last activity on the connection, which
+ * only moves forward, so the main loop can treat it as a lower bound and
+ * re-check the actual activity time when it expires.
+ */
+
+void
+cupsdUpdateClientDeadline(
+    cupsd_client_t *con)		/* I - Client connection */
+{
+  time_t	curtime,		/* Current time */
+		deadline;		/* New deadline */
+
+
+  curtime  = time(NULL);
+  deadline = httpGetActivity(con->http) + Timeout;
+
+  if (deadline <= curtime)
+    deadline = curtime + 1;
+
+  if (deadline == con->deadline_time)
+    return;
+
+  cupsArrayRemove(ClientDeadlines, con);
+
+  con->deadline_time = deadline;
+
+  cupsArrayAdd(ClientDeadlines, con);
+}
+
+
 /*
  * 'cupsdWriteClient()' - Write data to a client as needed.
  */
@@ -2322,6 +2168,7 @@ cupsdWriteClient(cupsd_client_t *con)	/* I - Client connection */
 {
   int		bytes,			/* Number of bytes written */
 		field_col;		/* Current column */
+  ssize_t	sent;			/* Number of file bytes sent */
   char		*bufptr,		/* Pointer into buffer */
 		*bufend;		/* Pointer to end of buffer */
   ipp_state_t	ipp_state;		/* IPP state value */
@@ -2432,6 +2279,26 @@ cupsdWriteClient(cupsd_client_t *con)	/* I - Client connection */
                    (int)bytes, httpGetState(con->http),
                    CUPS_LLCAST httpGetLength2(con->http));
   }
+  else if (!con->pipe_pid && (sent = _httpSendFile(con->http, con->file, CUPSD_SENDFILE_MAX)) >= 0)
+  {
+   /*
+    * Sent file data directly from the file without copying...
+    */
+
+    con->bytes += sent;
+
+    if (httpGetState(con->http) == HTTP_STATE_WAITING)
+      bytes = 0;
+    else
+      bytes = (int)sent;
+  }
+  else if (!con->pipe_pid && errno != ENOTSUP)
+  {
+    cupsdLogClient(con, CUPSD_LOG_DEBUG, "Closing for error %d (%s)",
+		   httpGetError(con->http), strerror(httpGetError(con->http)));
+    cupsdCloseClient(con);
+    return;
+  }
   else if ((bytes = read(con->file, con->header + con->header_used, (size_t)bytes)) > 0)
   {
     con->header_used += bytes;
@@ -2572,89 +2439,458 @@ cupsdWriteClient(cupsd_client_t *con)	/* I - Client connection */
       else
         bytes = con->header_used;
 
-      con->header_used = 0;
-    }
+      con->header_used = 0;
+    }
+  }
+
+  if (bytes <= 0 ||
+      (httpGetState(con->http) != HTTP_STATE_GET_SEND &&
+       httpGetState(con->http) != HTTP_STATE_POST_SEND))
+  {
+    if (!con->sent_header && con->pipe_pid)
+      cupsdSendError(con, HTTP_STATUS_SERVER_ERROR, CUPSD_AUTH_NONE);
+    else
+    {
+      cupsdLogRequest(con, HTTP_STATUS_OK);
+
+      if (httpIsChunked(con->http) && (!con->pipe_pid || con->sent_header > 0))
+      {
+        cupsdLogClient(con, CUPSD_LOG_DEBUG, "Sending 0-length chunk.");
+
+	if (httpWrite2(con->http, "", 0) < 0)
+	{
+	  cupsdLogClient(con, CUPSD_LOG_DEBUG, "Closing for error %d (%s)",
+			 httpGetError(con->http), strerror(httpGetError(con->http)));
+	  cupsdCloseClient(con);
+	  return;
+	}
+      }
+
+      cupsdLogClient(con, CUPSD_LOG_DEBUG2, "Flushing write buffer.");
+      httpFlushWrite(con->http);
+      cupsdLogClient(con, CUPSD_LOG_DEBUG2, "New state is %s", httpStateString(httpGetState(con->http)));
+
+      cupsdAddRequestMetrics(con);
+    }
+
+    cupsdAddSelect(httpGetFd(con->http), (cupsd_selfunc_t)cupsdReadClient, NULL, con);
+
+    cupsdLogClient(con, CUPSD_LOG_DEBUG, "Waiting for request.");
+
+    if (con->file >= 0)
+    {
+      cupsdRemoveSelect(con->file);
+
+      if (con->pipe_pid)
+	cupsdEndProcess(con->pipe_pid, 0);
+
+      close(con->file);
+      con->file     = -1;
+      con->pipe_pid = 0;
+    }
+
+    if (con->filename)
+    {
+      unlink(con->filename);
+      cupsdClearString(&con->filename);
+    }
+
+    if (con->request)
+    {
+      ippDelete(con->request);
+      con->request = NULL;
+    }
+
+    if (con->response)
+    {
+      ippDelete(con->response);
+      con->response = NULL;
+    }
+
+    cupsArrayDelete(con->response_attrs);
+    con->response_attrs = NULL;
+
+    cupsdClearString(&con->command);
+    cupsdClearString(&con->options);
+    cupsdClearString(&con->query_string);
+
+    if (!httpGetKeepAlive(con->http))
+    {
+      cupsdLogClient(con, CUPSD_LOG_DEBUG,
+		     "Closing because Keep-Alive is disabled.");
+      cupsdCloseClient(con);
+      return;
+    }
+    else
+    {
+      cupsArrayRemove(ActiveClients, con);
+      cupsdSetBusyState(0);
+    }
+  }
+}
+
+
+/*
+ * 'accept_client()' - Accept a new client.
+ */
+
+static int				/* O - 1 to accept more, 0 to stop */
+accept_client(cupsd_listener_t *lis)	/* I - Listener socket */
+{
+  const char		*hostname;	/* Hostname of client */
+  char			name[256];	/* Hostname of client */
+  int			count;		/* Count of connections on a host */
+  cupsd_client_t	*con,		/* New client pointer */
+			*tempcon;	/* Temporary client pointer */
+  socklen_t		addrlen;	/* Length of address */
+  http_addr_t		temp;		/* Temporary address variable */
+  static time_t		last_dos = 0;	/* Time of last DoS attack */
+#ifdef HAVE_TCPD_H
+  struct request_info	wrap_req;	/* TCP wrappers request information */
+#endif /* HAVE_TCPD_H */
+
+ /*
+  * Make sure we don't have a full set of clients already...
+  */
+
+  if (MaxClients && cupsArrayGetCount(Clients) >= MaxClients)
+    return (0);
+
+  cupsdSetBusyState(1);
+
+ /*
+  * Get a pointer to the next available client...
+  */
+
+  if (!Clients)
+    Clients = cupsArrayNew3(NULL, NULL, NULL, 0, NULL, NULL);
+
+  if (!Clients)
+  {
+    cupsdLogMessage(CUPSD_LOG_ERROR,
+                    "Unable to allocate memory for clients array!");
+    cupsdPauseListening();
+    return (0);
+  }
+
+  if (!ActiveClients)
+    ActiveClients = cupsArrayNew3((cups_array_func_t)compare_clients, NULL, NULL, 0, NULL, NULL);
+
+  if (!ActiveClients)
+  {
+    cupsdLogMessage(CUPSD_LOG_ERROR,
+                    "Unable to allocate memory for active clients array!");
+    cupsdPauseListening();
+    return (0);
+  }
+
+  if (!ClientDeadlines)
+    ClientDeadlines = cupsArrayNew3((cups_array_func_t)compare_deadlines, NULL, NULL, 0, NULL, NULL);
+
+  if (!ClientDeadlines)
+  {
+    cupsdLogMessage(CUPSD_LOG_ERROR,
+                    "Unable to allocate memory for client deadlines array!");
+    cupsdPauseListening();
+    return (0);
+  }
+
+  if (!NotifyWaits)
+    NotifyWaits = cupsArrayNew3((cups_array_func_t)compare_notify_waits, NULL, NULL, 0, NULL, NULL);
+
+  if (!NotifyWaits)
+  {
+    cupsdLogMessage(CUPSD_LOG_ERROR,
+                    "Unable to allocate memory for notification waits array!");
+    cupsdPauseListening();
+    return (0);
+  }
+
+  if ((con = calloc(1, sizeof(cupsd_client_t))) == NULL)
+  {
+    cupsdLogMessage(CUPSD_LOG_ERROR, "Unable to allocate memory for client!");
+    cupsdPauseListening();
+    return (0);
+  }
+
+ /*
+  * Accept the client and get the remote address...
+  */
+
+  if ((con->http = httpAcceptConnection(lis->fd, 0)) == NULL)
+  {
+    int	error = errno;			/* accept() error */
+
+    free(con);
+
+    if (error == EAGAIN || error == EWOULDBLOCK)
+      return (0);			/* No more connections */
+    else if (error == ECONNABORTED || error == EINTR)
+      return (1);			/* Try the next connection */
+
+    errno = error;
+
+    if (error == ENFILE || error == EMFILE)
+      cupsdPauseListening();
+    else
+      cupsdSetSelectPending(lis->fd);	/* Don't strand queued connections */
+
+    cupsdLogMessage(CUPSD_LOG_ERROR, "Unable to accept client connection - %s.",
+                    strerror(error));
+
+    return (0);
+  }
+
+  con->number = ++ LastClientNumber;
+  con->file   = -1;
+
+ /*
+  * Save the connected address and port number...
+  */
+
+  addrlen = sizeof(con->clientaddr);
+
+  if (getsockname(httpGetFd(con->http), (struct sockaddr *)&con->clientaddr, &addrlen) || addrlen == 0)
+    con->clientaddr = lis->address;
+
+  cupsdLogClient(con, CUPSD_LOG_DEBUG, "Server address is \"%s\".", httpAddrGetString(&con->clientaddr, name, sizeof(name)));
+
+ /*
+  * Check the number of clients on the same address...
+  */
+
+  for (count = 0, tempcon = (cupsd_client_t *)cupsArrayGetFirst(Clients);
+       tempcon;
+       tempcon = (cupsd_client_t *)cupsArrayGetNext(Clients))
+    if (httpAddrIsEqual(httpGetAddress(tempcon->http), httpGetAddress(con->http)))
+    {
+      count ++;
+      if (count >= MaxClientsPerHost)
+	break;
+    }
+
+  if (count >= MaxClientsPerHost)
+  {
+    if ((time(NULL) - last_dos) >= 60)
+    {
+      last_dos = time(NULL);
+      cupsdLogMessage(CUPSD_LOG_WARN,
+                      "Possible DoS attack - more than %d clients connecting "
+		      "from %s.",
+	              MaxClientsPerHost,
+		      httpGetHostname(con->http, name, sizeof(name)));
+    }
+
+    httpClose(con->http);
+    free(con);
+    return (1);
+  }
+
+ /*
+  * Get the hostname or format the IP address as needed...
+  */
+
+  if (HostNameLookups)
+    hostname = httpResolveHostname(con->http, NULL, 0);
+  else
+    hostname = httpGetHostname(con->http, NULL, 0);
+
+  if (hostname == NULL && HostNameLookups == 2)
+  {
+   /*
+    * Can't have an unresolved IP address with double-lookups enabled...
+    */
+    cupsdLogClient(con, CUPSD_LOG_WARN,
+                    "Name lookup failed - closing connection from %s!",
+                    httpGetHostname(con->http, NULL, 0));
+
+    httpClose(con->http);
+    free(con);
+    return (1);
+  }
+
+  if (HostNameLookups == 2)
+  {
+   /*
+    * Do double lookups as needed...
+    */
+
+    http_addrlist_t	*addrlist,	/* List of addresses */
+			*addr;		/* Current address */
+
+    if ((addrlist = httpAddrGetList(hostname, AF_UNSPEC, NULL)) != NULL)
+    {
+     /*
+      * See if the hostname maps to the same IP address...
+      */
+
+      for (addr = addrlist; addr; addr = addr->next)
+        if (httpAddrIsEqual(httpGetAddress(con->http), &(addr->addr)))
+          break;
+    }
+    else
+      addr = NULL;
+
+    httpAddrFreeList(addrlist);
+
+    if (!addr)
+    {
+     /*
+      * Can't have a hostname that doesn't resolve to the same IP address
+      * with double-lookups enabled...
+      */
+
+      cupsdLogClient(con, CUPSD_LOG_WARN,
+                      "IP lookup failed - closing connection from %s!",
+                      httpGetHostname(con->http, NULL, 0));
+
+      httpClose(con->http);
+      free(con);
+      return (1);
+    }
+  }
+
+#ifdef HAVE_TCPD_H
+ /*
+  * See if the connection is denied by TCP wrappers...
+  */
+
+  request_init(&wrap_req, RQ_DAEMON, "cupsd", RQ_FILE, httpGetFd(con->http),
+               NULL);
+  fromhost(&wrap_req);
+
+  if (!hosts_access(&wrap_req))
+  {
+    cupsdLogClient(con, CUPSD_LOG_WARN,
+                    "Connection from %s refused by /etc/hosts.allow and "
+		    "/etc/hosts.deny rules.", httpGetHostname(con->http, NULL, 0));
+
+    httpClose(con->http);
+    free(con);
+    return (1);
+  }
+#endif /* HAVE_TCPD_H */
+
+#ifdef AF_LOCAL
+  if (httpAddrGetFamily(httpGetAddress(con->http)) == AF_LOCAL)
+  {
+#  ifdef __APPLE__
+    socklen_t	peersize;		/* Size of peer credentials */
+    pid_t	peerpid;		/* Peer process ID */
+    char	peername[256];		/* Name of process */
+
+    peersize = sizeof(peerpid);
+    if (!getsockopt(httpGetFd(con->http), SOL_LOCAL, LOCAL_PEERPID, &peerpid,
+                    &peersize))
+    {
+      if (!proc_name((int)peerpid, peername, sizeof(peername)))
+	cupsdLogClient(con, CUPSD_LOG_INFO,
+	               "Accepted from %s (Domain ???[%d])",
+                       httpGetHostname(con->http, NULL, 0), (int)peerpid);
+      else
+	cupsdLogClient(con, CUPSD_LOG_INFO,
+                       "Accepted from %s (Domain %s[%d])",
+                       httpGetHostname(con->http, NULL, 0), peername, (int)peerpid);
+    }
+    else
+#  endif /* __APPLE__ */
+
+    cupsdLogClient(con, CUPSD_LOG_INFO, "Accepted from %s (Domain)",
+                   httpGetHostname(con->http, NULL, 0));
+  }
+  else
+#endif /* AF_LOCAL */
+  cupsdLogClient(con, CUPSD_LOG_INFO, "Accepted from %s:%d (IPv%d)",
+                 httpGetHostname(con->http, NULL, 0),
+		 httpAddrGetPort(httpGetAddress(con->http)),
+		 httpAddrGetFamily(httpGetAddress(con->http)) == AF_INET ? 4 : 6);
+
+ /*
+  * Get the local address the client connected to...
+  */
+
+  addrlen = sizeof(temp);
+  if (getsockname(httpGetFd(con->http), (struct sockaddr *)&temp, &addrlen))
+  {
+    cupsdLogClient(con, CUPSD_LOG_ERROR, "Unable to get local address - %s",
+                   strerror(errno));
+
+    cupsCopyString(con->servername, "localhost", sizeof(con->servername));
+    con->serverport = LocalPort;
   }
-
-  if (bytes <= 0 ||
-      (httpGetState(con->http) != HTTP_STATE_GET_SEND &&
-       httpGetState(con->http) != HTTP_STATE_POST_SEND))
+#ifdef AF_LOCAL
+  else if (httpAddrGetFamily(&temp) == AF_LOCAL)
   {
-    if (!con->sent_header && con->pipe_pid)
-      cupsdSendError(con, HTTP_STATUS_SERVER_ERROR, CUPSD_AUTH_NONE);
+    cupsCopyString(con->servername, "localhost", sizeof(con->servername));
+    con->serverport = LocalPort;
+  }
+#endif /* AF_LOCAL */
+  else
+  {
+    if (httpAddrIsLocalhost(&temp))
+      cupsCopyString(con->servername, "localhost", sizeof(con->servername));
+    else if (HostNameLookups)
+      httpAddrLookup(&temp, con->servername, sizeof(con->servername));
     else
-    {
-      cupsdLogRequest(con, HTTP_STATUS_OK);
+      httpAddrGetString(&temp, con->servername, sizeof(con->servername));
 
-      if (httpIsChunked(con->http) && (!con->pipe_pid || con->sent_header > 0))
-      {
-        cupsdLogClient(con, CUPSD_LOG_DEBUG, "Sending 0-length chunk.");
+    con->serverport = httpAddrGetPort(&(lis->address));
+  }
 
-	if (httpWrite2(con->http, "", 0) < 0)
-	{
-	  cupsdLogClient(con, CUPSD_LOG_DEBUG, "Closing for error %d (%s)",
-			 httpGetError(con->http), strerror(httpGetError(con->http)));
-	  cupsdCloseClient(con);
-	  return;
-	}
-      }
+ /*
+  * Apply ServerHeader if any...
+  */
 
-      cupsdLogClient(con, CUPSD_LOG_DEBUG2, "Flushing write buffer.");
-      httpFlushWrite(con->http);
-      cupsdLogClient(con, CUPSD_LOG_DEBUG2, "New state is %s", httpStateString(httpGetState(con->http)));
-    }
+  if (ServerHeader)
+    httpSetDefaultField(con->http, HTTP_FIELD_SERVER, ServerHeader);
 
-    cupsdAddSelect(httpGetFd(con->http), (cupsd_selfunc_t)cupsdReadClient, NULL, con);
+ /*
+  * Add the connection to the array of active clients...
+  */
 
-    cupsdLogClient(con, CUPSD_LOG_DEBUG, "Waiting for request.");
+  cupsArrayAdd(Clients, con);
 
-    if (con->file >= 0)
-    {
-      cupsdRemoveSelect(con->file);
+  cupsdUpdateClientDeadline(con);
 
-      if (con->pipe_pid)
-	cupsdEndProcess(con->pipe_pid, 0);
+ /*
+  * Add the socket to the server select.
+  */
 
-      close(con->file);
-      con->file     = -1;
-      con->pipe_pid = 0;
-    }
+  cupsdAddSelect(httpGetFd(con->http), (cupsd_selfunc_t)cupsdReadClient, NULL,
+                 con);
 
-    if (con->filename)
-    {
-      unlink(con->filename);
-      cupsdClearString(&con->filename);
-    }
+  cupsdLogClient(con, CUPSD_LOG_DEBUG, "Waiting for request.");
 
-    if (con->request)
-    {
-      ippDelete(con->request);
-      con->request = NULL;
-    }
+ /*
+  * Temporarily suspend accept()'s until we lose a client...
+  */
 
-    if (con->response)
-    {
-      ippDelete(con->response);
-      con->response = NULL;
-    }
+  if (cupsArrayGetCount(Clients) == MaxClients)
+    cupsdPauseListening();
 
-    cupsdClearString(&con->command);
-    cupsdClearString(&con->options);
-    cupsdClearString(&con->query_string);
+ /*
+  * See if we are connecting on a secure port...
+  */
 
-    if (!httpGetKeepAlive(con->http))
-    {
-      cupsdLogClient(con, CUPSD_LOG_DEBUG,
-		     "Closing because Keep-Alive is disabled.");
-      cupsdCloseClient(con);
-      return;
-    }
-    else
-    {
-      cupsArrayRemove(ActiveClients, con);
-      cupsdSetBusyState(0);
-    }
+  if (lis->encryption == HTTP_ENCRYPTION_ALWAYS)
+  {
+   /*
+    * HTTPS connection, force TLS negotiation...
+    */
+
+    con->tls_start     = time(NULL);
+    con->encryption = HTTP_ENCRYPTION_ALWAYS;
+  }
+  else
+  {
+   /*
+    * HTTP connection, but check for HTTPS negotiation on first data...
+    */
+
+    con->auto_ssl = 1;
   }
+
+  return (1);
 }
 
 
@@ -2768,6 +3004,61 @@ check_start_tls(cupsd_client_t *con)	/* I - Client connection */
 }
 
 
+/*
+ * 'check_stream()' - Start or continue streaming a Print-Job document.
+ *
+ * When StreamJobs is enabled, a Print-Job request is processed as soon as
+ * enough of the document has been received to auto-type it, so that the job
+ * can start printing while the rest of the document is received.  The rest of
+ * the document is charged to the user's quota as it arrives.
+ */
+
+static int				/* O - 1 to continue, 0 to stop reading */
+check_stream(cupsd_client_t *con)	/* I - Client connection */
+{
+  cupsd_job_t	*job;			/* Job receiving the document */
+
+
+  if (con->stream_job)
+  {
+    if (!cupsdUpdateStreamingQuota(con))
+    {
+     /*
+      * Over quota, stop receiving the document...
+      */
+
+      close(con->file);
+      con->file = -1;
+      cupsdFinishStreamingRequest(con, 1);
+
+      if (!cupsdSendError(con, HTTP_STATUS_REQUEST_TOO_LARGE, CUPSD_AUTH_NONE))
+        cupsdCloseClient(con);
+
+      return (0);
+    }
+
+    if ((job = cupsdFindJob(con->stream_job)) != NULL)
+      cupsdUpdateJobStream(job);
+  }
+  else if (StreamJobs && !con->streaming && con->request &&
+           ippGetOperation(con->request) == IPP_OP_PRINT_JOB &&
+	   lseek(con->file, 0, SEEK_CUR) >= MIME_MAX_BUFFER)
+  {
+    cupsdLogClient(con, CUPSD_LOG_DEBUG, "Processing Print-Job request while receiving the document.");
+
+    con->streaming = 1;
+
+    if (!cupsdProcessIPPRequest(con))
+    {
+      cupsdCloseClient(con);
+      return (0);
+    }
+  }
+
+  return (1);
+}
+
+
 /*
  * 'compare_clients()' - Compare two client connections.
  */
@@ -2788,6 +3079,72 @@ compare_clients(cupsd_client_t *a, /* I - First client */
 }
 
 
+/*
+ * 'compare_deadlines()' - Compare the inactivity deadlines of two clients.
+ */
+
+static int				/* O - Result of comparison */
+compare_deadlines(cupsd_client_t *a,	/* I - First client */
+                  cupsd_client_t *b,	/* I - Second client */
+                  void           *data)	/* I - User data (not used) */
+{
+  (void)data;
+
+  if (a->deadline_time < b->deadline_time)
+    return (-1);
+  else if (a->deadline_time > b->deadline_time)
+    return (1);
+  else
+    return (a->number - b->number);
+}
+
+
+/*
+ * 'compare_notify_waits()' - Compare the Get-Notifications wait deadlines of
+ *                            two clients.
+ */
+
+static int				/* O - Result of comparison */
+compare_notify_waits(
+    cupsd_client_t *a,			/* I - First client */
+    cupsd_client_t *b,			/* I - Second client */
+    void           *data)		/* I - User data (not used) */
+{
+  (void)data;
+
+  if (a->notify_wait < b->notify_wait)
+    return (-1);
+  else if (a->notify_wait > b->notify_wait)
+    return (1);
+  else
+    return (a->number - b->number);
+}
+
+
+/*
+ * 'discard_data()' - Discard request data that was read but won't be written.
+ */
+
+static void
+discard_data(int spliced)		/* I - 1 if data is in the splice pipe */
+{
+#ifdef HAVE_SPLICE
+  if (spliced && splice_pipe[0] >= 0)
+  {
+   /*
+    * Close the pipe, a new one is created for the next read...
+    */
+
+    close(splice_pipe[0]);
+    close(splice_pipe[1]);
+    splice_pipe[0] = splice_pipe[1] = -1;
+  }
+#else
+  (void)spliced;
+#endif /* HAVE_SPLICE */
+}
+
+
 /*
  * 'get_file()' - Get a filename and state info.
  */
@@ -3687,6 +4044,79 @@ pipe_command(cupsd_client_t *con,	/* I - Client connection */
 }
 
 
+/*
+ * 'preallocate_file()' - Preallocate space for the request data.
+ *
+ * The length comes from the Content-Length or, for chunked requests, the
+ * "job-k-octets" attribute.  The file size is not changed so that partially
+ * received files look the same as before.
+ */
+
+static void
+preallocate_file(cupsd_client_t *con)	/* I - Client connection */
+{
+#ifdef HAVE_FALLOCATE
+  off_t			length = 0;	/* Length of request data */
+  ipp_attribute_t	*attr;		/* job-k-octets attribute */
+
+
+  if (!httpIsChunked(con->http))
+    length = httpGetRemaining(con->http);
+  else if ((attr = ippFindAttribute(con->request, "job-k-octets", IPP_TAG_INTEGER)) != NULL && !ippFindAttribute(con->request, "compression", IPP_TAG_KEYWORD))
+    length = 1024 * (off_t)ippGetInteger(attr, 0);
+
+  if (length <= 0 || (MaxRequestSize > 0 && length > MaxRequestSize))
+    return;
+
+  if (fallocate(con->file, FALLOC_FL_KEEP_SIZE, 0, length))
+    cupsdLogClient(con, CUPSD_LOG_DEBUG2, "Unable to preallocate " CUPS_LLFMT " bytes for \"%s\": %s", CUPS_LLCAST length, con->filename, strerror(errno));
+
+#else
+  (void)con;
+#endif /* HAVE_FALLOCATE */
+}
+
+
+/*
+ * 'read_data()' - Read request data from the client.
+ *
+ * Uncompressed, unencrypted request data is spliced into a pipe and then
+ * written to the request file with write_data() without copying it.
+ * Otherwise the data is read into the buffer.
+ */
+
+static ssize_t				/* O - Number of bytes read or -1 on error */
+read_data(cupsd_client_t *con,		/* I - Client connection */
+          char           *buffer,	/* I - Buffer */
+	  size_t         bufsize,	/* I - Size of buffer */
+	  int            *spliced)	/* O - 1 if data is in the splice pipe */
+{
+#ifdef HAVE_SPLICE
+  ssize_t	bytes;			/* Bytes read */
+
+
+  if (con->file >= 0 && splice_pipe[0] < 0 && pipe2(splice_pipe, O_CLOEXEC | O_NONBLOCK))
+  {
+    cupsdLogClient(con, CUPSD_LOG_DEBUG, "Unable to create splice pipe: %s", strerror(errno));
+    splice_pipe[0] = splice_pipe[1] = -1;
+  }
+
+  if (con->file >= 0 && splice_pipe[0] >= 0)
+  {
+    if ((bytes = _httpReadPipe(con->http, splice_pipe[1], CUPSD_SPLICE_MAX)) >= 0 || errno != ENOTSUP)
+    {
+      *spliced = 1;
+      return (bytes);
+    }
+  }
+#endif /* HAVE_SPLICE */
+
+  *spliced = 0;
+
+  return (httpRead2(con->http, buffer, bufsize));
+}
+
+
 /*
  * 'valid_host()' - Is the Host: field valid?
  */
@@ -3847,6 +4277,56 @@ valid_host(cupsd_client_t *con)		/* I - Client connection */
 }
 
 
+/*
+ * 'write_data()' - Write request data to the request file.
+ */
+
+static ssize_t				/* O - Number of bytes written or -1 on error */
+write_data(cupsd_client_t *con,		/* I - Client connection */
+           const char     *buffer,	/* I - Buffer */
+	   ssize_t        bytes,	/* I - Number of bytes */
+	   int            spliced)	/* I - 1 if data is in the splice pipe */
+{
+#ifdef HAVE_SPLICE
+  if (spliced)
+  {
+    ssize_t	total,			/* Total bytes written */
+		count;			/* Bytes written */
+    int		error;			/* Write error */
+
+
+    for (total = 0; total < bytes; total += count)
+    {
+      if ((count = splice(splice_pipe[0], NULL, con->file, NULL, (size_t)(bytes - total), SPLICE_F_MOVE)) > 0)
+        continue;
+      else if (count < 0 && errno == EINTR)
+      {
+        count = 0;
+        continue;
+      }
+
+     /*
+      * Discard the rest of the data in the pipe...
+      */
+
+      error = count < 0 ? errno : ENOSPC;
+
+      discard_data(spliced);
+
+      errno = error;
+      break;
+    }
+
+    return (total);
+  }
+#else
+  (void)spliced;
+#endif /* HAVE_SPLICE */
+
+  return (write(con->file, buffer, (size_t)bytes));
+}
+
+
 /*
  * 'write_file()' - Send a file via HTTP.
  */
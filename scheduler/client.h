@@ -24,8 +24,15 @@ struct cupsd_client_s
   http_t		*http;		/* HTTP client connection */
   ipp_t			*request,	/* IPP request information */
 			*response;	/* IPP response information */
+  cups_array_t		*response_attrs;/* Cached attributes referenced by
+					 * the response */
   cupsd_location_t	*best;		/* Best match for AAA */
   struct timeval	start;		/* Request start time */
+  double		start_time,	/* Request start time (monotonic) */
+			header_time,	/* Time when HTTP header was read */
+			ipp_start_time,	/* Time when IPP processing started */
+			ipp_end_time;	/* Time when IPP response was ready */
+  time_t		deadline_time;	/* Earliest inactivity timeout */
   http_state_t		operation;	/* Request operation */
   off_t			bytes;		/* Bytes transferred for this request */
   int			is_browser;	/* Is the client a web browser? */
@@ -48,7 +55,15 @@ struct cupsd_client_s
   int			file;		/* Input/output file */
   int			file_ready;	/* Input ready on file/pipe? */
   int			bg_pending;	/* Background response pending? */
+  time_t		notify_wait;	/* Get-Notifications wait deadline
+					 * (0 if not waiting) */
   cupsd_printer_t	*bg_printer;	/* Background printer */
+  int			streaming,	/* Processed request while receiving
+					 * its document? */
+			stream_job,	/* Job receiving the document, if any */
+			stream_kbytes,	/* Document size when job was created */
+			stream_auth;	/* Deferred authentication type */
+  http_status_t		stream_status;	/* Deferred HTTP error, if any */
   int			pipe_pid;	/* Pipe process ID (or 0 if not a pipe) */
   http_status_t		pipe_status;	/* HTTP status from pipe process */
   int			sent_header,	/* Non-zero if sent HTTP header */
@@ -110,8 +125,12 @@ VAR time_t		ListeningPaused	VALUE(0);
 					/* Time when listening was paused */
 VAR cups_array_t	*Clients	VALUE(NULL),
 					/* HTTP clients */
-			*ActiveClients	VALUE(NULL);
+			*ActiveClients	VALUE(NULL),
 					/* Active HTTP clients */
+			*ClientDeadlines VALUE(NULL),
+					/* Clients sorted by deadline_time */
+			*NotifyWaits	VALUE(NULL);
+					/* Clients sorted by notify_wait */
 VAR char		*ServerHeader	VALUE(NULL);
 					/* Server header in requests */
 VAR int			CGIPipes[2]	VALUE2(-1,-1);
@@ -125,6 +144,7 @@ VAR cupsd_statbuf_t	*CGIStatusBuffer VALUE(NULL);
  */
 
 extern void	cupsdAcceptClient(cupsd_listener_t *lis);
+extern void	cupsdCheckNotifyWaits(void);
 extern void	cupsdCloseAllClients(void);
 extern int	cupsdCloseClient(cupsd_client_t *con);
 extern void	cupsdDeleteAllListeners(void);
@@ -139,10 +159,16 @@ extern int	cupsdSendError(cupsd_client_t *con, http_status_t code,
 extern int	cupsdSendHeader(cupsd_client_t *con, http_status_t code,
 		                char *type, int auth_type);
 extern void	cupsdShutdownClient(cupsd_client_t *con);
+extern void	cupsdStartIPPThread(void);
 extern void	cupsdStartListening(void);
+extern void	cupsdStopIPPThread(void);
 extern void	cupsdStopListening(void);
 extern void	cupsdUpdateCGI(void);
+extern void	cupsdUpdateClientDeadline(cupsd_client_t *con);
 extern void	cupsdWriteClient(cupsd_client_t *con);
 
+extern void	cupsdEndNotifyWait(cupsd_client_t *con);
 extern int	cupsdEndTLS(cupsd_client_t *con);
+extern int	cupsdFinishStreamingRequest(cupsd_client_t *con, int aborted);
 extern int	cupsdStartTLS(cupsd_client_t *con);
+extern int	cupsdUpdateStreamingQuota(cupsd_client_t *con);
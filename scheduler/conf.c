@@ -89,6 +89,7 @@ static const cupsd_var_t	cupsd_vars[] =
 #ifdef HAVE_ONDEMAND
   { "IdleExitTimeout",		&IdleExitTimeout,	CUPSD_VARTYPE_TIME },
 #endif /* HAVE_ONDEMAND */
+  { "JobAttrCacheSize",		&JobAttrCacheSize,	CUPSD_VARTYPE_SIZE },
   { "JobKillDelay",		&JobKillDelay,		CUPSD_VARTYPE_TIME },
   { "JobRetryLimit",		&JobRetryLimit,		CUPSD_VARTYPE_INTEGER },
   { "JobRetryInterval",		&JobRetryInterval,	CUPSD_VARTYPE_TIME },
@@ -97,7 +98,9 @@ static const cupsd_var_t	cupsd_vars[] =
   { "LaunchdTimeout",		&IdleExitTimeout,	CUPSD_VARTYPE_TIME },
 #endif /* HAVE_LAUNCHD */
   { "LimitRequestBody",		&MaxRequestSize,	CUPSD_VARTYPE_SIZE },
+  { "LogBufferSize",		&LogBufferSize,		CUPSD_VARTYPE_SIZE },
   { "LogDebugHistory",		&LogDebugHistory,	CUPSD_VARTYPE_INTEGER },
+  { "MaxAccepts",		&MaxAccepts,		CUPSD_VARTYPE_INTEGER },
   { "MaxActiveJobs",		&MaxActiveJobs,		CUPSD_VARTYPE_INTEGER },
   { "MaxClients",		&MaxClients,		CUPSD_VARTYPE_INTEGER },
   { "MaxClientsPerHost",	&MaxClientsPerHost,	CUPSD_VARTYPE_INTEGER },
@@ -123,8 +126,10 @@ static const cupsd_var_t	cupsd_vars[] =
   { "RootCertDuration",		&RootCertDuration,	CUPSD_VARTYPE_TIME },
   { "ServerAdmin",		&ServerAdmin,		CUPSD_VARTYPE_STRING },
   { "ServerName",		&ServerName,		CUPSD_VARTYPE_STRING },
+  { "StreamJobs",		&StreamJobs,		CUPSD_VARTYPE_BOOLEAN },
   { "StrictConformance",	&StrictConformance,	CUPSD_VARTYPE_BOOLEAN },
   { "Timeout",			&Timeout,		CUPSD_VARTYPE_TIME },
+  { "TraceJobs",		&TraceJobs,		CUPSD_VARTYPE_BOOLEAN },
   { "WebInterface",		&WebInterface,		CUPSD_VARTYPE_BOOLEAN }
 };
 static const cupsd_var_t	cupsfiles_vars[] =
@@ -531,6 +536,8 @@ cupsdReadConfiguration(void)
   int		status;			/* Return status */
   char		temp[1024],		/* Temporary buffer */
 		mimedir[1024],		/* MIME directory */
+		mimepaths[2048],	/* MIME directories */
+		mimecache[1024],	/* MIME cache file */
 		*slash;			/* Directory separator */
   cups_lang_t	*language;		/* Language */
   struct passwd	*user;			/* Default user */
@@ -677,6 +684,9 @@ cupsdReadConfiguration(void)
   cupsArrayDelete(ReadyPaperSizes);
   ReadyPaperSizes = NULL;
 
+  cupsArrayDelete(JobSummaryAttrs);
+  JobSummaryAttrs = NULL;
+
   cupsdSetString(&TempDir, NULL);
 
 #ifdef HAVE_GSSAPI
@@ -762,12 +772,15 @@ cupsdReadConfiguration(void)
   FilterNice               = 0;
   HostNameLookups          = FALSE;
   KeepAlive                = TRUE;
+  LogBufferSize            = 1024 * 1024;
   LogDebugHistory          = 200;
   LogFilePerm              = CUPS_DEFAULT_LOG_FILE_PERM;
   LogFileGroup             = Group;
   LogLevel                 = CUPSD_LOG_WARN;
   StripUserDomain          = FALSE;
   LogTimeFormat            = CUPSD_TIME_STANDARD;
+  SlowRequestLog           = 0.0;
+  MaxAccepts               = 16;
   MaxClients               = 100;
   MaxClientsPerHost        = 0;
   MaxLogSize               = 1024 * 1024;
@@ -777,6 +790,7 @@ cupsdReadConfiguration(void)
   ReloadTimeout	           = DEFAULT_KEEPALIVE;
   RootCertDuration         = 300;
   Sandboxing               = CUPSD_SANDBOXING_STRICT;
+  StreamJobs               = FALSE;
   StrictConformance        = FALSE;
 #ifdef CUPS_DEFAULT_SYNC_ON_CLOSE
   SyncOnClose              = TRUE;
@@ -784,6 +798,7 @@ cupsdReadConfiguration(void)
   SyncOnClose              = FALSE;
 #endif /* CUPS_DEFAULT_SYNC_ON_CLOSE */
   Timeout                  = 900;
+  TraceJobs                = FALSE;
   WebInterface             = CUPS_DEFAULT_WEBIF;
 
   BrowseLocalProtocols     = parse_protocols(CUPS_DEFAULT_BROWSE_LOCAL_PROTOCOLS);
@@ -800,6 +815,7 @@ cupsdReadConfiguration(void)
   JobHistory          = DEFAULT_HISTORY;
   JobFiles            = DEFAULT_FILES;
   JobAutoPurge        = 0;
+  JobAttrCacheSize    = 4 * 1024 * 1024;
   MaxHoldTime         = 0;
   MaxJobs             = 500;
   MaxActiveJobs       = 0;
@@ -1348,6 +1364,9 @@ cupsdReadConfiguration(void)
       ReadyPaperSizes = cupsArrayNewStrings(DefaultPaperSize, ',');
   }
 
+  if (!JobSummaryAttrs)
+    JobSummaryAttrs = cupsArrayNewStrings("document-format,job-impressions-completed,job-media-sheets-completed,job-originating-host-name,job-printer-state-message", ',');
+
  /*
   * Update classification setting as needed...
   */
@@ -1398,6 +1417,13 @@ cupsdReadConfiguration(void)
                   "Allowing up to %d client connections per host.",
                   MaxClientsPerHost);
 
+ /*
+  * Update the MaxAccepts value, as needed...
+  */
+
+  if (MaxAccepts <= 0)
+    MaxAccepts = 1;
+
  /*
   * Update the default policy, as needed...
   */
@@ -1628,15 +1654,14 @@ cupsdReadConfiguration(void)
 
     snprintf(temp, sizeof(temp), "%s/filter", ServerBin);
     snprintf(mimedir, sizeof(mimedir), "%s/mime", DataDir);
+    snprintf(mimepaths, sizeof(mimepaths), "%s:%s", mimedir, ServerRoot);
+    snprintf(mimecache, sizeof(mimecache), "%s/mime.cache", CacheDir);
 
     MimeDatabase = mimeNew();
     mimeSetErrorCallback(MimeDatabase, mime_error_cb, NULL);
 
     mimeAddType(MimeDatabase, "application", "octet-stream");
-    mimeLoadTypes(MimeDatabase, mimedir);
-    mimeLoadTypes(MimeDatabase, ServerRoot);
-    mimeLoadFilters(MimeDatabase, mimedir, temp);
-    mimeLoadFilters(MimeDatabase, ServerRoot, temp);
+    mimeLoadCache(MimeDatabase, mimecache, mimepaths, temp);
 
     if (mimeNumTypes(MimeDatabase) == 1 || mimeNumFilters(MimeDatabase) == 0)
     {
@@ -3478,6 +3503,37 @@ read_cupsd_conf(cups_file_t *fp)	/* I - File to read from */
         cupsdLogMessage(CUPSD_LOG_WARN, "Unknown LogTimeFormat %s on line %d of %s.",
 	                value, linenum, ConfigurationFile);
     }
+    else if (!_cups_strcasecmp(line, "SlowRequestLog") && value)
+    {
+     /*
+      * Threshold in seconds for logging slow IPP requests...
+      */
+
+      char	*units;			/* Units after number */
+
+      if (!_cups_strcasecmp(value, "off") || !_cups_strcasecmp(value, "no"))
+        SlowRequestLog = 0.0;
+      else if ((SlowRequestLog = strtod(value, &units)) < 0.0 || (*units && _cups_strcasecmp(units, "s") && _cups_strcasecmp(units, "ms")))
+      {
+        cupsdLogMessage(CUPSD_LOG_WARN, "Unknown SlowRequestLog %s on line %d of %s.",
+	                value, linenum, ConfigurationFile);
+        SlowRequestLog = 0.0;
+      }
+      else if (!_cups_strcasecmp(units, "ms"))
+        SlowRequestLog /= 1000.0;
+    }
+    else if (!_cups_strcasecmp(line, "JobSummaryAttributes") && value)
+    {
+     /*
+      * JobSummaryAttributes name[,name,...]
+      */
+
+      if (!JobSummaryAttrs)
+        JobSummaryAttrs = cupsArrayNewStrings(NULL, ',');
+
+      if (_cups_strcasecmp(value, "none"))
+        cupsArrayAddStrings(JobSummaryAttrs, value, ',');
+    }
     else if (!_cups_strcasecmp(line, "ReadyPaperSizes") && value)
     {
      /*
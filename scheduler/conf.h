@@ -151,8 +151,10 @@ VAR char		*AccessLog		VALUE(NULL),
 					/* Remote root user */
 			*Classification		VALUE(NULL);
 					/* Classification of system */
-VAR cups_array_t	*ReadyPaperSizes	VALUE(NULL);
+VAR cups_array_t	*ReadyPaperSizes	VALUE(NULL),
 					/* List of paper sizes to list as ready */
+			*JobSummaryAttrs	VALUE(NULL);
+					/* Job attributes kept for unloaded jobs */
 VAR uid_t		User			VALUE(1),
 					/* User ID for server */
 			RunUser			VALUE(0);
@@ -185,11 +187,22 @@ VAR cupsd_time_t	LogTimeFormat		VALUE(CUPSD_TIME_STANDARD);
 					/* Log file time format */
 VAR cups_file_t		*LogStderr		VALUE(NULL);
 					/* Stderr file, if any */
+VAR off_t		LogBufferSize		VALUE(1024 * 1024);
+					/* Size of log buffer for log thread */
+VAR long		LogDroppedLines		VALUE(0);
+					/* Log lines dropped because the log
+					 * buffer was full */
+VAR double		SlowRequestLog		VALUE(0.0);
+					/* Log IPP requests that take longer
+					 * than this many seconds (0 = off) */
 VAR cupsd_sandboxing_t	Sandboxing		VALUE(CUPSD_SANDBOXING_STRICT);
 					/* Sandboxing level */
 VAR int			UseSandboxing	VALUE(1);
 					/* Use sandboxing for child procs? */
-VAR int			MaxClients		VALUE(100),
+VAR int			MaxAccepts		VALUE(16),
+					/* Maximum number of connections to
+					 * accept at a time */
+			MaxClients		VALUE(100),
 					/* Maximum number of clients */
 			MaxClientsPerHost	VALUE(0),
 					/* Maximum number of clients per host */
@@ -290,5 +303,7 @@ extern int	cupsdLogPage(cupsd_job_t *job, const char *page);
 extern int	cupsdLogPrinter(cupsd_printer_t *p, int level, const char *message, ...) _CUPS_FORMAT(3, 4);
 extern int	cupsdLogRequest(cupsd_client_t *con, http_status_t code);
 extern int	cupsdReadConfiguration(void);
+extern void	cupsdStartLogThread(void);
+extern void	cupsdStopLogThread(void);
 extern int	cupsdWriteErrorLog(int level, const char *message);
 extern void	cupsdWriteStrings(void);
@@ -124,6 +124,8 @@ typedef struct cupsd_printer_s cupsd_printer_t;
 #include "dirsvc.h"
 #include "network.h"
 #include "subscriptions.h"
+#include "metrics.h"
+#include "trace.h"
 
 
 /*
@@ -159,6 +161,9 @@ VAR int			NeedReload	VALUE(RELOAD_ALL),
 					/* Shutting down the scheduler? */
 VAR void		*DefaultProfile	VALUE(0);
 					/* Default security profile */
+VAR cups_rwlock_t	StateLock	VALUE(CUPS_RWLOCK_INITIALIZER);
+					/* Scheduler state, held by the main
+					 * thread except while polling */
 
 #ifdef HAVE_ONDEMAND
 VAR int			OnDemand	VALUE(0);
@@ -215,13 +220,20 @@ extern int		cupsdStartProcess(const char *command, char *argv[],
 /* select.c */
 extern int		cupsdAddSelect(int fd, cupsd_selfunc_t read_cb,
 			               cupsd_selfunc_t write_cb, void *data);
+extern int		cupsdAddSelectEdge(int fd, cupsd_selfunc_t read_cb,
+			                   cupsd_selfunc_t write_cb,
+					   void *data);
 extern int		cupsdDoSelect(long timeout);
+extern void		cupsdHoldState(void);
 #ifdef CUPSD_IS_SELECTING
 extern int		cupsdIsSelecting(int fd);
 #endif /* CUPSD_IS_SELECTING */
+extern int		cupsdIsStateWanted(void);
 extern void		cupsdRemoveSelect(int fd);
-extern void		cupsdStartSelect(void);
+extern void		cupsdSetSelectPending(int fd);
+extern void		cupsdStartSelect(const char *backend);
 extern void		cupsdStopSelect(void);
+extern void		cupsdWaitState(void);
 
 /* server.c */
 extern void		cupsdStartServer(void);
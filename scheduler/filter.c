@@ -24,19 +24,42 @@ typedef struct _mime_typelist_s		// List of source types
   mime_type_t		*src;		// Source type
 } _mime_typelist_t;
 
+typedef struct _mime_fpath_s		// Cached filter path
+{
+  mime_type_t	*src,			// Source type
+		*dst;			// Destination type
+  size_t	srcsize;		// Source size class
+  int		cost;			// Cost of filters
+  cups_array_t	*filters;		// Filters to run or `NULL` for none
+} _mime_fpath_t;
+
+typedef struct _mime_fpaths_s		// Cached filter paths
+{
+  cups_array_t	*paths;			// Filter paths
+  size_t	num_sizes,		// Number of filter size limits
+		*sizes;			// Sorted filter size limits
+} _mime_fpaths_t;
+
 
 //
 // Local functions...
 //
 
+static void		mime_add_ftype(mime_t *mime, mime_filter_t *filter);
+static int		mime_compare_fpaths(_mime_fpath_t *a, _mime_fpath_t *b, void *data);
 static int		mime_compare_ftypes(mime_ftypes_t *a, mime_ftypes_t *b, void *data);
 static int		mime_compare_filters(mime_filter_t *, mime_filter_t *, void *);
+static int		mime_compare_sizes(const size_t *a, const size_t *b);
 static int		mime_compare_srcs(mime_filter_t *, mime_filter_t *, void *);
+static void		mime_delete_reach(mime_t *mime);
+static _mime_fpaths_t	*mime_find_fpaths(mime_t *mime);
 static mime_ftypes_t	*mime_find_ftypes(mime_t *mime, mime_type_t *dst);
 static cups_array_t	*mime_find_filters(mime_t *mime, mime_type_t *src, size_t srcsize, mime_type_t *dst, int *cost, _mime_typelist_t *visited);
+static void		mime_free_fpath(_mime_fpath_t *p, void *data);
 static void		mime_free_ftypes(mime_ftypes_t *c, void *data);
 static void		mime_free_filter(mime_filter_t *f, void *data);
 static cups_array_t	*mime_get_filter_types(mime_t *mime, mime_type_t *dst, cups_array_t *srcs, int level);
+static cups_array_t	*mime_get_reach(mime_t *mime, mime_type_t *dst);
 
 
 //
@@ -62,6 +85,9 @@ mimeAddFilter(mime_t      *mime,	// I - MIME database
     return (NULL);
   }
 
+  // Any change to the filters invalidates the cached filter paths...
+  _mimeDeleteFilterPaths(mime);
+
   // See if we already have an existing filter for the given source and
   // destination...
   if ((temp = mimeFilterLookup(mime, src, dst)) != NULL)
@@ -96,6 +122,9 @@ mimeAddFilter(mime_t      *mime,	// I - MIME database
     MIME_DEBUG("mimeAddFilter: Adding new filter.\n");
     cupsArrayAdd(mime->filters, temp);
     cupsArrayAdd(mime->srcs, temp);
+
+    if (mime->ftypes)
+      mime_add_ftype(mime, temp);
   }
 
   // Return the new/updated filter...
@@ -105,6 +134,29 @@ mimeAddFilter(mime_t      *mime,	// I - MIME database
 }
 
 
+//
+// '_mimeDeleteFilterPaths()' - Delete the cached filter paths.
+//
+
+void
+_mimeDeleteFilterPaths(mime_t *mime)	// I - MIME database
+{
+  _mime_fpaths_t	*fpaths;	// Cached filter paths
+
+
+  if (!mime || (fpaths = mime->fpaths) == NULL)
+    return;
+
+  MIME_DEBUG("_mimeDeleteFilterPaths(mime=%p)\n", (void *)mime);
+
+  cupsArrayDelete(fpaths->paths);
+  free(fpaths->sizes);
+  free(fpaths);
+
+  mime->fpaths = NULL;
+}
+
+
 //
 // 'mimeFilter()' - Find the fastest way to convert from one type to another.
 //
@@ -134,6 +186,9 @@ mimeFilter2(mime_t      *mime,		// I - MIME database
 	    int         *cost)		// O - Cost of filters
 {
   cups_array_t	*filters;		// Array of filters to run
+  _mime_fpaths_t *fpaths;		// Cached filter paths
+  _mime_fpath_t	key,			// Search key
+		*path;			// Cached filter path
 
 
   // Range-check the input...
@@ -145,19 +200,71 @@ mimeFilter2(mime_t      *mime,		// I - MIME database
   if (!mime || !src || !dst)
     return (NULL);
 
-  // (Re)build the source lookup array as needed...
-  if (!mime->srcs)
+  // Files whose size falls between the same two filter size limits use the
+  // same filters, so the cached paths are keyed by the next larger limit...
+  if ((fpaths = mime_find_fpaths(mime)) == NULL)
+    return (NULL);
+
+  key.src     = src;
+  key.dst     = dst;
+  key.srcsize = SIZE_MAX;
+
+  if (fpaths->num_sizes > 0 && srcsize <= fpaths->sizes[fpaths->num_sizes - 1])
   {
-    mime_filter_t	*current;	// Current filter
+    size_t	left,			// Left side of search
+		right;			// Right side of search
 
-    mime->srcs = cupsArrayNew((cups_array_cb_t)mime_compare_srcs, NULL);
+    for (left = 0, right = fpaths->num_sizes - 1; left < right;)
+    {
+      size_t	current = (left + right) / 2;
+					// Current size limit
 
-    for (current = mimeFirstFilter(mime); current; current = mimeNextFilter(mime))
-      cupsArrayAdd(mime->srcs, current);
+      if (srcsize <= fpaths->sizes[current])
+        right = current;
+      else
+        left = current + 1;
+    }
+
+    key.srcsize = fpaths->sizes[left];
+  }
+
+  if ((path = (_mime_fpath_t *)cupsArrayFind(fpaths->paths, &key)) == NULL)
+  {
+    // (Re)build the source lookup array as needed...
+    if (!mime->srcs)
+    {
+      mime_filter_t	*current;	// Current filter
+
+      mime->srcs = cupsArrayNew((cups_array_cb_t)mime_compare_srcs, NULL);
+
+      for (current = mimeFirstFilter(mime); current; current = mimeNextFilter(mime))
+	cupsArrayAdd(mime->srcs, current);
+    }
+
+    // Find the least costly filters and cache them...
+    if ((path = (_mime_fpath_t *)calloc(1, sizeof(_mime_fpath_t))) == NULL)
+      return (NULL);
+
+    *path         = key;
+    path->filters = mime_find_filters(mime, src, key.srcsize, dst, &path->cost, NULL);
+
+    MIME_DEBUG("mimeFilter2: Caching %d filter(s), cost %d, for size class " CUPS_LLFMT ".\n", cupsArrayGetCount(path->filters), path->cost, CUPS_LLCAST key.srcsize);
+
+    cupsArrayAdd(fpaths->paths, path);
   }
 
-  // Find the filters...
-  filters = mime_find_filters(mime, src, srcsize, dst, cost, NULL);
+  // Return a copy of the cached filters...
+  if (path->filters)
+  {
+    filters = cupsArrayDup(path->filters);
+
+    if (cost)
+      *cost = path->cost;
+  }
+  else
+  {
+    filters = NULL;
+  }
 
   MIME_DEBUG("mimeFilter2: Returning %d filter(s), cost %d:\n", cupsArrayCount(filters), cost ? *cost : -1);
 #ifdef DEBUG
@@ -216,43 +323,143 @@ mimeGetFilterTypes(mime_t       *mime,	// I - MIME database
   if (!mime->ftypes)
   {
     mime_filter_t	*current;	// Current filter
-    mime_ftypes_t	*cftype;	// Current filter type
 
     MIME_DEBUG("mimeGetFilterTypes: Building the filter destination cache.\n");
 
     mime->ftypes = cupsArrayNew3((cups_array_cb_t)mime_compare_ftypes, /*cb_data*/NULL, /*hash_cb*/NULL, /*hash_size*/0, /*copy_cb*/NULL, (cups_afree_cb_t)mime_free_ftypes);
 
     for (current = mimeFirstFilter(mime); current; current = mimeNextFilter(mime))
-    {
-      // See if we have a cache for this destination type...
-      MIME_DEBUG("mimeGetFilterTypes: Filter '%s' (%s/%s to %s/%s, cost %d)\n", current->filter, current->src->super, current->src->type, current->dst->super, current->dst->type, current->cost);
+      mime_add_ftype(mime, current);
+  }
 
-      if ((cftype = mime_find_ftypes(mime, current->dst)) == NULL)
-      {
-	// No, add a cache for this type...
-	if ((cftype = (mime_ftypes_t *)calloc(1, sizeof(mime_ftypes_t))) != NULL)
-	{
-	  MIME_DEBUG("mimeGetFilterTypes: Adding %s/%s to destination cache.\n", current->dst->super, current->dst->type);
-	  cftype->dst = current->dst;
-	  cupsArrayAdd(mime->ftypes, cftype);
-	}
-      }
+  // Get source types...
+  return (mime_get_filter_types(mime, dst, srcs, 0));
+}
 
-      if (cftype && !cupsArrayFind(cftype->srcs, current->src))
-      {
-	// Add source type to list of source types that can be converted to the
-	// destination type...
-	if (!cftype->srcs)
-	  cftype->srcs = cupsArrayNew3((cups_array_cb_t)_mimeCompareTypes, /*cb_data*/NULL, /*hash_cb*/NULL, /*hash_size*/0, /*copy_cb*/NULL, /*free_cb*/NULL);
 
-        MIME_DEBUG("mimeGetFilterTypes: Adding %s/%s to %s/%s association.\n", current->src->super, current->src->type, current->dst->super, current->dst->type);
-	cupsArrayAdd(cftype->srcs, current->src);
-      }
-    }
+//
+// '_mimeRemoveFilter()' - Update the lookup caches for a filter that is being deleted.
+//
+
+void
+_mimeRemoveFilter(mime_t        *mime,	// I - MIME database
+                  mime_filter_t *filter)// I - Filter
+{
+  mime_ftypes_t	*cftype;		// Filter types for destination
+
+
+  MIME_DEBUG("_mimeRemoveFilter(mime=%p, filter=%p)\n", (void *)mime, (void *)filter);
+
+  _mimeDeleteFilterPaths(mime);
+
+  // The source lookup cache is sorted by source type only, so it cannot be
+  // updated in place...
+  if (mime->srcs)
+  {
+    MIME_DEBUG("_mimeRemoveFilter: Deleting source lookup cache.\n");
+    cupsArrayDelete(mime->srcs);
+    mime->srcs = NULL;
   }
 
-  // Get source types...
-  return (mime_get_filter_types(mime, dst, srcs, 0));
+  // There is only one filter for each source and destination pair, so just
+  // remove the source type from the destination lookup cache...
+  if ((cftype = mime_find_ftypes(mime, filter->dst)) != NULL)
+  {
+    MIME_DEBUG("_mimeRemoveFilter: Removing %s/%s to %s/%s association.\n", filter->src->super, filter->src->type, filter->dst->super, filter->dst->type);
+    cupsArrayRemove(cftype->srcs, filter->src);
+
+    if (strcmp(filter->dst->super, "printer"))
+      mime_delete_reach(mime);
+  }
+}
+
+
+//
+// '_mimeRemoveType()' - Update the lookup caches for a type that is being deleted.
+//
+
+void
+_mimeRemoveType(mime_t      *mime,	// I - MIME database
+                mime_type_t *mt)	// I - Type
+{
+  mime_ftypes_t	*cftype;		// Filter types for type
+
+
+  MIME_DEBUG("_mimeRemoveType(mime=%p, mt=%p(%s/%s))\n", (void *)mime, (void *)mt, mt->super, mt->type);
+
+  _mimeDeleteFilterPaths(mime);
+
+  if ((cftype = mime_find_ftypes(mime, mt)) != NULL)
+    cupsArrayRemove(mime->ftypes, cftype);
+
+  if (strcmp(mt->super, "printer"))
+    mime_delete_reach(mime);
+}
+
+
+//
+// 'mime_add_ftype()' - Add a filter to the destination lookup cache.
+//
+
+static void
+mime_add_ftype(mime_t        *mime,	// I - MIME database
+               mime_filter_t *filter)	// I - Filter
+{
+  mime_ftypes_t	*cftype;		// Filter types for destination
+
+
+  MIME_DEBUG("mime_add_ftype: Filter '%s' (%s/%s to %s/%s, cost %d)\n", filter->filter, filter->src->super, filter->src->type, filter->dst->super, filter->dst->type, filter->cost);
+
+  // See if we have a cache for this destination type...
+  if ((cftype = mime_find_ftypes(mime, filter->dst)) == NULL)
+  {
+    // No, add a cache for this type...
+    if ((cftype = (mime_ftypes_t *)calloc(1, sizeof(mime_ftypes_t))) == NULL)
+      return;
+
+    MIME_DEBUG("mime_add_ftype: Adding %s/%s to destination cache.\n", filter->dst->super, filter->dst->type);
+    cftype->dst = filter->dst;
+    cupsArrayAdd(mime->ftypes, cftype);
+  }
+
+  if (!cupsArrayFind(cftype->srcs, filter->src))
+  {
+    // Add source type to list of source types that can be converted to the
+    // destination type...
+    if (!cftype->srcs)
+      cftype->srcs = cupsArrayNew3((cups_array_cb_t)_mimeCompareTypes, /*cb_data*/NULL, /*hash_cb*/NULL, /*hash_size*/0, /*copy_cb*/NULL, /*free_cb*/NULL);
+
+    MIME_DEBUG("mime_add_ftype: Adding %s/%s to %s/%s association.\n", filter->src->super, filter->src->type, filter->dst->super, filter->dst->type);
+    cupsArrayAdd(cftype->srcs, filter->src);
+
+    // Printer types are only ever final destinations, so new printer filters
+    // do not change what the other types can be converted from...
+    if (strcmp(filter->dst->super, "printer"))
+      mime_delete_reach(mime);
+  }
+}
+
+
+//
+// 'mime_compare_fpaths()' - Compare two cached filter paths.
+//
+
+static int				// O - Result of comparison
+mime_compare_fpaths(
+    _mime_fpath_t *a,			// I - First path
+    _mime_fpath_t *b,			// I - Second path
+    void          *data)		// I - Callback data (not used)
+{
+  (void)data;
+
+  if (a->src != b->src)
+    return (a->src < b->src ? -1 : 1);
+  else if (a->dst != b->dst)
+    return (a->dst < b->dst ? -1 : 1);
+  else if (a->srcsize != b->srcsize)
+    return (a->srcsize < b->srcsize ? -1 : 1);
+  else
+    return (0);
 }
 
 
@@ -289,6 +496,23 @@ mime_compare_filters(mime_filter_t *f0, // I - First filter
 }
 
 
+//
+// 'mime_compare_sizes()' - Compare two filter size limits.
+//
+
+static int				// O - Result of comparison
+mime_compare_sizes(const size_t *a,	// I - First size
+                   const size_t *b)	// I - Second size
+{
+  if (*a < *b)
+    return (-1);
+  else if (*a > *b)
+    return (1);
+  else
+    return (0);
+}
+
+
 //
 // 'mime_compare_srcs()' - Compare two filter source types.
 //
@@ -303,6 +527,88 @@ mime_compare_srcs(
 }
 
 
+//
+// 'mime_delete_reach()' - Delete the cached source types for all destinations.
+//
+
+static void
+mime_delete_reach(mime_t *mime)		// I - MIME database
+{
+  mime_ftypes_t	*cftype;		// Current filter types
+
+
+  for (cftype = (mime_ftypes_t *)cupsArrayGetFirst(mime->ftypes); cftype; cftype = (mime_ftypes_t *)cupsArrayGetNext(mime->ftypes))
+  {
+    cupsArrayDelete(cftype->reach);
+    cftype->reach = NULL;
+  }
+}
+
+
+//
+// 'mime_find_fpaths()' - Find or create the cached filter paths.
+//
+
+static _mime_fpaths_t *			// O - Cached filter paths
+mime_find_fpaths(mime_t *mime)		// I - MIME database
+{
+  _mime_fpaths_t	*fpaths;	// Cached filter paths
+  mime_filter_t		*current;	// Current filter
+  size_t		i,		// Looping var
+			num_sizes;	// Number of unique sizes
+
+
+  if (mime->fpaths)
+    return (mime->fpaths);
+
+  if ((fpaths = (_mime_fpaths_t *)calloc(1, sizeof(_mime_fpaths_t))) == NULL)
+    return (NULL);
+
+  if ((fpaths->paths = cupsArrayNew3((cups_array_cb_t)mime_compare_fpaths, /*cb_data*/NULL, /*hash_cb*/NULL, /*hash_size*/0, /*copy_cb*/NULL, (cups_afree_cb_t)mime_free_fpath)) == NULL)
+  {
+    free(fpaths);
+    return (NULL);
+  }
+
+  // Collect the unique filter size limits...
+  for (current = mimeFirstFilter(mime); current; current = mimeNextFilter(mime))
+  {
+    if (current->maxsize > 0)
+      fpaths->num_sizes ++;
+  }
+
+  if (fpaths->num_sizes > 0)
+  {
+    if ((fpaths->sizes = (size_t *)calloc(fpaths->num_sizes, sizeof(size_t))) == NULL)
+    {
+      cupsArrayDelete(fpaths->paths);
+      free(fpaths);
+      return (NULL);
+    }
+
+    for (current = mimeFirstFilter(mime), i = 0; current; current = mimeNextFilter(mime))
+    {
+      if (current->maxsize > 0)
+        fpaths->sizes[i ++] = current->maxsize;
+    }
+
+    qsort(fpaths->sizes, fpaths->num_sizes, sizeof(size_t), (int (*)(const void *, const void *))mime_compare_sizes);
+
+    for (i = 1, num_sizes = 1; i < fpaths->num_sizes; i ++)
+    {
+      if (fpaths->sizes[i] != fpaths->sizes[num_sizes - 1])
+        fpaths->sizes[num_sizes ++] = fpaths->sizes[i];
+    }
+
+    fpaths->num_sizes = num_sizes;
+  }
+
+  MIME_DEBUG("mime_find_fpaths: Created filter path cache with %u size limit(s).\n", (unsigned)fpaths->num_sizes);
+
+  return (mime->fpaths = fpaths);
+}
+
+
 //
 // 'mime_find_ftypes()' - Find a filter cache.
 //
@@ -470,6 +776,21 @@ mime_find_filters(
 }
 
 
+//
+// 'mime_free_fpath()' - Free a cached filter path.
+//
+
+static void
+mime_free_fpath(_mime_fpath_t *p,	// I - Filter path
+                void          *data)	// I - Callback data (not used)
+{
+  (void)data;
+
+  cupsArrayDelete(p->filters);
+  free(p);
+}
+
+
 //
 // 'mime_free_ftypes()' - Free a filter cache entry.
 //
@@ -480,6 +801,8 @@ mime_free_ftypes(mime_ftypes_t *c,	// I - Filter cache data
 {
   (void)data;
 
+  cupsArrayDelete(c->srcs);
+  cupsArrayDelete(c->reach);
   free(c);
 }
 
@@ -510,46 +833,59 @@ mime_get_filter_types(
     int          level)			// I - Recursion level
 {
   mime_ftypes_t	*c;			// Filter cache data
+  cups_array_t	*types;			// Source types to add
   int		i,			// Current source type
 		count;			// Number of source types
   mime_type_t	*src;			// Source type, if any
 
 
   // Lookup filters that produce the destination format...
-  if ((c = mime_find_ftypes(mime, dst)) != NULL)
+  if ((c = mime_find_ftypes(mime, dst)) == NULL)
+    return (srcs);
+
+  if (strcmp(dst->super, "printer"))
   {
-    // Add all of the source types that can be converted to this destination type...
-    for (i = 0, count = cupsArrayGetCount(c->srcs); i < count; i ++)
-    {
-      src = (mime_type_t *)cupsArrayGetElement(c->srcs, i);
+    // Other types use the cached list of every type that can be converted...
+    if (!c->reach)
+      c->reach = mime_get_reach(mime, dst);
 
-      if (!strcmp(src->super, "printer"))
-      {
-	if (level < 4)
-	{
-	  // Add filters that can convert to this type...
-	  srcs = mime_get_filter_types(mime, src, srcs, level + 1);
-	}
+    types = c->reach;
+  }
+  else
+  {
+    types = c->srcs;
+  }
 
-        continue;
-      }
+  // Add all of the source types that can be converted to this destination type...
+  for (i = 0, count = cupsArrayGetCount(types); i < count; i ++)
+  {
+    src = (mime_type_t *)cupsArrayGetElement(types, i);
 
-      if (!cupsArrayFind(srcs, src))
+    if (!strcmp(src->super, "printer"))
+    {
+      if (level < 4)
       {
-	// Make sure we have the source types array...
-	if (!srcs)
-	  srcs = cupsArrayNew3((cups_array_cb_t)_mimeCompareTypes, /*cb_data*/NULL, /*hash_cb*/NULL, /*hash_size*/0, /*copy_cb*/NULL, /*free_cb*/NULL);
-
-        // Add the source to the array...
-        MIME_DEBUG("mime_get_filter_types: Adding %s/%s to %s/%s filter.\n", src->super, src->type, dst->super, dst->type);
-	cupsArrayAdd(srcs, src);
-
-	if (level < 4)
-	{
-	  // Add filters that can convert to this type...
-	  srcs = mime_get_filter_types(mime, src, srcs, level + 1);
-	}
+	// Add filters that can convert to this type...
+	srcs = mime_get_filter_types(mime, src, srcs, level + 1);
       }
+
+      continue;
+    }
+
+    if (!cupsArrayFind(srcs, src))
+    {
+      // Make sure we have the source types array...
+      if (!srcs)
+	srcs = cupsArrayNew3((cups_array_cb_t)_mimeCompareTypes, /*cb_data*/NULL, /*hash_cb*/NULL, /*hash_size*/0, /*copy_cb*/NULL, /*free_cb*/NULL);
+
+      // Add the source to the array...
+      MIME_DEBUG("mime_get_filter_types: Adding %s/%s to %s/%s filter.\n", src->super, src->type, dst->super, dst->type);
+      cupsArrayAdd(srcs, src);
+
+      // Add the types that can be converted to this type, which are already
+      // in the list when we got here from a cached list...
+      if (types == c->srcs)
+	srcs = mime_get_filter_types(mime, src, srcs, level + 1);
     }
   }
 
@@ -560,3 +896,61 @@ mime_get_filter_types(
 
   return (srcs);
 }
+
+
+//
+// 'mime_get_reach()' - Get all of the source types that can be converted to a destination type.
+//
+// Printer types are skipped since they are only used as final destinations.
+//
+
+static cups_array_t *			// O - Source types
+mime_get_reach(mime_t      *mime,	// I - MIME database
+               mime_type_t *dst)	// I - Destination type
+{
+  cups_array_t	*reach;			// Source types
+  mime_type_t	**stack,		// Types to visit
+		*type,			// Current type
+		*src;			// Current source type
+  int		num_stack;		// Number of types to visit
+  mime_ftypes_t	*c;			// Filter cache data
+
+
+  MIME_DEBUG("mime_get_reach(mime=%p, dst=%p(%s/%s))\n", (void *)mime, (void *)dst, dst->super, dst->type);
+
+  // Do a depth-first search of the source types, visiting each type once...
+  if ((reach = cupsArrayNew3((cups_array_cb_t)_mimeCompareTypes, /*cb_data*/NULL, /*hash_cb*/NULL, /*hash_size*/0, /*copy_cb*/NULL, /*free_cb*/NULL)) == NULL)
+    return (NULL);
+
+  if ((stack = (mime_type_t **)calloc((size_t)mimeNumTypes(mime) + 1, sizeof(mime_type_t *))) == NULL)
+  {
+    cupsArrayDelete(reach);
+    return (NULL);
+  }
+
+  stack[0]  = dst;
+  num_stack = 1;
+
+  while (num_stack > 0)
+  {
+    type = stack[-- num_stack];
+
+    if ((c = mime_find_ftypes(mime, type)) == NULL)
+      continue;
+
+    for (src = (mime_type_t *)cupsArrayGetFirst(c->srcs); src; src = (mime_type_t *)cupsArrayGetNext(c->srcs))
+    {
+      if (!strcmp(src->super, "printer") || cupsArrayFind(reach, src))
+        continue;
+
+      cupsArrayAdd(reach, src);
+      stack[num_stack ++] = src;
+    }
+  }
+
+  free(stack);
+
+  MIME_DEBUG("mime_get_reach: Returning %d types.\n", (int)cupsArrayGetCount(reach));
+
+  return (reach);
+}
@@ -25,6 +25,37 @@ extern int mbr_check_membership_by_id(uuid_t user, gid_t group, int* ismember);
 #endif /* __APPLE__ */
 
 
+/*
+ * Local types...
+ */
+
+typedef struct cupsd_ippwork_s		/**** Queued read-only IPP request ****/
+{
+  cupsd_client_t	*con;		/* Client connection */
+  ipp_attribute_t	*uri;		/* Target URI */
+} cupsd_ippwork_t;
+
+
+/*
+ * Local globals...
+ */
+
+static cups_cond_t	ipp_cond = CUPS_COND_INITIALIZER;
+					/* Condition for queued requests */
+static cups_array_t	*ipp_done = NULL;
+					/* Finished requests */
+static cups_mutex_t	ipp_mutex = CUPS_MUTEX_INITIALIZER;
+					/* Mutex for queues and counters */
+static int		ipp_pipes[2] = { -1, -1 };
+					/* Pipes for finished requests */
+static cups_array_t	*ipp_queue = NULL;
+					/* Queued requests */
+static int		ipp_stopping = 0;
+					/* Stop the worker thread? */
+static cups_thread_t	ipp_thread = CUPS_THREAD_INVALID;
+					/* Worker thread */
+
+
 /*
  * Local functions...
  */
@@ -74,14 +105,18 @@ static void	create_local_printer(cupsd_client_t *con);
 static cups_array_t *create_requested_array(ipp_t *request);
 static void	create_subscriptions(cupsd_client_t *con, ipp_attribute_t *uri);
 static void	delete_printer(cupsd_client_t *con, ipp_attribute_t *uri);
+static void	finish_ipp_requests(void *data);
 static void	get_default(cupsd_client_t *con);
 static void	get_devices(cupsd_client_t *con);
 static void	get_document(cupsd_client_t *con, ipp_attribute_t *uri);
 static void	get_jobs(cupsd_client_t *con, ipp_attribute_t *uri);
 static void	get_job_attrs(cupsd_client_t *con, ipp_attribute_t *uri);
-static void	get_notifications(cupsd_client_t *con);
+static void	get_notifications(cupsd_client_t *con, int can_wait);
 static void	get_ppd(cupsd_client_t *con, ipp_attribute_t *uri);
 static void	get_ppds(cupsd_client_t *con);
+static ipp_t	*get_printer_cache(cupsd_client_t *con,
+		                   cupsd_printer_t *printer,
+				   cups_array_t *ra);
 static void	get_printers(cupsd_client_t *con, int type);
 static void	get_printer_attrs(cupsd_client_t *con, ipp_attribute_t *uri);
 static void	get_printer_supported(cupsd_client_t *con, ipp_attribute_t *uri);
@@ -94,6 +129,7 @@ static void	move_job(cupsd_client_t *con, ipp_attribute_t *uri);
 static int	ppd_parse_line(const char *line, char *option, int olen,
 		               char *choice, int clen);
 static void	print_job(cupsd_client_t *con, ipp_attribute_t *uri);
+static int	queue_ipp_request(cupsd_client_t *con, ipp_attribute_t *uri);
 static void	read_job_ticket(cupsd_client_t *con);
 static void	reject_jobs(cupsd_client_t *con, ipp_attribute_t *uri);
 static void	release_held_new_jobs(cupsd_client_t *con,
@@ -101,6 +137,8 @@ static void	release_held_new_jobs(cupsd_client_t *con,
 static void	release_job(cupsd_client_t *con, ipp_attribute_t *uri);
 static void	renew_subscription(cupsd_client_t *con, int sub_id);
 static void	restart_job(cupsd_client_t *con, ipp_attribute_t *uri);
+static void	run_ipp_request(cupsd_client_t *con, ipp_attribute_t *uri);
+static void	*run_ipp_thread(void *data);
 static void	save_auth_info(cupsd_client_t *con, cupsd_job_t *job,
 		               ipp_attribute_t *auth_info);
 static void	send_document(cupsd_client_t *con, ipp_attribute_t *uri);
@@ -114,12 +152,162 @@ static void	set_printer_attrs(cupsd_client_t *con, ipp_attribute_t *uri);
 static int	set_printer_defaults(cupsd_client_t *con, cupsd_printer_t *printer);
 static void	start_printer(cupsd_client_t *con, ipp_attribute_t *uri);
 static void	stop_printer(cupsd_client_t *con, ipp_attribute_t *uri);
+static void	trace_document(cupsd_client_t *con, cupsd_job_t *job, off_t bytes, mime_type_t *filetype, double type_start, double type_end);
 static void	url_encode_attr(ipp_attribute_t *attr, char *buffer, size_t bufsize);
 static char	*url_encode_string(const char *s, char *buffer, size_t bufsize);
 static int	user_allowed(cupsd_printer_t *p, const char *username);
 static void	validate_job(cupsd_client_t *con, ipp_attribute_t *uri);
 static int	validate_name(const char *name);
 static int	validate_user(cupsd_job_t *job, cupsd_client_t *con, const char *owner, char *username, size_t userlen);
+static void	yield_ipp_thread(cupsd_client_t *con);
+
+
+/*
+ * 'cupsdCheckNotifyWaits()' - Send responses for Get-Notifications requests
+ *                             that have new events or have waited long enough.
+ */
+
+void
+cupsdCheckNotifyWaits(void)
+{
+  cupsd_client_t	*con;		/* Waiting client */
+  time_t		curtime;	/* Current time */
+
+
+  curtime = time(NULL);
+
+  while ((con = (cupsd_client_t *)cupsArrayGetFirst(NotifyWaits)) != NULL &&
+         con->notify_wait <= curtime)
+  {
+    cupsdEndNotifyWait(con);
+
+    get_notifications(con, 0);
+
+    if (!send_response(con))
+      cupsdCloseClient(con);
+  }
+}
+
+
+/*
+ * 'cupsdEndNotifyWait()' - Stop waiting for events for a Get-Notifications
+ *                          request.
+ */
+
+void
+cupsdEndNotifyWait(cupsd_client_t *con)	/* I - Client connection */
+{
+  int			i;		/* Looping var */
+  ipp_attribute_t	*ids;		/* notify-subscription-ids */
+  cupsd_subscription_t	*sub;		/* Subscription */
+
+
+  if (!con->notify_wait)
+    return;
+
+  if ((ids = ippFindAttribute(con->request, "notify-subscription-ids", IPP_TAG_INTEGER)) != NULL)
+  {
+    for (i = 0; i < ids->num_values; i ++)
+    {
+      if ((sub = cupsdFindSubscription(ids->values[i].integer)) == NULL)
+        continue;
+
+      cupsArrayRemove(sub->waiters, con);
+
+      if (cupsArrayGetCount(sub->waiters) == 0)
+      {
+        cupsArrayDelete(sub->waiters);
+        sub->waiters = NULL;
+      }
+    }
+  }
+
+  cupsArrayRemove(NotifyWaits, con);
+
+  con->notify_wait = 0;
+  con->bg_pending  = 0;
+}
+
+
+/*
+ * 'cupsdFinishStreamingRequest()' - Finish a Print-Job request that was
+ *                                   processed while receiving its document.
+ */
+
+int					/* O - 1 on success, 0 on failure */
+cupsdFinishStreamingRequest(
+    cupsd_client_t *con,		/* I - Client connection */
+    int            aborted)		/* I - 1 if the document was not completely received */
+{
+  cupsd_job_t		*job;		/* Job */
+  ipp_attribute_t	*attr;		/* job-k-octets attribute */
+  char			filename[1024];	/* Job filename */
+  struct stat		fileinfo;	/* File information */
+  int			kbytes;		/* Additional size of document */
+  http_status_t		status;		/* Deferred HTTP error */
+
+
+  if (!con->streaming)
+    return (1);
+
+  con->streaming = 0;
+
+  if (con->stream_job && (job = cupsdFindJob(con->stream_job)) != NULL && job->streaming)
+  {
+    if (!aborted)
+    {
+     /*
+      * Update the job size and quota now that we have the whole document...
+      */
+
+      snprintf(filename, sizeof(filename), "%s/d%05d-%03d", RequestRoot, job->id, job->streaming);
+      if (stat(filename, &fileinfo))
+      {
+        kbytes = 0;
+      }
+      else
+      {
+        kbytes = (int)((fileinfo.st_size + 1023) / 1024) - con->stream_kbytes;
+
+        cupsdLogJob(job, CUPSD_LOG_DEBUG, "Received " CUPS_LLFMT " bytes of streamed document.", CUPS_LLCAST fileinfo.st_size);
+      }
+
+      if (kbytes > 0 && cupsdLoadJob(job))
+      {
+        cupsdUpdateQuota(cupsdFindDest(job->dest), job->username, 0, kbytes);
+
+	job->koctets += kbytes;
+
+	if ((attr = ippFindAttribute(job->attrs, "job-k-octets", IPP_TAG_INTEGER)) != NULL)
+	  attr->values[0].integer += kbytes;
+
+	job->dirty = 1;
+	cupsdMarkDirty(CUPSD_DIRTY_JOBS);
+      }
+    }
+
+    cupsdEndJobStream(job, aborted);
+  }
+
+  con->stream_job    = 0;
+  con->stream_kbytes = 0;
+  status             = con->stream_status;
+  con->stream_status = HTTP_STATUS_NONE;
+
+  if (aborted)
+  {
+    ippDelete(con->response);
+    con->response = NULL;
+
+    return (1);
+  }
+  else if (status != HTTP_STATUS_NONE)
+    return (cupsdSendError(con, status, con->stream_auth));
+  else if (con->response)
+    return (send_response(con));
+  else
+    return (1);
+}
 
 
 /*
@@ -142,6 +330,8 @@ cupsdProcessIPPRequest(
 			minor;		/* IPP minor version */
 
 
+  con->ipp_start_time = cupsGetClock();
+
   major = ippGetVersion(con->request, &minor);
 
   cupsdLogClient(con, CUPSD_LOG_DEBUG, "%s IPP/%d.%d request_id=%d", ippOpString(ippGetOperation(con->request)), major, minor, ippGetRequestId(con->request));
@@ -461,15 +651,10 @@ cupsdProcessIPPRequest(
 		break;
 
 	    case IPP_OP_GET_JOB_ATTRIBUTES :
-		get_job_attrs(con, uri);
-		break;
-
 	    case IPP_OP_GET_JOBS :
-		get_jobs(con, uri);
-		break;
-
 	    case IPP_OP_GET_PRINTER_ATTRIBUTES :
-		get_printer_attrs(con, uri);
+	        if (!queue_ipp_request(con, uri))
+		  run_ipp_request(con, uri);
 		break;
 
 	    case IPP_OP_GET_PRINTER_SUPPORTED_VALUES :
@@ -527,11 +712,9 @@ cupsdProcessIPPRequest(
 		break;
 
 	    case IPP_OP_CUPS_GET_PRINTERS :
-		get_printers(con, 0);
-		break;
-
 	    case IPP_OP_CUPS_GET_CLASSES :
-		get_printers(con, CUPS_PTYPE_CLASS);
+	        if (!queue_ipp_request(con, uri))
+		  run_ipp_request(con, uri);
 		break;
 
 	    case IPP_OP_CUPS_ADD_MODIFY_PRINTER :
@@ -598,7 +781,8 @@ cupsdProcessIPPRequest(
 		break;
 
 	    case IPP_OP_GET_SUBSCRIPTIONS :
-		get_subscriptions(con, uri);
+	        if (!queue_ipp_request(con, uri))
+		  run_ipp_request(con, uri);
 		break;
 
 	    case IPP_OP_RENEW_SUBSCRIPTION :
@@ -610,7 +794,7 @@ cupsdProcessIPPRequest(
 		break;
 
 	    case IPP_OP_GET_NOTIFICATIONS :
-		get_notifications(con);
+		get_notifications(con, 1);
 		break;
 
 	    case IPP_OP_CUPS_CREATE_LOCAL_PRINTER :
@@ -628,7 +812,15 @@ cupsdProcessIPPRequest(
     }
   }
 
-  if (!con->bg_pending && con->response)
+  if (con->streaming)
+  {
+   /*
+    * Send the response after the document has been received...
+    */
+
+    return (1);
+  }
+  else if (!con->bg_pending && con->response)
   {
    /*
     * Sending data from the scheduler...
@@ -648,6 +840,103 @@ cupsdProcessIPPRequest(
 }
 
 
+/*
+ * 'cupsdStartIPPThread()' - Start the thread for read-only IPP requests.
+ *
+ * The worker thread does not add parallelism: it runs a request while holding
+ * a read lock on StateLock, which the main thread only releases while it is
+ * blocked in poll(), and it is the only reader.  That makes the read lock
+ * exclusive, so requests may load job attributes and use the array iterators
+ * of the scheduler state.  Long requests call yield_ipp_thread() between
+ * items so that the main thread can process other clients and jobs.
+ */
+
+void
+cupsdStartIPPThread(void)
+{
+  if (ipp_thread != CUPS_THREAD_INVALID)
+    return;
+
+ /*
+  * Create a pipe so that the worker thread can wake up the main thread when
+  * a response is ready to send...
+  */
+
+  if (cupsdOpenPipe(ipp_pipes))
+  {
+    cupsdLogMessage(CUPSD_LOG_ERROR, "Unable to create pipes for IPP thread: %s", strerror(errno));
+    return;
+  }
+
+  cupsdAddSelect(ipp_pipes[0], (cupsd_selfunc_t)finish_ipp_requests, NULL, NULL);
+
+  ipp_queue    = cupsArrayNew(NULL, NULL);
+  ipp_done     = cupsArrayNew(NULL, NULL);
+  ipp_stopping = 0;
+
+  if ((ipp_thread = cupsThreadCreate(run_ipp_thread, NULL)) == CUPS_THREAD_INVALID)
+    cupsdLogMessage(CUPSD_LOG_ERROR, "Unable to create IPP thread: %s", strerror(errno));
+  else
+    cupsdLogMessage(CUPSD_LOG_DEBUG, "Started IPP thread.");
+}
+
+
+/*
+ * 'cupsdStopIPPThread()' - Stop the thread for read-only IPP requests.
+ */
+
+void
+cupsdStopIPPThread(void)
+{
+  cupsd_ippwork_t	*work;		/* Finished request */
+
+
+  if (ipp_thread != CUPS_THREAD_INVALID)
+  {
+   /*
+    * Let the worker thread finish any queued requests and then exit...
+    */
+
+    cupsMutexLock(&ipp_mutex);
+    ipp_stopping = 1;
+    cupsCondBroadcast(&ipp_cond);
+    cupsMutexUnlock(&ipp_mutex);
+
+    cupsRWUnlock(&StateLock);
+
+    cupsThreadWait(ipp_thread);
+
+    cupsdHoldState();
+
+    cupsdLogMessage(CUPSD_LOG_DEBUG, "Stopped IPP thread.");
+
+    ipp_thread = CUPS_THREAD_INVALID;
+  }
+
+ /*
+  * The clients are about to be closed, so just discard the responses...
+  */
+
+  for (work = (cupsd_ippwork_t *)cupsArrayFirst(ipp_done); work; work = (cupsd_ippwork_t *)cupsArrayNext(ipp_done))
+  {
+    work->con->bg_pending = 0;
+    free(work);
+  }
+
+  cupsArrayDelete(ipp_done);
+  cupsArrayDelete(ipp_queue);
+
+  ipp_done  = NULL;
+  ipp_queue = NULL;
+
+  if (ipp_pipes[0] >= 0)
+  {
+    cupsdRemoveSelect(ipp_pipes[0]);
+    cupsdClosePipe(ipp_pipes);
+  }
+}
+
+
 /*
  * 'cupsdTimeoutJob()' - Timeout a job waiting on job files.
  */
@@ -692,6 +981,66 @@ cupsdTimeoutJob(cupsd_job_t *job)	/* I - Job to timeout */
 }
 
 
+/*
+ * 'cupsdUpdateStreamingQuota()' - Update the quota for a document that is
+ *                                 still being received.
+ *
+ * Streamed documents are charged to the user's quota as they arrive, and the
+ * job is aborted as soon as the user goes over the printer's "job-k-limit".
+ */
+
+int					/* O - 1 if within quota, 0 if over quota */
+cupsdUpdateStreamingQuota(
+    cupsd_client_t *con)		/* I - Client connection */
+{
+  cupsd_job_t		*job;		/* Job */
+  cupsd_printer_t	*printer;	/* Destination printer or class */
+  cupsd_quota_t		*q;		/* Quota data */
+  ipp_attribute_t	*attr;		/* job-k-octets attribute */
+  struct stat		fileinfo;	/* File information */
+  int			kbytes;		/* Additional size of document */
+
+
+  if (!con->stream_job || (job = cupsdFindJob(con->stream_job)) == NULL || !job->streaming)
+    return (1);
+
+  if ((printer = cupsdFindDest(job->dest)) == NULL || !printer->k_limit)
+    return (1);
+
+  if (fstat(con->file, &fileinfo))
+    return (1);
+
+  if ((kbytes = (int)((fileinfo.st_size + 1023) / 1024) - con->stream_kbytes) <= 0 || !cupsdLoadJob(job))
+    return (1);
+
+ /*
+  * Update job-k-octets first so that a full quota recalculation includes the
+  * new data...
+  */
+
+  con->stream_kbytes += kbytes;
+  job->koctets       += kbytes;
+
+  if ((attr = ippFindAttribute(job->attrs, "job-k-octets", IPP_TAG_INTEGER)) != NULL)
+    attr->values[0].integer += kbytes;
+
+  job->dirty = 1;
+  cupsdMarkDirty(CUPSD_DIRTY_JOBS);
+
+  if ((q = cupsdUpdateQuota(printer, job->username, 0, kbytes)) == NULL || q->k_count <= printer->k_limit)
+    return (1);
+
+  cupsdLogJob(job, CUPSD_LOG_INFO, "User \"%s\" is over the quota limit.", job->username);
+
+  if (job->state_value < IPP_JSTATE_CANCELED)
+  {
+    ippSetString(job->attrs, &job->reasons, 0, "aborted-by-system");
+    cupsdSetJobState(job, IPP_JSTATE_ABORTED, CUPSD_JOB_DEFAULT, "Job aborted because the quota limit was reached.");
+  }
+
+  return (0);
+}
+
 /*
  * 'accept_jobs()' - Accept print jobs to a printer.
  */
@@ -753,6 +1102,13 @@ accept_jobs(cupsd_client_t  *con,	/* I - Client connection */
     cupsdLogClient(con, CUPSD_LOG_INFO, "Printer \"%s\" now accepting jobs (\"%s\").", printer->name, get_username(con));
   }
 
+ /*
+  * Jobs for classes containing the printer can now use it...
+  */
+
+  cupsdSetJobQueuesReady(printer);
+  cupsdCheckJobs();
+
  /*
   * Everything was ok, so return OK status...
   */
@@ -969,6 +1325,9 @@ add_class(cupsd_client_t  *con,		/* I - Client connection */
 
     if (pclass->num_printers > 0)
     {
+      for (i = 0; i < pclass->num_printers; i ++)
+        cupsArrayRemove(pclass->printers[i]->classes, pclass);
+
       free(pclass->printers);
       pclass->num_printers = 0;
     }
@@ -1033,6 +1392,7 @@ add_class(cupsd_client_t  *con,		/* I - Client connection */
   */
 
   cupsdSetPrinterAttrs(pclass);
+  cupsdSetJobQueuesReady(pclass);
   cupsdMarkDirty(CUPSD_DIRTY_CLASSES);
 
   if (need_restart_job && pclass->job)
@@ -1530,6 +1890,8 @@ add_job(cupsd_client_t  *con,		/* I - Client connection */
   job->dirty   = 1;
   con->request = ippNewRequest(job->attrs->request.op_status);
 
+  cupsdUpdateJobAttrCache(job);
+
   cupsdMarkDirty(CUPSD_DIRTY_JOBS);
 
   add_job_uuid(job);
@@ -1558,6 +1920,8 @@ add_job(cupsd_client_t  *con,		/* I - Client connection */
   else
     cupsdSetString(&job->username, "anonymous");
 
+  cupsdUpdateJobCounts(job, 1);
+
   if (!attr)
   {
     ippAddString(job->attrs, IPP_TAG_JOB, IPP_TAG_NAME, "job-originating-user-name", NULL, job->username);
@@ -1717,6 +2081,9 @@ add_job(cupsd_client_t  *con,		/* I - Client connection */
     ippSetString(job->attrs, &job->reasons, 0, "none");
   }
 
+  cupsdUpdateJobDeadline(job);
+  cupsdUpdateJobQueue(job);
+
   if (!(printer->type & CUPS_PTYPE_REMOTE) || Classification)
   {
    /*
@@ -3891,6 +4258,9 @@ close_job(cupsd_client_t  *con,		/* I - Client connection */
     }
   }
 
+  cupsdUpdateJobDeadline(job);
+  cupsdUpdateJobQueue(job);
+
   job->dirty = 1;
   cupsdMarkDirty(CUPSD_DIRTY_JOBS);
 
@@ -4747,6 +5117,9 @@ copy_job_attrs(cupsd_client_t *con,	/* I - Client connection */
 
     if (job->creation_time && (!ra || cupsArrayFind(ra, "time-at-creation")))
       ippAddInteger(con->response, IPP_TAG_JOB, IPP_TAG_INTEGER, "time-at-creation", (int)job->creation_time);
+
+    if (job->summary)
+      copy_attrs(con->response, job->summary, ra, IPP_TAG_JOB, 0, exclude);
   }
 }
 
@@ -4766,6 +5139,8 @@ copy_printer_attrs(
   int		i;			/* Looping var */
   int		is_encrypted = httpIsEncrypted(con->http);
 					/* Is the connection encrypted? */
+  ipp_t		*cached;		/* Cached printer attributes */
+  ipp_attribute_t *attr;		/* Cached attribute */
 
 
  /*
@@ -4938,9 +5313,18 @@ copy_printer_attrs(
   if (!ra || cupsArrayFind(ra, "uri-security-supported"))
     ippAddString(con->response, IPP_TAG_PRINTER, IPP_TAG_KEYWORD, "uri-security-supported", NULL, is_encrypted ? "tls" : "none");
 
-  copy_attrs(con->response, printer->attrs, ra, IPP_TAG_ZERO, 0, NULL);
-  if (printer->ppd_attrs)
-    copy_attrs(con->response, printer->ppd_attrs, ra, IPP_TAG_ZERO, 0, NULL);
+  if ((cached = get_printer_cache(con, printer, ra)) != NULL)
+  {
+    for (attr = cached->attrs; attr; attr = attr->next)
+      ippCopyAttribute(con->response, attr, 1);
+  }
+  else
+  {
+    copy_attrs(con->response, printer->attrs, ra, IPP_TAG_ZERO, 0, NULL);
+    if (printer->ppd_attrs)
+      copy_attrs(con->response, printer->ppd_attrs, ra, IPP_TAG_ZERO, 0, NULL);
+  }
+
   copy_attrs(con->response, CommonData, ra, IPP_TAG_ZERO, IPP_TAG_CUPS_CONST, NULL);
 
   cupsRWUnlock(&printer->lock);
@@ -6235,6 +6619,45 @@ delete_printer(cupsd_client_t  *con,	/* I - Client connection */
 }
 
 
+/*
+ * 'finish_ipp_requests()' - Send the responses for finished requests.
+ */
+
+static void
+finish_ipp_requests(void *data)		/* I - Callback data (unused) */
+{
+  char			buffer[256];	/* Wakeup bytes */
+  cupsd_client_t	*con;		/* Client connection */
+  cupsd_ippwork_t	*work;		/* Finished request */
+
+
+  (void)data;
+
+  if (read(ipp_pipes[0], buffer, sizeof(buffer)) < 0)
+    return;
+
+  cupsMutexLock(&ipp_mutex);
+
+  while ((work = (cupsd_ippwork_t *)cupsArrayFirst(ipp_done)) != NULL)
+  {
+    cupsArrayRemove(ipp_done, work);
+    cupsMutexUnlock(&ipp_mutex);
+
+    con = work->con;
+    free(work);
+
+    con->bg_pending = 0;
+
+    if (!send_response(con))
+      cupsdCloseClient(con);
+
+    cupsMutexLock(&ipp_mutex);
+  }
+
+  cupsMutexUnlock(&ipp_mutex);
+}
+
+
 /*
  * 'get_default()' - Get the default destination.
  */
@@ -6630,6 +7053,7 @@ get_jobs(cupsd_client_t  *con,		/* I - Client connection */
   http_status_t	status;			/* Policy status */
   ipp_attribute_t *attr;		/* Current attribute */
   const char	*dest;			/* Destination */
+  char		dest_name[IPP_MAX_NAME];/* Copy of destination name */
   cups_ptype_t	dtype;			/* Destination type (printer/class) */
   cups_ptype_t	dmask;			/* Destination type mask */
   char		scheme[HTTP_MAX_URI],	/* Scheme portion of URI */
@@ -6643,7 +7067,8 @@ get_jobs(cupsd_client_t  *con,		/* I - Client connection */
 		first_index = 1,	/* First index */
 		limit = 0,		/* Maximum number of jobs to return */
 		count,			/* Number of jobs that match */
-		need_load_job = 0;	/* Do we need to load the job? */
+		need_load_job = 0,	/* Do we need to load the job? */
+		need_summary = 0;	/* Do we need the job summary? */
   const char	*job_attr;		/* Job attribute requested */
   ipp_attribute_t *job_ids;		/* job-ids attribute */
   cupsd_job_t	*job;			/* Current job pointer */
@@ -6881,8 +7306,13 @@ get_jobs(cupsd_client_t  *con,		/* I - Client connection */
 	strcmp(job_attr, "time-at-creation") &&
 	strcmp(job_attr, "number-of-documents"))
     {
-      need_load_job = 1;
-      break;
+      if (!cupsArrayFind(JobSummaryAttrs, (void *)job_attr))
+      {
+        need_load_job = 1;
+        break;
+      }
+
+      need_summary = 1;
     }
 
   if (need_load_job && (limit == 0 || limit > 500) && (list == Jobs || delete_list))
@@ -6927,7 +7357,7 @@ get_jobs(cupsd_client_t  *con,		/* I - Client connection */
     {
       job = cupsdFindJob(job_ids->values[i].integer);
 
-      if (need_load_job && !job->attrs)
+      if ((need_load_job || (need_summary && !job->summary)) && !job->attrs)
       {
         cupsdLoadJob(job);
 
@@ -6951,13 +7381,48 @@ get_jobs(cupsd_client_t  *con,		/* I - Client connection */
   }
   else
   {
-    if (first_index > 1)
-      job = (cupsd_job_t *)cupsArrayIndex(list, first_index - 1);
-    else
-      job = (cupsd_job_t *)cupsArrayFirst(list);
+    int	i,				/* Looping var */
+	num_ids;			/* Number of job IDs */
+    int	*ids;				/* Job IDs to report */
+
+   /*
+    * Copy the job IDs and destination name so that we can let the main thread
+    * run while we build a long response...
+    */
+
+    if (first_index < 1)
+      first_index = 1;
+
+    if ((num_ids = cupsArrayCount(list) - first_index + 1) < 0)
+      num_ids = 0;
+
+    if ((ids = calloc((size_t)num_ids + 1, sizeof(int))) == NULL)
+    {
+      send_ipp_status(con, IPP_STATUS_ERROR_INTERNAL, _("Unable to allocate memory."));
+      cupsArrayDelete(ra);
+      if (delete_list)
+        cupsArrayDelete(list);
+      return;
+    }
+
+    for (i = 0, job = (cupsd_job_t *)cupsArrayIndex(list, first_index - 1); job && i < num_ids; job = (cupsd_job_t *)cupsArrayNext(list))
+      ids[i ++] = job->id;
+
+    num_ids = i;
+
+    if (dest)
+    {
+      cupsCopyString(dest_name, dest, sizeof(dest_name));
+      dest = dest_name;
+    }
 
-    for (count = 0; (limit <= 0 || count < limit) && job; job = (cupsd_job_t *)cupsArrayNext(list))
+    for (count = 0, i = 0; (limit <= 0 || count < limit) && i < num_ids; i ++)
     {
+      yield_ipp_thread(con);
+
+      if ((job = cupsdFindJob(ids[i])) == NULL)
+        continue;
+
      /*
       * Filter out jobs that don't match...
       */
@@ -6983,7 +7448,7 @@ get_jobs(cupsd_client_t  *con,		/* I - Client connection */
       if (job->id < first_job_id)
 	continue;
 
-      if (need_load_job && !job->attrs)
+      if ((need_load_job || (need_summary && !job->summary)) && !job->attrs)
       {
         cupsdLoadJob(job);
 
@@ -7009,6 +7474,8 @@ get_jobs(cupsd_client_t  *con,		/* I - Client connection */
 
       copy_job_attrs(con, job, ra, exclude);
     }
+
+    free(ids);
   }
 
   cupsArrayDelete(ra);
@@ -7025,7 +7492,9 @@ get_jobs(cupsd_client_t  *con,		/* I - Client connection */
  */
 
 static void
-get_notifications(cupsd_client_t *con)	/* I - Client connection */
+get_notifications(
+    cupsd_client_t *con,		/* I - Client connection */
+    int            can_wait)		/* I - Wait for events if requested? */
 {
   int			i, j;		/* Looping vars */
   http_status_t		status;		/* Policy status */
@@ -7095,6 +7564,50 @@ get_notifications(cupsd_client_t *con)	/* I - Client connection */
       interval = 30;
   }
 
+ /*
+  * If the client wants to wait for events and there are none yet, stop reading
+  * from the connection until cupsdAddEvent adds one or the poll interval is
+  * up.  cupsdCheckNotifyWaits then sends the response...
+  */
+
+  if (can_wait && interval > 0 && ippGetBoolean(ippFindAttribute(con->request, "notify-wait", IPP_TAG_BOOLEAN), 0))
+  {
+    for (i = 0; i < ids->num_values; i ++)
+    {
+      sub = cupsdFindSubscription(ids->values[i].integer);
+
+      if (sequences && i < sequences->num_values)
+	min_seq = sequences->values[i].integer;
+      else
+	min_seq = 1;
+
+      if (cupsArrayGetCount(sub->events) > 0 && min_seq < (sub->first_event_id + cupsArrayGetCount(sub->events)))
+        break;
+    }
+
+    if (i >= ids->num_values)
+    {
+      for (i = 0; i < ids->num_values; i ++)
+      {
+	sub = cupsdFindSubscription(ids->values[i].integer);
+
+	if (!sub->waiters)
+	  sub->waiters = cupsArrayNew(NULL, NULL);
+
+	cupsArrayAdd(sub->waiters, con);
+      }
+
+      cupsdLogClient(con, CUPSD_LOG_DEBUG, "Waiting up to %d seconds for events.", interval);
+
+      con->notify_wait = time(NULL) + interval;
+      con->bg_pending  = 1;
+
+      cupsArrayAdd(NotifyWaits, con);
+      cupsdRemoveSelect(httpGetFd(con->http));
+      return;
+    }
+  }
+
  /*
   * Tell the client to poll again in N seconds...
   */
@@ -7150,9 +7663,9 @@ get_notifications(cupsd_client_t *con)	/* I - Client connection */
     {
       ippAddSeparator(con->response);
 
-      copy_attrs(con->response,
-                 ((cupsd_event_t *)cupsArrayIndex(sub->events, j))->attrs, NULL,
-        	 IPP_TAG_EVENT_NOTIFICATION, 0, NULL);
+      cupsdAddEventAttrs(con->response, sub,
+                         (cupsd_event_t *)cupsArrayIndex(sub->events, j),
+			 sub->first_event_id + j, 0);
     }
 
     cupsRWUnlock(&sub->lock);
@@ -7524,6 +8037,79 @@ get_printer_attrs(cupsd_client_t  *con,	/* I - Client connection */
 }
 
 
+/*
+ * 'get_printer_cache()' - Get a cached copy of the printer and PPD attributes.
+ *
+ * The copy is keyed by the request version and requested-attributes values and
+ * is rebuilt whenever the printer generation changes.  The returned attributes
+ * are referenced by the client until the response has been sent, so they can
+ * be quick-copied into the response.
+ */
+
+static ipp_t *				/* O - Cached attributes or `NULL` */
+get_printer_cache(
+    cupsd_client_t  *con,		/* I - Client connection */
+    cupsd_printer_t *printer,		/* I - Printer */
+    cups_array_t    *ra)		/* I - Requested attributes array */
+{
+  int			i;		/* Looping var */
+  ipp_attribute_t	*requested;	/* requested-attributes attribute */
+  char			key[1024],	/* Cache key */
+			*keyptr;	/* Pointer into key */
+  size_t		len;		/* Length of value */
+  cupsd_pcache_t	*pc;		/* Cached attributes */
+
+
+ /*
+  * Build the cache key...
+  */
+
+  snprintf(key, sizeof(key), "%d", con->response->request.version[0]);
+  keyptr = key + strlen(key);
+
+  if ((requested = ippFindAttribute(con->request, "requested-attributes", IPP_TAG_KEYWORD)) != NULL)
+  {
+    for (i = 0; i < requested->num_values; i ++)
+    {
+      if ((len = strlen(requested->values[i].string.text)) > (sizeof(key) - (size_t)(keyptr - key) - 2))
+        return (NULL);			/* Too long to cache */
+
+      *keyptr++ = ',';
+      memcpy(keyptr, requested->values[i].string.text, len + 1);
+      keyptr += len;
+    }
+  }
+
+ /*
+  * Find or make a copy of the attributes...
+  */
+
+  if ((pc = cupsdFindPrinterCache(printer, key)) == NULL)
+  {
+    if ((pc = cupsdAddPrinterCache(printer, key)) == NULL)
+      return (NULL);
+
+    ippSetVersion(pc->attrs, con->response->request.version[0], con->response->request.version[1]);
+
+    copy_attrs(pc->attrs, printer->attrs, ra, IPP_TAG_ZERO, 0, NULL);
+    if (printer->ppd_attrs)
+      copy_attrs(pc->attrs, printer->ppd_attrs, ra, IPP_TAG_ZERO, 0, NULL);
+  }
+
+ /*
+  * Keep the copy around until the response has been sent...
+  */
+
+  if (!con->response_attrs && (con->response_attrs = cupsArrayNew3(NULL, NULL, NULL, 0, NULL, (cups_afree_cb_t)ippDelete)) == NULL)
+    return (NULL);
+
+  pc->attrs->use ++;
+  cupsArrayAdd(con->response_attrs, pc->attrs);
+
+  return (pc->attrs);
+}
+
+
 /*
  * 'get_printer_supported()' - Get printer supported values.
  */
@@ -7601,7 +8187,9 @@ get_printers(cupsd_client_t *con,	/* I - Client connection */
   char		*location;		/* Location string */
   const char	*username;		/* Current user */
   char		*first_printer_name;	/* first-printer-name attribute */
-  cups_array_t	*ra;			/* Requested attributes array */
+  cups_array_t	*ra,			/* Requested attributes array */
+		*names;			/* Printer names */
+  char		*name;			/* Current printer name */
   int		local;			/* Local connection? */
 
 
@@ -7687,23 +8275,45 @@ get_printers(cupsd_client_t *con,	/* I - Client connection */
   ra = create_requested_array(con->request);
 
  /*
-  * OK, build a list of printers for this printer...
+  * Copy the printer names so that we can let the main thread run while we
+  * build a long response...
   */
 
-  cupsRWLockWrite(&PrintersLock); // Should be a reader lock, but we can't easily update loop logic right now
-
-  if (first_printer_name)
+  if ((names = cupsArrayNew3(NULL, NULL, NULL, 0, (cups_acopy_cb_t)strdup, (cups_afree_cb_t)free)) == NULL)
   {
-    if ((printer = cupsdFindDest(first_printer_name)) == NULL)
-      printer = (cupsd_printer_t *)cupsArrayFirst(Printers);
+    send_ipp_status(con, IPP_STATUS_ERROR_INTERNAL, _("Unable to allocate memory."));
+    cupsArrayDelete(ra);
+    return;
   }
+
+  if (first_printer_name)
+    printer = cupsdFindDest(first_printer_name);
   else
+    printer = NULL;
+
+  cupsRWLockWrite(&PrintersLock); // Should be a reader lock, but we can't easily update loop logic right now
+
+  if (!printer || (printer = (cupsd_printer_t *)cupsArrayFind(Printers, printer)) == NULL)
     printer = (cupsd_printer_t *)cupsArrayFirst(Printers);
 
-  for (count = 0;
-       count < limit && printer;
-       printer = (cupsd_printer_t *)cupsArrayNext(Printers))
+  for (; printer; printer = (cupsd_printer_t *)cupsArrayNext(Printers))
+    cupsArrayAdd(names, printer->name);
+
+  cupsRWUnlock(&PrintersLock);
+
+ /*
+  * OK, build a list of printers for this printer...
+  */
+
+  for (count = 0, name = (char *)cupsArrayFirst(names);
+       count < limit && name;
+       name = (char *)cupsArrayNext(names))
   {
+    yield_ipp_thread(con);
+
+    if ((printer = cupsdFindDest(name)) == NULL)
+      continue;
+
     if (!local && !printer->shared)
       continue;
 
@@ -7741,8 +8351,7 @@ get_printers(cupsd_client_t *con,	/* I - Client connection */
     }
   }
 
-  cupsRWUnlock(&PrintersLock);
-
+  cupsArrayDelete(names);
   cupsArrayDelete(ra);
 
   con->response->request.op_status = IPP_STATUS_OK;
@@ -8546,6 +9155,8 @@ print_job(cupsd_client_t  *con,		/* I - Client connection */
   struct stat	fileinfo;		/* File information */
   int		kbytes;			/* Size of file */
   int		compression;		/* Document compression */
+  double	type_start = 0.0,	/* Start of auto-typing */
+		type_end = 0.0;		/* End of auto-typing */
 
 
  /*
@@ -8659,10 +9270,11 @@ print_job(cupsd_client_t  *con,		/* I - Client connection */
 
     cupsdLogClient(con, CUPSD_LOG_DEBUG, "Auto-typing file.");
 
-
-    filetype = mimeFileType(MimeDatabase, con->filename,
-                            doc_name ? doc_name->values[0].string.text : NULL,
-			    &compression);
+    type_start = cupsGetClock();
+    filetype   = mimeFileType(MimeDatabase, con->filename,
+                              doc_name ? doc_name->values[0].string.text : NULL,
+			      &compression);
+    type_end   = cupsGetClock();
 
     if (!filetype)
       filetype = mimeType(MimeDatabase, super, type);
@@ -8731,12 +9343,17 @@ print_job(cupsd_client_t  *con,		/* I - Client connection */
   */
 
   if (stat(con->filename, &fileinfo))
-    kbytes = 0;
+  {
+    fileinfo.st_size = 0;
+    kbytes           = 0;
+  }
   else
     kbytes = (fileinfo.st_size + 1023) / 1024;
 
   cupsdUpdateQuota(printer, job->username, 0, kbytes);
 
+  trace_document(con, job, fileinfo.st_size, filetype, type_start, type_end);
+
   job->koctets += kbytes;
 
   if ((attr = ippFindAttribute(job->attrs, "job-k-octets", IPP_TAG_INTEGER)) != NULL)
@@ -8760,6 +9377,17 @@ print_job(cupsd_client_t  *con,		/* I - Client connection */
 
   cupsdClearString(&con->filename);
 
+  if (con->streaming)
+  {
+   /*
+    * The rest of the document is still being received into the job file...
+    */
+
+    job->streaming     = job->num_files;
+    con->stream_job    = job->id;
+    con->stream_kbytes = kbytes;
+  }
+
  /*
   * See if we need to add the ending sheet...
   */
@@ -8786,6 +9414,41 @@ print_job(cupsd_client_t  *con,		/* I - Client connection */
 }
 
 
+/*
+ * 'queue_ipp_request()' - Queue a read-only request for the worker thread.
+ */
+
+static int				/* O - 1 if queued, 0 to run it now */
+queue_ipp_request(
+    cupsd_client_t  *con,		/* I - Client connection */
+    ipp_attribute_t *uri)		/* I - Target URI */
+{
+  cupsd_ippwork_t	*work;		/* Queued request */
+
+
+  if (ipp_thread == CUPS_THREAD_INVALID || (work = calloc(1, sizeof(cupsd_ippwork_t))) == NULL)
+    return (0);
+
+  work->con = con;
+  work->uri = uri;
+
+ /*
+  * Stop reading from the client until the response is ready...
+  */
+
+  con->bg_pending = 1;
+
+  cupsdRemoveSelect(httpGetFd(con->http));
+
+  cupsMutexLock(&ipp_mutex);
+  cupsArrayAdd(ipp_queue, work);
+  cupsCondBroadcast(&ipp_cond);
+  cupsMutexUnlock(&ipp_mutex);
+
+  return (1);
+}
+
+
 /*
  * 'read_job_ticket()' - Read a job ticket embedded in a print file.
  *
@@ -9094,10 +9757,10 @@ release_held_new_jobs(
   }
 
  /*
-  * Hold pending/new jobs sent to the printer...
+  * Release pending/new jobs sent to the printer...
   */
 
-  printer->holding_new_jobs = 0;
+  cupsdReleaseHeldNewJobs(printer);
 
   cupsdSetPrinterReasons(printer, "-hold-new-jobs");
 
@@ -9491,6 +10154,108 @@ restart_job(cupsd_client_t  *con,	/* I - Client connection */
 }
 
 
+/*
+ * 'run_ipp_request()' - Run a read-only request.
+ */
+
+static void
+run_ipp_request(cupsd_client_t  *con,	/* I - Client connection */
+                ipp_attribute_t *uri)	/* I - Target URI */
+{
+  switch (con->request->request.op_status)
+  {
+    case IPP_OP_GET_JOB_ATTRIBUTES :
+        get_job_attrs(con, uri);
+	break;
+
+    case IPP_OP_GET_JOBS :
+        get_jobs(con, uri);
+	break;
+
+    case IPP_OP_GET_PRINTER_ATTRIBUTES :
+        get_printer_attrs(con, uri);
+	break;
+
+    case IPP_OP_GET_SUBSCRIPTIONS :
+        get_subscriptions(con, uri);
+	break;
+
+    case IPP_OP_CUPS_GET_PRINTERS :
+        get_printers(con, 0);
+	break;
+
+    case IPP_OP_CUPS_GET_CLASSES :
+        get_printers(con, CUPS_PTYPE_CLASS);
+	break;
+
+    default :
+        send_ipp_status(con, IPP_STATUS_ERROR_OPERATION_NOT_SUPPORTED, _("%s not supported."), ippOpString(con->request->request.op_status));
+	break;
+  }
+}
+
+
+/*
+ * 'run_ipp_thread()' - Run queued read-only requests.
+ *
+ * Requests run while holding a read lock on StateLock, so the main thread is
+ * either polling or waiting for us.
+ */
+
+static void *				/* O - Thread exit status */
+run_ipp_thread(void *data)		/* I - Thread data (unused) */
+{
+  cupsd_ippwork_t	*work;		/* Queued request */
+  sigset_t		mask;		/* Signal mask */
+
+
+  (void)data;
+
+ /*
+  * Block all signals so that SIGCHLD, SIGHUP, and SIGTERM wake up the main
+  * thread instead of being delivered here...
+  */
+
+  sigfillset(&mask);
+  pthread_sigmask(SIG_BLOCK, &mask, NULL);
+
+  cupsMutexLock(&ipp_mutex);
+
+  for (;;)
+  {
+    if ((work = (cupsd_ippwork_t *)cupsArrayFirst(ipp_queue)) == NULL)
+    {
+      if (ipp_stopping)
+        break;
+
+      cupsCondWait(&ipp_cond, &ipp_mutex, 0.0);
+      continue;
+    }
+
+    cupsArrayRemove(ipp_queue, work);
+    cupsMutexUnlock(&ipp_mutex);
+
+    cupsRWLockRead(&StateLock);
+    run_ipp_request(work->con, work->uri);
+    cupsRWUnlock(&StateLock);
+
+   /*
+    * Hand the response back to the main thread...
+    */
+
+    cupsMutexLock(&ipp_mutex);
+    cupsArrayAdd(ipp_done, work);
+
+    if (write(ipp_pipes[1], "", 1) < 0)
+      cupsdLogMessage(CUPSD_LOG_ERROR, "Unable to wake up main thread: %s", strerror(errno));
+  }
+
+  cupsMutexUnlock(&ipp_mutex);
+
+  return (NULL);
+}
+
+
 /*
  * 'save_auth_info()' - Save authentication information for a job.
  */
@@ -9696,6 +10461,9 @@ send_document(cupsd_client_t  *con,	/* I - Client connection */
   int			kbytes;		/* Size of file */
   int			compression;	/* Type of compression */
   int			start_job;	/* Start the job? */
+  double		type_start = 0.0,
+					/* Start of auto-typing */
+			type_end = 0.0;	/* End of auto-typing */
 
 
  /*
@@ -9879,10 +10647,12 @@ send_document(cupsd_client_t  *con,	/* I - Client connection */
 
     cupsdLogJob(job, CUPSD_LOG_DEBUG, "Auto-typing file.");
 
-    doc_name = ippFindAttribute(con->request, "document-name", IPP_TAG_NAME);
-    filetype = mimeFileType(MimeDatabase, con->filename,
-                            doc_name ? doc_name->values[0].string.text : NULL,
-			    &compression);
+    doc_name   = ippFindAttribute(con->request, "document-name", IPP_TAG_NAME);
+    type_start = cupsGetClock();
+    filetype   = mimeFileType(MimeDatabase, con->filename,
+                              doc_name ? doc_name->values[0].string.text : NULL,
+			      &compression);
+    type_end   = cupsGetClock();
 
     if (!filetype)
       filetype = mimeType(MimeDatabase, super, type);
@@ -9954,12 +10724,17 @@ send_document(cupsd_client_t  *con,	/* I - Client connection */
     ippAddString(job->attrs, IPP_TAG_JOB, IPP_TAG_NAME, "document-name-supplied", NULL, ippGetString(attr, 0, NULL));
 
   if (stat(con->filename, &fileinfo))
-    kbytes = 0;
+  {
+    fileinfo.st_size = 0;
+    kbytes           = 0;
+  }
   else
     kbytes = (fileinfo.st_size + 1023) / 1024;
 
   cupsdUpdateQuota(printer, job->username, 0, kbytes);
 
+  trace_document(con, job, fileinfo.st_size, filetype, type_start, type_end);
+
   job->koctets += kbytes;
 
   if ((attr = ippFindAttribute(job->attrs, "job-k-octets", IPP_TAG_INTEGER)) != NULL)
@@ -10054,6 +10829,9 @@ send_document(cupsd_client_t  *con,	/* I - Client connection */
     start_job = 0;
   }
 
+  cupsdUpdateJobDeadline(job);
+  cupsdUpdateJobQueue(job);
+
  /*
   * Fill in the response info...
   */
@@ -10088,6 +10866,7 @@ send_http_error(
     cupsd_printer_t *printer)		/* I - Printer, if any */
 {
   ipp_attribute_t	*uri;		/* Request URI, if any */
+  int			auth_type;	/* Type of authentication required */
 
 
   if ((uri = ippFindAttribute(con->request, "printer-uri",
@@ -10096,13 +10875,10 @@ send_http_error(
 
   cupsdLogClient(con, status == HTTP_STATUS_FORBIDDEN ? CUPSD_LOG_ERROR : CUPSD_LOG_DEBUG, "Returning HTTP %s for %s (%s) from %s.", httpStatus(status), con->request ? ippOpString(con->request->request.op_status) : "no operation-id", uri ? uri->values[0].string.text : "no URI", con->http->hostname);
 
+  auth_type = CUPSD_AUTH_NONE;
+
   if (printer)
   {
-    int		auth_type;		/* Type of authentication required */
-
-
-    auth_type = CUPSD_AUTH_NONE;
-
     if (status == HTTP_STATUS_UNAUTHORIZED &&
         printer->num_auth_info_required > 0 &&
         !strcmp(printer->auth_info_required[0], "negotiate") &&
@@ -10147,11 +10923,19 @@ send_http_error(
 	  auth_type = auth->type;
       }
     }
+  }
 
-    cupsdSendError(con, status, auth_type);
+  if (con->streaming)
+  {
+   /*
+    * Send the error after the document has been received...
+    */
+
+    con->stream_status = status;
+    con->stream_auth   = auth_type;
   }
   else
-    cupsdSendError(con, status, CUPSD_AUTH_NONE);
+    cupsdSendError(con, status, auth_type);
 
   ippDelete(con->response);
   con->response = NULL;
@@ -10213,6 +10997,8 @@ send_response(cupsd_client_t *con)	/* I - Client */
 
   cupsMutexLock(&mutex);
 
+  con->ipp_end_time = cupsGetClock();
+
   if ((uri = ippFindAttribute(con->request, "printer-uri", IPP_TAG_URI)) == NULL)
   {
     if ((uri = ippFindAttribute(con->request, "job-uri", IPP_TAG_URI)) == NULL)
@@ -11234,6 +12020,37 @@ stop_printer(cupsd_client_t  *con,	/* I - Client connection */
 }
 
 
+/*
+ * 'trace_document()' - Add the spooling and auto-typing of a document to the
+ *                      job trace.
+ */
+
+static void
+trace_document(
+    cupsd_client_t *con,		/* I - Client connection */
+    cupsd_job_t    *job,		/* I - Job */
+    off_t          bytes,		/* I - Size of document */
+    mime_type_t    *filetype,		/* I - Type of document */
+    double         type_start,		/* I - Start of auto-typing or 0.0 */
+    double         type_end)		/* I - End of auto-typing or 0.0 */
+{
+  char	message[256];			/* Trace message */
+
+
+  if (!job->trace && !TraceJobs)
+    return;
+
+  snprintf(message, sizeof(message), CUPS_LLFMT " bytes from %s", CUPS_LLCAST bytes, con->http->hostname);
+  cupsdAddJobTrace(job, "ipp", "spool", 0, con->header_time, con->ipp_start_time, message);
+
+  if (type_end > 0.0)
+  {
+    snprintf(message, sizeof(message), "%s/%s", filetype->super, filetype->type);
+    cupsdAddJobTrace(job, "mime", "mimeFileType", 0, type_start, type_end, message);
+  }
+}
+
+
 /*
  * 'url_encode_attr()' - URL-encode a string attribute.
  */
@@ -11619,3 +12436,24 @@ validate_user(cupsd_job_t    *job,	/* I - Job */
   return (cupsdCheckPolicy(printer ? printer->op_policy_ptr : DefaultPolicyPtr,
                            con, owner) == HTTP_STATUS_OK);
 }
+
+
+/*
+ * 'yield_ipp_thread()' - Let the main thread run.
+ *
+ * Callers must not hold any other locks or pointers into the scheduler state
+ * across this call.
+ */
+
+static void
+yield_ipp_thread(cupsd_client_t *con)	/* I - Client connection */
+{
+  if (!con->bg_pending || !cupsdIsStateWanted())
+    return;				/* Main thread or nobody waiting */
+
+  cupsRWUnlock(&StateLock);
+
+  cupsdWaitState();
+
+  cupsRWLockRead(&StateLock);
+}
@@ -13,6 +13,10 @@
 #include <grp.h>
 #include <cups/backend.h>
 #include <cups/dir.h>
+#include <sys/mman.h>
+#ifdef HAVE_SENDFILE
+#  include <sys/sendfile.h>
+#endif /* HAVE_SENDFILE */
 #ifdef __APPLE__
 #  include <IOKit/pwr_mgt/IOPMLib.h>
 #  ifdef HAVE_IOKIT_PWR_MGT_IOPMLIBPRIVATE_H
@@ -42,8 +46,11 @@
  * UNLOADING OF JOBS (cupsdUnloadCompletedJobs)
  *
  *     We unload the job attributes when they are not needed to reduce overall
- *     memory consumption.  We don't unload jobs where job->state_value <
- *     IPP_JSTATE_STOPPED, job->printer != NULL, or job->access_time is recent.
+ *     memory consumption.  Completed jobs with loaded attributes are kept in
+ *     the JobAttrCache array in least recently used order, and the oldest
+ *     jobs are unloaded once their attributes use more than JobAttrCacheSize
+ *     bytes.  Jobs where job->state_value < IPP_JSTATE_STOPPED or
+ *     job->printer != NULL are not in the cache and are never unloaded.
  *
  * STARTING OF JOBS (start_job)
  *
@@ -93,6 +100,72 @@
  */
 
 
+/*
+ * Local structures...
+ *
+ * The job.index file is a binary copy of job.cache that can be mapped into
+ * memory and validated in a single pass.  It contains a header, fixed-size
+ * job records, fixed-size file records, and a table of nul-terminated
+ * strings that are shared by all of the records.  Values are stored in
+ * native byte order since the file is only read by the cupsd that wrote it.
+ */
+
+#define CUPSD_JOB_INDEX_MAGIC	"CUPSJIDX"
+#define CUPSD_JOB_INDEX_VERSION	1
+#define CUPSD_JOB_INDEX_NONE	0xffffffff
+
+typedef struct cupsd_jobindex_s		/**** Job index header ****/
+{
+  char		magic[8];		/* CUPSD_JOB_INDEX_MAGIC */
+  uint32_t	version,		/* CUPSD_JOB_INDEX_VERSION */
+		num_jobs,		/* Number of job records */
+		num_files,		/* Number of file records */
+		strings_size;		/* Size of string table */
+  int32_t	next_job_id;		/* NextJobId value */
+  uint32_t	summary_attrs;		/* JobSummaryAttributes string */
+  int64_t	cache_size,		/* Size of matching job.cache file */
+		cache_mtime;		/* Modification time of job.cache file */
+} cupsd_jobindex_t;
+
+typedef struct cupsd_jobrec_s		/**** Job index record ****/
+{
+  int32_t	id,			/* Job ID */
+		state,			/* Job state */
+		priority,		/* Job priority */
+		dtype,			/* Destination type */
+		koctets,		/* job-k-octets */
+		num_files;		/* Number of files */
+  uint32_t	first_file,		/* First file record */
+		username,		/* Username string */
+		dest,			/* Destination string */
+		name,			/* Job name string or CUPSD_JOB_INDEX_NONE */
+		summary,		/* Summary string or CUPSD_JOB_INDEX_NONE */
+		reserved;		/* Reserved, must be 0 */
+  int64_t	creation_time,		/* time-at-creation */
+		completed_time,		/* time-at-completed */
+		hold_until;		/* Hold-until time */
+} cupsd_jobrec_t;
+
+typedef struct cupsd_filerec_s		/**** Job index file record ****/
+{
+  uint32_t	type;			/* MIME type string ("super/type") */
+  int32_t	compression;		/* Compression status */
+} cupsd_filerec_t;
+
+typedef struct cupsd_ippbuf_s		/**** Memory buffer for IPP data ****/
+{
+  ipp_uchar_t	*data;			/* Buffer */
+  size_t	pos,			/* Current position */
+		length;			/* Length of buffer */
+} cupsd_ippbuf_t;
+
+typedef struct cupsd_idxstr_s		/**** Job index string ****/
+{
+  char		*str;			/* String */
+  uint32_t	offset;			/* Offset in string table */
+} cupsd_idxstr_t;
+
+
 /*
  * Local globals...
  */
@@ -104,6 +177,18 @@ static mime_filter_t	gziptoany_filter =
 			  0,		/* Cost */
 			  "gziptoany"	/* Filter program to run */
 			};
+static int		journal_records = -1;
+					/* Records in job.cache journal, -1 to compact */
+static int		num_journal_deletes = 0,
+					/* Number of purged jobs to journal */
+			alloc_journal_deletes = 0,
+					/* Allocated purged job IDs */
+			*journal_deletes = NULL;
+					/* Purged job IDs */
+static char		*summary_attrs = NULL;
+					/* JobSummaryAttributes used for job summaries */
+static long		job_attrs_seq = 0;
+					/* Last attribute cache use sequence */
 
 
 /*
@@ -111,26 +196,51 @@ static mime_filter_t	gziptoany_filter =
  */
 
 static int	compare_active_jobs(void *first, void *second, void *data);
+static void	check_job_attr_cache(cupsd_job_t *job);
+static int	compare_cached_jobs(void *first, void *second, void *data);
 static int	compare_completed_jobs(void *first, void *second, void *data);
+static int	compare_deadline_jobs(void *first, void *second, void *data);
+static int	compare_index_strings(cupsd_idxstr_t *first, cupsd_idxstr_t *second, void *data);
+static int	compare_job_counts(cupsd_jobcount_t *first, cupsd_jobcount_t *second, void *data);
+static int	compare_job_queue_heads(void *first, void *second, void *data);
+static int	compare_job_queues(void *first, void *second, void *data);
 static int	compare_jobs(void *first, void *second, void *data);
+static int	copy_summary_attr(void *context, ipp_t *dst, ipp_attribute_t *attr);
+static ipp_t	*decode_job_summary(const char *value);
 static void	dump_job_history(cupsd_job_t *job);
+static char	*encode_job_summary(cupsd_job_t *job);
 static void	finalize_job(cupsd_job_t *job, int set_job_state);
 static void	free_job_history(cupsd_job_t *job);
+static cupsd_jobcount_t *get_job_count(cups_array_t *counts, const char *name);
 static char	*get_options(cupsd_job_t *job, int banner_page, char *copies,
 		             size_t copies_size, char *title,
 			     size_t title_size);
+static void	get_summary_attrs(char *buffer, size_t bufsize);
+static int	hash_job_count(cupsd_jobcount_t *count, void *data);
+static uint32_t	index_string(cups_array_t *strings, cups_array_t *order, const char *str, uint32_t *size);
 static size_t	ipp_length(ipp_t *ipp);
 static void	load_job_cache(const char *filename);
+static int	load_job_index(const char *filename, struct stat *cacheinfo, cups_array_t *cached);
 static void	load_next_job_id(const char *filename);
 static void	load_request_root(void);
+static ssize_t	read_ippbuf(cupsd_ippbuf_t *buf, ipp_uchar_t *buffer, size_t bytes);
+static int	read_job_cache(cups_file_t *fp, const char *filename, cups_array_t *cached);
+static void	release_job_count(cups_array_t *counts, cupsd_jobcount_t *count);
 static void	remove_job_files(cupsd_job_t *job);
 static void	remove_job_history(cupsd_job_t *job);
+static void	set_queue_ready(cupsd_jobqueue_t *queue);
 static void	set_time(cupsd_job_t *job, const char *name);
 static void	start_job(cupsd_job_t *job, cupsd_printer_t *printer);
+static int	start_stream(cupsd_job_t *job, const char *filename);
 static void	stop_job(cupsd_job_t *job, cupsd_jobaction_t action);
+static void	stop_stream(cupsd_job_t *job);
 static void	unload_job(cupsd_job_t *job);
 static void	update_job(cupsd_job_t *job);
 static void	update_job_attrs(cupsd_job_t *job, int do_message);
+static void	update_stream(cupsd_job_t *job);
+static ssize_t	write_ippbuf(cupsd_ippbuf_t *buf, ipp_uchar_t *buffer, size_t bytes);
+static void	write_job_cache(cups_file_t *fp, cupsd_job_t *job);
+static void	write_job_index(const char *cachefile);
 
 
 /*
@@ -166,6 +276,7 @@ cupsdAddJob(int        priority,	/* I - Job priority */
 
   cupsArrayAdd(Jobs, job);
   cupsArrayAdd(ActiveJobs, job);
+  cupsdUpdateJobCounts(job, 1);
 
   return (job);
 }
@@ -217,22 +328,45 @@ void
 cupsdCheckJobs(void)
 {
   cupsd_job_t		*job;		/* Current job in queue */
-  cupsd_printer_t	*printer,	/* Printer destination */
+  cupsd_printer_t	*destptr,	/* Job destination */
+			*printer,	/* Printer destination */
 			*pclass;	/* Printer class destination */
   ipp_attribute_t	*attr;		/* Job attribute */
   time_t		curtime;	/* Current time */
   const char		*reasons;	/* job-state-reasons value */
+  cups_array_t		*expired,	/* Jobs with expired deadlines */
+			*heads;		/* Queues by priority of head job */
+  cupsd_jobqueue_t	*queue;		/* Current pending job queue */
+  int			jobid;		/* Job ID being started */
 
 
   curtime = time(NULL);
 
-  cupsdLogMessage(CUPSD_LOG_DEBUG2, "cupsdCheckJobs: %d active jobs, sleeping=%d, ac-power=%d, reload=%d, curtime=" CUPS_LLFMT, cupsArrayCount(ActiveJobs), Sleeping, ACPower, NeedReload, CUPS_LLCAST curtime);
+  cupsdLogMessage(CUPSD_LOG_DEBUG2, "cupsdCheckJobs: %d active jobs, %d deadlines, sleeping=%d, ac-power=%d, reload=%d, curtime=" CUPS_LLFMT, cupsArrayCount(ActiveJobs), cupsArrayCount(JobDeadlines), Sleeping, ACPower, NeedReload, CUPS_LLCAST curtime);
+
+ /*
+  * Collect the jobs whose kill, cancel, or hold-until time has passed.  The
+  * deadlines array is sorted by time, so we only look at the expired
+  * entries, and we copy them since handling a job changes its deadline...
+  */
+
+  expired = NULL;
+
+  for (job = (cupsd_job_t *)cupsArrayFirst(JobDeadlines);
+       job && job->deadline_time <= curtime;
+       job = (cupsd_job_t *)cupsArrayNext(JobDeadlines))
+  {
+    if (!expired)
+      expired = cupsArrayNew(NULL, NULL);
+
+    cupsArrayAdd(expired, job);
+  }
 
-  for (job = (cupsd_job_t *)cupsArrayFirst(ActiveJobs);
+  for (job = (cupsd_job_t *)cupsArrayFirst(expired);
        job;
-       job = (cupsd_job_t *)cupsArrayNext(ActiveJobs))
+       job = (cupsd_job_t *)cupsArrayNext(expired))
   {
-    cupsdLogMessage(CUPSD_LOG_DEBUG2, "cupsdCheckJobs: Job %d - dest=\"%s\", printer=%p, state=%d, cancel_time=" CUPS_LLFMT ", hold_until=" CUPS_LLFMT ", kill_time=" CUPS_LLFMT ", pending_cost=%d, pending_timeout=" CUPS_LLFMT, job->id, job->dest,(void *)job->printer, job->state_value, CUPS_LLCAST job->cancel_time, CUPS_LLCAST job->hold_until, CUPS_LLCAST job->kill_time, job->pending_cost, CUPS_LLCAST job->pending_timeout);
+    cupsdLogMessage(CUPSD_LOG_DEBUG2, "cupsdCheckJobs: Job %d - dest=\"%s\", printer=%p, state=%d, cancel_time=" CUPS_LLFMT ", hold_until=" CUPS_LLFMT ", kill_time=" CUPS_LLFMT ", pending_timeout=" CUPS_LLFMT, job->id, job->dest,(void *)job->printer, job->state_value, CUPS_LLCAST job->cancel_time, CUPS_LLCAST job->hold_until, CUPS_LLCAST job->kill_time, CUPS_LLCAST job->pending_timeout);
 
    /*
     * Kill jobs if they are unresponsive...
@@ -301,108 +435,173 @@ cupsdCheckJobs(void)
       }
       else
 	cupsdSetJobState(job, IPP_JSTATE_PENDING, CUPSD_JOB_DEFAULT, "Job hold expired.");
+
+      continue;
     }
 
    /*
-    * Continue jobs that are waiting on the FilterLimit...
+    * Otherwise the deadline is stale (the job state was changed directly), so
+    * recompute it...
     */
 
+    cupsdUpdateJobDeadline(job);
+  }
+
+  cupsArrayDelete(expired);
+
+ /*
+  * Continue jobs that are waiting on the FilterLimit...
+  */
+
+  for (job = (cupsd_job_t *)cupsArrayFirst(PrintingJobs);
+       job;
+       job = (cupsd_job_t *)cupsArrayNext(PrintingJobs))
+  {
     if (job->pending_cost > 0 &&
 	((FilterLevel + job->pending_cost) < FilterLimit || FilterLevel == 0))
       cupsdContinueJob(job);
+  }
 
-   /*
-    * Skip jobs that where held-on-create
-    */
+ /*
+  * Start pending jobs if their destination is available.  Each destination
+  * has its own queue of pending jobs, and a queue is only marked ready when
+  * its jobs change or a printer it can use becomes available, so we only need
+  * to look at the head of each ready queue.  The queues are visited in the
+  * priority order of their head jobs since a class and its member printers
+  * compete for the same printers...
+  */
 
-    reasons = ippGetString(job->reasons, 0, NULL);
-    if (reasons && !strcmp(reasons, "job-held-on-create"))
+  if (NeedReload || (Sleeping && !ACPower) || DoingShutdown ||
+      !cupsArrayCount(ReadyJobQueues))
+    return;
+
+  heads = cupsArrayNew(compare_job_queue_heads, NULL);
+
+  for (queue = (cupsd_jobqueue_t *)cupsArrayFirst(ReadyJobQueues);
+       queue;
+       queue = (cupsd_jobqueue_t *)cupsArrayNext(ReadyJobQueues))
+  {
+    if (cupsArrayCount(queue->jobs) > 0)
+    {
+      cupsArrayAdd(heads, queue);
+    }
+    else
     {
      /*
-      * Check whether the printer is still holding new jobs...
+      * Free empty queues here since no job refers to them...
       */
 
-      printer = cupsdFindDest(job->dest);
+      cupsArrayRemove(JobQueues, queue);
+      cupsArrayDelete(queue->jobs);
+      cupsdClearString(&queue->dest);
+      free(queue);
+    }
+  }
 
-      if (printer->holding_new_jobs)
-        continue;
+  cupsArrayClear(ReadyJobQueues);
 
-      ippSetString(job->attrs, &job->reasons, 0, "none");
+  while ((queue = (cupsd_jobqueue_t *)cupsArrayFirst(heads)) != NULL)
+  {
+    cupsArrayRemove(heads, queue);
+
+    cupsdLogMessage(CUPSD_LOG_DEBUG2, "cupsdCheckJobs: Destination \"%s\" has %d pending jobs.", queue->dest, cupsArrayCount(queue->jobs));
+
+    destptr = cupsdFindDest(queue->dest);
+    printer = destptr;
+    pclass  = NULL;
+
+    while (printer && (printer->type & CUPS_PTYPE_CLASS))
+    {
+     /*
+      * If the class is remote, just pass it to the remote server...
+      */
+
+      pclass = printer;
+
+      if (pclass->state == IPP_PSTATE_STOPPED)
+	printer = NULL;
+      else if (pclass->type & CUPS_PTYPE_REMOTE)
+	break;
+      else
+	printer = cupsdFindAvailablePrinter(printer->name);
+    }
+
+    if (!printer && !pclass)
+    {
+     /*
+      * Whoa, the printer and/or class for this destination went away;
+      * cancel the jobs...
+      */
+
+      for (job = (cupsd_job_t *)cupsArrayFirst(queue->jobs);
+           job;
+	   job = (cupsd_job_t *)cupsArrayNext(queue->jobs))
+	cupsdSetJobState(job, IPP_JSTATE_ABORTED, CUPSD_JOB_PURGE,
+			 "Job aborted because the destination printer/class "
+			 "has gone away.");
+      continue;
     }
 
    /*
-    * Start pending jobs if the destination is available...
+    * See if the printer is available or remote and not printing a job.  If
+    * not, the queue is marked ready again when a printer becomes available...
     */
 
-    if (job->state_value == IPP_JSTATE_PENDING && !NeedReload &&
-        (!Sleeping || ACPower) && !DoingShutdown && !job->printer)
-    {
-      printer = cupsdFindDest(job->dest);
-      pclass  = NULL;
+    if (!printer || printer->job || printer->state != IPP_PSTATE_IDLE)
+      continue;
 
-      while (printer && (printer->type & CUPS_PTYPE_CLASS))
-      {
-       /*
-        * If the class is remote, just pass it to the remote server...
-	*/
+   /*
+    * Skip jobs that were held-on-create while the destination is still
+    * holding new jobs...
+    */
 
-        pclass = printer;
+    for (job = (cupsd_job_t *)cupsArrayFirst(queue->jobs);
+         job;
+	 job = (cupsd_job_t *)cupsArrayNext(queue->jobs))
+    {
+      reasons = ippGetString(job->reasons, 0, NULL);
 
-        if (pclass->state == IPP_PSTATE_STOPPED)
-	  printer = NULL;
-        else if (pclass->type & CUPS_PTYPE_REMOTE)
-	  break;
-	else
-	  printer = cupsdFindAvailablePrinter(printer->name);
-      }
+      if (!destptr->holding_new_jobs || !reasons ||
+          strcmp(reasons, "job-held-on-create"))
+        break;
+    }
 
-      if (!printer && !pclass)
-      {
-       /*
-        * Whoa, the printer and/or class for this destination went away;
-	* cancel the job...
-	*/
+    if (!job)
+      continue;
 
-        cupsdSetJobState(job, IPP_JSTATE_ABORTED, CUPSD_JOB_PURGE,
-	                 "Job aborted because the destination printer/class "
-			 "has gone away.");
-      }
-      else if (printer)
-      {
-       /*
-        * See if the printer is available or remote and not printing a job;
-	* if so, start the job...
-	*/
+    if (pclass)
+    {
+     /*
+      * Add/update a job-printer-uri-actual attribute for this job
+      * so that we know which printer actually printed the job...
+      */
 
-        if (pclass)
-	{
-	 /*
-	  * Add/update a job-printer-uri-actual attribute for this job
-	  * so that we know which printer actually printed the job...
-	  */
+      if ((attr = ippFindAttribute(job->attrs, "job-printer-uri-actual", IPP_TAG_URI)) != NULL)
+	ippSetString(job->attrs, &attr, 0, printer->uri);
+      else
+	ippAddString(job->attrs, IPP_TAG_JOB, IPP_TAG_URI, "job-printer-uri-actual", NULL, printer->uri);
 
-          if ((attr = ippFindAttribute(job->attrs, "job-printer-uri-actual", IPP_TAG_URI)) != NULL)
-            ippSetString(job->attrs, &attr, 0, printer->uri);
-	  else
-	    ippAddString(job->attrs, IPP_TAG_JOB, IPP_TAG_URI, "job-printer-uri-actual", NULL, printer->uri);
+      job->dirty = 1;
+      cupsdMarkDirty(CUPSD_DIRTY_JOBS);
+    }
 
-          job->dirty = 1;
-          cupsdMarkDirty(CUPSD_DIRTY_JOBS);
-	}
+   /*
+    * Start the job, then look at this destination again if the job left the
+    * queue and there are more jobs to start.  Try again on the next check if
+    * the job is still queued...
+    */
 
-        if (!printer->job && printer->state == IPP_PSTATE_IDLE)
-        {
-	 /*
-	  * Start the job...
-	  */
+    jobid = job->id;
 
-	  cupsArraySave(ActiveJobs);
-	  start_job(job, printer);
-	  cupsArrayRestore(ActiveJobs);
-	}
-      }
-    }
+    start_job(job, printer);
+
+    if ((job = cupsdFindJob(jobid)) != NULL && job->queue == queue)
+      set_queue_ready(queue);
+    else if (cupsArrayCount(queue->jobs) > 0)
+      cupsArrayAdd(heads, queue);
   }
+
+  cupsArrayDelete(heads);
 }
 
 
@@ -495,6 +694,7 @@ cupsdContinueJob(cupsd_job_t *job)	/* I - Job */
   int			raw_file;       /* 1 if file type is vnd.cups-raw */
   int			filterfds[2][2] = { { -1, -1 }, { -1, -1 } };
 					/* Pipes used between filters */
+  int			stream_fd = -1;	/* Pipe for streamed document */
   int			envc;		/* Number of environment variables */
   struct stat		fileinfo;	/* Job file information */
   int			argc = 0;	/* Number of arguments */
@@ -565,6 +765,8 @@ cupsdContinueJob(cupsd_job_t *job)	/* I - Job */
 
     mime_type_t	*dst = job->printer->filetype;
 					/* Destination file type */
+    double	plan_start;		/* Start of filter planning */
+    char	plan_message[256];	/* Filter planning trace message */
 
     snprintf(filename, sizeof(filename), "%s/d%05d-%03d", RequestRoot,
              job->id, job->current_file + 1);
@@ -595,7 +797,11 @@ cupsdContinueJob(cupsd_job_t *job)	/* I - Job */
 	cupsdLogJob(job, CUPSD_LOG_ERROR, "Unable to print job using a supported raster format.");
     }
 
-    filters = mimeFilter2(MimeDatabase, job->filetypes[job->current_file], (size_t)fileinfo.st_size, dst, &(job->cost));
+    plan_start = cupsGetClock();
+    filters    = mimeFilter2(MimeDatabase, job->filetypes[job->current_file], (size_t)fileinfo.st_size, dst, &(job->cost));
+
+    snprintf(plan_message, sizeof(plan_message), "%s/%s to %s/%s, %d filters, cost %d", job->filetypes[job->current_file]->super, job->filetypes[job->current_file]->type, dst ? dst->super : "???", dst ? dst->type : "???", cupsArrayCount(filters), job->cost);
+    cupsdAddJobTrace(job, "mime", "mimeFilter", 0, plan_start, cupsGetClock(), plan_message);
 
     if (!filters)
     {
@@ -919,6 +1125,27 @@ cupsdContinueJob(cupsd_job_t *job)	/* I - Job */
     argv[6] = strdup(filename);
   }
 
+  if (job->streaming && job->streaming == job->current_file + 1 && argc == 7)
+  {
+   /*
+    * The document is still being received, so send it to the first filter
+    * (or backend) through a pipe as it arrives...
+    */
+
+    if ((stream_fd = start_stream(job, filename)) < 0)
+    {
+      abort_message = "Stopping job because the scheduler could not stream "
+                      "the document.";
+
+      goto abort_job;
+    }
+
+    free(argv[6]);
+    argv[6] = NULL;
+
+    filterfds[1][0] = stream_fd;
+  }
+
   for (i = 0; argv[i]; i ++)
     cupsdLogJob(job, CUPSD_LOG_DEBUG, "argv[%d]=\"%s\"", i, argv[i]);
 
@@ -1198,6 +1425,7 @@ cupsdContinueJob(cupsd_job_t *job)	/* I - Job */
 			    job->profile, job, job->filters + i);
 
     cupsdClosePipe(filterfds[slot ^ 1]);
+    stream_fd = -1;
 
     if (pid == 0)
     {
@@ -1212,6 +1440,7 @@ cupsdContinueJob(cupsd_job_t *job)	/* I - Job */
 
     cupsdLogJob(job, CUPSD_LOG_INFO, "Started filter %s (PID %d)", command,
                 pid);
+    cupsdBeginJobTrace(job, "filter", filter->filter, pid);
 
     if (argv[6])
     {
@@ -1269,6 +1498,7 @@ cupsdContinueJob(cupsd_job_t *job)	/* I - Job */
       {
 	cupsdLogJob(job, CUPSD_LOG_INFO, "Started backend %s (PID %d)",
 		    command, pid);
+	cupsdBeginJobTrace(job, "backend", scheme, pid);
       }
     }
 
@@ -1303,6 +1533,15 @@ cupsdContinueJob(cupsd_job_t *job)	/* I - Job */
 
   cupsdClosePipe(filterfds[slot]);
 
+  if (stream_fd >= 0)
+  {
+   /*
+    * Close the streamed document pipe that was passed to the backend...
+    */
+
+    cupsdClosePipe(filterfds[1]);
+  }
+
   for (i = 6; i < argc; i ++)
     free(argv[i]);
   free(argv);
@@ -1345,6 +1584,8 @@ cupsdContinueJob(cupsd_job_t *job)	/* I - Job */
   if (printer_state_reasons)
     free(printer_state_reasons);
 
+  stop_stream(job);
+
   cupsdClosePipe(job->print_pipes);
   cupsdClosePipe(job->back_pipes);
   cupsdClosePipe(job->side_pipes);
@@ -1373,6 +1614,9 @@ cupsdContinueJob(cupsd_job_t *job)	/* I - Job */
 
   job->printer->job = NULL;
   job->printer      = NULL;
+
+  cupsdUpdateJobQueue(job);
+  check_job_attr_cache(job);
 }
 
 
@@ -1391,8 +1635,31 @@ cupsdDeleteJob(cupsd_job_t       *job,	/* I - Job */
     finalize_job(job, 1);
 
   if (action == CUPSD_JOB_PURGE)
+  {
     remove_job_history(job);
 
+   /*
+    * Record the purge in the job.cache journal...
+    */
+
+    if (num_journal_deletes >= alloc_journal_deletes)
+    {
+      int *temp = realloc(journal_deletes, (size_t)(alloc_journal_deletes + 32) * sizeof(int));
+					/* New purged job IDs */
+
+      if (temp)
+      {
+        journal_deletes       = temp;
+        alloc_journal_deletes += 32;
+      }
+      else
+        journal_records = -1;
+    }
+
+    if (num_journal_deletes < alloc_journal_deletes)
+      journal_deletes[num_journal_deletes ++] = job->id;
+  }
+
   cupsdClearString(&job->username);
   cupsdClearString(&job->dest);
   for (i = 0;
@@ -1413,12 +1680,24 @@ cupsdDeleteJob(cupsd_job_t       *job,	/* I - Job */
 
   unload_job(job);
 
+  ippDelete(job->summary);
+
   if (job->history)
     free_job_history(job);
 
+  cupsdFreeJobTrace(job);
+
   cupsArrayRemove(Jobs, job);
   cupsArrayRemove(ActiveJobs, job);
   cupsArrayRemove(PrintingJobs, job);
+  cupsArrayRemove(JobDeadlines, job);
+  cupsdUpdateJobCounts(job, 0);
+
+  if (job->queue)
+  {
+    cupsArrayRemove(job->queue->jobs, job);
+    set_queue_ready(job->queue);
+  }
 
   free(job);
 }
@@ -1451,6 +1730,45 @@ cupsdFreeAllJobs(void)
 }
 
 
+/*
+ * 'cupsdEndJobStream()' - Finish receiving a streamed document.
+ */
+
+void
+cupsdEndJobStream(cupsd_job_t *job,	/* I - Job */
+                  int         aborted)	/* I - 1 if the document was not completely received */
+{
+  if (!job->streaming)
+    return;
+
+  job->streaming = 0;
+
+  if (aborted)
+  {
+   /*
+    * Stop the job before closing the pipe so that the filters don't print a
+    * partial document...
+    */
+
+    if (job->state_value < IPP_JSTATE_CANCELED)
+    {
+      ippSetString(job->attrs, &job->reasons, 0, "aborted-by-system");
+      cupsdSetJobState(job, IPP_JSTATE_ABORTED, CUPSD_JOB_DEFAULT, "Job aborted because the document was not completely received.");
+    }
+
+    stop_stream(job);
+  }
+  else
+  {
+   /*
+    * Send the rest of the document and then close the pipe...
+    */
+
+    cupsdUpdateJobStream(job);
+  }
+}
+
+
 /*
  * 'cupsdFindJob()' - Find the specified job.
  */
@@ -1500,17 +1818,16 @@ int					/* O - Job count */
 cupsdGetPrinterJobCount(
     const char *dest)			/* I - Printer or class name */
 {
-  int		count;			/* Job count */
-  cupsd_job_t	*job;			/* Current job */
+  cupsd_jobcount_t	key,		/* Search key */
+			*count;		/* Job count */
 
 
-  for (job = (cupsd_job_t *)cupsArrayFirst(ActiveJobs), count = 0;
-       job;
-       job = (cupsd_job_t *)cupsArrayNext(ActiveJobs))
-    if (job->dest && !_cups_strcasecmp(job->dest, dest))
-      count ++;
+  key.name = (char *)dest;
 
-  return (count);
+  if ((count = (cupsd_jobcount_t *)cupsArrayFind(DestJobCounts, &key)) != NULL)
+    return (count->count);
+  else
+    return (0);
 }
 
 
@@ -1523,17 +1840,16 @@ int					/* O - Job count */
 cupsdGetUserJobCount(
     const char *username)		/* I - Username */
 {
-  int		count;			/* Job count */
-  cupsd_job_t	*job;			/* Current job */
+  cupsd_jobcount_t	key,		/* Search key */
+			*count;		/* Job count */
 
 
-  for (job = (cupsd_job_t *)cupsArrayFirst(ActiveJobs), count = 0;
-       job;
-       job = (cupsd_job_t *)cupsArrayNext(ActiveJobs))
-    if (!_cups_strcasecmp(job->username, username))
-      count ++;
+  key.name = (char *)username;
 
-  return (count);
+  if ((count = (cupsd_jobcount_t *)cupsArrayFind(UserJobCounts, &key)) != NULL)
+    return (count->count);
+  else
+    return (0);
 }
 
 
@@ -1544,8 +1860,10 @@ cupsdGetUserJobCount(
 void
 cupsdLoadAllJobs(void)
 {
-  char		filename[1024];		/* Full filename of job.cache file */
-  struct stat	fileinfo;		/* Information on job.cache file */
+  char		filename[1024],		/* Full filename of job.cache file */
+		attrs[1024];		/* JobSummaryAttributes string */
+  struct stat	fileinfo,		/* Information on job.cache file */
+		journalinfo;		/* Information on job.journal file */
   cups_dir_t	*dir;			/* RequestRoot dir */
   cups_dentry_t	*dent;			/* Entry in RequestRoot */
   int		load_cache = 1;		/* Load the job.cache file? */
@@ -1564,6 +1882,35 @@ cupsdLoadAllJobs(void)
   if (!PrintingJobs)
     PrintingJobs = cupsArrayNew(compare_jobs, NULL);
 
+  if (!JobDeadlines)
+    JobDeadlines = cupsArrayNew(compare_deadline_jobs, NULL);
+
+  if (!JobQueues)
+    JobQueues = cupsArrayNew(compare_job_queues, NULL);
+
+  if (!ReadyJobQueues)
+    ReadyJobQueues = cupsArrayNew(compare_job_queues, NULL);
+
+  if (!DestJobCounts)
+    DestJobCounts = cupsArrayNew3((cups_array_cb_t)compare_job_counts, NULL, (cups_ahash_cb_t)hash_job_count, 256, NULL, NULL);
+
+  if (!UserJobCounts)
+    UserJobCounts = cupsArrayNew3((cups_array_cb_t)compare_job_counts, NULL, (cups_ahash_cb_t)hash_job_count, 256, NULL, NULL);
+
+  if (!JobAttrCache)
+    JobAttrCache = cupsArrayNew(compare_cached_jobs, NULL);
+
+ /*
+  * Remember the JobSummaryAttributes for the summaries we load and create...
+  */
+
+  free(summary_attrs);
+  summary_attrs = NULL;
+
+  get_summary_attrs(attrs, sizeof(attrs));
+  if (attrs[0])
+    summary_attrs = strdup(attrs);
+
  /*
   * See whether the job.cache file is older than the RequestRoot directory...
   */
@@ -1593,6 +1940,16 @@ cupsdLoadAllJobs(void)
   }
   else
   {
+   /*
+    * Changes since job.cache was written are in the journal...
+    */
+
+    snprintf(filename, sizeof(filename), "%s/job.journal", CacheDir);
+    if (!stat(filename, &journalinfo) && journalinfo.st_mtime > fileinfo.st_mtime)
+      fileinfo.st_mtime = journalinfo.st_mtime;
+
+    snprintf(filename, sizeof(filename), "%s/job.cache", CacheDir);
+
     while ((dent = cupsDirRead(dir)) != NULL)
     {
       if (strlen(dent->filename) >= 6 && dent->filename[0] == 'c' && dent->fileinfo.st_mtime > fileinfo.st_mtime)
@@ -1638,6 +1995,12 @@ cupsdLoadAllJobs(void)
 
   if (MaxJobs > 0 && cupsArrayCount(Jobs) >= MaxJobs)
     cupsdCleanJobs();
+
+ /*
+  * The printers and classes have been (re)loaded, so check every queue...
+  */
+
+  cupsdSetJobQueuesReady(NULL);
 }
 
 
@@ -1664,9 +2027,15 @@ cupsdLoadJob(cupsd_job_t *job)		/* I - Job */
     if (job->state_value > IPP_JSTATE_STOPPED)
       job->access_time = time(NULL);
 
+    JobAttrCacheHits ++;
+
+    cupsdUpdateJobAttrCache(job);
+
     return (1);
   }
 
+  JobAttrCacheMisses ++;
+
   if ((job->attrs = ippNew()) == NULL)
   {
     cupsdLogJob(job, CUPSD_LOG_ERROR, "Ran out of memory for job attributes.");
@@ -2066,6 +2435,9 @@ cupsdLoadJob(cupsd_job_t *job)		/* I - Job */
   }
 
   job->access_time = time(NULL);
+
+  cupsdUpdateJobAttrCache(job);
+
   return (1);
 
  /*
@@ -2130,6 +2502,11 @@ cupsdMoveJob(cupsd_job_t     *job,	/* I - Job */
   cupsdSetString(&job->dest, p->name);
   job->dtype = p->type & (CUPS_PTYPE_CLASS | CUPS_PTYPE_REMOTE);
 
+  if (job->dest_count)
+    cupsdUpdateJobCounts(job, 1);
+
+  cupsdUpdateJobQueue(job);
+
   if ((attr = ippFindAttribute(job->attrs, "job-printer-uri",
                                IPP_TAG_URI)) != NULL)
     ippSetString(job->attrs, &attr, 0, p->uri);
@@ -2143,6 +2520,52 @@ cupsdMoveJob(cupsd_job_t     *job,	/* I - Job */
 }
 
 
+/*
+ * 'cupsdReleaseHeldNewJobs()' - Release the pending jobs that were held on
+ *                               create for a printer or class.
+ */
+
+void
+cupsdReleaseHeldNewJobs(
+    cupsd_printer_t *p)			/* I - Printer or class */
+{
+  cupsd_jobqueue_t	key,		/* Search key */
+			*queue;		/* Pending job queue */
+  cupsd_job_t		*job;		/* Current job */
+  const char		*reasons;	/* job-state-reasons value */
+
+
+  p->holding_new_jobs = 0;
+
+ /*
+  * Jobs that are still held get their reason cleared when they are queued, so
+  * only the pending jobs for the destination need to be updated here...
+  */
+
+  key.dest = p->name;
+
+  if ((queue = (cupsd_jobqueue_t *)cupsArrayFind(JobQueues, &key)) == NULL)
+    return;
+
+  for (job = (cupsd_job_t *)cupsArrayFirst(queue->jobs);
+       job;
+       job = (cupsd_job_t *)cupsArrayNext(queue->jobs))
+  {
+    reasons = ippGetString(job->reasons, 0, NULL);
+
+    if (reasons && !strcmp(reasons, "job-held-on-create"))
+    {
+      ippSetString(job->attrs, &job->reasons, 0, "none");
+
+      job->dirty = 1;
+      cupsdMarkDirty(CUPSD_DIRTY_JOBS);
+    }
+  }
+
+  set_queue_ready(queue);
+}
+
+
 /*
  * 'cupsdReleaseJob()' - Release the specified job.
  */
@@ -2186,16 +2609,34 @@ cupsdRestartJob(cupsd_job_t *job)	/* I - Job */
 
 /*
  * 'cupsdSaveAllJobs()' - Save a summary of all jobs to disk.
+ *
+ * This also compacts the job.cache journal.
  */
 
 void
 cupsdSaveAllJobs(void)
 {
-  int		i;			/* Looping var */
   cups_file_t	*fp;			/* job.cache file */
   char		filename[1024];		/* job.cache filename */
   cupsd_job_t	*job;			/* Current job */
+  double	start = cupsGetClock();	/* Start time */
+
+
+ /*
+  * Remove the journal first - if we fail to write the new job.cache file, the
+  * newer job control files will cause a reload from the spool directory...
+  */
+
+  snprintf(filename, sizeof(filename), "%s/job.journal", CacheDir);
+  if (unlink(filename) && errno != ENOENT)
+    cupsdLogMessage(CUPSD_LOG_ERROR, "Unable to remove job cache journal \"%s\": %s", filename, strerror(errno));
+
+  snprintf(filename, sizeof(filename), "%s/job.index", CacheDir);
+  if (unlink(filename) && errno != ENOENT)
+    cupsdLogMessage(CUPSD_LOG_ERROR, "Unable to remove job index \"%s\": %s", filename, strerror(errno));
 
+  num_journal_deletes = 0;
+  journal_records     = -1;
 
   snprintf(filename, sizeof(filename), "%s/job.cache", CacheDir);
   if ((fp = cupsdCreateConfFile(filename, ConfigFilePerm)) == NULL)
@@ -2210,6 +2651,8 @@ cupsdSaveAllJobs(void)
   cupsFilePuts(fp, "# Job cache file for " CUPS_SVERSION "\n");
   cupsFilePrintf(fp, "# Written by cupsd\n");
   cupsFilePrintf(fp, "NextJobId %d\n", NextJobId);
+  if (summary_attrs)
+    cupsFilePrintf(fp, "SummaryAttributes %s\n", summary_attrs);
 
  /*
   * Write each job known to the system...
@@ -2219,37 +2662,18 @@ cupsdSaveAllJobs(void)
        job;
        job = (cupsd_job_t *)cupsArrayNext(Jobs))
   {
-    if (job->printer && job->printer->temporary)
-    {
-     /*
-      * Don't save jobs on temporary printers...
-      */
+    write_job_cache(fp, job);
+    job->journal = 0;
+  }
 
-      continue;
-    }
+  if (!cupsdCloseCreatedConfFile(fp, filename))
+  {
+    journal_records = 0;
 
-    cupsFilePrintf(fp, "<Job %d>\n", job->id);
-    cupsFilePrintf(fp, "State %d\n", job->state_value);
-    cupsFilePrintf(fp, "Created " CUPS_LLFMT "\n", CUPS_LLCAST job->creation_time);
-    if (job->completed_time)
-      cupsFilePrintf(fp, "Completed " CUPS_LLFMT "\n", CUPS_LLCAST job->completed_time);
-    cupsFilePrintf(fp, "Priority %d\n", job->priority);
-    if (job->hold_until)
-      cupsFilePrintf(fp, "HoldUntil " CUPS_LLFMT "\n", CUPS_LLCAST job->hold_until);
-    cupsFilePrintf(fp, "Username %s\n", job->username);
-    if (job->name)
-      cupsFilePutConf(fp, "Name", job->name);
-    cupsFilePrintf(fp, "Destination %s\n", job->dest);
-    cupsFilePrintf(fp, "DestType %d\n", job->dtype);
-    cupsFilePrintf(fp, "KOctets %d\n", job->koctets);
-    cupsFilePrintf(fp, "NumFiles %d\n", job->num_files);
-    for (i = 0; i < job->num_files; i ++)
-      cupsFilePrintf(fp, "File %d %s/%s %d\n", i + 1, job->filetypes[i]->super,
-                     job->filetypes[i]->type, job->compressions[i]);
-    cupsFilePuts(fp, "</Job>\n");
+    write_job_index(filename);
   }
 
-  cupsdCloseCreatedConfFile(fp, filename);
+  cupsdAddHistogram(&MetricsJobCacheSave, cupsGetClock() - start);
 }
 
 
@@ -2284,6 +2708,13 @@ cupsdSaveJob(cupsd_job_t *job)		/* I - Job */
 
   fchown(cupsFileNumber(fp), RunUser, Group);
 
+ /*
+  * Every change to the job attributes marks the job dirty, so update the size
+  * in the attribute cache here...
+  */
+
+  check_job_attr_cache(job);
+
   job->attrs->state = IPP_STATE_IDLE;
 
   if (ippWriteIO(fp, (ipp_iocb_t)cupsFileWrite, 1, NULL,
@@ -2303,8 +2734,88 @@ cupsdSaveJob(cupsd_job_t *job)		/* I - Job */
     cupsConcatString(filename, ".O", sizeof(filename));
     unlink(filename);
 
-    job->dirty = 0;
+    job->dirty   = 0;
+    job->journal = 1;
+  }
+}
+
+
+/*
+ * 'cupsdSaveJobJournal()' - Append changed jobs to the job.cache journal.
+ *
+ * Only jobs that are dirty, have been saved since the last journal update, or
+ * have been purged get written.  The journal is compacted into a new job.cache
+ * file once it holds as many records as there are jobs, so the amount of data
+ * written stays proportional to the number of changes rather than the number
+ * of jobs.
+ */
+
+void
+cupsdSaveJobJournal(void)
+{
+  int		i;			/* Looping var */
+  cups_file_t	*fp;			/* job.journal file */
+  char		filename[1024];		/* job.journal filename */
+  cupsd_job_t	*job;			/* Current job */
+  int		records;		/* Number of records written */
+  double	start;			/* Start time */
+
+
+  if (journal_records < 0 || journal_records >= cupsArrayCount(Jobs))
+  {
+    cupsdSaveAllJobs();
+    return;
+  }
+
+  start = cupsGetClock();
+
+  snprintf(filename, sizeof(filename), "%s/job.journal", CacheDir);
+  if ((fp = cupsFileOpen(filename, "a")) == NULL)
+  {
+    cupsdLogMessage(CUPSD_LOG_ERROR, "Unable to open job cache journal \"%s\": %s", filename, strerror(errno));
+    cupsdSaveAllJobs();
+    return;
+  }
+
+  if (!getuid() && fchown(cupsFileNumber(fp), getuid(), Group))
+    cupsdLogMessage(CUPSD_LOG_WARN, "Unable to change group for \"%s\": %s", filename, strerror(errno));
+
+  if (fchmod(cupsFileNumber(fp), ConfigFilePerm))
+    cupsdLogMessage(CUPSD_LOG_WARN, "Unable to change permissions for \"%s\": %s", filename, strerror(errno));
+
+  cupsdLogMessage(CUPSD_LOG_DEBUG, "Appending to job cache journal...");
+
+  cupsFilePrintf(fp, "NextJobId %d\n", NextJobId);
+  if (summary_attrs)
+    cupsFilePrintf(fp, "SummaryAttributes %s\n", summary_attrs);
+
+  for (i = 0; i < num_journal_deletes; i ++)
+    cupsFilePrintf(fp, "DeleteJob %d\n", journal_deletes[i]);
+
+  records             = num_journal_deletes;
+  num_journal_deletes = 0;
+
+  for (job = (cupsd_job_t *)cupsArrayFirst(Jobs);
+       job;
+       job = (cupsd_job_t *)cupsArrayNext(Jobs))
+  {
+    if (job->dirty || job->journal)
+    {
+      write_job_cache(fp, job);
+      job->journal = 0;
+      records ++;
+    }
+  }
+
+  if (cupsFileClose(fp))
+  {
+    cupsdLogMessage(CUPSD_LOG_ERROR, "Unable to write job cache journal \"%s\": %s", filename, strerror(errno));
+    journal_records = -1;
   }
+  else
+    journal_records += records;
+
+  cupsdAddHistogram(&MetricsJobJournalSave, cupsGetClock() - start);
 }
 
 
@@ -2485,6 +2996,8 @@ cupsdSetJobHoldUntil(cupsd_job_t *job,	/* I - Job */
 
   cupsdLogMessage(CUPSD_LOG_DEBUG2, "cupsdSetJobHoldUntil: hold_until=" CUPS_LLFMT,
                   CUPS_LLCAST job->hold_until);
+
+  cupsdUpdateJobDeadline(job);
 }
 
 
@@ -2514,6 +3027,9 @@ cupsdSetJobPriority(
 
   cupsArrayRemove(ActiveJobs, job);
 
+  if (job->queue)
+    cupsArrayRemove(job->queue->jobs, job);
+
   job->priority = priority;
 
   if ((attr = ippFindAttribute(job->attrs, "job-priority",
@@ -2525,11 +3041,66 @@ cupsdSetJobPriority(
 
   cupsArrayAdd(ActiveJobs, job);
 
+  if (job->queue)
+    cupsArrayAdd(job->queue->jobs, job);
+
   job->dirty = 1;
   cupsdMarkDirty(CUPSD_DIRTY_JOBS);
 }
 
 
+/*
+ * 'cupsdSetJobQueuesReady()' - Mark the pending job queues that can use a
+ *                              printer or class as ready to check.
+ *
+ * Call this when the printer or class may have become available.  Passing
+ * NULL marks every queue, e.g. after the printers and classes are loaded.
+ */
+
+void
+cupsdSetJobQueuesReady(
+    cupsd_printer_t *p)			/* I - Printer or class, NULL for all */
+{
+  cupsd_printer_t	*c;		/* Current class */
+  cupsd_jobqueue_t	key,		/* Search key */
+			*queue;		/* Current queue */
+
+
+  if (!cupsArrayCount(JobQueues))
+    return;
+
+  if (!p)
+  {
+    for (queue = (cupsd_jobqueue_t *)cupsArrayFirst(JobQueues);
+         queue;
+	 queue = (cupsd_jobqueue_t *)cupsArrayNext(JobQueues))
+      set_queue_ready(queue);
+
+    return;
+  }
+
+  key.dest = p->name;
+
+  set_queue_ready((cupsd_jobqueue_t *)cupsArrayFind(JobQueues, &key));
+
+  if (p->type & CUPS_PTYPE_CLASS)
+    return;
+
+ /*
+  * Jobs for any class containing the printer can use it, too...
+  */
+
+  for (c = (cupsd_printer_t *)cupsArrayFirst(p->classes);
+       c;
+       c = (cupsd_printer_t *)cupsArrayNext(p->classes))
+  {
+    key.dest = c->name;
+
+    set_queue_ready((cupsd_jobqueue_t *)cupsArrayFind(JobQueues, &key));
+  }
+}
+
+
 /*
  * 'cupsdSetJobState()' - Set the state of the specified print job.
  */
@@ -2586,6 +3157,8 @@ cupsdSetJobState(
   if (job->state)
     job->state->values[0].integer = (int)newstate;
 
+  check_job_attr_cache(job);
+
   switch (newstate)
   {
     case IPP_JSTATE_PENDING :
@@ -2674,7 +3247,10 @@ cupsdSetJobState(
 	*/
 
         if (!cupsArrayFind(ActiveJobs, job))
+	{
 	  cupsArrayAdd(ActiveJobs, job);
+	  cupsdUpdateJobCounts(job, 1);
+	}
 
        /*
 	* Save the job state to disk...
@@ -2697,7 +3273,10 @@ cupsdSetJobState(
 	  for (i = 0; job->filters[i] < 0; i++);
 
 	  if (!job->filters[i] && job->backend <= 0)
+	  {
 	    cupsArrayRemove(ActiveJobs, job);
+	    cupsdUpdateJobCounts(job, 0);
+	  }
 	}
 	else
 	{
@@ -2706,6 +3285,7 @@ cupsdSetJobState(
 	  */
 
 	  cupsArrayRemove(ActiveJobs, job);
+	  cupsdUpdateJobCounts(job, 0);
 	}
 
        /*
@@ -2777,6 +3357,16 @@ cupsdSetJobState(
   if (action >= CUPSD_JOB_FORCE && job && job->printer)
     finalize_job(job, 0);
 
+ /*
+  * Update the job's deadline for the new state...
+  */
+
+  if (job)
+  {
+    cupsdUpdateJobDeadline(job);
+    cupsdUpdateJobQueue(job);
+  }
+
  /*
   * Update the server "busy" state...
   */
@@ -2808,7 +3398,10 @@ cupsdStopAllJobs(
     else
     {
       if (kill_delay)
+      {
         job->kill_time = time(NULL) + kill_delay;
+        cupsdUpdateJobDeadline(job);
+      }
 
       cupsdSetJobState(job, IPP_JSTATE_PENDING, action, NULL);
     }
@@ -2818,29 +3411,269 @@ cupsdStopAllJobs(
 
 /*
  * 'cupsdUnloadCompletedJobs()' - Flush completed job history from memory.
+ *
+ * Completed jobs are saved right away so that the job history is on disk, and
+ * the least recently used completed job attributes are unloaded until the
+ * loaded attributes fit in JobAttrCacheSize bytes.
  */
 
 void
 cupsdUnloadCompletedJobs(void)
 {
   cupsd_job_t	*job;			/* Current job */
-  time_t	expire;			/* Expiration time */
-
+  int		count,			/* Number of jobs to check */
+		unloaded = 0;		/* Number of jobs unloaded */
 
-  expire = time(NULL) - 60;
 
-  for (job = (cupsd_job_t *)cupsArrayFirst(Jobs);
+  for (job = (cupsd_job_t *)cupsArrayFirst(JobAttrCache);
        job;
-       job = (cupsd_job_t *)cupsArrayNext(Jobs))
-    if (job->attrs && job->state_value >= IPP_JSTATE_STOPPED && !job->printer &&
-        job->access_time < expire)
+       job = (cupsd_job_t *)cupsArrayNext(JobAttrCache))
+    if (job->dirty)
+      cupsdSaveJob(job);
+
+  for (count = cupsArrayCount(JobAttrCache);
+       count > 0 && JobAttrCacheUsed > (size_t)JobAttrCacheSize &&
+           (job = (cupsd_job_t *)cupsArrayFirst(JobAttrCache)) != NULL;
+       count --)
+  {
+   /*
+    * Drop jobs that are active again and update the size...
+    */
+
+    check_job_attr_cache(job);
+
+    if (!job->attrs_seq)
+      continue;
+
+    if (job->dirty)
+      cupsdSaveJob(job);
+
+    if (job->dirty)
+    {
+     /*
+      * Unable to save, try again later...
+      */
+
+      cupsdUpdateJobAttrCache(job);
+      continue;
+    }
+
+    unload_job(job);
+    unloaded ++;
+  }
+
+  if (unloaded)
+    cupsdLogMessage(CUPSD_LOG_DEBUG, "Unloaded %d jobs, job attribute cache has %d jobs using %lu bytes (%ld hits, %ld misses).", unloaded, cupsArrayCount(JobAttrCache), (unsigned long)JobAttrCacheUsed, JobAttrCacheHits, JobAttrCacheMisses);
+}
+
+
+/*
+ * 'cupsdUpdateJobAttrCache()' - Move a job with loaded attributes to the end
+ *                               of the attribute cache.
+ *
+ * Jobs without loaded attributes or that are still active are removed from
+ * the cache.
+ */
+
+void
+cupsdUpdateJobAttrCache(
+    cupsd_job_t *job)			/* I - Job */
+{
+  if (job->attrs_seq)
+  {
+    cupsArrayRemove(JobAttrCache, job);
+
+    JobAttrCacheUsed -= job->attrs_size;
+    job->attrs_seq   = 0;
+    job->attrs_size  = 0;
+  }
+
+  if (!job->attrs || !JobAttrCache || job->state_value < IPP_JSTATE_STOPPED || job->printer)
+    return;
+
+  job->attrs_seq   = ++ job_attrs_seq;
+  job->attrs_size  = ippLength(job->attrs);
+  JobAttrCacheUsed += job->attrs_size;
+
+  cupsArrayAdd(JobAttrCache, job);
+}
+
+
+/*
+ * 'cupsdUpdateJobCounts()' - Update the destination and user active job
+ *                            counters for a job.
+ *
+ * Call with "active" set to 1 when the job is in the ActiveJobs array and 0
+ * when it is removed.  Calling again after the destination or username change
+ * moves the job to the new counters.
+ */
+
+void
+cupsdUpdateJobCounts(cupsd_job_t *job,	/* I - Job */
+                     int         active)/* I - 1 if active, 0 otherwise */
+{
+  cupsd_jobcount_t	*dest_count = NULL,
+					/* New destination counter */
+			*user_count = NULL;
+					/* New user counter */
+
+
+  if (active)
+  {
+    if (job->dest)
+      dest_count = get_job_count(DestJobCounts, job->dest);
+
+    if (job->username)
+      user_count = get_job_count(UserJobCounts, job->username);
+  }
+
+  if (dest_count != job->dest_count)
+  {
+    if (job->dest_count)
+      release_job_count(DestJobCounts, job->dest_count);
+
+    if ((job->dest_count = dest_count) != NULL)
+      dest_count->count ++;
+  }
+
+  if (user_count != job->user_count)
+  {
+    if (job->user_count)
+      release_job_count(UserJobCounts, job->user_count);
+
+    if ((job->user_count = user_count) != NULL)
+      user_count->count ++;
+  }
+}
+
+
+/*
+ * 'cupsdUpdateJobDeadline()' - Update the position of a job in the deadline
+ *                              list after its cancel, kill, or hold-until
+ *                              time has changed.
+ */
+
+void
+cupsdUpdateJobDeadline(
+    cupsd_job_t *job)			/* I - Job */
+{
+  time_t	deadline = 0;		/* New deadline */
+
+
+  if (job->cancel_time)
+    deadline = job->cancel_time;
+
+  if (job->kill_time && (!deadline || job->kill_time < deadline))
+    deadline = job->kill_time;
+
+  if (job->state_value == IPP_JSTATE_HELD && job->hold_until &&
+      (!deadline || job->hold_until < deadline))
+    deadline = job->hold_until;
+
+  if (deadline == job->deadline_time)
+    return;
+
+  if (job->deadline_time)
+    cupsArrayRemove(JobDeadlines, job);
+
+  job->deadline_time = deadline;
+
+  if (deadline)
+    cupsArrayAdd(JobDeadlines, job);
+}
+
+
+/*
+ * 'cupsdUpdateJobQueue()' - Add or remove a job from the pending job queue of
+ *                           its destination.
+ *
+ * A job is queued when it is pending and not assigned to a printer.
+ */
+
+void
+cupsdUpdateJobQueue(cupsd_job_t *job)	/* I - Job */
+{
+  cupsd_jobqueue_t	key,		/* Search key */
+			*queue = NULL;	/* New queue */
+
+
+  if (job->state_value == IPP_JSTATE_PENDING && !job->printer && job->dest)
+  {
+    if (job->queue && !_cups_strcasecmp(job->queue->dest, job->dest))
+      return;
+
+    key.dest = job->dest;
+
+    if ((queue = (cupsd_jobqueue_t *)cupsArrayFind(JobQueues, &key)) == NULL)
+    {
+      if ((queue = calloc(1, sizeof(cupsd_jobqueue_t))) == NULL ||
+          (queue->jobs = cupsArrayNew(compare_active_jobs, NULL)) == NULL)
+      {
+        cupsdLogJob(job, CUPSD_LOG_ERROR, "Unable to allocate memory for pending job queue.");
+        free(queue);
+        return;
+      }
+
+      cupsdSetString(&queue->dest, job->dest);
+      cupsArrayAdd(JobQueues, queue);
+    }
+  }
+
+  if (queue == job->queue)
+    return;
+
+  if (job->queue)
+  {
+   /*
+    * Mark the old queue ready so it gets freed once it is empty...
+    */
+
+    cupsArrayRemove(job->queue->jobs, job);
+    set_queue_ready(job->queue);
+  }
+
+  job->queue = queue;
+
+  if (queue)
+  {
+    const char		*reasons;	/* job-state-reasons value */
+    cupsd_printer_t	*dest;		/* Destination */
+
+   /*
+    * Jobs that were held on create are only skipped while the destination is
+    * still holding new jobs...
+    */
+
+    reasons = ippGetString(job->reasons, 0, NULL);
+
+    if (reasons && !strcmp(reasons, "job-held-on-create") &&
+        (dest = cupsdFindDest(job->dest)) != NULL && !dest->holding_new_jobs)
     {
-      if (job->dirty)
-        cupsdSaveJob(job);
+      ippSetString(job->attrs, &job->reasons, 0, "none");
 
-      if (!job->dirty)
-        unload_job(job);
+      job->dirty = 1;
+      cupsdMarkDirty(CUPSD_DIRTY_JOBS);
     }
+
+    cupsArrayAdd(queue->jobs, job);
+    set_queue_ready(queue);
+  }
+}
+
+
+/*
+ * 'cupsdUpdateJobStream()' - Send newly received document data to the filters.
+ */
+
+void
+cupsdUpdateJobStream(cupsd_job_t *job)	/* I - Job */
+{
+  if (job->stream && job->stream->waiting)
+  {
+    job->stream->waiting = 0;
+
+    cupsdAddSelect(job->stream->pipe, NULL, (cupsd_selfunc_t)update_stream, job);
+  }
 }
 
 
@@ -2926,42 +3759,246 @@ compare_active_jobs(void *first,  /* I - First job */
 
 
 /*
- * 'compare_completed_jobs()' - Compare the job IDs and completion times of two jobs.
+ * 'check_job_attr_cache()' - Update the attribute cache for a changed job.
+ *
+ * Unlike cupsdUpdateJobAttrCache(), this keeps the job's place in the cache
+ * and just updates the size of its attributes.
  */
 
-static int                           /* O - Difference */
-compare_completed_jobs(void *first,  /* I - First job */
-                       void *second, /* I - Second job */
-                       void *data)   /* I - App data (not used) */
+static void
+check_job_attr_cache(cupsd_job_t *job)	/* I - Job */
 {
-  int	diff;				/* Difference */
+  size_t	size;			/* New size of attributes */
 
 
-  (void)data;
+  if (!job->attrs_seq || !job->attrs || job->state_value < IPP_JSTATE_STOPPED || job->printer)
+  {
+   /*
+    * Add or remove the job as needed...
+    */
 
-  if ((diff = ((cupsd_job_t *)second)->completed_time -
-              ((cupsd_job_t *)first)->completed_time) != 0)
-    return (diff);
-  else
-    return (((cupsd_job_t *)first)->id - ((cupsd_job_t *)second)->id);
+    cupsdUpdateJobAttrCache(job);
+    return;
+  }
+
+  size             = ippLength(job->attrs);
+  JobAttrCacheUsed = JobAttrCacheUsed - job->attrs_size + size;
+  job->attrs_size  = size;
 }
 
 
 /*
- * 'compare_jobs()' - Compare the job IDs of two jobs.
+ * 'compare_cached_jobs()' - Compare the attribute cache use of two jobs.
  */
 
-static int                 /* O - Difference */
-compare_jobs(void *first,  /* I - First job */
-             void *second, /* I - Second job */
-             void *data)   /* I - App data (not used) */
+static int                          /* O - Difference */
+compare_cached_jobs(void *first,    /* I - First job */
+                    void *second,   /* I - Second job */
+                    void *data)     /* I - App data (not used) */
 {
-  (void)data;
+  long	first_seq = ((cupsd_job_t *)first)->attrs_seq,
+	second_seq = ((cupsd_job_t *)second)->attrs_seq;
+					/* Use sequences */
+
+
+  (void)data;
+
+  if (first_seq < second_seq)
+    return (-1);
+  else if (first_seq > second_seq)
+    return (1);
+  else
+    return (0);
+}
+
+
+/*
+ * 'compare_completed_jobs()' - Compare the job IDs and completion times of two jobs.
+ */
+
+static int                           /* O - Difference */
+compare_completed_jobs(void *first,  /* I - First job */
+                       void *second, /* I - Second job */
+                       void *data)   /* I - App data (not used) */
+{
+  int	diff;				/* Difference */
+
+
+  (void)data;
+
+  if ((diff = ((cupsd_job_t *)second)->completed_time -
+              ((cupsd_job_t *)first)->completed_time) != 0)
+    return (diff);
+  else
+    return (((cupsd_job_t *)first)->id - ((cupsd_job_t *)second)->id);
+}
+
+
+/*
+ * 'compare_deadline_jobs()' - Compare the deadlines and IDs of two jobs.
+ */
+
+static int                          /* O - Difference */
+compare_deadline_jobs(void *first,  /* I - First job */
+                      void *second, /* I - Second job */
+                      void *data)   /* I - App data (not used) */
+{
+  time_t	first_time = ((cupsd_job_t *)first)->deadline_time,
+		second_time = ((cupsd_job_t *)second)->deadline_time;
+					/* Deadlines */
+
+
+  (void)data;
+
+  if (first_time < second_time)
+    return (-1);
+  else if (first_time > second_time)
+    return (1);
+  else
+    return (((cupsd_job_t *)first)->id - ((cupsd_job_t *)second)->id);
+}
+
+
+/*
+ * 'compare_index_strings()' - Compare two job index strings.
+ */
+
+static int				/* O - Difference */
+compare_index_strings(
+    cupsd_idxstr_t *first,		/* I - First string */
+    cupsd_idxstr_t *second,		/* I - Second string */
+    void           *data)		/* I - App data (not used) */
+{
+  (void)data;
+
+  return (strcmp(first->str, second->str));
+}
+
+
+/*
+ * 'compare_job_counts()' - Compare the names of two job counters.
+ */
+
+static int				/* O - Difference */
+compare_job_counts(
+    cupsd_jobcount_t *first,		/* I - First job counter */
+    cupsd_jobcount_t *second,		/* I - Second job counter */
+    void             *data)		/* I - App data (not used) */
+{
+  (void)data;
+
+  return (_cups_strcasecmp(first->name, second->name));
+}
+
+
+/*
+ * 'compare_job_queue_heads()' - Compare the first jobs in two queues.
+ */
+
+static int                            /* O - Difference */
+compare_job_queue_heads(void *first,  /* I - First queue */
+                        void *second, /* I - Second queue */
+                        void *data)   /* I - App data (not used) */
+{
+  cupsd_job_t	*first_job = (cupsd_job_t *)cupsArrayIndex(((cupsd_jobqueue_t *)first)->jobs, 0),
+		*second_job = (cupsd_job_t *)cupsArrayIndex(((cupsd_jobqueue_t *)second)->jobs, 0);
+					/* First jobs */
+
+
+  if (!first_job || !second_job)
+    return (!first_job - !second_job);
+  else if (first_job == second_job)
+    return (0);
+  else
+    return (compare_active_jobs(first_job, second_job, data));
+}
+
+
+/*
+ * 'compare_job_queues()' - Compare the destinations of two queues.
+ */
+
+static int                       /* O - Difference */
+compare_job_queues(void *first,  /* I - First queue */
+                   void *second, /* I - Second queue */
+                   void *data)   /* I - App data (not used) */
+{
+  (void)data;
+
+  return (_cups_strcasecmp(((cupsd_jobqueue_t *)first)->dest,
+                           ((cupsd_jobqueue_t *)second)->dest));
+}
+
+
+/*
+ * 'compare_jobs()' - Compare the job IDs of two jobs.
+ */
+
+static int                 /* O - Difference */
+compare_jobs(void *first,  /* I - First job */
+             void *second, /* I - Second job */
+             void *data)   /* I - App data (not used) */
+{
+  (void)data;
 
   return (((cupsd_job_t *)first)->id - ((cupsd_job_t *)second)->id);
 }
 
 
+/*
+ * 'copy_summary_attr()' - Copy a job attribute to the job summary.
+ */
+
+static int				/* O - 1 to copy, 0 to skip */
+copy_summary_attr(
+    void            *context,		/* I - Context (not used) */
+    ipp_t           *dst,		/* I - Destination (not used) */
+    ipp_attribute_t *attr)		/* I - Attribute */
+{
+  const char	*name = ippGetName(attr);
+					/* Attribute name */
+
+
+  (void)context;
+  (void)dst;
+
+  return (name && ippGetGroupTag(attr) == IPP_TAG_JOB && cupsArrayFind(JobSummaryAttrs, (void *)name) != NULL);
+}
+
+
+/*
+ * 'decode_job_summary()' - Decode a job summary from the job cache.
+ */
+
+static ipp_t *				/* O - Summary attributes or NULL */
+decode_job_summary(const char *value)	/* I - Base64-encoded IPP message */
+{
+  ipp_uchar_t		data[4096];	/* IPP message */
+  size_t		length = sizeof(data);
+					/* Length of IPP message */
+  cupsd_ippbuf_t	buf;		/* Read buffer */
+  ipp_t			*summary;	/* Summary attributes */
+
+
+  if (!httpDecode64_3((char *)data, &length, value, NULL) || length == 0)
+    return (NULL);
+
+  buf.data   = data;
+  buf.pos    = 0;
+  buf.length = length;
+
+  summary = ippNew();
+
+  if (ippReadIO(&buf, (ipp_io_cb_t)read_ippbuf, 1, NULL, summary) != IPP_STATE_DATA)
+  {
+    ippDelete(summary);
+    return (NULL);
+  }
+
+  return (summary);
+}
+
+
 /*
  * 'dump_job_history()' - Dump any debug messages for a job.
  */
@@ -3096,6 +4133,52 @@ free_job_history(cupsd_job_t *job)	/* I - Job */
 }
 
 
+/*
+ * 'encode_job_summary()' - Encode a job summary for the job cache.
+ *
+ * The summary is written as a Base64-encoded IPP message.  Loaded jobs get a
+ * fresh summary from their attributes.  NULL is returned for summaries that
+ * are empty or too large.
+ */
+
+static char *				/* O - Base64 string (free when done) or NULL */
+encode_job_summary(cupsd_job_t *job)	/* I - Job */
+{
+  ipp_t			*summary;	/* Summary attributes */
+  ipp_uchar_t		data[4096];	/* IPP message */
+  cupsd_ippbuf_t	buf;		/* Write buffer */
+  char			*value = NULL;	/* Base64 string */
+
+
+  if (!summary_attrs)
+    return (NULL);
+
+  if (job->attrs)
+  {
+    summary = ippNew();
+    ippCopyAttributes(summary, job->attrs, 0, copy_summary_attr, NULL);
+  }
+  else if ((summary = job->summary) == NULL)
+    return (NULL);
+
+  buf.data   = data;
+  buf.pos    = 0;
+  buf.length = sizeof(data);
+
+  ippSetState(summary, IPP_STATE_IDLE);
+
+  if (ippGetFirstAttribute(summary) && ippLength(summary) <= sizeof(data) &&
+      ippWriteIO(&buf, (ipp_io_cb_t)write_ippbuf, 1, NULL, summary) == IPP_STATE_DATA &&
+      (value = malloc(2 * buf.pos + 4)) != NULL)
+    httpEncode64_3(value, 2 * buf.pos + 4, (char *)data, buf.pos, false);
+
+  if (summary != job->summary)
+    ippDelete(summary);
+
+  return (value);
+}
+
+
 /*
  * 'finalize_job()' - Cleanup after job filter processes and support data.
  */
@@ -3154,10 +4237,14 @@ finalize_job(cupsd_job_t *job,		/* I - Job */
   job->cancel_time = 0;
   job->kill_time   = 0;
 
+  cupsdUpdateJobDeadline(job);
+
  /*
   * Close pipes and status buffer...
   */
 
+  stop_stream(job);
+
   cupsdClosePipe(job->print_pipes);
   cupsdClosePipe(job->back_pipes);
   cupsdClosePipe(job->side_pipes);
@@ -3174,6 +4261,16 @@ finalize_job(cupsd_job_t *job,		/* I - Job */
   snprintf(buffer, sizeof(buffer), "total %d", ippGetInteger(job->impressions, 0));
   cupsdLogPage(job, buffer);
 
+ /*
+  * Write the job trace, if any...
+  */
+
+  if (job->trace)
+  {
+    cupsdAddJobTrace(job, "job", "finalize_job", 0, cupsGetClock(), 0.0, NULL);
+    cupsdSaveJobTrace(job);
+  }
+
  /*
   * Process the exit status...
   */
@@ -3635,6 +4732,39 @@ finalize_job(cupsd_job_t *job,		/* I - Job */
 
   job->printer->job = NULL;
   job->printer      = NULL;
+
+  cupsdUpdateJobQueue(job);
+  check_job_attr_cache(job);
+}
+
+
+/*
+ * 'get_job_count()' - Find or create a job counter.
+ */
+
+static cupsd_jobcount_t *		/* O - Job counter or NULL */
+get_job_count(cups_array_t *counts,	/* I - Job counters */
+              const char   *name)	/* I - Destination or user name */
+{
+  cupsd_jobcount_t	key,		/* Search key */
+			*count;		/* Job counter */
+
+
+  key.name = (char *)name;
+
+  if ((count = (cupsd_jobcount_t *)cupsArrayFind(counts, &key)) == NULL)
+  {
+    if ((count = calloc(1, sizeof(cupsd_jobcount_t))) == NULL)
+    {
+      cupsdLogMessage(CUPSD_LOG_ERROR, "Unable to allocate memory for job counter \"%s\".", name);
+      return (NULL);
+    }
+
+    cupsdSetString(&count->name, name);
+    cupsArrayAdd(counts, count);
+  }
+
+  return (count);
 }
 
 
@@ -4226,6 +5356,91 @@ get_options(cupsd_job_t *job,		/* I - Job */
 }
 
 
+/*
+ * 'get_summary_attrs()' - Get the JobSummaryAttributes list as a string.
+ */
+
+static void
+get_summary_attrs(char   *buffer,	/* I - String buffer */
+                  size_t bufsize)	/* I - Size of string buffer */
+{
+  const char	*name;			/* Attribute name */
+  char		*bufptr,		/* Pointer into buffer */
+		*bufend;		/* End of buffer */
+
+
+  *buffer = '\0';
+
+  for (name = (const char *)cupsArrayFirst(JobSummaryAttrs), bufptr = buffer, bufend = buffer + bufsize - 1;
+       name && bufptr < bufend;
+       name = (const char *)cupsArrayNext(JobSummaryAttrs))
+  {
+    if (bufptr > buffer)
+      *bufptr++ = ',';
+
+    cupsCopyString(bufptr, name, (size_t)(bufend - bufptr + 1));
+    bufptr += strlen(bufptr);
+  }
+}
+
+
+/*
+ * 'hash_job_count()' - Compute the hash of a job counter name.
+ */
+
+static int				/* O - Hash value */
+hash_job_count(
+    cupsd_jobcount_t *count,		/* I - Job counter */
+    void             *data)		/* I - App data (not used) */
+{
+  const char	*name;			/* Pointer into name */
+  unsigned	hash;			/* Hash value */
+
+
+  (void)data;
+
+  for (name = count->name, hash = 0; *name; name ++)
+    hash = 31 * hash + (unsigned)_cups_tolower(*name);
+
+  return ((int)(hash & 255));
+}
+
+
+/*
+ * 'index_string()' - Add a string to the job index string table.
+ */
+
+static uint32_t				/* O  - Offset in string table */
+index_string(cups_array_t *strings,	/* I  - Strings, sorted */
+             cups_array_t *order,	/* I  - Strings, in table order */
+             const char   *str,		/* I  - String */
+             uint32_t     *size)	/* IO - Size of string table */
+{
+  cupsd_idxstr_t	key,		/* Search key */
+			*idxstr;	/* Table string */
+
+
+  key.str = (char *)str;
+
+  if ((idxstr = (cupsd_idxstr_t *)cupsArrayFind(strings, &key)) == NULL)
+  {
+    if ((idxstr = calloc(1, sizeof(cupsd_idxstr_t))) == NULL || (idxstr->str = strdup(str)) == NULL)
+    {
+      free(idxstr);
+      return (CUPSD_JOB_INDEX_NONE);
+    }
+
+    idxstr->offset = *size;
+    *size          += (uint32_t)strlen(str) + 1;
+
+    cupsArrayAdd(strings, idxstr);
+    cupsArrayAdd(order, idxstr);
+  }
+
+  return (idxstr->offset);
+}
+
+
 /*
  * 'ipp_length()' - Compute the size of the buffer needed to hold
  *		    the textual IPP attributes.
@@ -4357,277 +5572,352 @@ static void
 load_job_cache(const char *filename)	/* I - job.cache filename */
 {
   cups_file_t	*fp;			/* job.cache file */
-  char		line[1024],		/* Line buffer */
-		*value;			/* Value on line */
-  int		linenum;		/* Line number in file */
+  cups_array_t	*cached;		/* Jobs from job.cache and journal */
   cupsd_job_t	*job;			/* Current job */
-  int		jobid;			/* Job ID */
   char		jobfile[1024];		/* Job filename */
+  int		records;		/* Number of journal records */
+  struct stat	cacheinfo;		/* Information on job.cache file */
 
 
  /*
-  * Open the job.cache file...
+  * Read entries from the job index or job cache file, then apply any changes
+  * recorded in the journal...
   */
 
-  if ((fp = cupsdOpenConfFile(filename)) == NULL)
+  cached = cupsArrayNew(compare_jobs, NULL);
+
+  snprintf(jobfile, sizeof(jobfile), "%s/job.index", CacheDir);
+
+  if (stat(filename, &cacheinfo) || !load_job_index(jobfile, &cacheinfo, cached))
   {
-    load_request_root();
-    return;
+    if ((fp = cupsdOpenConfFile(filename)) == NULL)
+    {
+      cupsArrayDelete(cached);
+      load_request_root();
+      return;
+    }
+
+    cupsdLogMessage(CUPSD_LOG_INFO, "Loading job cache file \"%s\"...",
+		    filename);
+
+    read_job_cache(fp, filename, cached);
+    cupsFileClose(fp);
   }
 
- /*
-  * Read entries from the job cache file and create jobs as needed.
-  */
+  snprintf(jobfile, sizeof(jobfile), "%s/job.journal", CacheDir);
+  if ((fp = cupsFileOpen(jobfile, "r")) != NULL)
+  {
+    cupsdLogMessage(CUPSD_LOG_INFO, "Replaying job cache journal \"%s\"...", jobfile);
 
-  cupsdLogMessage(CUPSD_LOG_INFO, "Loading job cache file \"%s\"...",
-                  filename);
+    records = read_job_cache(fp, jobfile, cached);
+    cupsFileClose(fp);
+  }
+  else
+    records = 0;
 
-  linenum = 0;
-  job     = NULL;
+ /*
+  * Make sure the job control files are still there...
+  */
 
-  while (cupsFileGetConf(fp, line, sizeof(line), &value, &linenum))
+  for (job = (cupsd_job_t *)cupsArrayFirst(cached);
+       job;
+       job = (cupsd_job_t *)cupsArrayNext(cached))
   {
-    if (!_cups_strcasecmp(line, "NextJobId"))
-    {
-      if (value)
-        NextJobId = atoi(value);
-    }
-    else if (!_cups_strcasecmp(line, "<Job"))
+    snprintf(jobfile, sizeof(jobfile), "%s/c%05d", RequestRoot, job->id);
+    if (access(jobfile, 0))
     {
-      if (job)
+      snprintf(jobfile, sizeof(jobfile), "%s/c%05d.N", RequestRoot, job->id);
+      if (access(jobfile, 0))
       {
-        cupsdLogMessage(CUPSD_LOG_ERROR, "Missing </Job> directive on line %d of %s.", linenum, filename);
-        continue;
-      }
+	cupsdLogJob(job, CUPSD_LOG_ERROR, "Files have gone away.");
 
-      if (!value)
-      {
-        cupsdLogMessage(CUPSD_LOG_ERROR, "Missing job ID on line %d of %s.", linenum, filename);
-	continue;
-      }
+       /*
+	* job.cache file is out-of-date compared to spool directory; load
+	* that instead...
+	*/
 
-      jobid = atoi(value);
-
-      if (jobid < 1)
-      {
-        cupsdLogMessage(CUPSD_LOG_ERROR, "Bad job ID %d on line %d of %s.", jobid, linenum, filename);
-        continue;
-      }
-
-      snprintf(jobfile, sizeof(jobfile), "%s/c%05d", RequestRoot, jobid);
-      if (access(jobfile, 0))
-      {
-	snprintf(jobfile, sizeof(jobfile), "%s/c%05d.N", RequestRoot, jobid);
-	if (access(jobfile, 0))
-	{
-	  cupsdLogMessage(CUPSD_LOG_ERROR, "[Job %d] Files have gone away.",
-			  jobid);
+	for (job = (cupsd_job_t *)cupsArrayFirst(cached);
+	     job;
+	     job = (cupsd_job_t *)cupsArrayNext(cached))
+	  cupsdDeleteJob(job, CUPSD_JOB_DEFAULT);
 
-         /*
-          * job.cache file is out-of-date compared to spool directory; load
-          * that instead...
-          */
+	cupsArrayDelete(cached);
 
-	  cupsFileClose(fp);
-          load_request_root();
-          return;
-	}
+	load_request_root();
+	return;
       }
+    }
+  }
 
-      job = calloc(1, sizeof(cupsd_job_t));
-      if (!job)
-      {
-        cupsdLogMessage(CUPSD_LOG_EMERG,
-		        "[Job %d] Unable to allocate memory for job.", jobid);
-        break;
-      }
+ /*
+  * Add the jobs...
+  */
 
-      job->id              = jobid;
-      job->back_pipes[0]   = -1;
-      job->back_pipes[1]   = -1;
-      job->print_pipes[0]  = -1;
-      job->print_pipes[1]  = -1;
-      job->side_pipes[0]   = -1;
-      job->side_pipes[1]   = -1;
-      job->status_pipes[0] = -1;
-      job->status_pipes[1] = -1;
+  for (job = (cupsd_job_t *)cupsArrayFirst(cached);
+       job;
+       job = (cupsd_job_t *)cupsArrayNext(cached))
+  {
+    cupsArrayAdd(Jobs, job);
 
-      cupsdLogJob(job, CUPSD_LOG_DEBUG, "Loading from cache...");
-    }
-    else if (!job)
+    if (job->state_value <= IPP_JSTATE_STOPPED && cupsdLoadJob(job))
     {
-      cupsdLogMessage(CUPSD_LOG_ERROR,
-	              "Missing <Job #> directive on line %d of %s.", linenum, filename);
-      continue;
+      cupsArrayAdd(ActiveJobs, job);
+      cupsdUpdateJobCounts(job, 1);
+      cupsdUpdateJobQueue(job);
     }
-    else if (!_cups_strcasecmp(line, "</Job>"))
+    else if (job->state_value > IPP_JSTATE_STOPPED)
     {
-      cupsArrayAdd(Jobs, job);
-
-      if (job->state_value <= IPP_JSTATE_STOPPED && cupsdLoadJob(job))
-	cupsArrayAdd(ActiveJobs, job);
-      else if (job->state_value > IPP_JSTATE_STOPPED)
+      if (!job->completed_time || !job->creation_time || !job->name || !job->koctets ||
+	  JobHistory < INT_MAX || (JobFiles < INT_MAX && job->num_files))
       {
-        if (!job->completed_time || !job->creation_time || !job->name || !job->koctets ||
-	    JobHistory < INT_MAX || (JobFiles < INT_MAX && job->num_files))
-	{
-	  cupsdLoadJob(job);
-	  unload_job(job);
-	}
+	cupsdLoadJob(job);
+	unload_job(job);
       }
-
-      job = NULL;
-    }
-    else if (!value)
-    {
-      cupsdLogMessage(CUPSD_LOG_ERROR, "Missing value on line %d of %s.", linenum, filename);
-      continue;
     }
-    else if (!_cups_strcasecmp(line, "State"))
-    {
-      job->state_value = (ipp_jstate_t)atoi(value);
+  }
 
-      if (job->state_value < IPP_JSTATE_PENDING)
-        job->state_value = IPP_JSTATE_PENDING;
-      else if (job->state_value > IPP_JSTATE_COMPLETED)
-        job->state_value = IPP_JSTATE_COMPLETED;
-    }
-    else if (!_cups_strcasecmp(line, "Name"))
-    {
-      cupsdSetString(&(job->name), value);
-    }
-    else if (!_cups_strcasecmp(line, "Created"))
-    {
-      job->creation_time = (time_t)strtoll(value, NULL, 10);
-    }
-    else if (!_cups_strcasecmp(line, "Completed"))
-    {
-      job->completed_time = (time_t)strtoll(value, NULL, 10);
-    }
-    else if (!_cups_strcasecmp(line, "HoldUntil"))
-    {
-      job->hold_until = (time_t)strtoll(value, NULL, 10);
-    }
-    else if (!_cups_strcasecmp(line, "Priority"))
-    {
-      job->priority = atoi(value);
-    }
-    else if (!_cups_strcasecmp(line, "Username"))
-    {
-      cupsdSetString(&job->username, value);
-    }
-    else if (!_cups_strcasecmp(line, "Destination"))
-    {
-      cupsdSetString(&job->dest, value);
-    }
-    else if (!_cups_strcasecmp(line, "DestType"))
-    {
-      job->dtype = (cups_ptype_t)atoi(value);
-    }
-    else if (!_cups_strcasecmp(line, "KOctets"))
+  cupsArrayDelete(cached);
+
+  journal_records     = records;
+  num_journal_deletes = 0;
+}
+
+
+/*
+ * 'load_job_index()' - Load jobs from the binary job.index file.
+ *
+ * Returns 0 if the index is missing, does not match the job.cache file, or
+ * is corrupt.
+ */
+
+static int				/* O - 1 on success, 0 on failure */
+load_job_index(
+    const char   *filename,		/* I - job.index filename */
+    struct stat  *cacheinfo,		/* I - job.cache information */
+    cups_array_t *cached)		/* I - Array for loaded jobs */
+{
+  int			fd;		/* File descriptor */
+  struct stat		fileinfo;	/* File information */
+  void			*data;		/* Mapped file */
+  const cupsd_jobindex_t *header;	/* Index header */
+  const cupsd_jobrec_t	*recs,		/* Job records */
+			*rec;		/* Current job record */
+  const cupsd_filerec_t	*files,		/* File records */
+			*file;		/* Current file record */
+  const char		*strings;	/* String table */
+  uint32_t		i, j;		/* Looping vars */
+  int32_t		lastid;		/* Previous job ID */
+  size_t		size;		/* Expected file size */
+  cupsd_job_t		*job;		/* New job */
+  char			super[MIME_MAX_SUPER + MIME_MAX_TYPE],
+					/* MIME super type */
+			*type;		/* MIME type */
+  const char		*errmsg = NULL;	/* Validation error */
+  int			loaded;		/* Loaded all jobs? */
+  int			use_summary;	/* Use job summaries? */
+
+
+  if ((fd = open(filename, O_RDONLY)) < 0)
+  {
+    if (errno != ENOENT)
+      cupsdLogMessage(CUPSD_LOG_ERROR, "Unable to open job index \"%s\": %s", filename, strerror(errno));
+
+    return (0);
+  }
+
+  if (fstat(fd, &fileinfo) || fileinfo.st_size < (off_t)sizeof(cupsd_jobindex_t))
+  {
+    close(fd);
+    return (0);
+  }
+
+  data = mmap(NULL, (size_t)fileinfo.st_size, PROT_READ, MAP_PRIVATE, fd, 0);
+  close(fd);
+
+  if (data == MAP_FAILED)
+  {
+    cupsdLogMessage(CUPSD_LOG_ERROR, "Unable to map job index \"%s\": %s", filename, strerror(errno));
+    return (0);
+  }
+
+ /*
+  * Validate the header and the sizes of each table...
+  */
+
+  header = (const cupsd_jobindex_t *)data;
+
+  if (memcmp(header->magic, CUPSD_JOB_INDEX_MAGIC, sizeof(header->magic)) || header->version != CUPSD_JOB_INDEX_VERSION)
+    errmsg = "bad header";
+  else if (header->cache_size != (int64_t)cacheinfo->st_size || header->cache_mtime != (int64_t)cacheinfo->st_mtime)
+    errmsg = "stale";
+  else if (header->num_jobs > (uint32_t)(fileinfo.st_size / (off_t)sizeof(cupsd_jobrec_t)) || header->num_files > (uint32_t)(fileinfo.st_size / (off_t)sizeof(cupsd_filerec_t)))
+    errmsg = "bad record count";
+  else
+  {
+    size = sizeof(cupsd_jobindex_t) + header->num_jobs * sizeof(cupsd_jobrec_t) + header->num_files * sizeof(cupsd_filerec_t) + header->strings_size;
+
+    if (size != (size_t)fileinfo.st_size)
+      errmsg = "bad size";
+  }
+
+  recs    = (const cupsd_jobrec_t *)(header + 1);
+  files   = (const cupsd_filerec_t *)(recs + header->num_jobs);
+  strings = (const char *)(files + header->num_files);
+
+  if (!errmsg && (header->strings_size == 0 || strings[header->strings_size - 1]))
+    errmsg = "bad string table";
+  else if (!errmsg && header->summary_attrs != CUPSD_JOB_INDEX_NONE && header->summary_attrs >= header->strings_size)
+    errmsg = "bad string offset";
+
+ /*
+  * Then validate the job and file records...
+  */
+
+  for (i = 0, rec = recs, lastid = 0; !errmsg && i < header->num_jobs; i ++, rec ++)
+  {
+    if (rec->id <= lastid)
+      errmsg = "bad job ID";
+    else if (rec->state < IPP_JSTATE_PENDING || rec->state > IPP_JSTATE_COMPLETED)
+      errmsg = "bad job state";
+    else if (rec->username >= header->strings_size || rec->dest >= header->strings_size || (rec->name != CUPSD_JOB_INDEX_NONE && rec->name >= header->strings_size) || (rec->summary != CUPSD_JOB_INDEX_NONE && rec->summary >= header->strings_size))
+      errmsg = "bad string offset";
+    else if (rec->num_files < 0 || rec->first_file > header->num_files || (uint32_t)rec->num_files > header->num_files - rec->first_file)
+      errmsg = "bad file count";
+
+    for (j = 0, file = files + rec->first_file; !errmsg && j < (uint32_t)rec->num_files; j ++, file ++)
     {
-      job->koctets = atoi(value);
+      if (file->type >= header->strings_size || !strchr(strings + file->type, '/'))
+        errmsg = "bad file type";
     }
-    else if (!_cups_strcasecmp(line, "NumFiles"))
-    {
-      job->num_files = atoi(value);
 
-      if (job->num_files < 0)
-      {
-	cupsdLogMessage(CUPSD_LOG_ERROR, "Bad NumFiles value %d on line %d of %s.", job->num_files, linenum, filename);
-        job->num_files = 0;
-	continue;
-      }
+    lastid = rec->id;
+  }
 
-      if (job->num_files > 0)
-      {
-        snprintf(jobfile, sizeof(jobfile), "%s/d%05d-001", RequestRoot,
-	         job->id);
-        if (access(jobfile, 0))
-	{
-	  cupsdLogJob(job, CUPSD_LOG_INFO, "Data files have gone away.");
-          job->num_files = 0;
-	  continue;
-	}
+  if (errmsg)
+  {
+    cupsdLogMessage(CUPSD_LOG_INFO, "Ignoring job index \"%s\": %s.", filename, errmsg);
+    munmap(data, (size_t)fileinfo.st_size);
+    return (0);
+  }
 
-        job->filetypes    = calloc((size_t)job->num_files, sizeof(mime_type_t *));
-	job->compressions = calloc((size_t)job->num_files, sizeof(int));
+ /*
+  * Create the jobs...
+  */
 
-        if (!job->filetypes || !job->compressions)
-	{
-	  cupsdLogJob(job, CUPSD_LOG_EMERG,
-		      "Unable to allocate memory for %d files.",
-		      job->num_files);
-          break;
-	}
-      }
-    }
-    else if (!_cups_strcasecmp(line, "File"))
+  cupsdLogMessage(CUPSD_LOG_INFO, "Loading job index \"%s\"...", filename);
+
+  NextJobId   = header->next_job_id;
+  use_summary = summary_attrs && header->summary_attrs != CUPSD_JOB_INDEX_NONE && !strcmp(strings + header->summary_attrs, summary_attrs);
+
+  for (i = 0, rec = recs; i < header->num_jobs; i ++, rec ++)
+  {
+    if ((job = calloc(1, sizeof(cupsd_job_t))) == NULL)
     {
-      int	number,			/* File number */
-		compression;		/* Compression value */
-      char	super[MIME_MAX_SUPER],	/* MIME super type */
-		type[MIME_MAX_TYPE];	/* MIME type */
+      cupsdLogMessage(CUPSD_LOG_EMERG, "[Job %d] Unable to allocate memory for job.", rec->id);
+      break;
+    }
 
+    job->id              = rec->id;
+    job->state_value     = (ipp_jstate_t)rec->state;
+    job->priority        = rec->priority;
+    job->dtype           = (cups_ptype_t)rec->dtype;
+    job->koctets         = rec->koctets;
+    job->creation_time   = (time_t)rec->creation_time;
+    job->completed_time  = (time_t)rec->completed_time;
+    job->hold_until      = (time_t)rec->hold_until;
+    job->back_pipes[0]   = -1;
+    job->back_pipes[1]   = -1;
+    job->print_pipes[0]  = -1;
+    job->print_pipes[1]  = -1;
+    job->side_pipes[0]   = -1;
+    job->side_pipes[1]   = -1;
+    job->status_pipes[0] = -1;
+    job->status_pipes[1] = -1;
+
+    cupsdSetString(&job->username, strings + rec->username);
+    cupsdSetString(&job->dest, strings + rec->dest);
+    if (rec->name != CUPSD_JOB_INDEX_NONE)
+      cupsdSetString(&job->name, strings + rec->name);
+    if (use_summary && rec->summary != CUPSD_JOB_INDEX_NONE)
+      job->summary = decode_job_summary(strings + rec->summary);
+
+    cupsArrayAdd(cached, job);
+
+    if (rec->num_files > 0)
+    {
+      char jobfile[1024];		/* Job filename */
 
-      if (sscanf(value, "%d%*[ \t]%15[^/]/%255s%d", &number, super, type,
-                 &compression) != 4)
+      snprintf(jobfile, sizeof(jobfile), "%s/d%05d-001", RequestRoot, job->id);
+      if (access(jobfile, 0))
       {
-        cupsdLogMessage(CUPSD_LOG_ERROR, "Bad File on line %d of %s.", linenum, filename);
+	cupsdLogJob(job, CUPSD_LOG_INFO, "Data files have gone away.");
 	continue;
       }
 
-      if (number < 1 || number > job->num_files)
+      job->filetypes    = calloc((size_t)rec->num_files, sizeof(mime_type_t *));
+      job->compressions = calloc((size_t)rec->num_files, sizeof(int));
+
+      if (!job->filetypes || !job->compressions)
       {
-        cupsdLogMessage(CUPSD_LOG_ERROR, "Bad File number %d on line %d of %s.", number, linenum, filename);
-        continue;
+	cupsdLogJob(job, CUPSD_LOG_EMERG, "Unable to allocate memory for %d files.", rec->num_files);
+	free(job->filetypes);
+	free(job->compressions);
+	job->filetypes    = NULL;
+	job->compressions = NULL;
+	break;
       }
 
-      number --;
+      job->num_files = rec->num_files;
 
       cupsRWLockRead(&MimeLock);
 
-      job->compressions[number] = compression;
-      job->filetypes[number]    = mimeType(MimeDatabase, super, type);
-
-      if (!job->filetypes[number])
+      for (j = 0, file = files + rec->first_file; j < (uint32_t)rec->num_files; j ++, file ++)
       {
-       /*
-        * If the original MIME type is unknown, auto-type it!
-	*/
+        cupsCopyString(super, strings + file->type, sizeof(super));
+	if ((type = strchr(super, '/')) != NULL)
+	  *type++ = '\0';
 
-        cupsdLogJob(job, CUPSD_LOG_ERROR,
-		    "Unknown MIME type %s/%s for file %d.",
-		    super, type, number + 1);
+	job->compressions[j] = file->compression;
 
-        snprintf(jobfile, sizeof(jobfile), "%s/d%05d-%03d", RequestRoot,
-	         job->id, number + 1);
-        job->filetypes[number] = mimeFileType(MimeDatabase, jobfile, NULL,
-	                                      job->compressions + number);
+	if (!type || (job->filetypes[j] = mimeType(MimeDatabase, super, type)) == NULL)
+	  break;
+      }
 
+      cupsRWUnlock(&MimeLock);
+
+      if (j < (uint32_t)rec->num_files)
+      {
        /*
-        * If that didn't work, assume it is raw...
+        * Let the job.cache file handle unknown MIME types...
 	*/
 
-        if (!job->filetypes[number])
-	  job->filetypes[number] = mimeType(MimeDatabase, "application",
-	                                    "vnd.cups-raw");
+        cupsdLogJob(job, CUPSD_LOG_INFO, "Unknown MIME type %s for file %u in job index.", strings + file->type, j + 1);
+        break;
       }
-
-      cupsRWUnlock(&MimeLock);
     }
-    else
-      cupsdLogMessage(CUPSD_LOG_ERROR, "Unknown %s directive on line %d of %s.", line, linenum, filename);
   }
 
-  if (job)
+  loaded = i >= header->num_jobs;
+
+  munmap(data, (size_t)fileinfo.st_size);
+
+  if (!loaded)
   {
-    cupsdLogMessage(CUPSD_LOG_ERROR,
-		    "Missing </Job> directive on line %d of %s.", linenum, filename);
-    cupsdDeleteJob(job, CUPSD_JOB_PURGE);
+   /*
+    * Unable to load everything, free what we have...
+    */
+
+    for (job = (cupsd_job_t *)cupsArrayFirst(cached);
+         job;
+	 job = (cupsd_job_t *)cupsArrayNext(cached))
+      cupsdDeleteJob(job, CUPSD_JOB_DEFAULT);
+
+    cupsArrayClear(cached);
+
+    return (0);
   }
 
-  cupsFileClose(fp);
+  return (1);
 }
 
 
@@ -4733,48 +6023,376 @@ load_request_root(void)
       * Assign the job ID...
       */
 
-      job->id              = atoi(dent->filename + 1);
-      job->back_pipes[0]   = -1;
-      job->back_pipes[1]   = -1;
-      job->print_pipes[0]  = -1;
-      job->print_pipes[1]  = -1;
-      job->side_pipes[0]   = -1;
-      job->side_pipes[1]   = -1;
-      job->status_pipes[0] = -1;
-      job->status_pipes[1] = -1;
+      job->id              = atoi(dent->filename + 1);
+      job->back_pipes[0]   = -1;
+      job->back_pipes[1]   = -1;
+      job->print_pipes[0]  = -1;
+      job->print_pipes[1]  = -1;
+      job->side_pipes[0]   = -1;
+      job->side_pipes[1]   = -1;
+      job->status_pipes[0] = -1;
+      job->status_pipes[1] = -1;
+
+      if (job->id >= NextJobId)
+        NextJobId = job->id + 1;
+
+     /*
+      * Load the job...
+      */
+
+      if (cupsdLoadJob(job))
+      {
+       /*
+        * Insert the job into the array, sorting by job priority and ID...
+        */
+
+	cupsArrayAdd(Jobs, job);
+
+	if (job->state_value <= IPP_JSTATE_STOPPED)
+	{
+	  cupsArrayAdd(ActiveJobs, job);
+	  cupsdUpdateJobCounts(job, 1);
+	  cupsdUpdateJobQueue(job);
+	}
+	else
+	  unload_job(job);
+      }
+      else
+      {
+       /*
+        * Unable to load job, delete it...
+        */
+
+        cupsdDeleteJob(job, CUPSD_JOB_FORCE);
+      }
+    }
+  }
+
+  cupsDirClose(dir);
+}
+
+
+/*
+ * 'read_ippbuf()' - Read IPP data from a memory buffer.
+ */
+
+static ssize_t				/* O - Number of bytes read */
+read_ippbuf(cupsd_ippbuf_t *buf,	/* I - Memory buffer */
+            ipp_uchar_t    *buffer,	/* I - Read buffer */
+	    size_t         bytes)	/* I - Number of bytes to read */
+{
+  if (bytes > (buf->length - buf->pos))
+    bytes = buf->length - buf->pos;
+
+  memcpy(buffer, buf->data + buf->pos, bytes);
+  buf->pos += bytes;
+
+  return ((ssize_t)bytes);
+}
+
+
+/*
+ * 'read_job_cache()' - Read job entries from a job.cache or journal file.
+ *
+ * Later entries for a job replace earlier ones.  Returns the number of job
+ * records that were read.
+ */
+
+static int				/* O - Number of records */
+read_job_cache(cups_file_t  *fp,	/* I - File to read from */
+               const char   *filename,	/* I - Filename */
+               cups_array_t *cached)	/* I - Jobs read so far */
+{
+  char		line[8192],		/* Line buffer */
+		*value;			/* Value on line */
+  int		linenum;		/* Line number in file */
+  int		records;		/* Number of records */
+  int		use_summary = 0;	/* Use job summaries? */
+  cupsd_job_t	*job,			/* Current job */
+		*old,			/* Previous entry for job */
+		key;			/* Search key */
+  int		jobid;			/* Job ID */
+  char		jobfile[1024];		/* Job filename */
+
+
+  linenum = 0;
+  records = 0;
+  job     = NULL;
+
+  while (cupsFileGetConf(fp, line, sizeof(line), &value, &linenum))
+  {
+    if (!_cups_strcasecmp(line, "NextJobId"))
+    {
+      if (value)
+        NextJobId = atoi(value);
+    }
+    else if (!_cups_strcasecmp(line, "SummaryAttributes"))
+    {
+     /*
+      * Only use summaries that were saved with the same JobSummaryAttributes...
+      */
+
+      use_summary = value && summary_attrs && !strcmp(value, summary_attrs);
+    }
+    else if (!_cups_strcasecmp(line, "DeleteJob"))
+    {
+      if (!value || (key.id = atoi(value)) < 1)
+      {
+        cupsdLogMessage(CUPSD_LOG_ERROR, "Bad DeleteJob on line %d of %s.", linenum, filename);
+	continue;
+      }
+
+      if ((old = (cupsd_job_t *)cupsArrayFind(cached, &key)) != NULL)
+      {
+        cupsArrayRemove(cached, old);
+	cupsdDeleteJob(old, CUPSD_JOB_DEFAULT);
+      }
+
+      records ++;
+    }
+    else if (!_cups_strcasecmp(line, "<Job"))
+    {
+      if (job)
+      {
+        cupsdLogMessage(CUPSD_LOG_ERROR, "Missing </Job> directive on line %d of %s.", linenum, filename);
+        continue;
+      }
+
+      if (!value)
+      {
+        cupsdLogMessage(CUPSD_LOG_ERROR, "Missing job ID on line %d of %s.", linenum, filename);
+	continue;
+      }
+
+      jobid = atoi(value);
+
+      if (jobid < 1)
+      {
+        cupsdLogMessage(CUPSD_LOG_ERROR, "Bad job ID %d on line %d of %s.", jobid, linenum, filename);
+        continue;
+      }
+
+      job = calloc(1, sizeof(cupsd_job_t));
+      if (!job)
+      {
+        cupsdLogMessage(CUPSD_LOG_EMERG,
+		        "[Job %d] Unable to allocate memory for job.", jobid);
+        break;
+      }
+
+      job->id              = jobid;
+      job->back_pipes[0]   = -1;
+      job->back_pipes[1]   = -1;
+      job->print_pipes[0]  = -1;
+      job->print_pipes[1]  = -1;
+      job->side_pipes[0]   = -1;
+      job->side_pipes[1]   = -1;
+      job->status_pipes[0] = -1;
+      job->status_pipes[1] = -1;
+
+      cupsdLogJob(job, CUPSD_LOG_DEBUG, "Loading from cache...");
+    }
+    else if (!job)
+    {
+      cupsdLogMessage(CUPSD_LOG_ERROR,
+	              "Missing <Job #> directive on line %d of %s.", linenum, filename);
+      continue;
+    }
+    else if (!_cups_strcasecmp(line, "</Job>"))
+    {
+      if ((old = (cupsd_job_t *)cupsArrayFind(cached, job)) != NULL)
+      {
+        cupsArrayRemove(cached, old);
+	cupsdDeleteJob(old, CUPSD_JOB_DEFAULT);
+      }
+
+      cupsArrayAdd(cached, job);
+      records ++;
+
+      job = NULL;
+    }
+    else if (!value)
+    {
+      cupsdLogMessage(CUPSD_LOG_ERROR, "Missing value on line %d of %s.", linenum, filename);
+      continue;
+    }
+    else if (!_cups_strcasecmp(line, "State"))
+    {
+      job->state_value = (ipp_jstate_t)atoi(value);
+
+      if (job->state_value < IPP_JSTATE_PENDING)
+        job->state_value = IPP_JSTATE_PENDING;
+      else if (job->state_value > IPP_JSTATE_COMPLETED)
+        job->state_value = IPP_JSTATE_COMPLETED;
+    }
+    else if (!_cups_strcasecmp(line, "Name"))
+    {
+      cupsdSetString(&(job->name), value);
+    }
+    else if (!_cups_strcasecmp(line, "Created"))
+    {
+      job->creation_time = (time_t)strtoll(value, NULL, 10);
+    }
+    else if (!_cups_strcasecmp(line, "Completed"))
+    {
+      job->completed_time = (time_t)strtoll(value, NULL, 10);
+    }
+    else if (!_cups_strcasecmp(line, "HoldUntil"))
+    {
+      job->hold_until = (time_t)strtoll(value, NULL, 10);
+    }
+    else if (!_cups_strcasecmp(line, "Priority"))
+    {
+      job->priority = atoi(value);
+    }
+    else if (!_cups_strcasecmp(line, "Username"))
+    {
+      cupsdSetString(&job->username, value);
+    }
+    else if (!_cups_strcasecmp(line, "Destination"))
+    {
+      cupsdSetString(&job->dest, value);
+    }
+    else if (!_cups_strcasecmp(line, "DestType"))
+    {
+      job->dtype = (cups_ptype_t)atoi(value);
+    }
+    else if (!_cups_strcasecmp(line, "KOctets"))
+    {
+      job->koctets = atoi(value);
+    }
+    else if (!_cups_strcasecmp(line, "NumFiles"))
+    {
+      job->num_files = atoi(value);
+
+      if (job->num_files < 0)
+      {
+	cupsdLogMessage(CUPSD_LOG_ERROR, "Bad NumFiles value %d on line %d of %s.", job->num_files, linenum, filename);
+        job->num_files = 0;
+	continue;
+      }
+
+      if (job->num_files > 0)
+      {
+        snprintf(jobfile, sizeof(jobfile), "%s/d%05d-001", RequestRoot,
+	         job->id);
+        if (access(jobfile, 0))
+	{
+	  cupsdLogJob(job, CUPSD_LOG_INFO, "Data files have gone away.");
+          job->num_files = 0;
+	  continue;
+	}
+
+        job->filetypes    = calloc((size_t)job->num_files, sizeof(mime_type_t *));
+	job->compressions = calloc((size_t)job->num_files, sizeof(int));
+
+        if (!job->filetypes || !job->compressions)
+	{
+	  cupsdLogJob(job, CUPSD_LOG_EMERG,
+		      "Unable to allocate memory for %d files.",
+		      job->num_files);
+          break;
+	}
+      }
+    }
+    else if (!_cups_strcasecmp(line, "Summary"))
+    {
+      if (use_summary)
+      {
+        ippDelete(job->summary);
+        job->summary = decode_job_summary(value);
+      }
+    }
+    else if (!_cups_strcasecmp(line, "File"))
+    {
+      int	number,			/* File number */
+		compression;		/* Compression value */
+      char	super[MIME_MAX_SUPER],	/* MIME super type */
+		type[MIME_MAX_TYPE];	/* MIME type */
+
+
+      if (sscanf(value, "%d%*[ \t]%15[^/]/%255s%d", &number, super, type,
+                 &compression) != 4)
+      {
+        cupsdLogMessage(CUPSD_LOG_ERROR, "Bad File on line %d of %s.", linenum, filename);
+	continue;
+      }
+
+      if (number < 1 || number > job->num_files)
+      {
+        cupsdLogMessage(CUPSD_LOG_ERROR, "Bad File number %d on line %d of %s.", number, linenum, filename);
+        continue;
+      }
+
+      number --;
 
-      if (job->id >= NextJobId)
-        NextJobId = job->id + 1;
+      cupsRWLockRead(&MimeLock);
 
-     /*
-      * Load the job...
-      */
+      job->compressions[number] = compression;
+      job->filetypes[number]    = mimeType(MimeDatabase, super, type);
 
-      if (cupsdLoadJob(job))
+      if (!job->filetypes[number])
       {
        /*
-        * Insert the job into the array, sorting by job priority and ID...
-        */
+        * If the original MIME type is unknown, auto-type it!
+	*/
 
-	cupsArrayAdd(Jobs, job);
+        cupsdLogJob(job, CUPSD_LOG_ERROR,
+		    "Unknown MIME type %s/%s for file %d.",
+		    super, type, number + 1);
+
+        snprintf(jobfile, sizeof(jobfile), "%s/d%05d-%03d", RequestRoot,
+	         job->id, number + 1);
+        job->filetypes[number] = mimeFileType(MimeDatabase, jobfile, NULL,
+	                                      job->compressions + number);
 
-	if (job->state_value <= IPP_JSTATE_STOPPED)
-	  cupsArrayAdd(ActiveJobs, job);
-	else
-	  unload_job(job);
-      }
-      else
-      {
        /*
-        * Unable to load job, delete it...
-        */
+        * If that didn't work, assume it is raw...
+	*/
 
-        cupsdDeleteJob(job, CUPSD_JOB_FORCE);
+        if (!job->filetypes[number])
+	  job->filetypes[number] = mimeType(MimeDatabase, "application",
+	                                    "vnd.cups-raw");
       }
+
+      cupsRWUnlock(&MimeLock);
     }
+    else
+      cupsdLogMessage(CUPSD_LOG_ERROR, "Unknown %s directive on line %d of %s.", line, linenum, filename);
   }
 
-  cupsDirClose(dir);
+  if (job)
+  {
+    cupsdLogMessage(CUPSD_LOG_ERROR,
+		    "Missing </Job> directive on line %d of %s.", linenum, filename);
+
+   /*
+    * Keep any earlier entry for the job, otherwise purge it...
+    */
+
+    cupsdDeleteJob(job, cupsArrayFind(cached, job) ? CUPSD_JOB_DEFAULT : CUPSD_JOB_PURGE);
+  }
+
+  return (records);
+}
+
+
+/*
+ * 'release_job_count()' - Decrement a job counter, removing it when it
+ *                         reaches 0.
+ */
+
+static void
+release_job_count(
+    cups_array_t     *counts,		/* I - Job counters */
+    cupsd_jobcount_t *count)		/* I - Job counter */
+{
+  if (-- count->count > 0)
+    return;
+
+  cupsArrayRemove(counts, count);
+  cupsdClearString(&count->name);
+  free(count);
 }
 
 
@@ -4829,10 +6447,35 @@ remove_job_history(cupsd_job_t *job)	/* I - Job */
 	   job->id);
   cupsdUnlinkOrRemoveFile(filename);
 
+ /*
+  * And the job trace...
+  */
+
+  snprintf(filename, sizeof(filename), "%s/t%05d.json", RequestRoot,
+	   job->id);
+  if (cupsdUnlinkOrRemoveFile(filename) == 0)
+  {
+    snprintf(filename, sizeof(filename), "%s/t%05d.json.O", RequestRoot,
+	     job->id);
+    cupsdUnlinkOrRemoveFile(filename);
+  }
+
   LastEvent |= CUPSD_EVENT_PRINTER_STATE_CHANGED;
 }
 
 
+/*
+ * 'set_queue_ready()' - Mark a pending job queue as ready to check.
+ */
+
+static void
+set_queue_ready(cupsd_jobqueue_t *queue)/* I - Queue or NULL */
+{
+  if (queue && !cupsArrayFind(ReadyJobQueues, queue))
+    cupsArrayAdd(ReadyJobQueues, queue);
+}
+
+
 /*
  * 'set_time()' - Set one of the "time-at-xyz" attributes.
  */
@@ -4906,6 +6549,8 @@ start_job(cupsd_job_t     *job,		/* I - Job ID */
 						   "job-cancel-after",
 						   IPP_TAG_INTEGER);
 					/* job-cancel-after attribute */
+  double	start_time = cupsGetClock();
+					/* Time we started the job */
 
 
   cupsdLogMessage(CUPSD_LOG_DEBUG2, "start_job(job=%p(%d), printer=%p(%s))",
@@ -4963,6 +6608,8 @@ start_job(cupsd_job_t     *job,		/* I - Job ID */
   else
     job->cancel_time = 0;
 
+  cupsdUpdateJobDeadline(job);
+
  /*
   * Check for support files...
   */
@@ -5094,10 +6741,60 @@ start_job(cupsd_job_t     *job,		/* I - Job ID */
   * Now start the first file in the job...
   */
 
+  cupsdAddJobTrace(job, "job", "start_job", 0, start_time, cupsGetClock(), printer->name);
+
   cupsdContinueJob(job);
 }
 
 
+/*
+ * 'start_stream()' - Start streaming a document that is still being received.
+ */
+
+static int				/* O - Read end of pipe or -1 on error */
+start_stream(cupsd_job_t *job,		/* I - Job */
+             const char  *filename)	/* I - Document file */
+{
+  cupsd_jobstream_t	*stream;	/* Streamed document */
+  int			fds[2];		/* Pipe */
+
+
+  stop_stream(job);
+
+  if ((stream = calloc(1, sizeof(cupsd_jobstream_t))) == NULL)
+  {
+    cupsdLogJob(job, CUPSD_LOG_ERROR, "Unable to allocate memory for document stream.");
+    return (-1);
+  }
+
+  if ((stream->file = open(filename, O_RDONLY | O_CLOEXEC)) < 0)
+  {
+    cupsdLogJob(job, CUPSD_LOG_ERROR, "Unable to open document file \"%s\": %s", filename, strerror(errno));
+    free(stream);
+    return (-1);
+  }
+
+  if (cupsdOpenPipe(fds))
+  {
+    cupsdLogJob(job, CUPSD_LOG_ERROR, "Unable to create document stream pipe: %s", strerror(errno));
+    close(stream->file);
+    free(stream);
+    return (-1);
+  }
+
+  fcntl(fds[1], F_SETFL, fcntl(fds[1], F_GETFL) | O_NONBLOCK);
+
+  stream->pipe = fds[1];
+  job->stream  = stream;
+
+  cupsdAddSelect(stream->pipe, NULL, (cupsd_selfunc_t)update_stream, job);
+
+  cupsdLogJob(job, CUPSD_LOG_DEBUG, "Streaming document %d while it is received.", job->streaming);
+
+  return (fds[0]);
+}
+
+
 /*
  * 'stop_job()' - Stop a print job.
  */
@@ -5120,6 +6817,8 @@ stop_job(cupsd_job_t       *job,	/* I - Job */
   else if (action >= CUPSD_JOB_FORCE)
     job->kill_time = 0;
 
+  cupsdUpdateJobDeadline(job);
+
   for (i = 0; job->filters[i]; i ++)
     if (job->filters[i] > 0)
     {
@@ -5148,6 +6847,25 @@ stop_job(cupsd_job_t       *job,	/* I - Job */
 }
 
 
+/*
+ * 'stop_stream()' - Stop streaming a document.
+ */
+
+static void
+stop_stream(cupsd_job_t *job)		/* I - Job */
+{
+  if (!job->stream)
+    return;
+
+  cupsdRemoveSelect(job->stream->pipe);
+  close(job->stream->pipe);
+  close(job->stream->file);
+
+  free(job->stream);
+  job->stream = NULL;
+}
+
+
 /*
  * 'unload_job()' - Unload a job from memory.
  */
@@ -5160,6 +6878,20 @@ unload_job(cupsd_job_t *job)		/* I - Job */
 
   cupsdLogJob(job, CUPSD_LOG_DEBUG, "Unloading...");
 
+ /*
+  * Keep the JobSummaryAttributes so that Get-Jobs does not need to reload the
+  * job...
+  */
+
+  ippDelete(job->summary);
+  job->summary = NULL;
+
+  if (summary_attrs)
+  {
+    job->summary = ippNew();
+    ippCopyAttributes(job->summary, job->attrs, 0, copy_summary_attr, NULL);
+  }
+
   ippDelete(job->attrs);
 
   job->attrs           = NULL;
@@ -5170,6 +6902,8 @@ unload_job(cupsd_job_t *job)		/* I - Job */
   job->job_sheets      = NULL;
   job->printer_message = NULL;
   job->printer_reasons = NULL;
+
+  cupsdUpdateJobAttrCache(job);
 }
 
 
@@ -5212,6 +6946,18 @@ update_job(cupsd_job_t *job)		/* I - Job to check */
   while ((ptr = cupsdStatBufUpdate(job->status_buffer, &loglevel,
                                    message, sizeof(message))) != NULL)
   {
+   /*
+    * Add page, state, and error messages to the job trace...
+    */
+
+    if (job->trace && loglevel >= CUPSD_LOG_STATE &&
+        loglevel <= CUPSD_LOG_ERROR && loglevel != CUPSD_LOG_NONE)
+      cupsdAddJobTrace(job, "status",
+                       loglevel == CUPSD_LOG_STATE ? "STATE" :
+		       loglevel == CUPSD_LOG_JOBSTATE ? "JOBSTATE" :
+		       loglevel == CUPSD_LOG_PAGE ? "PAGE" : levels[loglevel],
+		       0, cupsGetClock(), 0.0, message);
+
    /*
     * Process page and printer state messages as needed...
     */
@@ -5331,6 +7077,8 @@ update_job(cupsd_job_t *job)		/* I - Job to check */
 	      job->cancel_time = time(NULL) + MaxJobTime;
 	    else
 	      job->cancel_time = 0;
+
+	    cupsdUpdateJobDeadline(job);
 	  }
         }
       }
@@ -5710,3 +7458,262 @@ update_job_attrs(cupsd_job_t *job,	/* I - Job to update */
   job->dirty = 1;
   cupsdMarkDirty(CUPSD_DIRTY_JOBS);
 }
+
+
+/*
+ * 'update_stream()' - Send document data to the first filter.
+ */
+
+static void
+update_stream(cupsd_job_t *job)		/* I - Job */
+{
+  cupsd_jobstream_t	*stream = job->stream;
+					/* Streamed document */
+  ssize_t		bytes;		/* Bytes sent */
+#ifndef HAVE_SENDFILE
+  char			buffer[32768];	/* Copy buffer */
+#endif /* !HAVE_SENDFILE */
+
+
+  if (!stream)
+    return;
+
+#ifdef HAVE_SENDFILE
+  bytes = sendfile(stream->pipe, stream->file, &stream->offset, 65536);
+#else
+  if ((bytes = pread(stream->file, buffer, sizeof(buffer), stream->offset)) > 0 && (bytes = write(stream->pipe, buffer, (size_t)bytes)) > 0)
+    stream->offset += bytes;
+#endif /* HAVE_SENDFILE */
+
+  if (bytes > 0 || (bytes < 0 && (errno == EAGAIN || errno == EINTR)))
+    return;
+
+  if (bytes == 0 && job->streaming)
+  {
+   /*
+    * Wait for more document data...
+    */
+
+    stream->waiting = 1;
+
+    cupsdRemoveSelect(stream->pipe);
+    return;
+  }
+
+  if (bytes < 0)
+    cupsdLogJob(job, CUPSD_LOG_DEBUG, "Unable to stream document: %s", strerror(errno));
+  else
+    cupsdLogJob(job, CUPSD_LOG_DEBUG, "Streamed " CUPS_LLFMT " bytes of document %d.", CUPS_LLCAST stream->offset, job->current_file);
+
+  stop_stream(job);
+}
+
+
+/*
+ * 'write_ippbuf()' - Write IPP data to a memory buffer.
+ */
+
+static ssize_t				/* O - Number of bytes written */
+write_ippbuf(cupsd_ippbuf_t *buf,	/* I - Memory buffer */
+             ipp_uchar_t    *buffer,	/* I - Write buffer */
+	     size_t         bytes)	/* I - Number of bytes to write */
+{
+  if (bytes > (buf->length - buf->pos))
+    return (-1);
+
+  memcpy(buf->data + buf->pos, buffer, bytes);
+  buf->pos += bytes;
+
+  return ((ssize_t)bytes);
+}
+
+
+/*
+ * 'write_job_cache()' - Write the job.cache entry for a job.
+ */
+
+static void
+write_job_cache(cups_file_t *fp,	/* I - job.cache or journal file */
+                cupsd_job_t *job)	/* I - Job */
+{
+  int	i;				/* Looping var */
+  char	*summary;			/* Encoded job summary */
+
+
+  if (job->printer && job->printer->temporary)
+  {
+   /*
+    * Don't save jobs on temporary printers...
+    */
+
+    return;
+  }
+
+  cupsFilePrintf(fp, "<Job %d>\n", job->id);
+  cupsFilePrintf(fp, "State %d\n", job->state_value);
+  cupsFilePrintf(fp, "Created " CUPS_LLFMT "\n", CUPS_LLCAST job->creation_time);
+  if (job->completed_time)
+    cupsFilePrintf(fp, "Completed " CUPS_LLFMT "\n", CUPS_LLCAST job->completed_time);
+  cupsFilePrintf(fp, "Priority %d\n", job->priority);
+  if (job->hold_until)
+    cupsFilePrintf(fp, "HoldUntil " CUPS_LLFMT "\n", CUPS_LLCAST job->hold_until);
+  cupsFilePrintf(fp, "Username %s\n", job->username);
+  if (job->name)
+    cupsFilePutConf(fp, "Name", job->name);
+  cupsFilePrintf(fp, "Destination %s\n", job->dest);
+  cupsFilePrintf(fp, "DestType %d\n", job->dtype);
+  cupsFilePrintf(fp, "KOctets %d\n", job->koctets);
+  cupsFilePrintf(fp, "NumFiles %d\n", job->num_files);
+  for (i = 0; i < job->num_files; i ++)
+    cupsFilePrintf(fp, "File %d %s/%s %d\n", i + 1, job->filetypes[i]->super,
+                   job->filetypes[i]->type, job->compressions[i]);
+  if ((summary = encode_job_summary(job)) != NULL)
+  {
+    cupsFilePrintf(fp, "Summary %s\n", summary);
+    free(summary);
+  }
+  cupsFilePuts(fp, "</Job>\n");
+}
+
+
+/*
+ * 'write_job_index()' - Write the binary job.index file.
+ */
+
+static void
+write_job_index(const char *cachefile)	/* I - job.cache filename */
+{
+  cups_file_t		*fp;		/* job.index file */
+  char			filename[1024];	/* job.index filename */
+  struct stat		cacheinfo;	/* job.cache information */
+  cupsd_jobindex_t	header;		/* Index header */
+  cupsd_jobrec_t	*recs = NULL,	/* Job records */
+			*rec;		/* Current job record */
+  cupsd_filerec_t	*files = NULL,	/* File records */
+			*file;		/* Current file record */
+  cups_array_t		*strings,	/* Strings, sorted */
+			*order;		/* Strings, in table order */
+  cupsd_idxstr_t	*idxstr;	/* Current string */
+  cupsd_job_t		*job;		/* Current job */
+  int			i;		/* Looping var */
+  char			type[MIME_MAX_SUPER + MIME_MAX_TYPE],
+					/* MIME type string */
+			*summary;	/* Encoded job summary */
+  int			ok = 0;		/* Wrote everything? */
+
+
+  if (stat(cachefile, &cacheinfo))
+    return;
+
+ /*
+  * Build the records and string table...
+  */
+
+  memset(&header, 0, sizeof(header));
+  memcpy(header.magic, CUPSD_JOB_INDEX_MAGIC, sizeof(header.magic));
+  header.version     = CUPSD_JOB_INDEX_VERSION;
+  header.next_job_id = NextJobId;
+  header.cache_size  = (int64_t)cacheinfo.st_size;
+  header.cache_mtime = (int64_t)cacheinfo.st_mtime;
+
+  for (job = (cupsd_job_t *)cupsArrayFirst(Jobs);
+       job;
+       job = (cupsd_job_t *)cupsArrayNext(Jobs))
+    header.num_files += (uint32_t)job->num_files;
+
+  strings = cupsArrayNew3((cups_array_cb_t)compare_index_strings, NULL, NULL, 0, NULL, NULL);
+  order   = cupsArrayNew3(NULL, NULL, NULL, 0, NULL, NULL);
+
+  if ((recs = calloc((size_t)cupsArrayCount(Jobs) + 1, sizeof(cupsd_jobrec_t))) == NULL ||
+      (files = calloc((size_t)header.num_files + 1, sizeof(cupsd_filerec_t))) == NULL || !strings || !order)
+  {
+    cupsdLogMessage(CUPSD_LOG_ERROR, "Unable to allocate memory for job index.");
+    goto cleanup;
+  }
+
+  header.num_files     = 0;
+  header.summary_attrs = summary_attrs ? index_string(strings, order, summary_attrs, &header.strings_size) : CUPSD_JOB_INDEX_NONE;
+
+  for (job = (cupsd_job_t *)cupsArrayFirst(Jobs), rec = recs, file = files;
+       job;
+       job = (cupsd_job_t *)cupsArrayNext(Jobs))
+  {
+    if ((job->printer && job->printer->temporary) || !job->username || !job->dest)
+      continue;
+
+    rec->id             = job->id;
+    rec->state          = (int32_t)job->state_value;
+    rec->priority       = job->priority;
+    rec->dtype          = (int32_t)job->dtype;
+    rec->koctets        = job->koctets;
+    rec->num_files      = job->num_files;
+    rec->first_file     = header.num_files;
+    rec->creation_time  = (int64_t)job->creation_time;
+    rec->completed_time = (int64_t)job->completed_time;
+    rec->hold_until     = (int64_t)job->hold_until;
+    rec->username       = index_string(strings, order, job->username, &header.strings_size);
+    rec->dest           = index_string(strings, order, job->dest, &header.strings_size);
+    rec->name           = job->name ? index_string(strings, order, job->name, &header.strings_size) : CUPSD_JOB_INDEX_NONE;
+    rec->summary        = CUPSD_JOB_INDEX_NONE;
+
+    if ((summary = encode_job_summary(job)) != NULL)
+    {
+      rec->summary = index_string(strings, order, summary, &header.strings_size);
+      free(summary);
+    }
+
+    for (i = 0; i < job->num_files; i ++, file ++)
+    {
+      snprintf(type, sizeof(type), "%s/%s", job->filetypes[i]->super, job->filetypes[i]->type);
+
+      file->type        = index_string(strings, order, type, &header.strings_size);
+      file->compression = job->compressions[i];
+    }
+
+    header.num_files += (uint32_t)job->num_files;
+    header.num_jobs ++;
+    rec ++;
+  }
+
+  if (cupsArrayCount(order) == 0)
+    index_string(strings, order, "", &header.strings_size);
+
+ /*
+  * Write the index file...
+  */
+
+  snprintf(filename, sizeof(filename), "%s/job.index", CacheDir);
+  if ((fp = cupsdCreateConfFile(filename, ConfigFilePerm)) == NULL)
+    goto cleanup;
+
+  cupsFileWrite(fp, (char *)&header, sizeof(header));
+  cupsFileWrite(fp, (char *)recs, header.num_jobs * sizeof(cupsd_jobrec_t));
+  cupsFileWrite(fp, (char *)files, header.num_files * sizeof(cupsd_filerec_t));
+
+  for (idxstr = (cupsd_idxstr_t *)cupsArrayFirst(order);
+       idxstr;
+       idxstr = (cupsd_idxstr_t *)cupsArrayNext(order))
+    cupsFileWrite(fp, idxstr->str, strlen(idxstr->str) + 1);
+
+  if (!cupsdCloseCreatedConfFile(fp, filename))
+    ok = 1;
+
+  cleanup:
+
+  if (!ok)
+    cupsdLogMessage(CUPSD_LOG_ERROR, "Unable to write job index.");
+
+  for (idxstr = (cupsd_idxstr_t *)cupsArrayFirst(order);
+       idxstr;
+       idxstr = (cupsd_idxstr_t *)cupsArrayNext(order))
+  {
+    free(idxstr->str);
+    free(idxstr);
+  }
+
+  cupsArrayDelete(strings);
+  cupsArrayDelete(order);
+
+  free(recs);
+  free(files);
+}
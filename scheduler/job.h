@@ -21,6 +21,41 @@ typedef enum cupsd_jobaction_e		/**** Actions for state changes ****/
 } cupsd_jobaction_t;
 
 
+/*
+ * Pending job queue structure...
+ */
+
+typedef struct cupsd_jobqueue_s		/**** Pending jobs for a destination ****/
+{
+  char			*dest;		/* Destination printer or class */
+  cups_array_t		*jobs;		/* Pending jobs, by priority */
+} cupsd_jobqueue_t;
+
+
+/*
+ * Active job counter structure...
+ */
+
+typedef struct cupsd_jobcount_s		/**** Active job counter ****/
+{
+  char			*name;		/* Destination or user name */
+  int			count;		/* Number of active jobs */
+} cupsd_jobcount_t;
+
+
+/*
+ * Streamed document structure...
+ */
+
+typedef struct cupsd_jobstream_s	/**** Document being streamed ****/
+{
+  int			pipe;		/* Pipe to the first filter */
+  int			file;		/* Document file */
+  off_t			offset;		/* Bytes sent to the first filter */
+  int			waiting;	/* Waiting for more document data? */
+} cupsd_jobstream_t;
+
+
 /*
  * Job request structure...
  */
@@ -29,7 +64,8 @@ struct cupsd_job_s			/**** Job request ****/
 {
   int			id,		/* Job ID */
 			priority,	/* Job priority */
-			dirty;		/* Do we need to write the "c" file? */
+			dirty,		/* Do we need to write the "c" file? */
+			journal;	/* Do we need to write the job.cache entry? */
   ipp_jstate_t		state_value;	/* Cached job-state */
   int			pending_timeout;/* Non-zero if the job was created and
 					 * waiting on files */
@@ -39,6 +75,9 @@ struct cupsd_job_s			/**** Job request ****/
   int			koctets;	/* job-k-octets */
   cups_ptype_t		dtype;		/* Destination type */
   cupsd_printer_t	*printer;	/* Printer this job is assigned to */
+  cupsd_jobqueue_t	*queue;		/* Pending job queue, if any */
+  cupsd_jobcount_t	*dest_count,	/* Active job counter for destination */
+			*user_count;	/* Active job counter for user */
   int			num_files;	/* Number of files in job */
   mime_type_t		**filetypes;	/* File types */
   int			*compressions;	/* Compression status of each file */
@@ -48,6 +87,8 @@ struct cupsd_job_s			/**** Job request ****/
 			cancel_time,	/* When to cancel/send SIGTERM */
 			creation_time,	/* When job was created */
 			completed_time,	/* When job was completed (0 if not) */
+			deadline_time,	/* Next cancel/kill/hold-until time
+					 * (0 if none) */
 			file_time,	/* Job file retain time */
 			history_time,	/* Job history retain time */
 			hold_until,	/* Hold expiration date/time */
@@ -61,6 +102,9 @@ struct cupsd_job_s			/**** Job request ****/
 					/* job-printer-state-reasons */
   int			current_file;	/* Current file in job */
   ipp_t			*attrs;		/* Job attributes */
+  ipp_t			*summary;	/* Summary attributes for unloaded job */
+  size_t		attrs_size;	/* Encoded size of loaded attributes */
+  long			attrs_seq;	/* Attribute cache use sequence (0 if not cached) */
   int			print_pipes[2],	/* Print data pipes */
 			back_pipes[2],	/* Backchannel pipes */
 			side_pipes[2],	/* Sidechannel pipes */
@@ -78,12 +122,18 @@ struct cupsd_job_s			/**** Job request ****/
   int			completed;	/* cups-waiting-for-job-completed seen */
   int			print_as_raster;
 					/* Need to print the job as raster */
+  int			streaming;	/* Document number being received, if
+					 * any */
+  cupsd_jobstream_t	*stream;	/* Document being streamed to the
+					 * filters, if any */
   char			*auth_env[3],	/* AUTH_xxx environment variables,
                                          * if any */
 			*auth_uid;	/* AUTH_UID environment variable */
   void			*profile,	/* Security profile for filters */
 			*bprofile;	/* Security profile for backend */
   cups_array_t		*history;	/* Debug log history */
+  cups_array_t		*subscriptions;	/* Subscriptions for this job */
+  cups_array_t		*trace;		/* Job trace spans, if any */
   int			progress;	/* Printing progress */
   int			num_keywords;	/* Number of PPD keywords */
   cups_option_t		*keywords;	/* PPD keywords */
@@ -120,12 +170,33 @@ VAR int			MaxJobs		VALUE(0),
 					/* Max time for a job */
 VAR int			JobAutoPurge	VALUE(0);
 					/* Automatically purge jobs */
+VAR off_t		JobAttrCacheSize VALUE(4 * 1024 * 1024);
+					/* Max size of loaded job attributes */
+VAR size_t		JobAttrCacheUsed VALUE(0);
+					/* Size of loaded job attributes */
+VAR long		JobAttrCacheHits VALUE(0),
+					/* Job loads with attributes in memory */
+			JobAttrCacheMisses VALUE(0);
+					/* Job loads from job control files */
 VAR cups_array_t	*Jobs		VALUE(NULL),
 					/* List of current jobs */
 			*ActiveJobs	VALUE(NULL),
 					/* List of active jobs */
-			*PrintingJobs	VALUE(NULL);
+			*PrintingJobs	VALUE(NULL),
 					/* List of jobs that are printing */
+			*JobDeadlines	VALUE(NULL),
+					/* Jobs sorted by deadline_time */
+			*JobQueues	VALUE(NULL),
+					/* Pending job queues, by destination */
+			*ReadyJobQueues	VALUE(NULL),
+					/* Changed pending job queues, by destination */
+			*DestJobCounts	VALUE(NULL),
+					/* Active job counts, by destination */
+			*UserJobCounts	VALUE(NULL),
+					/* Active job counts, by user */
+			*JobAttrCache	VALUE(NULL);
+					/* Jobs with loaded attributes, least
+					 * recently used first */
 VAR int			NextJobId	VALUE(1);
 					/* Next job ID to use */
 VAR int			JobKillDelay	VALUE(DEFAULT_TIMEOUT),
@@ -134,6 +205,9 @@ VAR int			JobKillDelay	VALUE(DEFAULT_TIMEOUT),
 					/* Max number of tries */
 			JobRetryInterval VALUE(300);
 					/* Seconds between retries */
+VAR int			StreamJobs	VALUE(FALSE);
+					/* Start printing documents while they
+					 * are received? */
 
 
 /*
@@ -148,6 +222,7 @@ extern void		cupsdCleanJobs(void);
 extern void		cupsdContinueJob(cupsd_job_t *job);
 extern void		cupsdDeleteJob(cupsd_job_t *job,
 			               cupsd_jobaction_t action);
+extern void		cupsdEndJobStream(cupsd_job_t *job, int aborted);
 extern cupsd_job_t	*cupsdFindJob(int id);
 extern void		cupsdFreeAllJobs(void);
 extern cups_array_t	*cupsdGetCompletedJobs(cupsd_printer_t *p);
@@ -156,13 +231,16 @@ extern int		cupsdGetUserJobCount(const char *username);
 extern void		cupsdLoadAllJobs(void);
 extern int		cupsdLoadJob(cupsd_job_t *job);
 extern void		cupsdMoveJob(cupsd_job_t *job, cupsd_printer_t *p);
+extern void		cupsdReleaseHeldNewJobs(cupsd_printer_t *p);
 extern void		cupsdReleaseJob(cupsd_job_t *job);
 extern void		cupsdRestartJob(cupsd_job_t *job);
 extern void		cupsdSaveAllJobs(void);
 extern void		cupsdSaveJob(cupsd_job_t *job);
+extern void		cupsdSaveJobJournal(void);
 extern void		cupsdSetJobHoldUntil(cupsd_job_t *job,
 			                     const char *when, int update);
 extern void		cupsdSetJobPriority(cupsd_job_t *job, int priority);
+extern void		cupsdSetJobQueuesReady(cupsd_printer_t *p);
 extern void		cupsdSetJobState(cupsd_job_t *job,
 			                 ipp_jstate_t newstate,
 					 cupsd_jobaction_t action,
@@ -173,4 +251,9 @@ extern void		cupsdStopAllJobs(cupsd_jobaction_t action,
 			                 int kill_delay);
 extern int		cupsdTimeoutJob(cupsd_job_t *job);
 extern void		cupsdUnloadCompletedJobs(void);
+extern void		cupsdUpdateJobAttrCache(cupsd_job_t *job);
+extern void		cupsdUpdateJobCounts(cupsd_job_t *job, int active);
+extern void		cupsdUpdateJobDeadline(cupsd_job_t *job);
+extern void		cupsdUpdateJobQueue(cupsd_job_t *job);
+extern void		cupsdUpdateJobStream(cupsd_job_t *job);
 extern void		cupsdUpdateJobs(void);
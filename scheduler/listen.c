@@ -106,7 +106,19 @@ cupsdResumeListening(void)
   for (lis = (cupsd_listener_t *)cupsArrayFirst(Listeners);
        lis;
        lis = (cupsd_listener_t *)cupsArrayNext(Listeners))
-    cupsdAddSelect(lis->fd, (cupsd_selfunc_t)cupsdAcceptClient, NULL, lis);
+  {
+    if (lis->fd < 0)
+      continue;
+
+   /*
+    * cupsdAcceptClient() accepts connections until accept() fails with
+    * EAGAIN, so make sure the socket doesn't block...
+    */
+
+    fcntl(lis->fd, F_SETFL, fcntl(lis->fd, F_GETFL) | O_NONBLOCK);
+
+    cupsdAddSelectEdge(lis->fd, (cupsd_selfunc_t)cupsdAcceptClient, NULL, lis);
+  }
 
   ListeningPaused = 0;
 }
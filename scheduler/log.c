@@ -51,6 +51,26 @@
 #define PWG_JobAccountingUserURI	"JAUU"
 
 
+/*
+ * Log files for buffered log lines...
+ */
+
+#define CUPSD_LOGFILE_ACCESS		0	/* AccessLog */
+#define CUPSD_LOGFILE_ERROR		1	/* ErrorLog */
+#define CUPSD_LOGFILE_PAGE		2	/* PageLog */
+
+
+/*
+ * Local types...
+ */
+
+typedef struct cupsd_logrec_s		/**** Buffered log line ****/
+{
+  int		file;			/* Log file (CUPSD_LOGFILE_xxx) */
+  size_t	length;			/* Length of line that follows */
+} cupsd_logrec_t;
+
+
 /*
  * Local globals...
  */
@@ -60,6 +80,20 @@ static cups_mutex_t log_mutex = CUPS_MUTEX_INITIALIZER;
 static size_t	log_linesize = 0;	/* Size of line for output file */
 static char	*log_line = NULL;	/* Line for output file */
 
+static cups_mutex_t log_bufmutex = CUPS_MUTEX_INITIALIZER;
+					/* Mutex for log buffer */
+static cups_cond_t log_bufcond = CUPS_COND_INITIALIZER;
+					/* Condition for log buffer changes */
+static char	*log_buffer = NULL,	/* Ring buffer of log lines */
+		*log_batch = NULL;	/* Lines being written by log thread */
+static size_t	log_bufsize = 0,	/* Size of ring buffer */
+		log_bufhead = 0,	/* Total bytes taken from buffer */
+		log_buftail = 0;	/* Total bytes added to buffer */
+static long	log_dropped = 0;	/* Dropped lines not yet reported */
+static int	log_running = 0,	/* Is the log thread running? */
+		log_stopping = 0;	/* Should the log thread stop? */
+static cups_thread_t log_thread;	/* Log thread */
+
 #ifdef HAVE_ASL_H
 static const int log_levels[] =		/* ASL levels... */
 		{
@@ -95,7 +129,11 @@ static const int log_levels[] =		/* SYSLOG levels... */
  * Local functions...
  */
 
+static void	copy_log_data(const void *data, size_t length);
 static int	format_log_line(const char *message, va_list ap);
+static int	log_queue(int file, int level, const char *prefix, const char *message);
+static void	*run_log_thread(void *data);
+static void	write_log_lines(const char *data, size_t length);
 
 
 /*
@@ -798,7 +836,8 @@ int					/* O - 1 on success, 0 on error */
 cupsdLogPage(cupsd_job_t *job,		/* I - Job being printed */
              const char  *page)		/* I - Page being printed */
 {
-  int			i;		/* Looping var */
+  int			i,		/* Looping var */
+			ret;		/* Return value */
   char			buffer[2048],	/* Buffer for page log */
 			*bufptr,	/* Pointer into buffer */
 			name[256];	/* Attribute name */
@@ -1024,9 +1063,6 @@ cupsdLogPage(cupsd_job_t *job,		/* I - Job being printed */
   * Not using syslog; check the log file...
   */
 
-  if (!cupsdCheckLogFile(&PageFile, PageLog))
-    return (0);
-
  /*
   * Print a page log entry of the form:
   *
@@ -1034,6 +1070,12 @@ cupsdLogPage(cupsd_job_t *job,		/* I - Job being printed */
   *        billing hostname
   */
 
+  if ((ret = log_queue(CUPSD_LOGFILE_PAGE, CUPSD_LOG_INFO, NULL, buffer)) >= 0)
+    return (ret);
+
+  if (!cupsdCheckLogFile(&PageFile, PageLog))
+    return (0);
+
   cupsFilePrintf(PageFile, "%s\n", buffer);
   cupsFileFlush(PageFile);
 
@@ -1141,7 +1183,9 @@ int					/* O - 1 on success, 0 on error */
 cupsdLogRequest(cupsd_client_t *con,	/* I - Request to log */
                 http_status_t  code)	/* I - Response code */
 {
-  char	temp[2048];			/* Temporary string for URI */
+  int	ret;				/* Return value */
+  char	temp[2048],			/* Temporary string for URI */
+	line[4096];			/* Log line */
   static const char * const states[] =	/* HTTP client states... */
 		{
 		  "WAITING",
@@ -1301,37 +1345,132 @@ cupsdLogRequest(cupsd_client_t *con,	/* I - Request to log */
 #endif /* HAVE_SYSTEMD_SD_JOURNAL_H */
 
  /*
-  * Not using syslog; check the log file...
+  * Not using syslog; format a log of the request in "common log format"...
   */
 
-  if (!cupsdCheckLogFile(&AccessFile, AccessLog))
-    return (0);
+  snprintf(line, sizeof(line),
+           "%s - %s %s \"%s %s HTTP/%d.%d\" %d " CUPS_LLFMT " %s %s",
+	   con->http->hostname,
+	   con->username[0] != '\0' ? con->username : "-",
+	   cupsdGetDateTime(&(con->start), LogTimeFormat),
+	   states[con->operation],
+	   _httpEncodeURI(temp, con->uri, sizeof(temp)),
+	   con->http->version / 100, con->http->version % 100,
+	   code, CUPS_LLCAST con->bytes,
+	   con->request ?
+	       ippOpString(con->request->request.op_status) : "-",
+	   con->response ?
+	       ippErrorString(con->response->request.op_status) : "-");
 
  /*
-  * Write a log of the request in "common log format"...
+  * Queue it for the log thread or write it to the log file...
   */
 
-  cupsFilePrintf(AccessFile,
-                 "%s - %s %s \"%s %s HTTP/%d.%d\" %d " CUPS_LLFMT " %s %s\n",
-        	 con->http->hostname,
-		 con->username[0] != '\0' ? con->username : "-",
-		 cupsdGetDateTime(&(con->start), LogTimeFormat),
-		 states[con->operation],
-		 _httpEncodeURI(temp, con->uri, sizeof(temp)),
-		 con->http->version / 100, con->http->version % 100,
-		 code, CUPS_LLCAST con->bytes,
-		 con->request ?
-		     ippOpString(con->request->request.op_status) : "-",
-		 con->response ?
-		     ippErrorString(con->response->request.op_status) :
-		     "-");
+  if ((ret = log_queue(CUPSD_LOGFILE_ACCESS, CUPSD_LOG_INFO, NULL, line)) >= 0)
+    return (ret);
+
+  if (!cupsdCheckLogFile(&AccessFile, AccessLog))
+    return (0);
 
+  cupsFilePrintf(AccessFile, "%s\n", line);
   cupsFileFlush(AccessFile);
 
   return (1);
 }
 
 
+/*
+ * 'cupsdStartLogThread()' - Start the thread that writes the log files.
+ */
+
+void
+cupsdStartLogThread(void)
+{
+  if (LogBufferSize <= 0 || log_running)
+    return;
+
+ /*
+  * Allocate the ring buffer and a buffer for the lines the thread is
+  * writing.  The buffer must be able to hold the longest log line...
+  */
+
+  log_bufsize = LogBufferSize < 131072 ? 131072 : (size_t)LogBufferSize;
+
+  if ((log_buffer = malloc(log_bufsize)) == NULL || (log_batch = malloc(log_bufsize)) == NULL)
+  {
+    cupsdLogMessage(CUPSD_LOG_ERROR, "Unable to allocate memory for log buffer: %s", strerror(errno));
+    free(log_buffer);
+    log_buffer = NULL;
+    return;
+  }
+
+  log_bufhead  = 0;
+  log_buftail  = 0;
+  log_dropped  = 0;
+  log_stopping = 0;
+  log_running  = 1;
+
+  if ((log_thread = cupsThreadCreate(run_log_thread, NULL)) == CUPS_THREAD_INVALID)
+  {
+    log_running = 0;
+
+    free(log_buffer);
+    free(log_batch);
+    log_buffer = NULL;
+    log_batch  = NULL;
+
+    cupsdLogMessage(CUPSD_LOG_ERROR, "Unable to create log thread: %s", strerror(errno));
+    return;
+  }
+
+  cupsdLogMessage(CUPSD_LOG_DEBUG, "Started log thread with a %u byte buffer.", (unsigned)log_bufsize);
+}
+
+
+/*
+ * 'cupsdStopLogThread()' - Write any buffered log lines and stop the log
+ *                          thread.
+ */
+
+void
+cupsdStopLogThread(void)
+{
+  if (!log_buffer)
+    return;
+
+ /*
+  * Tell the thread to write the remaining lines and exit.  The thread clears
+  * log_running once the buffer is empty so later lines are written directly...
+  */
+
+  cupsMutexLock(&log_bufmutex);
+  log_stopping = 1;
+  cupsCondBroadcast(&log_bufcond);
+  cupsMutexUnlock(&log_bufmutex);
+
+  cupsThreadWait(log_thread);
+
+  free(log_buffer);
+  free(log_batch);
+  log_buffer = NULL;
+  log_batch  = NULL;
+
+ /*
+  * Sync the log files as needed...
+  */
+
+  if (SyncOnClose)
+  {
+    if (AccessFile && AccessFile != LogStderr)
+      fsync(cupsFileNumber(AccessFile));
+    if (ErrorFile && ErrorFile != LogStderr)
+      fsync(cupsFileNumber(ErrorFile));
+    if (PageFile && PageFile != LogStderr)
+      fsync(cupsFileNumber(PageFile));
+  }
+}
+
+
 /*
  * 'cupsdWriteErrorLog()' - Write a line to the ErrorLog.
  */
@@ -1341,6 +1480,7 @@ cupsdWriteErrorLog(int        level,	/* I - Log level */
                    const char *message)	/* I - Message string */
 {
   int		ret = 1;		/* Return value */
+  char		prefix[256];		/* Level and date/time */
   static const char	levels[] =	/* Log levels... */
 		{
 		  ' ',
@@ -1376,7 +1516,16 @@ cupsdWriteErrorLog(int        level,	/* I - Log level */
 #endif /* HAVE_SYSTEMD_SD_JOURNAL_H */
 
  /*
-  * Not using syslog; check the log file...
+  * Not using syslog; queue the message for the log thread...
+  */
+
+  snprintf(prefix, sizeof(prefix), "%c %s ", levels[level], cupsdGetDateTime(NULL, LogTimeFormat));
+
+  if ((ret = log_queue(CUPSD_LOGFILE_ERROR, level, prefix, message)) >= 0)
+    return (ret);
+
+ /*
+  * No log thread; check the log file...
   */
 
   if (!cupsdCheckLogFile(&ErrorFile, ErrorLog))
@@ -1389,15 +1538,42 @@ cupsdWriteErrorLog(int        level,	/* I - Log level */
     * Write the log message...
     */
 
-    cupsFilePrintf(ErrorFile, "%c %s %s\n", levels[level],
-                   cupsdGetDateTime(NULL, LogTimeFormat), message);
+    cupsFilePrintf(ErrorFile, "%s%s\n", prefix, message);
     cupsFileFlush(ErrorFile);
+    ret = 1;
   }
 
   return (ret);
 }
 
 
+/*
+ * 'copy_log_data()' - Copy data to the log buffer.
+ *
+ * The caller must hold log_bufmutex and have checked for space...
+ */
+
+static void
+copy_log_data(const void *data,		/* I - Data to copy */
+              size_t     length)	/* I - Length of data */
+{
+  size_t	offset = log_buftail % log_bufsize,
+					/* Offset in buffer */
+		count;			/* Bytes to copy before wrapping */
+
+
+  if ((count = log_bufsize - offset) > length)
+    count = length;
+
+  memcpy(log_buffer + offset, data, count);
+
+  if (count < length)
+    memcpy(log_buffer, (const char *)data + count, length - count);
+
+  log_buftail += length;
+}
+
+
 /*
  * 'format_log_line()' - Format a line for a log file.
  *
@@ -1460,3 +1636,227 @@ format_log_line(const char *message,	/* I - Printf-style format string */
 
   return (1);
 }
+
+
+/*
+ * 'log_queue()' - Queue a log line for the log thread.
+ */
+
+static int				/* O - 1 if queued, 0 if dropped, -1 if no log thread */
+log_queue(int        file,		/* I - Log file (CUPSD_LOGFILE_xxx) */
+          int        level,		/* I - Log level */
+          const char *prefix,		/* I - Line prefix or `NULL` */
+          const char *message)		/* I - Line */
+{
+  int		tries;			/* Number of waits for space */
+  cupsd_logrec_t rec;			/* Log line record */
+  size_t	prefixlen = prefix ? strlen(prefix) : 0,
+					/* Length of prefix */
+		messagelen = strlen(message);
+					/* Length of line */
+  char		notice[256];		/* Dropped lines notice */
+
+
+  rec.file   = file;
+  rec.length = prefixlen + messagelen + 1;
+
+  cupsMutexLock(&log_bufmutex);
+
+  if (!log_running)
+  {
+    cupsMutexUnlock(&log_bufmutex);
+    return (-1);
+  }
+
+ /*
+  * Wait for space in the buffer - debug lines are dropped right away while
+  * other lines wait up to 1 second for the log thread to catch up...
+  */
+
+  for (tries = 0; (log_buftail - log_bufhead + sizeof(rec) + rec.length) > log_bufsize; tries ++)
+  {
+    if (level >= CUPSD_LOG_DEBUG || tries >= 10 || (sizeof(rec) + rec.length) > log_bufsize)
+    {
+      LogDroppedLines ++;
+      log_dropped ++;
+
+      cupsMutexUnlock(&log_bufmutex);
+      return (0);
+    }
+
+    cupsCondWait(&log_bufcond, &log_bufmutex, 0.1);
+  }
+
+ /*
+  * Report any dropped lines in the error log first...
+  */
+
+  if (log_dropped > 0 && ErrorLog && strcmp(ErrorLog, "syslog"))
+  {
+    cupsd_logrec_t nrec;		/* Notice record */
+
+    snprintf(notice, sizeof(notice), "W %s Dropped %ld log lines because the log buffer was full.\n", cupsdGetDateTime(NULL, LogTimeFormat), log_dropped);
+
+    nrec.file   = CUPSD_LOGFILE_ERROR;
+    nrec.length = strlen(notice);
+
+    if ((log_buftail - log_bufhead + sizeof(nrec) + nrec.length + sizeof(rec) + rec.length) <= log_bufsize)
+    {
+      copy_log_data(&nrec, sizeof(nrec));
+      copy_log_data(notice, nrec.length);
+
+      log_dropped = 0;
+    }
+  }
+
+ /*
+  * Then copy the line and wake up the log thread...
+  */
+
+  copy_log_data(&rec, sizeof(rec));
+  if (prefixlen)
+    copy_log_data(prefix, prefixlen);
+  copy_log_data(message, messagelen);
+  copy_log_data("\n", 1);
+
+  cupsCondBroadcast(&log_bufcond);
+  cupsMutexUnlock(&log_bufmutex);
+
+  return (1);
+}
+
+
+/*
+ * 'run_log_thread()' - Write buffered log lines to the log files.
+ */
+
+static void *				/* O - Thread exit status */
+run_log_thread(void *data)		/* I - Thread data (unused) */
+{
+  size_t	length,			/* Length of batch */
+		offset,			/* Offset in buffer */
+		count;			/* Bytes to copy before wrapping */
+  sigset_t	mask;			/* Signal mask */
+
+
+  (void)data;
+
+ /*
+  * Leave signal handling to the main thread, otherwise a SIGCHLD that is
+  * delivered here doesn't interrupt cupsdDoSelect()...
+  */
+
+  sigfillset(&mask);
+  pthread_sigmask(SIG_BLOCK, &mask, NULL);
+
+  cupsMutexLock(&log_bufmutex);
+
+  for (;;)
+  {
+   /*
+    * Wait for lines to write...
+    */
+
+    while (log_bufhead == log_buftail && !log_stopping)
+      cupsCondWait(&log_bufcond, &log_bufmutex, 0.0);
+
+    if (log_bufhead == log_buftail)
+      break;
+
+   /*
+    * Take everything in the buffer as a single batch so that producers can
+    * keep adding lines while we write...
+    */
+
+    length = log_buftail - log_bufhead;
+    offset = log_bufhead % log_bufsize;
+
+    if ((count = log_bufsize - offset) > length)
+      count = length;
+
+    memcpy(log_batch, log_buffer + offset, count);
+
+    if (count < length)
+      memcpy(log_batch + count, log_buffer, length - count);
+
+    log_bufhead = log_buftail;
+
+    cupsCondBroadcast(&log_bufcond);
+    cupsMutexUnlock(&log_bufmutex);
+
+    write_log_lines(log_batch, length);
+
+    cupsMutexLock(&log_bufmutex);
+  }
+
+ /*
+  * The buffer is empty and we are stopping, so any new lines get written
+  * directly to the log files...
+  */
+
+  log_running = 0;
+
+  cupsMutexUnlock(&log_bufmutex);
+
+  return (NULL);
+}
+
+
+/*
+ * 'write_log_lines()' - Write a batch of log lines to the log files.
+ */
+
+static void
+write_log_lines(const char *data,	/* I - Log line records */
+                size_t     length)	/* I - Length of records */
+{
+  const char	*end = data + length;	/* End of records */
+  cupsd_logrec_t rec;			/* Current record */
+  cups_file_t	**lf;			/* Log file */
+  const char	*logname;		/* Log filename */
+  int		written = 0;		/* Log files written */
+
+
+  while (data < end)
+  {
+    memcpy(&rec, data, sizeof(rec));
+    data += sizeof(rec);
+
+    switch (rec.file)
+    {
+      case CUPSD_LOGFILE_ACCESS :
+          lf      = &AccessFile;
+          logname = AccessLog;
+          break;
+
+      case CUPSD_LOGFILE_PAGE :
+          lf      = &PageFile;
+          logname = PageLog;
+          break;
+
+      default :
+          lf      = &ErrorFile;
+          logname = ErrorLog;
+          break;
+    }
+
+   /*
+    * Check for rotation before each line, but only flush once per batch...
+    */
+
+    if (cupsdCheckLogFile(lf, logname) && *lf)
+    {
+      cupsFileWrite(*lf, data, rec.length);
+      written |= 1 << rec.file;
+    }
+
+    data += rec.length;
+  }
+
+  if ((written & (1 << CUPSD_LOGFILE_ACCESS)) && AccessFile)
+    cupsFileFlush(AccessFile);
+  if ((written & (1 << CUPSD_LOGFILE_ERROR)) && ErrorFile)
+    cupsFileFlush(ErrorFile);
+  if ((written & (1 << CUPSD_LOGFILE_PAGE)) && PageFile)
+    cupsFileFlush(PageFile);
+}
@@ -522,7 +522,7 @@ main(int  argc,				/* I - Number of command-line args */
 
   setrlimit(RLIMIT_NOFILE, &limit);
 
-  cupsdStartSelect();
+  cupsdStartSelect(NULL);
 
  /*
   * Read configuration...
@@ -787,6 +787,8 @@ main(int  argc,				/* I - Number of command-line args */
     * times.
     */
 
+    cupsdSendNotifications();
+
     if ((timeout = select_timeout(fds)) > 1 && LastEvent)
       timeout = 1;
 
@@ -1005,23 +1007,35 @@ main(int  argc,				/* I - Number of command-line args */
       */
 
       if (httpGetReady(con->http))
-      {
         cupsdReadClient(con);
-	continue;
-      }
+    }
 
-     /*
-      * Check the activity and close old clients...
-      */
+   /*
+    * Send responses for Get-Notifications requests that are done waiting...
+    */
 
-      activity = current_time - Timeout;
-      if (httpGetActivity(con->http) < activity && !con->pipe_pid)
-      {
-        cupsdLogMessage(CUPSD_LOG_DEBUG, "Closing client %d after %d seconds of inactivity.", con->number, Timeout);
+    cupsdCheckNotifyWaits();
+
+   /*
+    * Check the activity and close old clients, starting with the earliest
+    * deadline...
+    */
+
+    activity = current_time - Timeout;
 
-        cupsdCloseClient(con);
+    while ((con = (cupsd_client_t *)cupsArrayFirst(ClientDeadlines)) != NULL &&
+           con->deadline_time < current_time)
+    {
+      if (httpGetActivity(con->http) >= activity || con->pipe_pid || con->bg_pending)
+      {
+        cupsdUpdateClientDeadline(con);
         continue;
       }
+
+      cupsdLogMessage(CUPSD_LOG_DEBUG, "Closing client %d after %d seconds of inactivity.", con->number, Timeout);
+
+      if (cupsdCloseClient(con))
+        cupsdUpdateClientDeadline(con);
     }
 
    /*
@@ -1420,6 +1434,19 @@ process_children(void)
 	  type         = "Backend";
 	}
 
+       /*
+	* End the process span in the job trace, rewriting the trace if the
+	* job has already been finalized...
+	*/
+
+	if (job->trace)
+	{
+	  cupsdEndJobTrace(job, pid);
+
+	  if (job->status_pipes[0] < 0)
+	    cupsdSaveJobTrace(job);
+	}
+
 	if (status && status != SIGTERM && status != SIGKILL &&
 	    status != SIGPIPE)
 	{
@@ -1506,7 +1533,10 @@ process_children(void)
 	  for (i = 0; job->filters[i] < 0; i++);
 
 	  if (!job->filters[i] && job->backend <= 0)
+	  {
 	    cupsArrayRemove(ActiveJobs, job);
+	    cupsdUpdateJobCounts(job, 0);
+	  }
 	}
 	else if (job->current_file < job->num_files && job->printer)
 	{
@@ -1592,6 +1622,7 @@ select_timeout(int fds)			/* I - Number of descriptors returned */
   time_t		now;		/* Current time */
   cupsd_client_t	*con;		/* Client information */
   cupsd_job_t		*job;		/* Job information */
+  cupsd_jobqueue_t	*queue;		/* Pending job queue */
   const char		*why;		/* Debugging aid */
 
 
@@ -1657,14 +1688,23 @@ select_timeout(int fds)			/* I - Number of descriptors returned */
   * Check the activity and close old clients...
   */
 
-  for (con = (cupsd_client_t *)cupsArrayFirst(Clients);
-       con;
-       con = (cupsd_client_t *)cupsArrayNext(Clients))
-    if ((httpGetActivity(con->http) + Timeout) < timeout)
-    {
-      timeout = httpGetActivity(con->http) + Timeout;
-      why     = "timeout a client connection";
-    }
+  if ((con = (cupsd_client_t *)cupsArrayFirst(ClientDeadlines)) != NULL &&
+      con->deadline_time < timeout)
+  {
+    timeout = con->deadline_time;
+    why     = "timeout a client connection";
+  }
+
+ /*
+  * Check for Get-Notifications requests that are done waiting...
+  */
+
+  if ((con = (cupsd_client_t *)cupsArrayFirst(NotifyWaits)) != NULL &&
+      con->notify_wait < timeout)
+  {
+    timeout = con->notify_wait;
+    why     = "send notifications";
+  }
 
  /*
   * Write out changes to configuration and state files...
@@ -1685,33 +1725,31 @@ select_timeout(int fds)			/* I - Number of descriptors returned */
     why     = "update job history";
   }
 
-  for (job = (cupsd_job_t *)cupsArrayFirst(ActiveJobs);
-       job;
-       job = (cupsd_job_t *)cupsArrayNext(ActiveJobs))
+  if ((job = (cupsd_job_t *)cupsArrayFirst(JobDeadlines)) != NULL &&
+      job->deadline_time < timeout)
   {
-    if (job->cancel_time && job->cancel_time < timeout)
-    {
-      timeout = job->cancel_time;
-      why     = "cancel stuck jobs";
-    }
+    timeout = job->deadline_time;
 
-    if (job->kill_time && job->kill_time < timeout)
-    {
-      timeout = job->kill_time;
-      why     = "kill unresponsive jobs";
-    }
-
-    if (job->state_value == IPP_JSTATE_HELD && job->hold_until < timeout)
-    {
-      timeout = job->hold_until;
-      why     = "release held jobs";
-    }
+    if (timeout == job->kill_time)
+      why = "kill unresponsive jobs";
+    else if (timeout == job->cancel_time)
+      why = "cancel stuck jobs";
+    else
+      why = "release held jobs";
+  }
 
-    if (job->state_value == IPP_JSTATE_PENDING && timeout > (now + 10))
+  if (timeout > (now + 10))
+  {
+    for (queue = (cupsd_jobqueue_t *)cupsArrayFirst(JobQueues);
+	 queue;
+	 queue = (cupsd_jobqueue_t *)cupsArrayNext(JobQueues))
     {
-      timeout = now + 10;
-      why     = "start pending jobs";
-      break;
+      if (cupsArrayCount(queue->jobs) > 0)
+      {
+	timeout = now + 10;
+	why     = "start pending jobs";
+	break;
+      }
     }
   }
 
@@ -0,0 +1,469 @@
+/*
+ * Metrics routines for the CUPS scheduler.
+ *
+ * Copyright © 2026 by OpenPrinting.
+ *
+ * Licensed under Apache License v2.0.  See the file "LICENSE" for more
+ * information.
+ */
+
+/*
+ * Include necessary headers...
+ */
+
+#include "cupsd.h"
+#include <stdarg.h>
+
+
+/*
+ * Local constants...
+ */
+
+#define CUPSD_OP_MAX		0x201	/* Number of operation slots */
+
+#define CUPSD_STAGE_HEADER	0	/* Reading the HTTP header */
+#define CUPSD_STAGE_DATA	1	/* Reading the request and document data */
+#define CUPSD_STAGE_PROCESS	2	/* Processing the request */
+#define CUPSD_STAGE_RESPONSE	3	/* Sending the response */
+#define CUPSD_STAGE_MAX		4	/* Number of request stages */
+
+
+/*
+ * Local types...
+ */
+
+typedef struct cupsd_opmetrics_s	/**** IPP operation metrics ****/
+{
+  long			requests,	/* Number of requests */
+			errors;		/* Number of error responses */
+  cupsd_histogram_t	latency,	/* Request latency */
+			stages[CUPSD_STAGE_MAX];
+					/* Time spent in each stage */
+} cupsd_opmetrics_t;
+
+typedef struct cupsd_metricsbuf_s	/**** Metrics output buffer ****/
+{
+  char			*data;		/* Output data */
+  size_t		size,		/* Size of buffer */
+			length;		/* Length of output */
+} cupsd_metricsbuf_t;
+
+
+/*
+ * Local globals...
+ */
+
+static cupsd_opmetrics_t *op_metrics[CUPSD_OP_MAX];
+					/* Metrics for each operation */
+static const char * const stage_names[CUPSD_STAGE_MAX] =
+			{		/* Names of request stages */
+			  "header",
+			  "data",
+			  "process",
+			  "response"
+			};
+
+
+/*
+ * Local functions...
+ */
+
+static int	histogram_index(long usecs);
+static int	op_index(ipp_op_t op);
+static const char *op_name(int i);
+static void	write_histogram(cupsd_metricsbuf_t *mb, const char *name, const char *labels, cupsd_histogram_t *h);
+static void	write_metrics(cupsd_metricsbuf_t *mb, const char *format, ...) _CUPS_FORMAT(2, 3);
+
+
+/*
+ * 'cupsdAddHistogram()' - Add a sample to a histogram.
+ */
+
+void
+cupsdAddHistogram(cupsd_histogram_t *h,	/* I - Histogram */
+                  double            seconds)
+					/* I - Sample in seconds */
+{
+  long	usecs = seconds > 0.0 ? (long)(seconds * 1000000.0) : 0;
+					/* Sample in microseconds */
+
+
+  cupsdAddMetric(h->buckets[histogram_index(usecs)], 1);
+  cupsdAddMetric(h->count, 1);
+  cupsdAddMetric(h->sum, usecs);
+}
+
+
+/*
+ * 'cupsdAddRequestMetrics()' - Record the timings of a finished IPP request.
+ *
+ * This is called from the main thread once the response has been flushed to
+ * the client.
+ */
+
+void
+cupsdAddRequestMetrics(
+    cupsd_client_t *con)		/* I - Client connection */
+{
+  int			i;		/* Looping var */
+  ipp_op_t		op;		/* Operation */
+  cupsd_opmetrics_t	*m;		/* Metrics for operation */
+  double		curtime,	/* Current time */
+			header_time,	/* Time when header was read */
+			ipp_end_time,	/* Time when response was ready */
+			total,		/* Total time for request */
+			stages[CUPSD_STAGE_MAX];
+					/* Time for each stage */
+
+
+  if (!con->request || !con->ipp_start_time)
+    return;
+
+  op = ippGetOperation(con->request);
+  i  = op_index(op);
+
+  if (!op_metrics[i] && (op_metrics[i] = calloc(1, sizeof(cupsd_opmetrics_t))) == NULL)
+    return;
+
+  m = op_metrics[i];
+
+ /*
+  * Figure out the time spent in each stage.  Responses that are produced by a
+  * helper program like cups-driverd count as processing time...
+  */
+
+  curtime      = cupsGetClock();
+  header_time  = con->header_time >= con->start_time ? con->header_time : con->start_time;
+  ipp_end_time = con->ipp_end_time >= con->ipp_start_time ? con->ipp_end_time : curtime;
+
+  stages[CUPSD_STAGE_HEADER]   = header_time - con->start_time;
+  stages[CUPSD_STAGE_DATA]     = con->ipp_start_time - header_time;
+  stages[CUPSD_STAGE_PROCESS]  = ipp_end_time - con->ipp_start_time;
+  stages[CUPSD_STAGE_RESPONSE] = curtime - ipp_end_time;
+  total                        = curtime - con->start_time;
+
+  cupsdAddMetric(m->requests, 1);
+
+  if (con->response && ippGetStatusCode(con->response) >= IPP_STATUS_ERROR_BAD_REQUEST)
+    cupsdAddMetric(m->errors, 1);
+
+  cupsdAddHistogram(&m->latency, total);
+
+  for (i = 0; i < CUPSD_STAGE_MAX; i ++)
+    cupsdAddHistogram(m->stages + i, stages[i]);
+
+ /*
+  * Log slow requests...
+  */
+
+  if (SlowRequestLog > 0.0 && total >= SlowRequestLog)
+    cupsdLogClient(con, CUPSD_LOG_WARN, "Slow %s request took %.3f seconds (header %.3f, data %.3f for " CUPS_LLFMT " bytes, processing %.3f, response %.3f).", ippOpString(op), total, stages[CUPSD_STAGE_HEADER], stages[CUPSD_STAGE_DATA], CUPS_LLCAST con->bytes, stages[CUPSD_STAGE_PROCESS], stages[CUPSD_STAGE_RESPONSE]);
+}
+
+
+/*
+ * 'cupsdSendMetrics()' - Send the metrics to a client.
+ *
+ * The metrics use the Prometheus text exposition format.
+ */
+
+int					/* O - 1 on success, 0 on failure */
+cupsdSendMetrics(cupsd_client_t *con)	/* I - Client connection */
+{
+  int			i,		/* Looping var */
+			j,		/* Looping var */
+			ret = 0;	/* Return value */
+  cupsd_metricsbuf_t	mb;		/* Output buffer */
+  char			labels[256];	/* Histogram labels */
+  cupsd_printer_t	*p;		/* Current printer */
+  cupsd_jobqueue_t	*queue;		/* Current pending job queue */
+  cupsd_jobcount_t	*count;		/* Current active job counter */
+
+
+  memset(&mb, 0, sizeof(mb));
+
+ /*
+  * IPP requests...
+  */
+
+  write_metrics(&mb, "# HELP cups_ipp_requests_total Number of IPP requests.\n"
+                     "# TYPE cups_ipp_requests_total counter\n");
+  for (i = 0; i < CUPSD_OP_MAX; i ++)
+  {
+    if (op_metrics[i])
+      write_metrics(&mb, "cups_ipp_requests_total{operation=\"%s\"} %ld\n", op_name(i), op_metrics[i]->requests);
+  }
+
+  write_metrics(&mb, "# HELP cups_ipp_errors_total Number of IPP requests that returned an error.\n"
+                     "# TYPE cups_ipp_errors_total counter\n");
+  for (i = 0; i < CUPSD_OP_MAX; i ++)
+  {
+    if (op_metrics[i])
+      write_metrics(&mb, "cups_ipp_errors_total{operation=\"%s\"} %ld\n", op_name(i), op_metrics[i]->errors);
+  }
+
+  write_metrics(&mb, "# HELP cups_ipp_request_duration_seconds Time from reading the HTTP request to flushing the IPP response.\n"
+                     "# TYPE cups_ipp_request_duration_seconds histogram\n");
+  for (i = 0; i < CUPSD_OP_MAX; i ++)
+  {
+    if (op_metrics[i])
+    {
+      snprintf(labels, sizeof(labels), "operation=\"%s\"", op_name(i));
+      write_histogram(&mb, "cups_ipp_request_duration_seconds", labels, &op_metrics[i]->latency);
+    }
+  }
+
+  write_metrics(&mb, "# HELP cups_ipp_request_stage_duration_seconds Time spent reading the header, reading the data, processing, and sending the response.\n"
+                     "# TYPE cups_ipp_request_stage_duration_seconds histogram\n");
+  for (i = 0; i < CUPSD_OP_MAX; i ++)
+  {
+    if (!op_metrics[i])
+      continue;
+
+    for (j = 0; j < CUPSD_STAGE_MAX; j ++)
+    {
+      snprintf(labels, sizeof(labels), "operation=\"%s\",stage=\"%s\"", op_name(i), stage_names[j]);
+      write_histogram(&mb, "cups_ipp_request_stage_duration_seconds", labels, op_metrics[i]->stages + j);
+    }
+  }
+
+ /*
+  * Printers and queues...
+  */
+
+  write_metrics(&mb, "# HELP cups_printer_state Printer state (3 = idle, 4 = processing, 5 = stopped).\n"
+                     "# TYPE cups_printer_state gauge\n");
+  for (p = (cupsd_printer_t *)cupsArrayFirst(Printers); p; p = (cupsd_printer_t *)cupsArrayNext(Printers))
+    write_metrics(&mb, "cups_printer_state{printer=\"%s\"} %d\n", p->name, (int)p->state);
+
+  write_metrics(&mb, "# HELP cups_printer_jobs_pending Number of pending jobs for each destination.\n"
+                     "# TYPE cups_printer_jobs_pending gauge\n");
+  for (queue = (cupsd_jobqueue_t *)cupsArrayFirst(JobQueues); queue; queue = (cupsd_jobqueue_t *)cupsArrayNext(JobQueues))
+    write_metrics(&mb, "cups_printer_jobs_pending{printer=\"%s\"} %d\n", queue->dest, cupsArrayGetCount(queue->jobs));
+
+  write_metrics(&mb, "# HELP cups_printer_jobs_active Number of active jobs for each destination.\n"
+                     "# TYPE cups_printer_jobs_active gauge\n");
+  for (count = (cupsd_jobcount_t *)cupsArrayFirst(DestJobCounts); count; count = (cupsd_jobcount_t *)cupsArrayNext(DestJobCounts))
+    write_metrics(&mb, "cups_printer_jobs_active{printer=\"%s\"} %d\n", count->name, count->count);
+
+ /*
+  * Jobs and filters...
+  */
+
+  write_metrics(&mb, "# HELP cups_jobs Number of jobs in memory.\n"
+                     "# TYPE cups_jobs gauge\n"
+                     "cups_jobs %d\n"
+                     "# HELP cups_jobs_active Number of active jobs.\n"
+                     "# TYPE cups_jobs_active gauge\n"
+                     "cups_jobs_active %d\n"
+                     "# HELP cups_jobs_printing Number of printing jobs.\n"
+                     "# TYPE cups_jobs_printing gauge\n"
+                     "cups_jobs_printing %d\n"
+                     "# HELP cups_filter_level Current filter cost of printing jobs.\n"
+                     "# TYPE cups_filter_level gauge\n"
+                     "cups_filter_level %d\n"
+                     "# HELP cups_filter_limit Maximum filter cost (FilterLimit), 0 for no limit.\n"
+                     "# TYPE cups_filter_limit gauge\n"
+                     "cups_filter_limit %d\n"
+                     "# HELP cups_spooled_bytes_total Bytes of print files received.\n"
+                     "# TYPE cups_spooled_bytes_total counter\n"
+                     "cups_spooled_bytes_total %ld\n"
+                     "# HELP cups_job_attr_cache_hits_total Job loads with attributes in memory.\n"
+                     "# TYPE cups_job_attr_cache_hits_total counter\n"
+                     "cups_job_attr_cache_hits_total %ld\n"
+                     "# HELP cups_job_attr_cache_misses_total Job loads from job control files.\n"
+                     "# TYPE cups_job_attr_cache_misses_total counter\n"
+                     "cups_job_attr_cache_misses_total %ld\n"
+                     "# HELP cups_job_attr_cache_bytes Size of loaded job attributes.\n"
+                     "# TYPE cups_job_attr_cache_bytes gauge\n"
+                     "cups_job_attr_cache_bytes %ld\n",
+                     cupsArrayGetCount(Jobs), cupsArrayGetCount(ActiveJobs), cupsArrayGetCount(PrintingJobs), FilterLevel, FilterLimit, MetricsBytesSpooled, JobAttrCacheHits, JobAttrCacheMisses, (long)JobAttrCacheUsed);
+
+  write_metrics(&mb, "# HELP cups_job_cache_save_seconds Time to write the job.cache file.\n"
+                     "# TYPE cups_job_cache_save_seconds histogram\n");
+  write_histogram(&mb, "cups_job_cache_save_seconds", NULL, &MetricsJobCacheSave);
+
+  write_metrics(&mb, "# HELP cups_job_journal_save_seconds Time to append to the job.journal file.\n"
+                     "# TYPE cups_job_journal_save_seconds histogram\n");
+  write_histogram(&mb, "cups_job_journal_save_seconds", NULL, &MetricsJobJournalSave);
+
+ /*
+  * Clients, subscriptions, and logging...
+  */
+
+  write_metrics(&mb, "# HELP cups_clients Number of connected clients.\n"
+                     "# TYPE cups_clients gauge\n"
+                     "cups_clients %d\n"
+                     "# HELP cups_subscriptions Number of subscriptions.\n"
+                     "# TYPE cups_subscriptions gauge\n"
+                     "cups_subscriptions %d\n"
+                     "# HELP cups_events_total Number of events generated.\n"
+                     "# TYPE cups_events_total counter\n"
+                     "cups_events_total %ld\n"
+                     "# HELP cups_log_dropped_lines_total Log lines dropped because the log buffer was full.\n"
+                     "# TYPE cups_log_dropped_lines_total counter\n"
+                     "cups_log_dropped_lines_total %ld\n",
+                     cupsArrayGetCount(Clients), cupsArrayGetCount(Subscriptions), MetricsEvents, LogDroppedLines);
+
+ /*
+  * Send the response...
+  */
+
+  if (!mb.data)
+    return (0);
+
+  httpSetLength(con->http, mb.length);
+
+  if (cupsdSendHeader(con, HTTP_STATUS_OK, "text/plain; version=0.0.4", CUPSD_AUTH_NONE) && httpWrite2(con->http, mb.data, mb.length) >= 0 && httpFlushWrite(con->http) >= 0)
+    ret = 1;
+
+  free(mb.data);
+
+  return (ret);
+}
+
+
+/*
+ * 'histogram_index()' - Return the histogram bucket for a sample.
+ *
+ * Samples below 8 microseconds get their own bucket.  Larger samples use the
+ * power of 2 plus the next 3 bits to select one of 8 buckets per power of 2.
+ */
+
+static int				/* O - Bucket index */
+histogram_index(long usecs)		/* I - Sample in microseconds */
+{
+  int	e,				/* Power of 2 */
+	i;				/* Bucket index */
+
+
+  if (usecs < 8)
+    return (usecs < 0 ? 0 : (int)usecs);
+
+  for (e = 3; e < 62 && (usecs >> (e + 1)); e ++);
+
+  i = (e - 2) * 8 + (int)((usecs >> (e - 3)) & 7);
+
+  return (i < CUPSD_HISTOGRAM_MAX ? i : CUPSD_HISTOGRAM_MAX - 1);
+}
+
+
+/*
+ * 'op_index()' - Return the metrics slot for an operation.
+ */
+
+static int				/* O - Index into op_metrics */
+op_index(ipp_op_t op)			/* I - Operation */
+{
+  if (op >= 0 && op < 0x100)
+    return ((int)op);
+  else if (op >= 0x4000 && op < 0x4100)
+    return ((int)op - 0x4000 + 0x100);
+  else
+    return (CUPSD_OP_MAX - 1);
+}
+
+
+/*
+ * 'op_name()' - Return the operation name for a metrics slot.
+ */
+
+static const char *			/* O - Operation name */
+op_name(int i)				/* I - Index into op_metrics */
+{
+  if (i < 0x100)
+    return (ippOpString((ipp_op_t)i));
+  else if (i < (CUPSD_OP_MAX - 1))
+    return (ippOpString((ipp_op_t)(i - 0x100 + 0x4000)));
+  else
+    return ("unknown");
+}
+
+
+/*
+ * 'write_histogram()' - Write a histogram.
+ */
+
+static void
+write_histogram(
+    cupsd_metricsbuf_t *mb,		/* I - Output buffer */
+    const char         *name,		/* I - Metric name */
+    const char         *labels,		/* I - Labels or `NULL` */
+    cupsd_histogram_t  *h)		/* I - Histogram */
+{
+  int		i,			/* Looping var */
+		e;			/* Power of 2 */
+  long		total = 0;		/* Cumulative count */
+  const char	*sep = labels ? "," : "";
+					/* Label separator */
+
+
+  if (!labels)
+    labels = "";
+
+ /*
+  * Report the buckets at each power of 2 from 64 microseconds to 32 seconds,
+  * which line up with the HDR bucket boundaries...
+  */
+
+  for (i = 0, e = 6; e <= 25; e ++)
+  {
+    for (; i < (e - 2) * 8; i ++)
+      total += h->buckets[i];
+
+    write_metrics(mb, "%s_bucket{%s%sle=\"%g\"} %ld\n", name, labels, sep, (1L << e) / 1000000.0, total);
+  }
+
+  write_metrics(mb, "%s_bucket{%s%sle=\"+Inf\"} %ld\n", name, labels, sep, h->count);
+
+  if (*labels)
+    write_metrics(mb, "%s_sum{%s} %.6f\n%s_count{%s} %ld\n", name, labels, h->sum / 1000000.0, name, labels, h->count);
+  else
+    write_metrics(mb, "%s_sum %.6f\n%s_count %ld\n", name, h->sum / 1000000.0, name, h->count);
+}
+
+
+/*
+ * 'write_metrics()' - Add formatted text to the metrics output.
+ */
+
+static void
+write_metrics(cupsd_metricsbuf_t *mb,	/* I - Output buffer */
+              const char         *format,
+					/* I - Printf-style format string */
+              ...)			/* I - Additional arguments as needed */
+{
+  va_list	ap;			/* Pointer to arguments */
+  int		bytes;			/* Bytes needed */
+  char		*temp;			/* New buffer */
+
+
+  if (!mb->size)
+  {
+    if ((mb->data = malloc(65536)) == NULL)
+      return;
+
+    mb->size = 65536;
+  }
+
+  for (;;)
+  {
+    va_start(ap, format);
+    bytes = vsnprintf(mb->data + mb->length, mb->size - mb->length, format, ap);
+    va_end(ap);
+
+    if (bytes < 0)
+      return;
+
+    if ((size_t)bytes < (mb->size - mb->length))
+      break;
+
+    if ((temp = realloc(mb->data, 2 * mb->size)) == NULL)
+      return;
+
+    mb->data = temp;
+    mb->size *= 2;
+  }
+
+  mb->length += (size_t)bytes;
+}
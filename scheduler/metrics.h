@@ -0,0 +1,62 @@
+/*
+ * Metrics definitions for the CUPS scheduler.
+ *
+ * Copyright © 2026 by OpenPrinting.
+ *
+ * Licensed under Apache License v2.0.  See the file "LICENSE" for more
+ * information.
+ */
+
+/*
+ * Constants...
+ */
+
+#define CUPSD_HISTOGRAM_MAX	248	/* Number of histogram buckets */
+
+
+/*
+ * Counters are updated from the main thread and the IPP thread, so use
+ * relaxed atomic adds that don't need a lock...
+ */
+
+#define cupsdAddMetric(counter,n) __atomic_fetch_add(&(counter), (n), __ATOMIC_RELAXED)
+
+
+/*
+ * Histogram structure...
+ *
+ * Samples are recorded in microseconds using HDR-style buckets - 8 linear
+ * buckets for each power of 2, so every bucket is within 12.5% of the
+ * recorded value from 1 microsecond to over an hour...
+ */
+
+typedef struct cupsd_histogram_s	/**** Latency histogram ****/
+{
+  long		count,			/* Number of samples */
+		sum,			/* Sum of samples in microseconds */
+		buckets[CUPSD_HISTOGRAM_MAX];
+					/* Number of samples in each bucket */
+} cupsd_histogram_t;
+
+
+/*
+ * Globals...
+ */
+
+VAR long		MetricsBytesSpooled VALUE(0),
+					/* Bytes of print files received */
+			MetricsEvents	VALUE(0);
+					/* Events generated */
+VAR cupsd_histogram_t	MetricsJobCacheSave,
+					/* Time to write job.cache */
+			MetricsJobJournalSave;
+					/* Time to append to job.journal */
+
+
+/*
+ * Prototypes...
+ */
+
+extern void	cupsdAddHistogram(cupsd_histogram_t *h, double seconds);
+extern void	cupsdAddRequestMetrics(cupsd_client_t *con);
+extern int	cupsdSendMetrics(cupsd_client_t *con);
@@ -39,8 +39,14 @@ extern "C" {
 //
 
 extern int	_mimeCompareTypes(mime_type_t *a, mime_type_t *b, void *data);
+extern void	_mimeDeleteFilterPaths(mime_t *mime);
+extern void	_mimeDeleteIndex(mime_t *mime);
+extern void	_mimeDeleteRules(mime_magic_t *rules);
 extern void	_mimeError(mime_t *mime, const char *format, ...) _CUPS_FORMAT(2, 3);
+extern mime_type_t *_mimeFileTypeUncompiled(mime_t *mime, const char *pathname, const char *filename, int *compression);
 extern void	_mimeFreeType(mime_type_t *t, void *data);
+extern void	_mimeRemoveFilter(mime_t *mime, mime_filter_t *filter);
+extern void	_mimeRemoveType(mime_t *mime, mime_type_t *mt);
 
 
 #  ifdef __cplusplus
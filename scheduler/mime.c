@@ -13,6 +13,16 @@
 #include <cups/string-private.h>
 #include <cups/dir.h>
 #include "mime-private.h"
+#include <fcntl.h>
+#include <sys/mman.h>
+
+
+//
+// Local constants...
+//
+
+#define MIME_CACHE_MAX_DEPTH	64	// Maximum depth of cached rules
+#define MIME_CACHE_VERSION	1	// Cache file version
 
 
 //
@@ -25,16 +35,76 @@ typedef struct _mime_fcache_s		// Filter cache structure
 	*path;				// Full path to filter if available
 } _mime_fcache_t;
 
+typedef struct _mime_cache_header_s	// Cache file header
+{
+  char		magic[8];		// "CUPSMIME"
+  unsigned	version,		// Cache file version
+		num_types,		// Number of types
+		num_rules,		// Number of type rules
+		num_filters,		// Number of filters
+		num_errors,		// Number of error messages
+		reserved;		// Reserved for alignment
+  unsigned char	key[32];		// SHA-256 key for the source files
+} _mime_cache_header_t;
+
+typedef struct _mime_cache_type_s	// Cached type
+{
+  char		super[MIME_MAX_SUPER],	// Super-type name
+		type[MIME_MAX_TYPE];	// Type name
+  int		priority,		// Priority of this type
+		num_rules;		// Number of rules for this type
+} _mime_cache_type_t;
+
+typedef struct _mime_cache_rule_s	// Cached type rule, in depth-first order
+{
+  int		op,			// Operation code
+		invert,			// Invert the result
+		depth,			// Depth in rules tree
+		offset,			// Offset in file
+		region,			// Region length
+		length;			// Length of data
+  char		value[256];		// Value or regular expression string
+} _mime_cache_rule_t;
+
+typedef struct _mime_cache_filter_s	// Cached filter
+{
+  unsigned	src,			// Source type index
+		dst;			// Destination type index
+  int		cost,			// Relative cost
+		reserved;		// Reserved for alignment
+  size_t	maxsize;		// Maximum file size for this filter
+  char		filter[MIME_MAX_FILTER];// Filter program to use
+} _mime_cache_filter_t;
+
+typedef struct _mime_cache_error_s	// Cached error message
+{
+  char		message[1024];		// Message
+} _mime_cache_error_t;
+
+typedef struct _mime_cache_errors_s	// Error messages while loading
+{
+  cups_array_t	*messages;		// Messages
+  mime_error_cb_t cb;			// Original callback
+  void		*ctx;			// Original callback data
+} _mime_cache_errors_t;
+
 
 //
 // Local functions...
 //
 
 static const char *mime_add_fcache(cups_array_t *filtercache, const char *name, const char *filterpath);
+static void	mime_cache_error(_mime_cache_errors_t *errors, const char *message);
+static bool	mime_cache_key(mime_t *mime, const char *pathnames, const char *filterpath, unsigned char *key);
 static int	mime_compare_fcache(_mime_fcache_t *a, _mime_fcache_t *b, void *data);
+static unsigned	mime_count_rules(mime_magic_t *rules);
 static void	mime_delete_fcache(cups_array_t *filtercache);
 static void	mime_load_convs(mime_t *mime, const char *filename, const char *filterpath, cups_array_t *filtercache);
 static void	mime_load_types(mime_t *mime, const char *filename);
+static bool	mime_read_cache(mime_t *mime, const char *cachefile, const unsigned char *key);
+static bool	mime_update_key(unsigned char *key, const void *data, size_t datalen);
+static void	mime_write_cache(mime_t *mime, const char *cachefile, const unsigned char *key, cups_array_t *errors);
+static bool	mime_write_rules(cups_file_t *fp, mime_magic_t *rules, int depth);
 
 
 //
@@ -50,10 +120,13 @@ mimeDelete(mime_t *mime)		// I - MIME database
     return;
 
   // Free the types and filters arrays, and then the MIME database structure.
+  _mimeDeleteIndex(mime);
+  _mimeDeleteFilterPaths(mime);
   cupsArrayDelete(mime->types);
   cupsArrayDelete(mime->filters);
   cupsArrayDelete(mime->ftypes);
   cupsArrayDelete(mime->srcs);
+  cupsMutexDestroy(&mime->index_mutex);
   free(mime);
 }
 
@@ -76,22 +149,10 @@ mimeDeleteFilter(mime_t        *mime,	// I - MIME database
     MIME_DEBUG("mimeDeleteFilter: Filter not in MIME database.\n");
 #endif // DEBUG
 
-  cupsArrayRemove(mime->filters, filter);
-
-  // Deleting a filter invalidates the source and destination lookup caches...
-  if (mime->srcs)
-  {
-    MIME_DEBUG("mimeDeleteFilter: Deleting source lookup cache.\n");
-    cupsArrayDelete(mime->srcs);
-    mime->srcs = NULL;
-  }
+  // Update the lookup caches and then remove the filter...
+  _mimeRemoveFilter(mime, filter);
 
-  if (mime->ftypes)
-  {
-    MIME_DEBUG("mimeDeleteFilter: Deleting destination lookup cache.\n");
-    cupsArrayDelete(mime->ftypes);
-    mime->ftypes = NULL;
-  }
+  cupsArrayRemove(mime->filters, filter);
 }
 
 
@@ -113,6 +174,10 @@ mimeDeleteType(mime_t      *mime,	// I - MIME database
     MIME_DEBUG("mimeDeleteFilter: Type not in MIME database.\n");
 #endif // DEBUG
 
+  // Deleting a type invalidates the compiled type rules and filter caches...
+  _mimeDeleteIndex(mime);
+  _mimeRemoveType(mime, mt);
+
   cupsArrayRemove(mime->types, mt);
 }
 
@@ -213,6 +278,96 @@ mimeLoad(const char *pathname,		// I - Directory to load
 }
 
 
+//
+// 'mimeLoadCache()' - Load types and filters from disk using a cache file.
+//
+// This function loads all of the .types and then all of the .convs files from
+// the colon-separated list of directories in "pathnames".  The result is saved
+// in "cachefile" and later calls load the cache file instead as long as the
+// directories, files, and filter directories have not changed.
+//
+// The cache file is only used when the database has no filters and no type
+// rules, for example a new database with some empty types.
+//
+
+mime_t *				// O - MIME database
+mimeLoadCache(mime_t     *mime,		// I - MIME database or `NULL` to create a new one
+              const char *cachefile,	// I - Cache file or `NULL` for none
+              const char *pathnames,	// I - Colon-separated list of directories to load from
+              const char *filterpath)	// I - Default filter program directory
+{
+  mime_type_t		*type;		// Current type
+  bool			usecache;	// Use the cache file?
+  unsigned char		key[32];	// Key for source files
+  char			*paths,		// Copy of directories
+			*path,		// Current directory
+			*next;		// Next directory
+  _mime_cache_errors_t	errors;		// Error messages
+
+
+  MIME_DEBUG("mimeLoadCache(mime=%p, cachefile=\"%s\", pathnames=\"%s\", filterpath=\"%s\")\n", (void *)mime, cachefile, pathnames, filterpath);
+
+  // Range check input...
+  if (!mime && (mime = mimeNew()) == NULL)
+    return (NULL);
+
+  if (!pathnames || !filterpath || (paths = strdup(pathnames)) == NULL)
+    return (mime);
+
+  // See if we can use the cache file...
+  usecache = cachefile && mimeNumFilters(mime) == 0;
+
+  for (type = mimeFirstType(mime); usecache && type; type = mimeNextType(mime))
+  {
+    if (type->rules)
+      usecache = false;
+  }
+
+  if (usecache && (usecache = mime_cache_key(mime, pathnames, filterpath, key)) && mime_read_cache(mime, cachefile, key))
+  {
+    free(paths);
+    return (mime);
+  }
+
+  // Load the types and then the filters, recording any errors for the cache
+  // file...
+  errors.messages = cupsArrayNew3(/*cb*/NULL, /*cb_data*/NULL, /*hash_cb*/NULL, /*hash_size*/0, (cups_acopy_cb_t)strdup, (cups_afree_cb_t)free);
+  errors.cb       = mime->error_cb;
+  errors.ctx      = mime->error_ctx;
+
+  mimeSetErrorCallback(mime, (mime_error_cb_t)mime_cache_error, &errors);
+
+  for (path = paths; path; path = next)
+  {
+    if ((next = strchr(path, ':')) != NULL)
+      *next = '\0';
+
+    mimeLoadTypes(mime, path);
+
+    if (next)
+      *next++ = ':';
+  }
+
+  for (path = paths; path; path = next)
+  {
+    if ((next = strchr(path, ':')) != NULL)
+      *next++ = '\0';
+
+    mimeLoadFilters(mime, path, filterpath);
+  }
+
+  mimeSetErrorCallback(mime, errors.cb, errors.ctx);
+
+  if (usecache)
+    mime_write_cache(mime, cachefile, key, errors.messages);
+
+  cupsArrayDelete(errors.messages);
+  free(paths);
+
+  return (mime);
+}
+
+
 //
 // 'mimeLoadFilters()' - Load filter definitions from disk.
 //
@@ -335,7 +490,13 @@ mimeLoadTypes(mime_t     *mime,		// I - MIME database or @code NULL@ to create a
 mime_t *				// O - MIME database
 mimeNew(void)
 {
-  return ((mime_t *)calloc(1, sizeof(mime_t)));
+  mime_t	*mime;			// New MIME database
+
+
+  if ((mime = (mime_t *)calloc(1, sizeof(mime_t))) != NULL)
+    cupsMutexInit(&mime->index_mutex);
+
+  return (mime);
 }
 
 
@@ -493,6 +654,169 @@ mime_add_fcache(
 }
 
 
+//
+// 'mime_cache_error()' - Record an error message for the cache file.
+//
+
+static void
+mime_cache_error(
+    _mime_cache_errors_t *errors,	// I - Error messages
+    const char           *message)	// I - Message
+{
+  cupsArrayAdd(errors->messages, (void *)message);
+
+  if (errors->cb)
+    (errors->cb)(errors->ctx, message);
+}
+
+
+//
+// 'mime_cache_key()' - Compute the key for the cache file.
+//
+// The key covers the cache format, the directories and their modification
+// times, the contents of each .types and .convs file, and the modification
+// times of the filter directories so that adding or removing a filter
+// program also invalidates the cache.
+//
+
+static bool				// O - `true` on success, `false` on error
+mime_cache_key(mime_t        *mime,	// I - MIME database
+               const char    *pathnames,// I - Colon-separated list of directories
+               const char    *filterpath,// I - Filter program directories
+               unsigned char *key)	// O - SHA-256 key
+{
+  bool		ret = true;		// Return value
+  char		buffer[1024],		// Key data
+		*paths,			// Copy of directories
+		*path,			// Current directory
+		*next;			// Next directory
+  const char	*filename;		// Current filename
+  struct stat	info;			// Directory or file information
+  mime_type_t	*type;			// Current type
+  cups_dir_t	*dir;			// Directory
+  cups_dentry_t	*dent;			// Directory entry
+  cups_array_t	*files;			// Sorted .types and .convs files
+  int		fd;			// File descriptor
+  unsigned char	*data,			// File data
+		hash[32];		// File hash
+  ssize_t	bytes;			// Bytes read
+  size_t	length;			// Length of filename or data
+
+
+  // Start with the cache format and the directories...
+  memset(key, 0, 32);
+
+  snprintf(buffer, sizeof(buffer), "CUPSMIME %d %u %u %u\n%s\n%s\n", MIME_CACHE_VERSION, (unsigned)sizeof(_mime_cache_type_t), (unsigned)sizeof(_mime_cache_rule_t), (unsigned)sizeof(_mime_cache_filter_t), pathnames, filterpath);
+  if (!mime_update_key(key, buffer, strlen(buffer)))
+    return (false);
+
+  // Add any existing types...
+  for (type = mimeFirstType(mime); type; type = mimeNextType(mime))
+  {
+    snprintf(buffer, sizeof(buffer), "%s/%s %d\n", type->super, type->type, type->priority);
+    if (!mime_update_key(key, buffer, strlen(buffer)))
+      return (false);
+  }
+
+  // Add the .types and .convs files in each directory...
+  if ((paths = strdup(pathnames)) == NULL)
+    return (false);
+
+  for (path = paths; ret && path; path = next)
+  {
+    if ((next = strchr(path, ':')) != NULL)
+      *next++ = '\0';
+
+    // The sorted list of filenames tracks additions and removals, so only
+    // note whether the directory exists (ServerRoot is rewritten constantly)
+    dir = cupsDirOpen(path);
+
+    snprintf(buffer, sizeof(buffer), "%s %d\n", path, dir != NULL);
+    if (!mime_update_key(key, buffer, strlen(buffer)))
+      ret = false;
+
+    if (!dir)
+      continue;
+
+    files = cupsArrayNew3((cups_array_cb_t)strcmp, /*cb_data*/NULL, /*hash_cb*/NULL, /*hash_size*/0, (cups_acopy_cb_t)strdup, (cups_afree_cb_t)free);
+
+    while ((dent = cupsDirRead(dir)) != NULL)
+    {
+      if ((length = strlen(dent->filename)) > 6 && (!strcmp(dent->filename + length - 6, ".types") || !strcmp(dent->filename + length - 6, ".convs")))
+        cupsArrayAdd(files, dent->filename);
+    }
+
+    cupsDirClose(dir);
+
+    for (filename = (const char *)cupsArrayGetFirst(files); ret && filename; filename = (const char *)cupsArrayGetNext(files))
+    {
+      // Hash the file contents...
+      snprintf(buffer, sizeof(buffer), "%s/%s", path, filename);
+
+      if ((fd = open(buffer, O_RDONLY)) < 0)
+      {
+        ret = false;
+        break;
+      }
+
+      if (fstat(fd, &info) || (data = malloc((size_t)info.st_size + 1)) == NULL)
+      {
+        close(fd);
+        ret = false;
+        break;
+      }
+
+      for (length = 0; length < (size_t)info.st_size; length += (size_t)bytes)
+      {
+        if ((bytes = read(fd, data + length, (size_t)info.st_size - length)) <= 0)
+          break;
+      }
+
+      close(fd);
+
+      if (length < (size_t)info.st_size || cupsHashData("sha2-256", data, length, hash, sizeof(hash)) != (ssize_t)sizeof(hash))
+        ret = false;
+
+      free(data);
+
+      if (ret)
+      {
+        snprintf(buffer, sizeof(buffer), "%s\n", filename);
+        ret = mime_update_key(key, buffer, strlen(buffer)) && mime_update_key(key, hash, sizeof(hash));
+      }
+    }
+
+    cupsArrayDelete(files);
+  }
+
+  free(paths);
+
+  // Add the filter directories...
+  if (ret && (paths = strdup(filterpath)) != NULL)
+  {
+    for (path = paths; ret && path; path = next)
+    {
+      if ((next = strchr(path, ':')) != NULL)
+	*next++ = '\0';
+
+      if (stat(path, &info))
+	info.st_mtime = 0;
+
+      snprintf(buffer, sizeof(buffer), "%s %ld\n", path, (long)info.st_mtime);
+      ret = mime_update_key(key, buffer, strlen(buffer));
+    }
+
+    free(paths);
+  }
+  else
+  {
+    ret = false;
+  }
+
+  return (ret);
+}
+
+
 //
 // 'mime_compare_fcache()' - Compare two filter cache entries.
 //
@@ -509,6 +833,23 @@ mime_compare_fcache(
 }
 
 
+//
+// 'mime_count_rules()' - Count the rules in a rules tree.
+//
+
+static unsigned				// O - Number of rules
+mime_count_rules(mime_magic_t *rules)	// I - Rules
+{
+  unsigned	count;			// Number of rules
+
+
+  for (count = 0; rules; rules = rules->next)
+    count += 1 + mime_count_rules(rules->child);
+
+  return (count);
+}
+
+
 //
 // 'mime_delete_fcache()' - Free all memory used by the filter cache.
 //
@@ -759,3 +1100,446 @@ mime_load_types(mime_t     *mime,	// I - MIME database
 
   cupsFileClose(fp);
 }
+
+
+//
+// 'mime_read_cache()' - Load types and filters from a cache file.
+//
+
+static bool				// O - `true` on success, `false` on error
+mime_read_cache(
+    mime_t              *mime,		// I - MIME database
+    const char          *cachefile,	// I - Cache file
+    const unsigned char *key)		// I - Key for source files
+{
+  int				fd;	// File descriptor
+  struct stat			info;	// File information
+  void				*data;	// Mapped cache file
+  const _mime_cache_header_t	*header;// Cache file header
+  const _mime_cache_type_t	*ctypes,// Cached types
+				*ctype;	// Current cached type
+  const _mime_cache_rule_t	*crules,// Cached rules
+				*crule;	// Current cached rule
+  const _mime_cache_filter_t	*cfilters,
+					// Cached filters
+				*cfilter;
+					// Current cached filter
+  const _mime_cache_error_t	*cerrors;
+					// Cached error messages
+  unsigned			i,	// Looping var
+				j,	// Looping var
+				num_rules;
+					// Number of rules for types
+  mime_type_t			**types;// Types
+  mime_magic_t			**rules,// Rules for each type
+				*temp,	// New rule
+				*parents[MIME_CACHE_MAX_DEPTH + 1],
+					// Parent rules
+				*last[MIME_CACHE_MAX_DEPTH + 1];
+					// Last rule at each depth
+  mime_filter_t			*filter;// Current filter
+  bool				*added,	// Was the type added?
+				ret = false;
+					// Return value
+
+
+  MIME_DEBUG("mime_read_cache(mime=%p, cachefile=\"%s\", key=%p)\n", (void *)mime, cachefile, (void *)key);
+
+  // Map the cache file...
+  if ((fd = open(cachefile, O_RDONLY)) < 0)
+    return (false);
+
+  if (fstat(fd, &info) || info.st_size < (off_t)sizeof(_mime_cache_header_t) || (data = mmap(NULL, (size_t)info.st_size, PROT_READ, MAP_PRIVATE, fd, 0)) == MAP_FAILED)
+  {
+    close(fd);
+    return (false);
+  }
+
+  close(fd);
+
+  // Validate the header and records before changing the database...
+  header = (const _mime_cache_header_t *)data;
+  types  = NULL;
+  rules  = NULL;
+  added  = NULL;
+
+  if (memcmp(header->magic, "CUPSMIME", 8) || header->version != MIME_CACHE_VERSION || memcmp(header->key, key, sizeof(header->key)))
+  {
+    MIME_DEBUG("mime_read_cache: Cache file is out of date.\n");
+    goto done;
+  }
+
+  if (header->num_types > 65536 || header->num_rules > 1048576 || header->num_filters > 1048576 || header->num_errors > 65536 || (size_t)info.st_size != sizeof(_mime_cache_header_t) + header->num_types * sizeof(_mime_cache_type_t) + header->num_rules * sizeof(_mime_cache_rule_t) + header->num_filters * sizeof(_mime_cache_filter_t) + header->num_errors * sizeof(_mime_cache_error_t))
+  {
+    MIME_DEBUG("mime_read_cache: Bad cache file size.\n");
+    goto done;
+  }
+
+  ctypes   = (const _mime_cache_type_t *)(header + 1);
+  crules   = (const _mime_cache_rule_t *)(ctypes + header->num_types);
+  cfilters = (const _mime_cache_filter_t *)(crules + header->num_rules);
+  cerrors  = (const _mime_cache_error_t *)(cfilters + header->num_filters);
+
+  for (i = 0, num_rules = 0, crule = crules, ctype = ctypes; i < header->num_types; i ++, ctype ++)
+  {
+    // Types must have names and be unique and sorted like the database...
+    if (!memchr(ctype->super, 0, sizeof(ctype->super)) || !memchr(ctype->type, 0, sizeof(ctype->type)) || !ctype->super[0] || !ctype->type[0] || ctype->num_rules < 0 || (unsigned)ctype->num_rules > header->num_rules - num_rules)
+      goto done;
+
+    if (i > 0 && (strcmp(ctype[-1].super, ctype->super) > 0 || (!strcmp(ctype[-1].super, ctype->super) && strcmp(ctype[-1].type, ctype->type) >= 0)))
+      goto done;
+
+    for (j = 0; j < (unsigned)ctype->num_rules; j ++, crule ++)
+    {
+      if (crule->op < MIME_MAGIC_NOP || crule->op > MIME_MAGIC_REGEX || (crule->invert != 0 && crule->invert != 1) || crule->depth < 0 || crule->depth >= MIME_CACHE_MAX_DEPTH || (j == 0 && crule->depth != 0) || (j > 0 && crule->depth > crule[-1].depth + 1) || !memchr(crule->value, 0, sizeof(crule->value)))
+        goto done;
+
+      // Use the same limits as mimeAddTypeRule() and mime_check_rules()...
+      if (crule->offset < 0 || crule->region < 0 || crule->region > MIME_MAX_BUFFER || crule->length < 0 || crule->length > MIME_MAX_BUFFER)
+        goto done;
+
+      switch (crule->op)
+      {
+        case MIME_MAGIC_MATCH :
+        case MIME_MAGIC_LOCALE :
+            if (!memchr(crule->value, 0, sizeof(temp->value.matchv)))
+              goto done;
+            break;
+
+        case MIME_MAGIC_STRING :
+        case MIME_MAGIC_ISTRING :
+        case MIME_MAGIC_CONTAINS :
+            if (crule->length == 0 || (size_t)crule->length > sizeof(temp->value.stringv))
+              goto done;
+            break;
+
+        case MIME_MAGIC_REGEX :
+            if (crule->length != MIME_MAX_BUFFER)
+              goto done;
+            break;
+
+        default :
+            break;
+      }
+    }
+
+    num_rules += (unsigned)ctype->num_rules;
+  }
+
+  if (num_rules != header->num_rules)
+    goto done;
+
+  for (i = 0, cfilter = cfilters; i < header->num_filters; i ++, cfilter ++)
+  {
+    if (cfilter->src >= header->num_types || cfilter->dst >= header->num_types || !memchr(cfilter->filter, 0, sizeof(cfilter->filter)))
+      goto done;
+  }
+
+  for (i = 0; i < header->num_errors; i ++)
+  {
+    if (!memchr(cerrors[i].message, 0, sizeof(cerrors[i].message)))
+      goto done;
+  }
+
+  // Build the rules for each type...
+  if ((types = calloc(header->num_types + 1, sizeof(mime_type_t *))) == NULL || (rules = calloc(header->num_types + 1, sizeof(mime_magic_t *))) == NULL || (added = calloc(header->num_types + 1, sizeof(bool))) == NULL)
+    goto done;
+
+  for (i = 0, crule = crules, ctype = ctypes; i < header->num_types; i ++, ctype ++)
+  {
+    parents[0] = NULL;
+    last[0]    = NULL;
+
+    for (j = 0; j < (unsigned)ctype->num_rules; j ++, crule ++)
+    {
+      if ((temp = calloc(1, sizeof(mime_magic_t))) == NULL)
+        goto done;
+
+      temp->op     = (short)crule->op;
+      temp->invert = (short)crule->invert;
+      temp->offset = crule->offset;
+      temp->region = crule->region;
+      temp->length = crule->length;
+
+      if (temp->op == MIME_MAGIC_REGEX)
+      {
+        if (regcomp(&(temp->value.rev), crule->value, REG_NOSUB | REG_EXTENDED))
+        {
+          free(temp);
+          goto done;
+        }
+
+        temp->regex = strdup(crule->value);
+      }
+      else
+      {
+        memcpy(temp->value.stringv, crule->value, sizeof(temp->value.stringv));
+      }
+
+      // Add the rule to the tree...
+      temp->parent = parents[crule->depth];
+
+      if (last[crule->depth])
+      {
+        last[crule->depth]->next = temp;
+        temp->prev               = last[crule->depth];
+      }
+      else if (temp->parent)
+      {
+        temp->parent->child = temp;
+      }
+      else
+      {
+        rules[i] = temp;
+      }
+
+      last[crule->depth]        = temp;
+      parents[crule->depth + 1] = temp;
+      last[crule->depth + 1]    = NULL;
+    }
+  }
+
+  // Then add the types and filters, removing them again if we run out of
+  // memory...
+  for (i = 0, ctype = ctypes; i < header->num_types; i ++, ctype ++)
+  {
+    if ((types[i] = mimeType(mime, ctype->super, ctype->type)) == NULL)
+    {
+      if ((types[i] = mimeAddType(mime, ctype->super, ctype->type)) == NULL)
+        goto undo;
+
+      added[i] = true;
+    }
+  }
+
+  for (i = 0, cfilter = cfilters; i < header->num_filters; i ++, cfilter ++)
+  {
+    if ((filter = mimeAddFilter(mime, types[cfilter->src], types[cfilter->dst], cfilter->cost, cfilter->filter)) == NULL)
+      goto undo;
+
+    filter->maxsize = cfilter->maxsize;
+  }
+
+  // Everything is added, so attach the rules...
+  for (i = 0, ctype = ctypes; i < header->num_types; i ++, ctype ++)
+  {
+    types[i]->priority = ctype->priority;
+    types[i]->rules    = rules[i];
+    rules[i]           = NULL;
+  }
+
+  _mimeDeleteIndex(mime);
+
+  // Report the errors from the original load...
+  for (i = 0; i < header->num_errors; i ++)
+    _mimeError(mime, "%s", cerrors[i].message);
+
+  MIME_DEBUG("mime_read_cache: Loaded %u types, %u rules, and %u filters.\n", header->num_types, header->num_rules, header->num_filters);
+
+  ret = true;
+  goto done;
+
+  // Restore the database to its original state (types without rules or
+  // filters) on error...
+  undo:
+
+  while ((filter = mimeFirstFilter(mime)) != NULL)
+    mimeDeleteFilter(mime, filter);
+
+  for (i = 0; i < header->num_types; i ++)
+  {
+    if (added[i])
+      mimeDeleteType(mime, types[i]);
+  }
+
+  done:
+
+  if (rules)
+  {
+    for (i = 0; i < header->num_types; i ++)
+      _mimeDeleteRules(rules[i]);
+  }
+
+  free(types);
+  free(rules);
+  free(added);
+  munmap(data, (size_t)info.st_size);
+
+  return (ret);
+}
+
+
+//
+// 'mime_update_key()' - Add data to the cache key.
+//
+
+static bool				// O - `true` on success, `false` on error
+mime_update_key(unsigned char *key,	// IO - SHA-256 key
+                const void    *data,	// I  - Data
+                size_t        datalen)	// I  - Length of data
+{
+  unsigned char	buffer[1056];		// Previous key and data
+
+
+  if (datalen > (sizeof(buffer) - 32))
+    return (false);
+
+  memcpy(buffer, key, 32);
+  memcpy(buffer + 32, data, datalen);
+
+  return (cupsHashData("sha2-256", buffer, datalen + 32, key, 32) == 32);
+}
+
+
+//
+// 'mime_write_cache()' - Save types and filters to a cache file.
+//
+
+static void
+mime_write_cache(
+    mime_t              *mime,		// I - MIME database
+    const char          *cachefile,	// I - Cache file
+    const unsigned char *key,		// I - Key for source files
+    cups_array_t        *errors)	// I - Error messages
+{
+  cups_file_t		*fp;		// Cache file
+  char			tempfile[1024];	// Temporary file
+  bool			ret;		// Write status
+  int			i,		// Looping var
+			count;		// Number of types
+  mime_type_t		*type;		// Current type
+  mime_filter_t		*filter;	// Current filter
+  const char		*message;	// Current error message
+  _mime_cache_header_t	header;		// Cache file header
+  _mime_cache_type_t	ctype;		// Cached type
+  _mime_cache_filter_t	cfilter;	// Cached filter
+  _mime_cache_error_t	cerror;		// Cached error message
+
+
+  MIME_DEBUG("mime_write_cache(mime=%p, cachefile=\"%s\", key=%p, errors=%p)\n", (void *)mime, cachefile, (void *)key, (void *)errors);
+
+  // Write to a temporary file and then rename it so that cupsd never sees
+  // a partial file...
+  snprintf(tempfile, sizeof(tempfile), "%s.N", cachefile);
+
+  if ((fp = cupsFileOpen(tempfile, "w")) == NULL)
+  {
+    MIME_DEBUG("mime_write_cache: Unable to create \"%s\": %s\n", tempfile, strerror(errno));
+    return;
+  }
+
+  memset(&header, 0, sizeof(header));
+  memcpy(header.magic, "CUPSMIME", 8);
+  memcpy(header.key, key, sizeof(header.key));
+
+  header.version     = MIME_CACHE_VERSION;
+  header.num_types   = (unsigned)mimeNumTypes(mime);
+  header.num_filters = (unsigned)mimeNumFilters(mime);
+  header.num_errors  = (unsigned)cupsArrayGetCount(errors);
+
+  for (type = mimeFirstType(mime); type; type = mimeNextType(mime))
+    header.num_rules += mime_count_rules(type->rules);
+
+  ret = cupsFileWrite(fp, (char *)&header, sizeof(header)) == (ssize_t)sizeof(header);
+
+  // Write the types and then all of the rules...
+  for (i = 0, count = mimeNumTypes(mime); ret && i < count; i ++)
+  {
+    type = (mime_type_t *)cupsArrayGetElement(mime->types, i);
+
+    memset(&ctype, 0, sizeof(ctype));
+    cupsCopyString(ctype.super, type->super, sizeof(ctype.super));
+    cupsCopyString(ctype.type, type->type, sizeof(ctype.type));
+    ctype.priority  = type->priority;
+    ctype.num_rules = (int)mime_count_rules(type->rules);
+
+    ret = cupsFileWrite(fp, (char *)&ctype, sizeof(ctype)) == (ssize_t)sizeof(ctype);
+  }
+
+  for (i = 0; ret && i < count; i ++)
+  {
+    type = (mime_type_t *)cupsArrayGetElement(mime->types, i);
+    ret  = mime_write_rules(fp, type->rules, 0);
+  }
+
+  // Write the filters, using the index of each type...
+  for (filter = mimeFirstFilter(mime); ret && filter; filter = mimeNextFilter(mime))
+  {
+    memset(&cfilter, 0, sizeof(cfilter));
+
+    cupsArrayFind(mime->types, filter->src);
+    cfilter.src = (unsigned)cupsArrayGetIndex(mime->types);
+    cupsArrayFind(mime->types, filter->dst);
+    cfilter.dst = (unsigned)cupsArrayGetIndex(mime->types);
+
+    cfilter.cost    = filter->cost;
+    cfilter.maxsize = filter->maxsize;
+    cupsCopyString(cfilter.filter, filter->filter, sizeof(cfilter.filter));
+
+    ret = cupsFileWrite(fp, (char *)&cfilter, sizeof(cfilter)) == (ssize_t)sizeof(cfilter);
+  }
+
+  // Write the error messages...
+  for (message = (const char *)cupsArrayGetFirst(errors); ret && message; message = (const char *)cupsArrayGetNext(errors))
+  {
+    memset(&cerror, 0, sizeof(cerror));
+    cupsCopyString(cerror.message, message, sizeof(cerror.message));
+
+    ret = cupsFileWrite(fp, (char *)&cerror, sizeof(cerror)) == (ssize_t)sizeof(cerror);
+  }
+
+  if (cupsFileClose(fp))
+    ret = false;
+
+  if (!ret || rename(tempfile, cachefile))
+  {
+    MIME_DEBUG("mime_write_cache: Unable to write \"%s\": %s\n", cachefile, strerror(errno));
+    unlink(tempfile);
+  }
+}
+
+
+//
+// 'mime_write_rules()' - Save a rules tree to a cache file.
+//
+
+static bool				// O - `true` on success, `false` on error
+mime_write_rules(cups_file_t  *fp,	// I - Cache file
+                 mime_magic_t *rules,	// I - Rules
+                 int          depth)	// I - Depth in rules tree
+{
+  _mime_cache_rule_t	crule;		// Cached rule
+
+
+  if (rules && depth >= MIME_CACHE_MAX_DEPTH)
+    return (false);
+
+  for (; rules; rules = rules->next)
+  {
+    memset(&crule, 0, sizeof(crule));
+
+    crule.op     = rules->op;
+    crule.invert = rules->invert;
+    crule.depth  = depth;
+    crule.offset = rules->offset;
+    crule.region = rules->region;
+    crule.length = rules->length;
+
+    if (rules->op == MIME_MAGIC_REGEX)
+    {
+      if (!rules->regex)
+        return (false);
+
+      cupsCopyString(crule.value, rules->regex, sizeof(crule.value));
+    }
+    else
+    {
+      memcpy(crule.value, rules->value.stringv, sizeof(rules->value.stringv));
+    }
+
+    if (cupsFileWrite(fp, (char *)&crule, sizeof(crule)) != (ssize_t)sizeof(crule) || !mime_write_rules(fp, rules->child, depth + 1))
+      return (false);
+  }
+
+  return (true);
+}
@@ -14,6 +14,7 @@
 #  include <cups/array.h>
 #  include <cups/ipp.h>
 #  include <cups/file.h>
+#  include <cups/thread.h>
 #  include <regex.h>
 #  ifdef __cplusplus
 extern "C" {
@@ -63,7 +64,9 @@ typedef struct _mime_magic_s		// MIME Magic Data
 		invert;			// Invert the result
   int		offset,			// Offset in file
 		region,			// Region length
-		length;			// Length of data
+		length,			// Length of data
+		pattern;		// Compiled "contains" pattern number or 0
+  char		*regex;			// Regular expression string or `NULL`
   union
   {
     char	matchv[64];		// Match value
@@ -87,7 +90,8 @@ typedef struct _mime_type_s		// MIME Type Data
 typedef struct _mime_ftypes_s		// MIME filter types data
 {
   mime_type_t	*dst;			// Destination type
-  cups_array_t	*srcs;			// Source types
+  cups_array_t	*srcs,			// Source types
+		*reach;			// All source types that can be converted or `NULL` if not cached
 } mime_ftypes_t;
 
 typedef struct _mime_filter_s		// MIME Conversion Filter Data
@@ -109,6 +113,9 @@ typedef struct _mime_s			// MIME Database
   cups_array_t		*ftypes;	// Filter types
   mime_error_cb_t	error_cb;	// Error message callback
   void			*error_ctx;	// Pointer for callback
+  struct _mime_index_s	*index;		// Compiled type detection rules
+  cups_mutex_t		index_mutex;	// Mutex for compiling the type detection rules
+  struct _mime_fpaths_s	*fpaths;	// Cached filter paths
 } mime_t;
 
 
@@ -134,6 +141,7 @@ extern mime_type_t	*mimeFirstType(mime_t *mime);
 extern cups_array_t	*mimeGetFilterTypes(mime_t *mime, mime_type_t *dst, cups_array_t *srcs);
 
 extern mime_t		*mimeLoad(const char *pathname, const char *filterpath);
+extern mime_t		*mimeLoadCache(mime_t *mime, const char *cachefile, const char *pathnames, const char *filterpath);
 extern mime_t		*mimeLoadFilters(mime_t *mime, const char *pathname, const char *filterpath);
 extern mime_t		*mimeLoadTypes(mime_t *mime, const char *pathname);
 
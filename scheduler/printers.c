@@ -42,6 +42,7 @@ static void	add_printer_formats(cupsd_printer_t *p);
 static int	compare_printers(void *first, void *second, void *data);
 static void	delete_printer_filters(cupsd_printer_t *p);
 static void	dirty_printer(cupsd_printer_t *p);
+static void	free_pcache(cupsd_pcache_t *pc);
 static void	load_ppd(cupsd_printer_t *p);
 static ipp_t	*new_media_col(pwg_size_t *size);
 static void	write_xml_string(cups_file_t *fp, const char *s);
@@ -131,6 +132,71 @@ cupsdAddPrinter(const char *name)	/* I - Name of printer */
 }
 
 
+/*
+ * 'cupsdAddPrinterCache()' - Add an empty cached attribute copy for a printer.
+ *
+ * The least recently used copy is freed when there are already
+ * CUPSD_PCACHE_MAX copies.
+ */
+
+cupsd_pcache_t *			/* O - Cached attributes or `NULL` on error */
+cupsdAddPrinterCache(
+    cupsd_printer_t *p,			/* I - Printer */
+    const char      *key)		/* I - Cache key */
+{
+  cupsd_pcache_t	*pc;		/* Cached attributes */
+
+
+  if (!p->cache && (p->cache = cupsArrayNew3(NULL, NULL, NULL, 0, NULL, NULL)) == NULL)
+    return (NULL);
+
+  if (cupsArrayCount(p->cache) >= CUPSD_PCACHE_MAX)
+  {
+    pc = (cupsd_pcache_t *)cupsArrayFirst(p->cache);
+    cupsArrayRemove(p->cache, pc);
+    free_pcache(pc);
+  }
+
+  if ((pc = calloc(1, sizeof(cupsd_pcache_t))) == NULL)
+    return (NULL);
+
+  pc->key   = strdup(key);
+  pc->attrs = ippNew();
+
+  if (!pc->key || !pc->attrs)
+  {
+    free_pcache(pc);
+    return (NULL);
+  }
+
+  cupsArrayAdd(p->cache, pc);
+
+  return (pc);
+}
+
+
+/*
+ * 'cupsdClearPrinterCache()' - Free the cached attribute copies for a printer.
+ *
+ * Responses that still use a cached copy keep a reference to it until they
+ * are sent.
+ */
+
+void
+cupsdClearPrinterCache(
+    cupsd_printer_t *p)			/* I - Printer */
+{
+  cupsd_pcache_t	*pc;		/* Cached attributes */
+
+
+  for (pc = (cupsd_pcache_t *)cupsArrayFirst(p->cache); pc; pc = (cupsd_pcache_t *)cupsArrayNext(p->cache))
+    free_pcache(pc);
+
+  cupsArrayDelete(p->cache);
+  p->cache = NULL;
+}
+
+
 /*
  * 'cupsdCreateCommonData()' - Create the common printer data.
  */
@@ -683,6 +749,12 @@ cupsdDeletePrinter(
                      update ? "Job stopped due to printer being deleted." :
 		              "Job stopped.");
 
+ /*
+  * Check the pending jobs so they are aborted if the printer is not replaced...
+  */
+
+  cupsdSetJobQueuesReady(p);
+
  /*
   * Expire subscriptions on the printer...
   */
@@ -752,7 +824,12 @@ cupsdDeletePrinter(
   */
 
   if (p->printers != NULL)
+  {
+    for (i = 0; i < p->num_printers; i ++)
+      cupsArrayRemove(p->printers[i]->classes, p);
+
     free(p->printers);
+  }
 
   cupsRWLockWrite(&MimeLock);
 
@@ -764,6 +841,8 @@ cupsdDeletePrinter(
   ippDelete(p->attrs);
   ippDelete(p->ppd_attrs);
 
+  cupsdClearPrinterCache(p);
+
   _ppdCacheDestroy(p->pc);
 
   mimeDeleteType(MimeDatabase, p->filetype);
@@ -881,6 +960,46 @@ cupsdFindPrinter(const char *name)	/* I - Name of printer to find */
 }
 
 
+/*
+ * 'cupsdFindPrinterCache()' - Find a cached attribute copy for a printer.
+ *
+ * All copies are freed when the printer generation has changed since they
+ * were made.
+ */
+
+cupsd_pcache_t *			/* O - Cached attributes or `NULL` */
+cupsdFindPrinterCache(
+    cupsd_printer_t *p,			/* I - Printer */
+    const char      *key)		/* I - Cache key */
+{
+  cupsd_pcache_t	*pc;		/* Cached attributes */
+
+
+  if (p->cache_generation != p->generation)
+  {
+    cupsdClearPrinterCache(p);
+    p->cache_generation = p->generation;
+    return (NULL);
+  }
+
+  for (pc = (cupsd_pcache_t *)cupsArrayFirst(p->cache); pc; pc = (cupsd_pcache_t *)cupsArrayNext(p->cache))
+  {
+    if (!strcmp(pc->key, key))
+    {
+     /*
+      * Move to the end of the list...
+      */
+
+      cupsArrayRemove(p->cache, pc);
+      cupsArrayAdd(p->cache, pc);
+      break;
+    }
+  }
+
+  return (pc);
+}
+
+
 /*
  * 'cupsdLoadAllPrinters()' - Load printers from the printers.conf file.
  */
@@ -1998,6 +2117,12 @@ cupsdSetPrinterAttr(
   ipp_tag_t		value_tag;	/* Value tag for this attribute */
 
 
+ /*
+  * Invalidate cached copies of the printer attributes...
+  */
+
+  p->generation ++;
+
  /*
   * Don't allow empty values...
   */
@@ -2242,6 +2367,12 @@ cupsdSetPrinterAttrs(cupsd_printer_t *p)/* I - Printer to setup */
 		*filter;		/* Current filter */
 
 
+ /*
+  * Invalidate cached copies of the printer attributes...
+  */
+
+  p->generation ++;
+
  /*
   * Make sure that we have the common attributes defined...
   */
@@ -2606,6 +2737,12 @@ cupsdSetPrinterReasons(
   cupsdLogMessage(CUPSD_LOG_DEBUG2,
 		  "cupsdSetPrinterReasons(p=%p(%s),s=\"%s\"", (void *)p, p->name, s);
 
+ /*
+  * Invalidate cached copies of the printer attributes...
+  */
+
+  p->generation ++;
+
   if (s[0] == '-' || s[0] == '+')
   {
    /*
@@ -2746,6 +2883,12 @@ cupsdSetPrinterState(
   };
 
 
+ /*
+  * Invalidate cached copies of the printer attributes...
+  */
+
+  p->generation ++;
+
  /*
   * Set the new state and clear/set the reasons and message...
   */
@@ -2806,6 +2949,13 @@ cupsdSetPrinterState(
   if (update &&
       (old_state == IPP_PSTATE_STOPPED) != (s == IPP_PSTATE_STOPPED))
     dirty_printer(p);
+
+ /*
+  * Check the pending jobs that can use an idle printer...
+  */
+
+  if (s == IPP_PSTATE_IDLE)
+    cupsdSetJobQueuesReady(p);
 }
 
 
@@ -3872,6 +4022,19 @@ dirty_printer(cupsd_printer_t *p)	/* I - Printer */
 }
 
 
+/*
+ * 'free_pcache()' - Free a cached attribute copy.
+ */
+
+static void
+free_pcache(cupsd_pcache_t *pc)		/* I - Cached attributes */
+{
+  free(pc->key);
+  ippDelete(pc->attrs);
+  free(pc);
+}
+
+
 /*
  * 'load_ppd()' - Load a cached PPD file, updating the cache as needed.
  */
@@ -25,6 +25,19 @@ typedef struct
 } cupsd_quota_t;
 
 
+/*
+ * Cached Get-Printer-Attributes copy...
+ */
+
+typedef struct cupsd_pcache_s		/**** Cached printer attributes ****/
+{
+  char		*key;			/* Request version and requested-attributes */
+  ipp_t		*attrs;			/* Copy of printer and PPD attributes */
+} cupsd_pcache_t;
+
+#define CUPSD_PCACHE_MAX	4	/* Max cached copies per printer */
+
+
 /*
  * Printer/class information structure...
  */
@@ -72,15 +85,21 @@ struct cupsd_printer_s
   cupsd_job_t	*job;			/* Current job in queue */
   ipp_t		*attrs,			/* Attributes supported by this printer */
 		*ppd_attrs;		/* Attributes based on the PPD */
+  int		generation,		/* Attribute generation */
+		cache_generation;	/* Generation of cached attributes */
+  cups_array_t	*cache;			/* Cached attribute copies, least
+					 * recently used first */
   int		num_printers,		/* Number of printers in class */
 		last_printer;		/* Last printer job was sent to */
   struct cupsd_printer_s **printers;	/* Printers in class */
+  cups_array_t	*classes;		/* Classes containing this printer */
   int		quota_period,		/* Period for quotas */
 		page_limit,		/* Maximum number of pages */
 		k_limit;		/* Maximum number of kilobytes */
   cups_array_t	*quotas;		/* Quota records */
   int		deny_users;		/* 1 = deny, 0 = allow */
   cups_array_t	*users;			/* Allowed/denied users */
+  cups_array_t	*subscriptions;		/* Subscriptions for this printer */
   int		sequence_number;	/* Increasing sequence number */
   int		num_options;		/* Number of default options */
   cups_option_t	*options;		/* Default options */
@@ -125,12 +144,15 @@ VAR cupsd_policy_t	*DefaultPolicyPtr
  */
 
 extern cupsd_printer_t	*cupsdAddPrinter(const char *name);
+extern cupsd_pcache_t	*cupsdAddPrinterCache(cupsd_printer_t *p, const char *key);
+extern void		cupsdClearPrinterCache(cupsd_printer_t *p);
 extern void		cupsdCreateCommonData(void);
 extern void		cupsdDeleteAllPrinters(void);
 extern int		cupsdDeletePrinter(cupsd_printer_t *p, int update);
 extern void             cupsdDeleteTemporaryPrinters(int force);
 extern cupsd_printer_t	*cupsdFindDest(const char *name);
 extern cupsd_printer_t	*cupsdFindPrinter(const char *name);
+extern cupsd_pcache_t	*cupsdFindPrinterCache(cupsd_printer_t *p, const char *key);
 extern cupsd_quota_t	*cupsdFindQuota(cupsd_printer_t *p, const char *username);
 extern void		cupsdFreeQuotas(cupsd_printer_t *p);
 extern void		cupsdLoadAllPrinters(void);
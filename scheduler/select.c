@@ -10,6 +10,14 @@
 
 #include "cupsd.h"
 #include <poll.h>
+#ifdef HAVE_EPOLL
+#  include <sys/epoll.h>
+#endif // HAVE_EPOLL
+#ifdef HAVE_IO_URING
+#  include <linux/io_uring.h>
+#  include <sys/mman.h>
+#  include <sys/syscall.h>
+#endif // HAVE_IO_URING
 
 
 //
@@ -36,13 +44,27 @@
 //
 //     typedef void (*cupsd_selfunc_t)(void *data);
 //
-//     void cupsdStartSelect(void);
+//     void cupsdStartSelect(const char *backend);
 //     void cupsdStopSelect(void);
 //     void cupsdAddSelect(int fd, cupsd_selfunc_t read_cb,
 //                         cupsd_selfunc_t write_cb, void *data);
 //     void cupsdRemoveSelect(int fd);
 //     int cupsdDoSelect(int timeout);
 //
+//     void cupsdAddSelectEdge(int fd, cupsd_selfunc_t read_cb,
+//                             cupsd_selfunc_t write_cb, void *data);
+//     void cupsdSetSelectPending(int fd);
+//
+//   cupsdAddSelectEdge() is used for file descriptors whose callbacks
+//   read or write until they get EAGAIN, like the listening sockets.  A
+//   callback that stops early (MaxAccepts) calls cupsdSetSelectPending()
+//   so that it is called again on the next cupsdDoSelect() without
+//   waiting for a new event.
+//
+//   The testselect program passes "poll", "epoll", or "io_uring" to
+//   cupsdStartSelect() to choose a specific implementation; the
+//   scheduler passes NULL to use the best one that works.
+//
 //
 // IMPLEMENTATION STRATEGY
 //
@@ -85,17 +107,19 @@
 //
 //     3. epoll() - O(n)
 //         a. cupsdStartSelect() creates epoll file descriptor using
-//            epoll_create() with the maximum fd count, and
-//            allocates an events buffer for the maximum fd count.
+//            epoll_create1() and allocates an events buffer for the
+//            maximum fd count.  If epoll is not available, revert to
+//            the poll() system call.
 //         b. cupsdAdd/RemoveSelect() uses epoll_ctl() to add
-//            (EPOLL_CTL_ADD) or remove (EPOLL_CTL_DEL) a single
-//            event using the level-triggered semantics. The event
-//            user data field is a pointer to the new callback array
-//            element.
+//            (EPOLL_CTL_ADD), modify (EPOLL_CTL_MOD), or remove
+//            (EPOLL_CTL_DEL) a single event using the level-triggered
+//            semantics, or edge-triggered semantics for
+//            cupsdAddSelectEdge().  The event user data field is the
+//            file descriptor.
 //         c. cupsdDoSelect() uses epoll_wait() with the global event
 //            buffer allocated in cupsdStartSelect() and then loops
-//            through the events, using the user data field to find
-//            the callback record.
+//            through the events, looking up the callback record, and
+//            then calls the callbacks for any pending file descriptors.
 //         d. cupsdStopSelect() closes the epoll file descriptor and
 //            frees all of the memory used by the event buffer.
 //
@@ -112,7 +136,26 @@
 //         e. cupsdStopSelect() closes the kqueue() file descriptor
 //            and frees all of the memory used by the event buffer.
 //
-//     5. /dev/poll - O(n log n) - NOT YET IMPLEMENTED
+//     5. io_uring - O(n)
+//         a. cupsdStartSelect() creates an io_uring instance with
+//            io_uring_setup(), maps the submission and completion
+//            queues, and checks that multishot poll works.  If it does
+//            not, revert to epoll() or poll().
+//         b. cupsdAddSelect() queues a one-shot IORING_OP_POLL_ADD
+//            request, which is re-armed after each completion to get
+//            level-triggered semantics.  cupsdAddSelectEdge() queues a
+//            multishot poll request that stays armed.  The request user
+//            data is the file descriptor plus a generation number so
+//            that completions for old requests are ignored.
+//         c. cupsdRemoveSelect() queues an IORING_OP_POLL_REMOVE request.
+//         d. cupsdDoSelect() submits the queued requests along with an
+//            IORING_OP_TIMEOUT request using a single io_uring_enter()
+//            call, then loops through the completions, looking up the
+//            callback record.
+//         e. cupsdStopSelect() unmaps the queues and closes the io_uring
+//            file descriptor.
+//
+//     6. /dev/poll - O(n log n) - NOT YET IMPLEMENTED
 //         a. cupsdStartSelect() opens /dev/poll and allocates an
 //            array of pollfd structs; on failure to open /dev/poll,
 //            revert to poll() system call.
@@ -163,7 +206,16 @@
 typedef struct _cupsd_fd_s
 {
   int			fd,		// File descriptor
-			use;		// Use count
+			use,		// Use count
+			edge,		// Read/write until EAGAIN?
+			pending;	// Call again without waiting?
+#if defined(HAVE_EPOLL) || defined(HAVE_IO_URING)
+  unsigned		events;		// Registered epoll/poll events
+#endif // HAVE_EPOLL || HAVE_IO_URING
+#ifdef HAVE_IO_URING
+  int			arm;		// Poll request needs to be armed?
+  uint64_t		uring_data;	// Current poll request user data
+#endif // HAVE_IO_URING
   cupsd_selfunc_t	read_cb,	// Read callback
 			write_cb;	// Write callback
   void			*data;		// Data pointer for callbacks
@@ -178,14 +230,72 @@ static cups_array_t	*cupsd_fds = NULL;
 static int		cupsd_alloc_pollfds = 0,
 			cupsd_update_pollfds = 0;
 static struct pollfd	*cupsd_pollfds = NULL;
+static int		state_wanted = 0;
+					// Main thread waiting for StateLock?
+static cups_cond_t	state_cond = CUPS_COND_INITIALIZER;
+					// Condition for state_wanted changes
+static cups_mutex_t	state_mutex = CUPS_MUTEX_INITIALIZER;
+					// Mutex for state_wanted
+static cups_array_t	*cupsd_pending_fds = NULL;
+					// Pending file descriptors
+#ifdef HAVE_EPOLL
+static int		cupsd_epoll_fd = -1,
+					// epoll file descriptor
+			cupsd_alloc_epoll = 0;
+					// Size of epoll events buffer
+static struct epoll_event *cupsd_epoll_events = NULL;
+					// epoll events buffer
+#endif // HAVE_EPOLL
+#ifdef HAVE_IO_URING
+static struct
+{
+  int			fd;		// io_uring file descriptor
+  unsigned		sq_tail,	// Local submission queue tail
+			*sq_khead,	// Kernel submission queue head
+			*sq_ktail,	// Kernel submission queue tail
+			sq_mask,	// Submission queue mask
+			*sq_array,	// Submission queue index array
+			*cq_khead,	// Kernel completion queue head
+			*cq_ktail,	// Kernel completion queue tail
+			cq_mask;	// Completion queue mask
+  struct io_uring_sqe	*sqes;		// Submission queue entries
+  struct io_uring_cqe	*cqes;		// Completion queue entries
+  void			*sq_ring,	// Submission queue ring mapping
+			*cq_ring;	// Completion queue ring mapping
+  size_t		sq_ring_size,	// Size of submission queue mapping
+			cq_ring_size,	// Size of completion queue mapping
+			sqes_size;	// Size of submission queue entries
+  uint32_t		generation;	// Poll request generation number
+}			cupsd_uring = { -1 };
+					// io_uring instance
+static cups_array_t	*cupsd_arm_fds = NULL;
+					// File descriptors to (re)arm
+#  define CUPSD_URING_ENTRIES	1024	// Number of submission queue entries
+#  define CUPSD_URING_IGNORE	0	// User data for ignored completions
+#  define CUPSD_URING_TIMEOUT	1	// User data for timeout completions
+#endif // HAVE_IO_URING
 
 
 //
 // Local functions...
 //
 
+static int	add_select(int fd, cupsd_selfunc_t read_cb, cupsd_selfunc_t write_cb, void *data, int edge);
 static int	compare_fds(_cupsd_fd_t *a, _cupsd_fd_t *b, void *data);
+static void	do_pending(void);
 static _cupsd_fd_t *find_fd(int fd);
+#ifdef HAVE_EPOLL
+static int	do_epoll(long timeout);
+#endif // HAVE_EPOLL
+#ifdef HAVE_IO_URING
+static int	do_uring(long timeout);
+static void	uring_arm(_cupsd_fd_t *fdptr);
+static void	uring_disarm(_cupsd_fd_t *fdptr);
+static int	uring_enter(unsigned min_complete, int flags);
+static struct io_uring_sqe *uring_get_sqe(void);
+static int	uring_start(void);
+static void	uring_stop(void);
+#endif // HAVE_IO_URING
 #define		release_fd(f) { \
 		  (f)->use --; \
 		  if (!(f)->use) free((f));\
@@ -203,41 +313,29 @@ cupsdAddSelect(int             fd,	// I - File descriptor
                cupsd_selfunc_t write_cb,// I - Write callback
 	       void            *data)	// I - Data to pass to callback
 {
-  _cupsd_fd_t	*fdptr;			// File descriptor record
-
-
-  // Range check input...
   cupsdLogMessage(CUPSD_LOG_DEBUG2, "cupsdAddSelect(fd=%d, read_cb=%p, write_cb=%p, data=%p)", fd, (void *)read_cb, (void *)write_cb, (void *)data);
 
-  if (fd < 0)
-    return (0);
-
-  // See if this FD has already been added...
-  if ((fdptr = find_fd(fd)) == NULL)
-  {
-    // No, add a new entry...
-    if ((fdptr = calloc(1, sizeof(_cupsd_fd_t))) == NULL)
-      return (0);
-
-    fdptr->fd  = fd;
-    fdptr->use = 1;
+  return (add_select(fd, read_cb, write_cb, data, 0));
+}
 
-    if (!cupsArrayAdd(cupsd_fds, fdptr))
-    {
-      cupsdLogMessage(CUPSD_LOG_EMERG, "Unable to add fd %d to array!", fd);
-      free(fdptr);
-      return (0);
-    }
-  }
 
-  cupsd_update_pollfds = 1;
+//
+// 'cupsdAddSelectEdge()' - Add an edge-triggered file descriptor to the list.
+//
+// The callbacks must read or write until they get EAGAIN, or call
+// cupsdSetSelectPending() if they stop early.
+//
 
-  // Save the (new) read and write callbacks...
-  fdptr->read_cb  = read_cb;
-  fdptr->write_cb = write_cb;
-  fdptr->data     = data;
+int					// O - 1 on success, 0 on error
+cupsdAddSelectEdge(
+    int             fd,			// I - File descriptor
+    cupsd_selfunc_t read_cb,		// I - Read callback
+    cupsd_selfunc_t write_cb,		// I - Write callback
+    void            *data)		// I - Data to pass to callback
+{
+  cupsdLogMessage(CUPSD_LOG_DEBUG2, "cupsdAddSelectEdge(fd=%d, read_cb=%p, write_cb=%p, data=%p)", fd, (void *)read_cb, (void *)write_cb, (void *)data);
 
-  return (1);
+  return (add_select(fd, read_cb, write_cb, data, 1));
 }
 
 
@@ -254,6 +352,16 @@ cupsdDoSelect(long timeout)		// I - Timeout in seconds
   int			count;		// Number of file descriptors
 
 
+#ifdef HAVE_IO_URING
+  if (cupsd_uring.fd >= 0)
+    return (do_uring(timeout));
+#endif // HAVE_IO_URING
+
+#ifdef HAVE_EPOLL
+  if (cupsd_epoll_fd >= 0)
+    return (do_epoll(timeout));
+#endif // HAVE_EPOLL
+
   count = cupsArrayCount(cupsd_fds);
 
   if (cupsd_update_pollfds)
@@ -296,14 +404,21 @@ cupsdDoSelect(long timeout)		// I - Timeout in seconds
     }
   }
 
-  // Prevent 100% CPU by releasing control before the poll call...
+  // Prevent 100% CPU by releasing control before the poll call, and let the
+  // IPP thread use the scheduler state while we wait...
+  cupsRWUnlock(&StateLock);
+
   usleep(1);
 
-  if (timeout >= 0 && timeout < 86400)
+  if (cupsArrayCount(cupsd_pending_fds) > 0)
+    nfds = poll(cupsd_pollfds, (nfds_t)count, 0);
+  else if (timeout >= 0 && timeout < 86400)
     nfds = poll(cupsd_pollfds, (nfds_t)count, timeout * 1000);
   else
     nfds = poll(cupsd_pollfds, (nfds_t)count, -1);
 
+  cupsdHoldState();
+
   cupsdLogMessage(CUPSD_LOG_DEBUG2, "poll(nfds=%d, timeout=%ld) returned %d", count, timeout < 86400 ? timeout * 1000 : -1, nfds);
 
   if (nfds > 0)
@@ -334,11 +449,37 @@ cupsdDoSelect(long timeout)		// I - Timeout in seconds
     }
   }
 
+  // Then do callbacks for any pending file descriptors...
+  do_pending();
+
   // Return the number of file descriptors handled...
   return (nfds);
 }
 
 
+//
+// 'cupsdHoldState()' - Acquire the scheduler state lock for the main thread.
+//
+// The IPP thread checks cupsdIsStateWanted() while holding a read lock and
+// releases the lock so that the main thread does not wait for long requests.
+//
+
+void
+cupsdHoldState(void)
+{
+  cupsMutexLock(&state_mutex);
+  state_wanted = 1;
+  cupsMutexUnlock(&state_mutex);
+
+  cupsRWLockWrite(&StateLock);
+
+  cupsMutexLock(&state_mutex);
+  state_wanted = 0;
+  cupsCondBroadcast(&state_cond);
+  cupsMutexUnlock(&state_mutex);
+}
+
+
 #ifdef CUPSD_IS_SELECTING
 //
 // 'cupsdIsSelecting()' - Determine whether we are monitoring a file
@@ -353,6 +494,25 @@ cupsdIsSelecting(int fd)		// I - File descriptor
 #endif // CUPSD_IS_SELECTING
 
 
+//
+// 'cupsdIsStateWanted()' - Determine whether the main thread is waiting for
+//                          the scheduler state lock.
+//
+
+int					// O - 1 if waiting, 0 otherwise
+cupsdIsStateWanted(void)
+{
+  int	wanted;				// Return value
+
+
+  cupsMutexLock(&state_mutex);
+  wanted = state_wanted;
+  cupsMutexUnlock(&state_mutex);
+
+  return (wanted);
+}
+
+
 //
 // 'cupsdRemoveSelect()' - Remove a file descriptor from the list.
 //
@@ -376,6 +536,31 @@ cupsdRemoveSelect(int fd)		// I - File descriptor
   // Update the pollfds array...
   cupsd_update_pollfds = 1;
 
+#ifdef HAVE_EPOLL
+  if (cupsd_epoll_fd >= 0 && fdptr->events)
+    epoll_ctl(cupsd_epoll_fd, EPOLL_CTL_DEL, fd, NULL);
+#endif // HAVE_EPOLL
+
+#ifdef HAVE_IO_URING
+  // Cancel the poll request now, since it holds a reference to the file that
+  // would otherwise keep the connection open after the caller closes it...
+  if (cupsd_uring.fd >= 0 && fdptr->uring_data)
+  {
+    uring_disarm(fdptr);
+    uring_enter(0, 0);
+  }
+#endif // HAVE_IO_URING
+
+  // Remove any pending callbacks.  If cupsdDoSelect() is doing the pending
+  // callbacks right now, it releases the file descriptor record for us...
+  if (fdptr->pending)
+  {
+    fdptr->pending = 0;
+
+    if (cupsArrayRemove(cupsd_pending_fds, fdptr))
+      release_fd(fdptr);
+  }
+
   // Remove the file descriptor from the active array and add to the
   // inactive array (or release, if we don't need the inactive array...)
   cupsArrayRemove(cupsd_fds, fdptr);
@@ -384,18 +569,78 @@ cupsdRemoveSelect(int fd)		// I - File descriptor
 }
 
 
+//
+// 'cupsdSetSelectPending()' - Call the callbacks for a file descriptor again
+//                             on the next cupsdDoSelect().
+//
+// This is used by callbacks for edge-triggered file descriptors that stop
+// before they get EAGAIN, so that they are not starved of further events.
+//
+
+void
+cupsdSetSelectPending(int fd)		// I - File descriptor
+{
+  _cupsd_fd_t		*fdptr;		// File descriptor record
+
+
+  if ((fdptr = find_fd(fd)) == NULL || fdptr->pending)
+    return;
+
+  fdptr->pending = 1;
+  retain_fd(fdptr);
+  cupsArrayAdd(cupsd_pending_fds, fdptr);
+}
+
+
 //
 // 'cupsdStartSelect()' - Initialize the file polling engine.
 //
 
 void
-cupsdStartSelect(void)
+cupsdStartSelect(
+    const char *backend)		// I - Implementation for testing or `NULL` for the best
 {
-  cupsdLogMessage(CUPSD_LOG_DEBUG, "cupsdStartSelect()");
+  cupsdLogMessage(CUPSD_LOG_DEBUG, "cupsdStartSelect(backend=\"%s\")", backend ? backend : "(null)");
 
-  cupsd_fds = cupsArrayNew((cups_array_func_t)compare_fds, NULL);
+  cupsd_fds         = cupsArrayNew((cups_array_func_t)compare_fds, NULL);
+  cupsd_pending_fds = cupsArrayNew(NULL, NULL);
 
   cupsd_update_pollfds = 0;
+
+  if (!backend)
+    backend = "";
+
+#ifdef HAVE_IO_URING
+  if ((!*backend || !strcmp(backend, "io_uring")) && !uring_start())
+  {
+    cupsdLogMessage(CUPSD_LOG_DEBUG, "Using io_uring.");
+    backend = "io_uring";
+  }
+#endif // HAVE_IO_URING
+
+#ifdef HAVE_EPOLL
+  if (*backend && strcmp(backend, "epoll"))
+  {
+    // Using io_uring or poll...
+  }
+  else if ((cupsd_epoll_fd = epoll_create1(EPOLL_CLOEXEC)) < 0)
+  {
+    cupsdLogMessage(CUPSD_LOG_DEBUG, "Unable to use epoll, using poll instead: %s", strerror(errno));
+  }
+  else
+  {
+    cupsd_alloc_epoll = MaxFDs > 0 ? MaxFDs : 1024;
+
+    if ((cupsd_epoll_events = calloc((size_t)cupsd_alloc_epoll, sizeof(struct epoll_event))) == NULL)
+    {
+      close(cupsd_epoll_fd);
+      cupsd_epoll_fd    = -1;
+      cupsd_alloc_epoll = 0;
+    }
+  }
+#endif // HAVE_EPOLL
+
+  cupsdHoldState();
 }
 
 
@@ -411,12 +656,35 @@ cupsdStopSelect(void)
 
   cupsdLogMessage(CUPSD_LOG_DEBUG, "cupsdStopSelect()");
 
+  for (fdptr = (_cupsd_fd_t *)cupsArrayFirst(cupsd_pending_fds); fdptr; fdptr = (_cupsd_fd_t *)cupsArrayNext(cupsd_pending_fds))
+    release_fd(fdptr);
+
+  cupsArrayDelete(cupsd_pending_fds);
+  cupsd_pending_fds = NULL;
+
   for (fdptr = (_cupsd_fd_t *)cupsArrayFirst(cupsd_fds); fdptr; fdptr = (_cupsd_fd_t *)cupsArrayNext(cupsd_fds))
-    free(fdptr);
+    release_fd(fdptr);
 
   cupsArrayDelete(cupsd_fds);
   cupsd_fds = NULL;
 
+#ifdef HAVE_EPOLL
+  if (cupsd_epoll_fd >= 0)
+  {
+    close(cupsd_epoll_fd);
+    cupsd_epoll_fd = -1;
+  }
+
+  free(cupsd_epoll_events);
+  cupsd_epoll_events = NULL;
+  cupsd_alloc_epoll  = 0;
+#endif // HAVE_EPOLL
+
+#ifdef HAVE_IO_URING
+  if (cupsd_uring.fd >= 0)
+    uring_stop();
+#endif // HAVE_IO_URING
+
   if (cupsd_pollfds)
   {
     free(cupsd_pollfds);
@@ -425,6 +693,150 @@ cupsdStopSelect(void)
   }
 
   cupsd_update_pollfds = 0;
+
+  cupsRWUnlock(&StateLock);
+}
+
+
+//
+// 'cupsdWaitState()' - Wait for the main thread to acquire the scheduler
+//                      state lock.
+//
+// The IPP thread calls this function after releasing its read lock.
+//
+
+void
+cupsdWaitState(void)
+{
+  cupsMutexLock(&state_mutex);
+  while (state_wanted)
+    cupsCondWait(&state_cond, &state_mutex, 0.0);
+  cupsMutexUnlock(&state_mutex);
+}
+
+
+//
+// 'add_select()' - Add a file descriptor to the list.
+//
+
+static int				// O - 1 on success, 0 on error
+add_select(int             fd,		// I - File descriptor
+           cupsd_selfunc_t read_cb,	// I - Read callback
+           cupsd_selfunc_t write_cb,	// I - Write callback
+	   void            *data,	// I - Data to pass to callback
+	   int             edge)	// I - Edge-triggered?
+{
+  _cupsd_fd_t	*fdptr;			// File descriptor record
+
+
+  // Range check input...
+  if (fd < 0)
+    return (0);
+
+  // See if this FD has already been added...
+  if ((fdptr = find_fd(fd)) == NULL)
+  {
+    // No, add a new entry...
+    if ((fdptr = calloc(1, sizeof(_cupsd_fd_t))) == NULL)
+      return (0);
+
+    fdptr->fd  = fd;
+    fdptr->use = 1;
+
+    if (!cupsArrayAdd(cupsd_fds, fdptr))
+    {
+      cupsdLogMessage(CUPSD_LOG_EMERG, "Unable to add fd %d to array!", fd);
+      free(fdptr);
+      return (0);
+    }
+  }
+
+  cupsd_update_pollfds = 1;
+
+  // Save the (new) read and write callbacks...
+  fdptr->read_cb  = read_cb;
+  fdptr->write_cb = write_cb;
+  fdptr->data     = data;
+  fdptr->edge     = edge;
+
+#ifdef HAVE_EPOLL
+  if (cupsd_epoll_fd >= 0)
+  {
+    struct epoll_event	event;		// epoll event
+    int			op;		// epoll operation
+
+    memset(&event, 0, sizeof(event));
+
+    event.data.fd = fd;
+
+    if (read_cb)
+      event.events |= EPOLLIN;
+    if (write_cb)
+      event.events |= EPOLLOUT;
+    if (edge)
+      event.events |= EPOLLET;
+
+    if (event.events == fdptr->events)
+      return (1);
+
+    op = fdptr->events ? EPOLL_CTL_MOD : EPOLL_CTL_ADD;
+
+    if (epoll_ctl(cupsd_epoll_fd, op, fd, &event))
+    {
+      if (op == EPOLL_CTL_MOD && errno == ENOENT)
+      {
+        // The file descriptor was closed and reused before it was removed...
+        op = EPOLL_CTL_ADD;
+      }
+      else if (op == EPOLL_CTL_ADD && errno == EEXIST)
+      {
+        // The file descriptor was added by another record...
+        op = EPOLL_CTL_MOD;
+      }
+      else
+        op = -1;
+
+      if (op < 0 || epoll_ctl(cupsd_epoll_fd, op, fd, &event))
+      {
+        // Regular files can't be used with epoll but are always ready, so
+        // call the callbacks every time...
+        cupsdLogMessage(CUPSD_LOG_DEBUG2, "add_select: Unable to watch fd %d with epoll: %s", fd, strerror(errno));
+
+        fdptr->events = 0;
+        cupsdSetSelectPending(fd);
+        return (1);
+      }
+    }
+
+    fdptr->events = event.events;
+  }
+#endif // HAVE_EPOLL
+
+#ifdef HAVE_IO_URING
+  if (cupsd_uring.fd >= 0)
+  {
+    unsigned	events = 0;		// Poll events
+
+    if (read_cb)
+      events |= POLLIN;
+    if (write_cb)
+      events |= POLLOUT;
+    if (edge)
+      events |= 0x80000000;		// Use a multishot poll request
+
+    if (events != fdptr->events || (!fdptr->uring_data && !fdptr->arm))
+    {
+      uring_disarm(fdptr);
+
+      fdptr->events = events;
+
+      if (events & (POLLIN | POLLOUT))
+        uring_arm(fdptr);
+    }
+  }
+#endif // HAVE_IO_URING
+
+  return (1);
 }
 
 
@@ -442,6 +854,274 @@ compare_fds(_cupsd_fd_t *a, // I - First file descriptor
 }
 
 
+//
+// 'do_pending()' - Do callbacks for pending file descriptors.
+//
+
+static void
+do_pending(void)
+{
+  _cupsd_fd_t	*fdptr;			// Current file descriptor
+  cups_array_t	*pending;		// Pending file descriptors
+
+
+  if (cupsArrayCount(cupsd_pending_fds) == 0)
+    return;
+
+  // Swap the pending array so that callbacks can make their file descriptors
+  // pending again...
+  pending           = cupsd_pending_fds;
+  cupsd_pending_fds = cupsArrayNew(NULL, NULL);
+
+  for (fdptr = (_cupsd_fd_t *)cupsArrayFirst(pending); fdptr; fdptr = (_cupsd_fd_t *)cupsArrayNext(pending))
+  {
+    if (fdptr->pending)
+    {
+      fdptr->pending = 0;
+
+      if (fdptr->use > 1 && fdptr->read_cb)
+	(*(fdptr->read_cb))(fdptr->data);
+
+      if (fdptr->use > 1 && fdptr->write_cb)
+	(*(fdptr->write_cb))(fdptr->data);
+
+#ifdef HAVE_EPOLL
+      // Regular files don't generate epoll events so keep them pending...
+      if (cupsd_epoll_fd >= 0 && fdptr->use > 1 && !fdptr->events && !fdptr->pending)
+      {
+        fdptr->pending = 1;
+        retain_fd(fdptr);
+        cupsArrayAdd(cupsd_pending_fds, fdptr);
+      }
+#endif // HAVE_EPOLL
+    }
+
+    release_fd(fdptr);
+  }
+
+  cupsArrayDelete(pending);
+}
+
+
+#ifdef HAVE_EPOLL
+//
+// 'do_epoll()' - Do a select-like operation using epoll.
+//
+
+static int				// O - Number of files or -1 on error
+do_epoll(long timeout)			// I - Timeout in seconds
+{
+  int			nfds,		// Number of file descriptors
+			i;		// Looping var
+  _cupsd_fd_t		*fdptr;		// Current file descriptor
+  struct epoll_event	*event;		// Current event
+
+
+  // Prevent 100% CPU by releasing control before the epoll call, and let the
+  // IPP thread use the scheduler state while we wait...
+  cupsRWUnlock(&StateLock);
+
+  usleep(1);
+
+  if (cupsArrayCount(cupsd_pending_fds) > 0)
+    nfds = epoll_wait(cupsd_epoll_fd, cupsd_epoll_events, cupsd_alloc_epoll, 0);
+  else if (timeout >= 0 && timeout < 86400)
+    nfds = epoll_wait(cupsd_epoll_fd, cupsd_epoll_events, cupsd_alloc_epoll, (int)(timeout * 1000));
+  else
+    nfds = epoll_wait(cupsd_epoll_fd, cupsd_epoll_events, cupsd_alloc_epoll, -1);
+
+  cupsdHoldState();
+
+  cupsdLogMessage(CUPSD_LOG_DEBUG2, "epoll_wait(nfds=%d, timeout=%ld) returned %d", cupsArrayCount(cupsd_fds), timeout < 86400 ? timeout * 1000 : -1, nfds);
+
+  if (nfds < 0 && errno == EINTR)
+    nfds = 0;
+
+  // Do callbacks for each file descriptor...
+  for (i = nfds, event = cupsd_epoll_events; i > 0; i --, event ++)
+  {
+    if ((fdptr = find_fd(event->data.fd)) == NULL)
+    {
+      cupsdLogMessage(CUPSD_LOG_DEBUG2, "cupsd_epoll_events[%d] not found", event->data.fd);
+      continue;
+    }
+
+    cupsdLogMessage(CUPSD_LOG_DEBUG2, "cupsd_epoll_events[%d].events=%u", event->data.fd, event->events);
+
+    retain_fd(fdptr);
+
+    if (fdptr->read_cb && (event->events & (EPOLLIN | EPOLLERR | EPOLLHUP)))
+      (*(fdptr->read_cb))(fdptr->data);
+
+    if (fdptr->use > 1 && fdptr->write_cb && (event->events & (EPOLLOUT | EPOLLERR | EPOLLHUP)))
+      (*(fdptr->write_cb))(fdptr->data);
+
+    release_fd(fdptr);
+  }
+
+  // Then do callbacks for any pending file descriptors...
+  if (nfds >= 0)
+    do_pending();
+
+  // Return the number of file descriptors handled...
+  return (nfds);
+}
+#endif // HAVE_EPOLL
+
+
+#ifdef HAVE_IO_URING
+//
+// 'do_uring()' - Do a select-like operation using io_uring.
+//
+
+static int				// O - Number of files or -1 on error
+do_uring(long timeout)			// I - Timeout in seconds
+{
+  int			nfds = 0;	// Number of file descriptors
+  unsigned		head,		// Completion queue head
+			tail;		// Completion queue tail
+  _cupsd_fd_t		*fdptr;		// Current file descriptor
+  cups_array_t		*arm;		// File descriptors to arm
+  struct io_uring_sqe	*sqe;		// Submission queue entry
+  struct io_uring_cqe	*cqe;		// Completion queue entry
+  uint64_t		data;		// Completion user data
+  int			res;		// Completion result
+  unsigned		flags;		// Completion flags
+  static struct __kernel_timespec ts;	// Timeout
+
+
+  // Arm poll requests for new and changed file descriptors...
+  if (cupsArrayCount(cupsd_arm_fds) > 0)
+  {
+    arm           = cupsd_arm_fds;
+    cupsd_arm_fds = cupsArrayNew(NULL, NULL);
+
+    for (fdptr = (_cupsd_fd_t *)cupsArrayFirst(arm); fdptr; fdptr = (_cupsd_fd_t *)cupsArrayNext(arm))
+    {
+      if (fdptr->arm && find_fd(fdptr->fd) == fdptr && (sqe = uring_get_sqe()) != NULL)
+      {
+	fdptr->uring_data = ((uint64_t)++ cupsd_uring.generation << 32) | (unsigned)fdptr->fd;
+
+        sqe->opcode         = IORING_OP_POLL_ADD;
+        sqe->fd             = fdptr->fd;
+        sqe->poll32_events  = fdptr->events & (POLLIN | POLLOUT);
+        sqe->len            = (fdptr->events & 0x80000000) ? IORING_POLL_ADD_MULTI : 0;
+        sqe->user_data      = fdptr->uring_data;
+      }
+
+      fdptr->arm = 0;
+
+      release_fd(fdptr);
+    }
+
+    cupsArrayDelete(arm);
+  }
+
+  // Add a timeout request that completes when the timeout expires or any
+  // other request completes...
+  if (cupsArrayCount(cupsd_pending_fds) == 0 && timeout >= 0 && timeout < 86400 && (sqe = uring_get_sqe()) != NULL)
+  {
+    ts.tv_sec  = timeout;
+    ts.tv_nsec = 0;
+
+    sqe->opcode    = IORING_OP_TIMEOUT;
+    sqe->fd        = -1;
+    sqe->addr      = (uint64_t)(uintptr_t)&ts;
+    sqe->len       = 1;
+    sqe->off       = 1;
+    sqe->user_data = CUPSD_URING_TIMEOUT;
+  }
+
+  // Prevent 100% CPU by releasing control before the io_uring call, and let
+  // the IPP thread use the scheduler state while we wait...
+  cupsRWUnlock(&StateLock);
+
+  usleep(1);
+
+  if (cupsArrayCount(cupsd_pending_fds) > 0)
+    res = uring_enter(0, 0);
+  else
+    res = uring_enter(1, IORING_ENTER_GETEVENTS);
+
+  cupsdHoldState();
+
+  cupsdLogMessage(CUPSD_LOG_DEBUG2, "io_uring_enter(nfds=%d, timeout=%ld) returned %d", cupsArrayCount(cupsd_fds), timeout < 86400 ? timeout * 1000 : -1, res);
+
+  if (res < 0 && errno != EINTR && errno != EBUSY && errno != EAGAIN)
+    return (-1);
+
+  // Do callbacks for each completion...
+  for (head = *cupsd_uring.cq_khead, tail = __atomic_load_n(cupsd_uring.cq_ktail, __ATOMIC_ACQUIRE); head != tail; head ++)
+  {
+    // Copy the completion and release the queue entry before doing any
+    // callbacks, since they may add requests...
+    cqe   = cupsd_uring.cqes + (head & cupsd_uring.cq_mask);
+    data  = cqe->user_data;
+    res   = cqe->res;
+    flags = cqe->flags;
+
+    __atomic_store_n(cupsd_uring.cq_khead, head + 1, __ATOMIC_RELEASE);
+
+    if (data == CUPSD_URING_IGNORE || data == CUPSD_URING_TIMEOUT)
+      continue;
+
+    if ((fdptr = find_fd((int)(data & 0xffffffff))) == NULL || fdptr->uring_data != data)
+    {
+      cupsdLogMessage(CUPSD_LOG_DEBUG2, "io_uring completion for fd %d (generation %u) not found", (int)(data & 0xffffffff), (unsigned)(data >> 32));
+      continue;
+    }
+
+    cupsdLogMessage(CUPSD_LOG_DEBUG2, "io_uring completion for fd %d: res=%d, flags=%u", fdptr->fd, res, flags);
+
+    retain_fd(fdptr);
+
+    if (!(flags & IORING_CQE_F_MORE))
+    {
+      // One-shot or cancelled request, re-arm after the callbacks...
+      fdptr->uring_data = 0;
+    }
+
+    if (res > 0 && !fdptr->edge)
+    {
+      // The completion is posted as soon as the file descriptor is ready, so
+      // the data may have been read since then (copy_model() reads the CGI
+      // pipe directly, for example).  Check again so that the callbacks
+      // don't block...
+      struct pollfd	pfd;		// Poll data
+
+      pfd.fd      = fdptr->fd;
+      pfd.events  = (short)(fdptr->events & (POLLIN | POLLOUT));
+      pfd.revents = 0;
+
+      res = poll(&pfd, 1, 0) > 0 ? pfd.revents : 0;
+    }
+
+    if (res > 0)
+    {
+      nfds ++;
+
+      if (fdptr->read_cb && (res & (POLLIN | POLLERR | POLLHUP)))
+	(*(fdptr->read_cb))(fdptr->data);
+
+      if (fdptr->use > 1 && fdptr->write_cb && (res & (POLLOUT | POLLERR | POLLHUP)))
+	(*(fdptr->write_cb))(fdptr->data);
+    }
+
+    if (fdptr->use > 1 && !fdptr->uring_data && !fdptr->arm && (fdptr->events & (POLLIN | POLLOUT)))
+      uring_arm(fdptr);
+
+    release_fd(fdptr);
+  }
+
+  // Then do callbacks for any pending file descriptors...
+  do_pending();
+
+  // Return the number of file descriptors handled...
+  return (nfds);
+}
+#endif // HAVE_IO_URING
+
+
 //
 // 'find_fd()' - Find an existing file descriptor record.
 //
@@ -462,3 +1142,265 @@ find_fd(int fd)				// I - File descriptor
 
   return (fdptr);
 }
+
+
+#ifdef HAVE_IO_URING
+//
+// 'uring_arm()' - Queue a poll request for a file descriptor.
+//
+
+static void
+uring_arm(_cupsd_fd_t *fdptr)		// I - File descriptor record
+{
+  if (fdptr->arm)
+    return;
+
+  fdptr->arm = 1;
+  retain_fd(fdptr);
+  cupsArrayAdd(cupsd_arm_fds, fdptr);
+}
+
+
+//
+// 'uring_disarm()' - Cancel the poll request for a file descriptor.
+//
+
+static void
+uring_disarm(_cupsd_fd_t *fdptr)	// I - File descriptor record
+{
+  struct io_uring_sqe	*sqe;		// Submission queue entry
+
+
+  // Don't arm a request that hasn't been submitted yet...
+  fdptr->arm = 0;
+
+  if (!fdptr->uring_data)
+    return;
+
+  if ((sqe = uring_get_sqe()) != NULL)
+  {
+    sqe->opcode    = IORING_OP_POLL_REMOVE;
+    sqe->fd        = -1;
+    sqe->addr      = fdptr->uring_data;
+    sqe->user_data = CUPSD_URING_IGNORE;
+  }
+
+  fdptr->uring_data = 0;
+}
+
+
+//
+// 'uring_enter()' - Submit queued requests and optionally wait for
+//                   completions.
+//
+
+static int				// O - Number of requests submitted or -1 on error
+uring_enter(unsigned min_complete,	// I - Minimum number of completions
+            int      flags)		// I - io_uring_enter flags
+{
+  unsigned	to_submit;		// Number of requests to submit
+
+
+  __atomic_store_n(cupsd_uring.sq_ktail, cupsd_uring.sq_tail, __ATOMIC_RELEASE);
+
+  to_submit = cupsd_uring.sq_tail - __atomic_load_n(cupsd_uring.sq_khead, __ATOMIC_ACQUIRE);
+
+  if (!to_submit && !min_complete)
+    return (0);
+
+  return ((int)syscall(__NR_io_uring_enter, cupsd_uring.fd, to_submit, min_complete, flags, NULL, 0));
+}
+
+
+//
+// 'uring_get_sqe()' - Get the next submission queue entry.
+//
+
+static struct io_uring_sqe *		// O - Submission queue entry or `NULL`
+uring_get_sqe(void)
+{
+  struct io_uring_sqe	*sqe;		// Submission queue entry
+  unsigned		index;		// Queue index
+
+
+  if ((cupsd_uring.sq_tail - __atomic_load_n(cupsd_uring.sq_khead, __ATOMIC_ACQUIRE)) > cupsd_uring.sq_mask)
+  {
+    // Queue is full, submit what we have...
+    if (uring_enter(0, 0) < 0 || (cupsd_uring.sq_tail - __atomic_load_n(cupsd_uring.sq_khead, __ATOMIC_ACQUIRE)) > cupsd_uring.sq_mask)
+    {
+      cupsdLogMessage(CUPSD_LOG_ERROR, "Unable to submit io_uring requests: %s", strerror(errno));
+      return (NULL);
+    }
+  }
+
+  index = cupsd_uring.sq_tail & cupsd_uring.sq_mask;
+  sqe   = cupsd_uring.sqes + index;
+
+  memset(sqe, 0, sizeof(struct io_uring_sqe));
+
+  cupsd_uring.sq_array[index] = index;
+  cupsd_uring.sq_tail ++;
+
+  return (sqe);
+}
+
+
+//
+// 'uring_start()' - Create and check the io_uring instance.
+//
+
+static int				// O - 0 on success, -1 on error
+uring_start(void)
+{
+  struct io_uring_params params;	// io_uring parameters
+  struct io_uring_sqe	*sqe;		// Submission queue entry
+  struct io_uring_cqe	*cqe;		// Completion queue entry
+  int			fds[2];		// Test pipe
+  int			ok = 0;		// Did multishot poll work?
+
+
+  // Create the io_uring instance with room for a completion for every file
+  // descriptor...
+  memset(&params, 0, sizeof(params));
+  params.flags      = IORING_SETUP_CQSIZE;
+  params.cq_entries = (unsigned)(MaxFDs > CUPSD_URING_ENTRIES ? 2 * MaxFDs : 2 * CUPSD_URING_ENTRIES);
+
+  if ((cupsd_uring.fd = (int)syscall(__NR_io_uring_setup, CUPSD_URING_ENTRIES, &params)) < 0)
+  {
+    cupsdLogMessage(CUPSD_LOG_DEBUG, "Unable to use io_uring: %s", strerror(errno));
+    return (-1);
+  }
+
+  fcntl(cupsd_uring.fd, F_SETFD, FD_CLOEXEC);
+
+  // Map the queues...
+  cupsd_uring.sq_ring_size = params.sq_off.array + params.sq_entries * sizeof(unsigned);
+  cupsd_uring.cq_ring_size = params.cq_off.cqes + params.cq_entries * sizeof(struct io_uring_cqe);
+  cupsd_uring.sqes_size    = params.sq_entries * sizeof(struct io_uring_sqe);
+
+  if (params.features & IORING_FEAT_SINGLE_MMAP)
+  {
+    if (cupsd_uring.cq_ring_size > cupsd_uring.sq_ring_size)
+      cupsd_uring.sq_ring_size = cupsd_uring.cq_ring_size;
+
+    cupsd_uring.cq_ring_size = 0;
+  }
+
+  if ((cupsd_uring.sq_ring = mmap(NULL, cupsd_uring.sq_ring_size, PROT_READ | PROT_WRITE, MAP_SHARED | MAP_POPULATE, cupsd_uring.fd, IORING_OFF_SQ_RING)) == MAP_FAILED)
+  {
+    cupsd_uring.sq_ring = NULL;
+    goto error;
+  }
+
+  if (cupsd_uring.cq_ring_size)
+  {
+    if ((cupsd_uring.cq_ring = mmap(NULL, cupsd_uring.cq_ring_size, PROT_READ | PROT_WRITE, MAP_SHARED | MAP_POPULATE, cupsd_uring.fd, IORING_OFF_CQ_RING)) == MAP_FAILED)
+    {
+      cupsd_uring.cq_ring = NULL;
+      goto error;
+    }
+  }
+  else
+    cupsd_uring.cq_ring = cupsd_uring.sq_ring;
+
+  if ((cupsd_uring.sqes = mmap(NULL, cupsd_uring.sqes_size, PROT_READ | PROT_WRITE, MAP_SHARED | MAP_POPULATE, cupsd_uring.fd, IORING_OFF_SQES)) == MAP_FAILED)
+  {
+    cupsd_uring.sqes = NULL;
+    goto error;
+  }
+
+  cupsd_uring.sq_khead = (unsigned *)((char *)cupsd_uring.sq_ring + params.sq_off.head);
+  cupsd_uring.sq_ktail = (unsigned *)((char *)cupsd_uring.sq_ring + params.sq_off.tail);
+  cupsd_uring.sq_mask  = *(unsigned *)((char *)cupsd_uring.sq_ring + params.sq_off.ring_mask);
+  cupsd_uring.sq_array = (unsigned *)((char *)cupsd_uring.sq_ring + params.sq_off.array);
+  cupsd_uring.sq_tail  = *cupsd_uring.sq_ktail;
+  cupsd_uring.cq_khead = (unsigned *)((char *)cupsd_uring.cq_ring + params.cq_off.head);
+  cupsd_uring.cq_ktail = (unsigned *)((char *)cupsd_uring.cq_ring + params.cq_off.tail);
+  cupsd_uring.cq_mask  = *(unsigned *)((char *)cupsd_uring.cq_ring + params.cq_off.ring_mask);
+  cupsd_uring.cqes     = (struct io_uring_cqe *)((char *)cupsd_uring.cq_ring + params.cq_off.cqes);
+
+  // Make sure that multishot poll requests work (Linux 5.13 and later)...
+  if (pipe(fds))
+    goto error;
+
+  if ((sqe = uring_get_sqe()) != NULL)
+  {
+    sqe->opcode        = IORING_OP_POLL_ADD;
+    sqe->fd            = fds[0];
+    sqe->poll32_events = POLLIN;
+    sqe->len           = IORING_POLL_ADD_MULTI;
+    sqe->user_data     = CUPSD_URING_TIMEOUT;
+
+    if (write(fds[1], "", 1) == 1 && uring_enter(1, IORING_ENTER_GETEVENTS) == 1 && *cupsd_uring.cq_khead != __atomic_load_n(cupsd_uring.cq_ktail, __ATOMIC_ACQUIRE))
+    {
+      cqe = cupsd_uring.cqes + (*cupsd_uring.cq_khead & cupsd_uring.cq_mask);
+      ok  = cqe->res > 0 && (cqe->res & POLLIN) && (cqe->flags & IORING_CQE_F_MORE);
+    }
+  }
+
+  close(fds[0]);
+  close(fds[1]);
+
+  if (!ok)
+  {
+    cupsdLogMessage(CUPSD_LOG_DEBUG, "Unable to use io_uring: Multishot poll not supported.");
+    uring_stop();
+    return (-1);
+  }
+
+  // Cancel the test request and discard its completions...
+  if ((sqe = uring_get_sqe()) != NULL)
+  {
+    sqe->opcode    = IORING_OP_POLL_REMOVE;
+    sqe->fd        = -1;
+    sqe->addr      = CUPSD_URING_TIMEOUT;
+    sqe->user_data = CUPSD_URING_IGNORE;
+
+    uring_enter(2, IORING_ENTER_GETEVENTS);
+  }
+
+  __atomic_store_n(cupsd_uring.cq_khead, __atomic_load_n(cupsd_uring.cq_ktail, __ATOMIC_ACQUIRE), __ATOMIC_RELEASE);
+
+  cupsd_arm_fds = cupsArrayNew(NULL, NULL);
+
+  return (0);
+
+  // If we get here there was an error...
+  error:
+
+  cupsdLogMessage(CUPSD_LOG_DEBUG, "Unable to use io_uring: %s", strerror(errno));
+  uring_stop();
+
+  return (-1);
+}
+
+
+//
+// 'uring_stop()' - Destroy the io_uring instance.
+//
+
+static void
+uring_stop(void)
+{
+  _cupsd_fd_t	*fdptr;			// Current file descriptor
+
+
+  for (fdptr = (_cupsd_fd_t *)cupsArrayFirst(cupsd_arm_fds); fdptr; fdptr = (_cupsd_fd_t *)cupsArrayNext(cupsd_arm_fds))
+    release_fd(fdptr);
+
+  cupsArrayDelete(cupsd_arm_fds);
+  cupsd_arm_fds = NULL;
+
+  if (cupsd_uring.sqes)
+    munmap(cupsd_uring.sqes, cupsd_uring.sqes_size);
+  if (cupsd_uring.cq_ring && cupsd_uring.cq_ring != cupsd_uring.sq_ring)
+    munmap(cupsd_uring.cq_ring, cupsd_uring.cq_ring_size);
+  if (cupsd_uring.sq_ring)
+    munmap(cupsd_uring.sq_ring, cupsd_uring.sq_ring_size);
+
+  close(cupsd_uring.fd);
+
+  memset(&cupsd_uring, 0, sizeof(cupsd_uring));
+  cupsd_uring.fd = -1;
+}
+#endif // HAVE_IO_URING
@@ -34,6 +34,12 @@ static int		started = 0;	/* Did we start the server already? */
 void
 cupsdStartServer(void)
 {
+ /*
+  * Start writing log files from the log thread...
+  */
+
+  cupsdStartLogThread();
+
  /*
   * Create the default security profile...
   */
@@ -79,6 +85,12 @@ cupsdStartServer(void)
     cupsdAddSelect(CGIPipes[0], (cupsd_selfunc_t)cupsdUpdateCGI, NULL, NULL);
   }
 
+ /*
+  * Start the thread for read-only IPP requests...
+  */
+
+  cupsdStartIPPThread();
+
  /*
   * Mark that the server has started and printers and jobs may be changed...
   */
@@ -108,9 +120,10 @@ cupsdStopServer(void)
   cupsdStopColor();
 
  /*
-  * Close all network clients...
+  * Finish any pending IPP requests and close all network clients...
   */
 
+  cupsdStopIPPThread();
   cupsdCloseAllClients();
   cupsdStopListening();
   cupsdStopBrowsing();
@@ -139,9 +152,11 @@ cupsdStopServer(void)
   }
 
  /*
-  * Close all log files...
+  * Write any buffered log lines and close all log files...
   */
 
+  cupsdStopLogThread();
+
   if (AccessFile != NULL)
   {
     if (AccessFile != LogStderr)
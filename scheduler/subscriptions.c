@@ -20,6 +20,33 @@
 #endif /* HAVE_DBUS */
 
 
+/*
+ * Local types...
+ */
+
+typedef struct cupsd_pending_s		/**** Event waiting for a notifier ****/
+{
+  cupsd_event_t		*event;		/* Event */
+  int			sequence;	/* notify-sequence-number */
+} cupsd_pending_t;
+
+
+/*
+ * Local globals...
+ */
+
+#define CUPSD_EVENT_BITS 21		/* Number of event bits */
+#define CUPSD_MAX_OUTPUT (256 * 1024)	/* Maximum unwritten bytes for a
+					 * notifier */
+
+static cups_array_t	*event_subscriptions[CUPSD_EVENT_BITS] = { NULL };
+					/* Subscriptions without a printer, by
+					 * event bit */
+static cups_array_t	*pending_subscriptions = NULL;
+					/* Subscriptions with events waiting
+					 * for the notifier */
+
+
 /*
  * Local functions...
  */
@@ -28,6 +55,12 @@ static int	cupsd_compare_subscriptions(cupsd_subscription_t *first,
 					    cupsd_subscription_t *second,
 					    void *unused);
 static void	cupsd_delete_event(cupsd_event_t *event, void *data);
+static void	cupsd_index_subscription(cupsd_subscription_t *sub);
+static void	cupsd_queue_notification(cupsd_subscription_t *sub,
+					 cupsd_event_t *event);
+static cupsd_event_t *cupsd_new_event(cupsd_eventmask_t event,
+				      cupsd_printer_t *dest, cupsd_job_t *job,
+				      const char *text);
 #ifdef HAVE_DBUS
 static void	cupsd_send_dbus(cupsd_eventmask_t event, cupsd_printer_t *dest,
 				cupsd_job_t *job);
@@ -35,7 +68,12 @@ static void	cupsd_send_dbus(cupsd_eventmask_t event, cupsd_printer_t *dest,
 static void	cupsd_send_notification(cupsd_subscription_t *sub,
 					cupsd_event_t *event);
 static void	cupsd_start_notifier(cupsd_subscription_t *sub);
+static void	cupsd_unindex_subscription(cupsd_subscription_t *sub);
 static void	cupsd_update_notifier(void);
+static void	cupsd_wake_waiters(cupsd_subscription_t *sub);
+static ssize_t	cupsd_write_buffer(cupsd_subscription_t *sub,
+				   ipp_uchar_t *buffer, size_t bytes);
+static void	cupsd_write_notifier(cupsd_subscription_t *sub);
 
 
 /*
@@ -50,12 +88,12 @@ cupsdAddEvent(
     const char	      *text,		/* I - Notification text */
     ...)				/* I - Additional arguments as needed */
 {
-  int			i,		/* Looping var */
+  int			i, j,		/* Looping vars */
 			scount;		/* Number of subscriptions */
   va_list		ap;		/* Pointer to additional arguments */
   char			ftext[1024];	/* Formatted text buffer */
-  ipp_attribute_t	*attr;		/* Printer/job attribute */
   cupsd_event_t		*temp = NULL;	/* New event pointer */
+  cups_array_t		*subs;		/* Subscriptions to check */
   cupsd_subscription_t	*sub;		/* Current subscription */
 
 
@@ -70,6 +108,8 @@ cupsdAddEvent(
 
   LastEvent |= event;
 
+  cupsdAddMetric(MetricsEvents, 1);
+
 #ifdef HAVE_DBUS
   cupsd_send_dbus(event, dest, job);
 #endif /* HAVE_DBUS */
@@ -94,147 +134,50 @@ cupsdAddEvent(
   if (job && !dest)
     dest = cupsdFindPrinter(job->dest);
 
+  va_start(ap, text);
+  vsnprintf(ftext, sizeof(ftext), text, ap);
+  va_end(ap);
+
   cupsRWLockRead(&SubscriptionsLock);
 
-  for (i = 0, scount = cupsArrayGetCount(Subscriptions); i < scount; i ++)
+  for (i = 0; i < (CUPSD_EVENT_BITS + 2); i ++)
   {
    /*
-    * Check if this subscription requires this event...
+    * Only look at the subscriptions that can match: those without a printer
+    * for each event bit, then those for the printer, then those for the job...
     */
 
-    sub = (cupsd_subscription_t *)cupsArrayGetElement(Subscriptions, i);
+    if (i < CUPSD_EVENT_BITS)
+      subs = (event & (1 << i)) ? event_subscriptions[i] : NULL;
+    else if (i == CUPSD_EVENT_BITS)
+      subs = dest ? dest->subscriptions : NULL;
+    else
+      subs = job ? job->subscriptions : NULL;
 
-    if ((sub->mask & event) != 0 && (sub->dest == dest || !sub->dest || sub->job == job))
+    for (j = 0, scount = cupsArrayGetCount(subs); j < scount; j ++)
     {
      /*
-      * Need this event, so create a new event record...
+      * Check if this subscription requires this event and that we haven't
+      * already sent it from an earlier list...
       */
 
-      if ((temp = (cupsd_event_t *)calloc(1, sizeof(cupsd_event_t))) == NULL)
-      {
-	cupsdLogMessage(CUPSD_LOG_CRIT,
-			"Unable to allocate memory for event - %s",
-			strerror(errno));
-        cupsRWUnlock(&SubscriptionsLock);
-	return;
-      }
+      sub = (cupsd_subscription_t *)cupsArrayGetElement(subs, j);
 
-      temp->event = event;
-      temp->time  = time(NULL);
-      temp->attrs = ippNew();
-      temp->job	  = job;
-      temp->dest  = dest;
+      if (!(sub->mask & event))
+        continue;
+      else if (i < CUPSD_EVENT_BITS && (sub->mask & event & ((1 << i) - 1)))
+        continue;
+      else if (i > CUPSD_EVENT_BITS && (!sub->dest || sub->dest == dest))
+        continue;
 
      /*
-      * Add common event notification attributes...
+      * Need this event, so create the shared event record the first time...
       */
 
-      ippAddString(temp->attrs, IPP_TAG_EVENT_NOTIFICATION, IPP_TAG_CHARSET,
-		   "notify-charset", NULL, "utf-8");
-
-      ippAddString(temp->attrs, IPP_TAG_EVENT_NOTIFICATION, IPP_TAG_LANGUAGE,
-		   "notify-natural-language", NULL, "en-US");
-
-      ippAddInteger(temp->attrs, IPP_TAG_EVENT_NOTIFICATION, IPP_TAG_INTEGER,
-		    "notify-subscription-id", sub->id);
-
-      ippAddInteger(temp->attrs, IPP_TAG_EVENT_NOTIFICATION, IPP_TAG_INTEGER,
-		    "notify-sequence-number", sub->next_event_id);
-
-      ippAddString(temp->attrs, IPP_TAG_EVENT_NOTIFICATION, IPP_TAG_KEYWORD,
-		   "notify-subscribed-event", NULL, cupsdEventName(event));
-
-      if (sub->user_data_len > 0)
-	ippAddOctetString(temp->attrs, IPP_TAG_EVENT_NOTIFICATION,
-			  "notify-user-data", sub->user_data,
-			  sub->user_data_len);
-
-      ippAddInteger(temp->attrs, IPP_TAG_EVENT_NOTIFICATION, IPP_TAG_INTEGER,
-		    "printer-up-time", time(NULL));
-
-      va_start(ap, text);
-      vsnprintf(ftext, sizeof(ftext), text, ap);
-      va_end(ap);
-
-      ippAddString(temp->attrs, IPP_TAG_EVENT_NOTIFICATION, IPP_TAG_TEXT,
-		   "notify-text", NULL, ftext);
-
-      if (job)
-        cupsdLogJob(job, CUPSD_LOG_DEBUG, "%s: %s", cupsdEventName(event), ftext);
-      else
-        cupsdLogPrinter(dest, CUPSD_LOG_DEBUG, "%s: %s", cupsdEventName(event), ftext);
-
-      if (dest)
-      {
-       /*
-	* Add printer attributes...
-	*/
-
-	ippAddString(temp->attrs, IPP_TAG_EVENT_NOTIFICATION, IPP_TAG_URI, "notify-printer-uri", NULL, dest->uri);
-
-	ippAddString(temp->attrs, IPP_TAG_EVENT_NOTIFICATION, IPP_TAG_NAME, "printer-name", NULL, dest->name);
-
-	ippAddInteger(temp->attrs, IPP_TAG_EVENT_NOTIFICATION, IPP_TAG_ENUM, "printer-state", (int)dest->state);
-
-	if (dest->num_reasons == 0)
-	  ippAddString(temp->attrs, IPP_TAG_EVENT_NOTIFICATION, IPP_TAG_KEYWORD, "printer-state-reasons", NULL, dest->state == IPP_PSTATE_STOPPED ? "paused" : "none");
-	else
-	  ippAddStrings(temp->attrs, IPP_TAG_EVENT_NOTIFICATION, IPP_TAG_KEYWORD, "printer-state-reasons", dest->num_reasons, NULL, (const char * const *)dest->reasons);
-
-	ippAddBoolean(temp->attrs, IPP_TAG_EVENT_NOTIFICATION, "printer-is-accepting-jobs", (char)dest->accepting);
-      }
-
-      if (job)
+      if (!temp && (temp = cupsd_new_event(event, dest, job, ftext)) == NULL)
       {
-       /*
-	* Add job attributes...
-	*/
-
-	ippAddInteger(temp->attrs, IPP_TAG_EVENT_NOTIFICATION, IPP_TAG_INTEGER, sub->job ? "notify-job-id" : "job-id", job->id);
-	ippAddInteger(temp->attrs, IPP_TAG_EVENT_NOTIFICATION, IPP_TAG_ENUM, "job-state", (int)job->state_value);
-
-	if ((attr = ippFindAttribute(job->attrs, "job-name", IPP_TAG_NAME)) != NULL)
-	  ippAddString(temp->attrs, IPP_TAG_EVENT_NOTIFICATION, IPP_TAG_NAME, "job-name", NULL, attr->values[0].string.text);
-
-	switch (job->state_value)
-	{
-	  case IPP_JSTATE_PENDING :
-	      if (dest && dest->state == IPP_PSTATE_STOPPED)
-		ippAddString(temp->attrs, IPP_TAG_EVENT_NOTIFICATION, IPP_TAG_KEYWORD, "job-state-reasons", NULL, "printer-stopped");
-	      else
-		ippAddString(temp->attrs, IPP_TAG_EVENT_NOTIFICATION, IPP_TAG_KEYWORD, "job-state-reasons", NULL, "none");
-	      break;
-
-	  case IPP_JSTATE_HELD :
-	      if (ippFindAttribute(job->attrs, "job-hold-until", IPP_TAG_KEYWORD) != NULL ||
-		  ippFindAttribute(job->attrs, "job-hold-until", IPP_TAG_NAME) != NULL)
-		ippAddString(temp->attrs, IPP_TAG_EVENT_NOTIFICATION, IPP_TAG_KEYWORD, "job-state-reasons", NULL, "job-hold-until-specified");
-	      else
-		ippAddString(temp->attrs, IPP_TAG_EVENT_NOTIFICATION, IPP_TAG_KEYWORD, "job-state-reasons", NULL, "job-incoming");
-	      break;
-
-	  case IPP_JSTATE_PROCESSING :
-	      ippAddString(temp->attrs, IPP_TAG_EVENT_NOTIFICATION, IPP_TAG_KEYWORD, "job-state-reasons", NULL, "job-printing");
-	      break;
-
-	  case IPP_JSTATE_STOPPED :
-	      ippAddString(temp->attrs, IPP_TAG_EVENT_NOTIFICATION, IPP_TAG_KEYWORD, "job-state-reasons", NULL, "job-stopped");
-	      break;
-
-	  case IPP_JSTATE_CANCELED :
-	      ippAddString(temp->attrs, IPP_TAG_EVENT_NOTIFICATION, IPP_TAG_KEYWORD, "job-state-reasons", NULL, "job-canceled-by-user");
-	      break;
-
-	  case IPP_JSTATE_ABORTED :
-	      ippAddString(temp->attrs, IPP_TAG_EVENT_NOTIFICATION, IPP_TAG_KEYWORD, "job-state-reasons", NULL, "aborted-by-system");
-	      break;
-
-	  case IPP_JSTATE_COMPLETED :
-	      ippAddString(temp->attrs, IPP_TAG_EVENT_NOTIFICATION, IPP_TAG_KEYWORD, "job-state-reasons", NULL, "job-completed-successfully");
-	      break;
-	}
-
-	ippAddInteger(temp->attrs, IPP_TAG_EVENT_NOTIFICATION, IPP_TAG_INTEGER, "job-impressions-completed", job->sheets ? job->sheets->values[0].integer : 0);
+        cupsRWUnlock(&SubscriptionsLock);
+	return;
       }
 
      /*
@@ -248,12 +191,62 @@ cupsdAddEvent(
   cupsRWUnlock(&SubscriptionsLock);
 
   if (temp)
+  {
+   /*
+    * Release our reference to the event; each subscription holds its own...
+    */
+
+    cupsd_delete_event(temp, NULL);
     cupsdMarkDirty(CUPSD_DIRTY_SUBSCRIPTIONS);
+  }
   else
     cupsdLogMessage(CUPSD_LOG_DEBUG, "Discarding unused %s event...", cupsdEventName(event));
 }
 
 
+/*
+ * 'cupsdAddEventAttrs()' - Add the notification attributes for an event.
+ *
+ * The common event attributes are shared by all subscriptions, so the
+ * subscription-specific attributes are added here as the message is copied.
+ */
+
+void
+cupsdAddEventAttrs(
+    ipp_t		 *ipp,		/* I - Message or response */
+    cupsd_subscription_t *sub,		/* I - Subscription */
+    cupsd_event_t	 *event,	/* I - Event */
+    int			 sequence,	/* I - notify-sequence-number */
+    int			 quickcopy)	/* I - Share values with event? */
+{
+  ipp_attribute_t	*attr;		/* Current event attribute */
+
+
+  for (attr = event->attrs->attrs; attr; attr = attr->next)
+  {
+    if (!strcmp(attr->name, "notify-subscribed-event"))
+    {
+      ippAddInteger(ipp, IPP_TAG_EVENT_NOTIFICATION, IPP_TAG_INTEGER,
+		    "notify-subscription-id", sub->id);
+
+      ippAddInteger(ipp, IPP_TAG_EVENT_NOTIFICATION, IPP_TAG_INTEGER,
+		    "notify-sequence-number", sequence);
+
+      ippCopyAttribute(ipp, attr, quickcopy);
+
+      if (sub->user_data_len > 0)
+	ippAddOctetString(ipp, IPP_TAG_EVENT_NOTIFICATION, "notify-user-data",
+			  sub->user_data, sub->user_data_len);
+    }
+    else if (sub->job && !strcmp(attr->name, "job-id"))
+      ippAddInteger(ipp, IPP_TAG_EVENT_NOTIFICATION, IPP_TAG_INTEGER,
+		    "notify-job-id", attr->values[0].integer);
+    else
+      ippCopyAttribute(ipp, attr, quickcopy);
+  }
+}
+
+
 /*
  * 'cupsdAddSubscription()' - Add a new subscription object.
  */
@@ -306,14 +299,8 @@ cupsdAddSubscription(
 
   if (MaxSubscriptionsPerJob > 0 && job)
   {
-    int count;				/* Number of job subscriptions */
-
-    for (temp = (cupsd_subscription_t *)cupsArrayFirst(Subscriptions),
-	     count = 0;
-	 temp;
-	 temp = (cupsd_subscription_t *)cupsArrayNext(Subscriptions))
-      if (temp->job == job)
-	count ++;
+    int count = cupsArrayGetCount(job->subscriptions);
+					/* Number of job subscriptions */
 
     if (count >= MaxSubscriptionsPerJob)
     {
@@ -328,14 +315,8 @@ cupsdAddSubscription(
 
   if (MaxSubscriptionsPerPrinter > 0 && dest)
   {
-    int count;				/* Number of printer subscriptions */
-
-    for (temp = (cupsd_subscription_t *)cupsArrayFirst(Subscriptions),
-	     count = 0;
-	 temp;
-	 temp = (cupsd_subscription_t *)cupsArrayNext(Subscriptions))
-      if (temp->dest == dest)
-	count ++;
+    int count = cupsArrayGetCount(dest->subscriptions);
+					/* Number of printer subscriptions */
 
     if (count >= MaxSubscriptionsPerPrinter)
     {
@@ -395,6 +376,7 @@ cupsdAddSubscription(
   */
 
   cupsArrayAdd(Subscriptions, temp);
+  cupsd_index_subscription(temp);
 
   cupsRWUnlock(&SubscriptionsLock);
 
@@ -454,7 +436,10 @@ cupsdDeleteSubscription(
   */
 
   if (sub->pipe >= 0)
+  {
+    cupsdRemoveSelect(sub->pipe);
     close(sub->pipe);
+  }
 
  /*
   * Remove subscription from array...
@@ -464,10 +449,18 @@ cupsdDeleteSubscription(
     cupsRWLockWrite(&SubscriptionsLock);
 
   cupsArrayRemove(Subscriptions, sub);
+  cupsd_unindex_subscription(sub);
 
   if (update >= 0)
     cupsRWUnlock(&SubscriptionsLock);
 
+ /*
+  * Let any waiting Get-Notifications requests know the subscription is gone...
+  */
+
+  if (sub->waiters)
+    cupsd_wake_waiters(sub);
+
  /*
   * Free memory...
   */
@@ -478,6 +471,24 @@ cupsdDeleteSubscription(
   cupsdClearString(&(sub->recipient));
 
   cupsArrayDelete(sub->events);
+  cupsArrayDelete(sub->waiters);
+
+  if (sub->pending)
+  {
+    cupsd_pending_t *p;			/* Pending event */
+
+    cupsArrayRemove(pending_subscriptions, sub);
+
+    for (p = (cupsd_pending_t *)cupsArrayGetFirst(sub->pending); p; p = (cupsd_pending_t *)cupsArrayGetNext(sub->pending))
+    {
+      cupsd_delete_event(p->event, NULL);
+      free(p);
+    }
+
+    cupsArrayDelete(sub->pending);
+  }
+
+  free(sub->output);
 
   free(sub);
 
@@ -783,7 +794,20 @@ cupsdLoadAllSubscriptions(void)
       }
 
       if (delete_sub)
+      {
 	cupsdDeleteSubscription(sub, 0);
+      }
+      else
+      {
+       /*
+        * Now that the events, printer, and job are known, add the
+	* subscription to the index...
+	*/
+
+        cupsRWLockWrite(&SubscriptionsLock);
+        cupsd_index_subscription(sub);
+        cupsRWUnlock(&SubscriptionsLock);
+      }
 
       sub	 = NULL;
       delete_sub = 0;
@@ -1056,6 +1080,17 @@ cupsdLoadAllSubscriptions(void)
     }
   }
 
+  if (sub)
+  {
+   /*
+    * Keep the subscription we were loading when we hit the error...
+    */
+
+    cupsRWLockWrite(&SubscriptionsLock);
+    cupsd_index_subscription(sub);
+    cupsRWUnlock(&SubscriptionsLock);
+  }
+
   cupsFileClose(fp);
 }
 
@@ -1191,6 +1226,98 @@ cupsdSaveAllSubscriptions(void)
 }
 
 
+/*
+ * 'cupsdSendNotifications()' - Write queued events to the notifiers.
+ *
+ * All of the events queued for a subscription are encoded into a single
+ * buffer and written to the notifier pipe together.  New events are dropped
+ * while a notifier that is not reading has CUPSD_MAX_OUTPUT bytes waiting.
+ */
+
+void
+cupsdSendNotifications(void)
+{
+  cupsd_subscription_t	*sub;		/* Current subscription */
+  cupsd_pending_t	*p;		/* Pending event */
+  ipp_t			*message;	/* Notification message */
+  ipp_state_t		state;		/* IPP event state */
+  int			count;		/* Number of events */
+  size_t		start;		/* Start of event in buffer */
+
+
+  while ((sub = (cupsd_subscription_t *)cupsArrayGetFirst(pending_subscriptions)) != NULL)
+  {
+    cupsArrayRemove(pending_subscriptions, sub);
+
+    if (sub->pipe < 0)
+      cupsd_start_notifier(sub);
+
+    cupsdLogMessage(CUPSD_LOG_DEBUG2, "sub->pipe=%d", sub->pipe);
+
+    if (sub->output_pos > 0)
+    {
+     /*
+      * Move the data a stalled notifier has not read yet to the front of the
+      * buffer...
+      */
+
+      sub->output_len -= sub->output_pos;
+      memmove(sub->output, sub->output + sub->output_pos, sub->output_len);
+      sub->output_pos = 0;
+    }
+
+    for (p = (cupsd_pending_t *)cupsArrayGetFirst(sub->pending), count = 0; p; p = (cupsd_pending_t *)cupsArrayGetNext(sub->pending))
+    {
+      if (sub->pipe >= 0 && sub->output_len >= CUPSD_MAX_OUTPUT)
+      {
+        if (!sub->output_dropped)
+          cupsdLogMessage(CUPSD_LOG_WARN, "Notifier for subscription %d (%s) is not reading events, dropping new events.", sub->id, sub->recipient);
+
+        sub->output_dropped ++;
+      }
+      else if (sub->pipe >= 0 && (message = ippNew()) != NULL)
+      {
+	cupsdAddEventAttrs(message, sub, p->event, p->sequence, 1);
+
+        start = sub->output_len;
+
+	while ((state = ippWriteIO(sub, (ipp_io_cb_t)cupsd_write_buffer, 1, NULL, message)) != IPP_STATE_DATA)
+	  if (state == IPP_STATE_ERROR)
+	    break;
+
+	ippDelete(message);
+
+	if (state == IPP_STATE_ERROR)
+	{
+	 /*
+	  * Don't send a partial message...
+	  */
+
+	  sub->output_len = start;
+
+	  cupsdLogMessage(CUPSD_LOG_ERROR, "Unable to send event for subscription %d (%s)!", sub->id, sub->recipient);
+	}
+	else
+	  count ++;
+      }
+
+      cupsd_delete_event(p->event, NULL);
+      free(p);
+    }
+
+    cupsArrayDelete(sub->pending);
+    sub->pending = NULL;
+
+    if (count > 0)
+    {
+      cupsdLogMessage(CUPSD_LOG_DEBUG2, "Sending %d event(s) to notifier for subscription %d.", count, sub->id);
+
+      cupsd_write_notifier(sub);
+    }
+  }
+}
+
+
 /*
  * 'cupsdStopAllNotifiers()' - Stop all notifier processes.
  */
@@ -1208,6 +1335,12 @@ cupsdStopAllNotifiers(void)
   if (!NotifierStatusBuffer)
     return;
 
+ /*
+  * Send any queued events...
+  */
+
+  cupsdSendNotifications();
+
  /*
   * Yes, kill any processes that are left...
   */
@@ -1222,6 +1355,7 @@ cupsdStopAllNotifiers(void)
     {
       cupsdEndProcess(sub->pid, 0);
 
+      cupsdRemoveSelect(sub->pipe);
       close(sub->pipe);
       sub->pipe = -1;
     }
@@ -1276,14 +1410,253 @@ static void cupsd_delete_event(cupsd_event_t *event, /* I - Event to delete */
                                void *data)           /* Unused */
 {
   /*
-   * Free memory...
+   * Free memory once the last subscription is done with the event...
    */
 
   (void)data;
+
+  if (-- event->use > 0)
+    return;
+
   ippDelete(event->attrs);
   free(event);
 }
 
+
+/*
+ * 'cupsd_index_subscription()' - Add a subscription to the event, printer, and
+ *                                job indices.
+ *
+ * The caller must hold a write lock on SubscriptionsLock.
+ */
+
+static void
+cupsd_index_subscription(
+    cupsd_subscription_t *sub)		/* I - Subscription */
+{
+  int	i;				/* Looping var */
+
+
+  if (sub->dest)
+  {
+    if (!sub->dest->subscriptions)
+      sub->dest->subscriptions = cupsArrayNew(NULL, NULL);
+
+    cupsArrayAdd(sub->dest->subscriptions, sub);
+  }
+  else
+  {
+    for (i = 0; i < CUPSD_EVENT_BITS; i ++)
+    {
+      if (!(sub->mask & (1 << i)))
+        continue;
+
+      if (!event_subscriptions[i])
+        event_subscriptions[i] = cupsArrayNew(NULL, NULL);
+
+      cupsArrayAdd(event_subscriptions[i], sub);
+    }
+  }
+
+  if (sub->job)
+  {
+    if (!sub->job->subscriptions)
+      sub->job->subscriptions = cupsArrayNew(NULL, NULL);
+
+    cupsArrayAdd(sub->job->subscriptions, sub);
+  }
+}
+
+
+/*
+ * 'cupsd_new_event()' - Create the shared record for an event.
+ *
+ * The returned event has a single reference held by the caller.
+ */
+
+static cupsd_event_t *			/* O - New event or NULL on error */
+cupsd_new_event(
+    cupsd_eventmask_t event,		/* I - Event */
+    cupsd_printer_t   *dest,		/* I - Printer associated with event */
+    cupsd_job_t	      *job,		/* I - Job associated with event */
+    const char	      *text)		/* I - Notification text */
+{
+  cupsd_event_t		*temp;		/* New event */
+  ipp_attribute_t	*attr;		/* Printer/job attribute */
+
+
+  if ((temp = (cupsd_event_t *)calloc(1, sizeof(cupsd_event_t))) == NULL)
+  {
+    cupsdLogMessage(CUPSD_LOG_CRIT, "Unable to allocate memory for event - %s",
+		    strerror(errno));
+    return (NULL);
+  }
+
+  temp->use   = 1;
+  temp->event = event;
+  temp->time  = time(NULL);
+  temp->attrs = ippNew();
+  temp->job   = job;
+  temp->dest  = dest;
+
+ /*
+  * Add common event notification attributes...
+  */
+
+  ippAddString(temp->attrs, IPP_TAG_EVENT_NOTIFICATION, IPP_TAG_CHARSET,
+	       "notify-charset", NULL, "utf-8");
+
+  ippAddString(temp->attrs, IPP_TAG_EVENT_NOTIFICATION, IPP_TAG_LANGUAGE,
+	       "notify-natural-language", NULL, "en-US");
+
+  ippAddString(temp->attrs, IPP_TAG_EVENT_NOTIFICATION, IPP_TAG_KEYWORD,
+	       "notify-subscribed-event", NULL, cupsdEventName(event));
+
+  ippAddInteger(temp->attrs, IPP_TAG_EVENT_NOTIFICATION, IPP_TAG_INTEGER,
+		"printer-up-time", time(NULL));
+
+  ippAddString(temp->attrs, IPP_TAG_EVENT_NOTIFICATION, IPP_TAG_TEXT,
+	       "notify-text", NULL, text);
+
+  if (job)
+    cupsdLogJob(job, CUPSD_LOG_DEBUG, "%s: %s", cupsdEventName(event), text);
+  else
+    cupsdLogPrinter(dest, CUPSD_LOG_DEBUG, "%s: %s", cupsdEventName(event), text);
+
+  if (dest)
+  {
+   /*
+    * Add printer attributes...
+    */
+
+    ippAddString(temp->attrs, IPP_TAG_EVENT_NOTIFICATION, IPP_TAG_URI, "notify-printer-uri", NULL, dest->uri);
+
+    ippAddString(temp->attrs, IPP_TAG_EVENT_NOTIFICATION, IPP_TAG_NAME, "printer-name", NULL, dest->name);
+
+    ippAddInteger(temp->attrs, IPP_TAG_EVENT_NOTIFICATION, IPP_TAG_ENUM, "printer-state", (int)dest->state);
+
+    if (dest->num_reasons == 0)
+      ippAddString(temp->attrs, IPP_TAG_EVENT_NOTIFICATION, IPP_TAG_KEYWORD, "printer-state-reasons", NULL, dest->state == IPP_PSTATE_STOPPED ? "paused" : "none");
+    else
+      ippAddStrings(temp->attrs, IPP_TAG_EVENT_NOTIFICATION, IPP_TAG_KEYWORD, "printer-state-reasons", dest->num_reasons, NULL, (const char * const *)dest->reasons);
+
+    ippAddBoolean(temp->attrs, IPP_TAG_EVENT_NOTIFICATION, "printer-is-accepting-jobs", (char)dest->accepting);
+  }
+
+  if (job)
+  {
+   /*
+    * Add job attributes; "job-id" is reported as "notify-job-id" to
+    * job subscriptions by cupsdAddEventAttrs...
+    */
+
+    ippAddInteger(temp->attrs, IPP_TAG_EVENT_NOTIFICATION, IPP_TAG_INTEGER, "job-id", job->id);
+    ippAddInteger(temp->attrs, IPP_TAG_EVENT_NOTIFICATION, IPP_TAG_ENUM, "job-state", (int)job->state_value);
+
+    if ((attr = ippFindAttribute(job->attrs, "job-name", IPP_TAG_NAME)) != NULL)
+      ippAddString(temp->attrs, IPP_TAG_EVENT_NOTIFICATION, IPP_TAG_NAME, "job-name", NULL, attr->values[0].string.text);
+
+    switch (job->state_value)
+    {
+      case IPP_JSTATE_PENDING :
+	  if (dest && dest->state == IPP_PSTATE_STOPPED)
+	    ippAddString(temp->attrs, IPP_TAG_EVENT_NOTIFICATION, IPP_TAG_KEYWORD, "job-state-reasons", NULL, "printer-stopped");
+	  else
+	    ippAddString(temp->attrs, IPP_TAG_EVENT_NOTIFICATION, IPP_TAG_KEYWORD, "job-state-reasons", NULL, "none");
+	  break;
+
+      case IPP_JSTATE_HELD :
+	  if (ippFindAttribute(job->attrs, "job-hold-until", IPP_TAG_KEYWORD) != NULL ||
+	      ippFindAttribute(job->attrs, "job-hold-until", IPP_TAG_NAME) != NULL)
+	    ippAddString(temp->attrs, IPP_TAG_EVENT_NOTIFICATION, IPP_TAG_KEYWORD, "job-state-reasons", NULL, "job-hold-until-specified");
+	  else
+	    ippAddString(temp->attrs, IPP_TAG_EVENT_NOTIFICATION, IPP_TAG_KEYWORD, "job-state-reasons", NULL, "job-incoming");
+	  break;
+
+      case IPP_JSTATE_PROCESSING :
+	  ippAddString(temp->attrs, IPP_TAG_EVENT_NOTIFICATION, IPP_TAG_KEYWORD, "job-state-reasons", NULL, "job-printing");
+	  break;
+
+      case IPP_JSTATE_STOPPED :
+	  ippAddString(temp->attrs, IPP_TAG_EVENT_NOTIFICATION, IPP_TAG_KEYWORD, "job-state-reasons", NULL, "job-stopped");
+	  break;
+
+      case IPP_JSTATE_CANCELED :
+	  ippAddString(temp->attrs, IPP_TAG_EVENT_NOTIFICATION, IPP_TAG_KEYWORD, "job-state-reasons", NULL, "job-canceled-by-user");
+	  break;
+
+      case IPP_JSTATE_ABORTED :
+	  ippAddString(temp->attrs, IPP_TAG_EVENT_NOTIFICATION, IPP_TAG_KEYWORD, "job-state-reasons", NULL, "aborted-by-system");
+	  break;
+
+      case IPP_JSTATE_COMPLETED :
+	  ippAddString(temp->attrs, IPP_TAG_EVENT_NOTIFICATION, IPP_TAG_KEYWORD, "job-state-reasons", NULL, "job-completed-successfully");
+	  break;
+    }
+
+    ippAddInteger(temp->attrs, IPP_TAG_EVENT_NOTIFICATION, IPP_TAG_INTEGER, "job-impressions-completed", job->sheets ? job->sheets->values[0].integer : 0);
+  }
+
+  return (temp);
+}
+
+
+/*
+ * 'cupsd_queue_notification()' - Queue an event for the notifier.
+ *
+ * A job-progress event replaces any job-progress event for the same job that
+ * has not been written to the notifier yet.
+ */
+
+static void
+cupsd_queue_notification(
+    cupsd_subscription_t *sub,		/* I - Subscription */
+    cupsd_event_t	 *event)	/* I - Event */
+{
+  cupsd_pending_t	*p;		/* Pending event */
+
+
+  if (!sub->pending)
+  {
+    if ((sub->pending = cupsArrayNew(NULL, NULL)) == NULL)
+      return;
+
+    if (!pending_subscriptions)
+      pending_subscriptions = cupsArrayNew(NULL, NULL);
+
+    cupsArrayAdd(pending_subscriptions, sub);
+  }
+
+  if (event->event == CUPSD_EVENT_JOB_PROGRESS)
+  {
+    for (p = (cupsd_pending_t *)cupsArrayGetLast(sub->pending); p; p = (cupsd_pending_t *)cupsArrayGetPrev(sub->pending))
+    {
+      if (p->event->event == CUPSD_EVENT_JOB_PROGRESS && p->event->job == event->job)
+      {
+        cupsArrayRemove(sub->pending, p);
+        cupsd_delete_event(p->event, NULL);
+        break;
+      }
+    }
+  }
+  else
+    p = NULL;
+
+  if (!p && (p = (cupsd_pending_t *)calloc(1, sizeof(cupsd_pending_t))) == NULL)
+  {
+    cupsdLogMessage(CUPSD_LOG_CRIT, "Unable to allocate memory for subscription #%d!", sub->id);
+    return;
+  }
+
+  event->use ++;
+
+  p->event    = event;
+  p->sequence = sub->next_event_id;
+
+  cupsArrayAdd(sub->pending, p);
+}
+
+
 #ifdef HAVE_DBUS
 /*
  * 'cupsd_send_dbus()' - Send a DBUS notification...
@@ -1373,9 +1746,6 @@ cupsd_send_notification(
     cupsd_subscription_t *sub,		/* I - Subscription object */
     cupsd_event_t	 *event)	/* I - Event to send */
 {
-  ipp_state_t	state;			/* IPP event state */
-
-
   cupsdLogMessage(CUPSD_LOG_DEBUG2,
 		  "cupsd_send_notification(sub=%p(%d), event=%p(%s))",
 		  (void *)sub, sub->id, (void *)event, cupsdEventName(event->event));
@@ -1424,61 +1794,19 @@ cupsd_send_notification(
   * event cache limit, we don't need to check for overflow here...
   */
 
+  event->use ++;
   cupsArrayAdd(sub->events, event);
 
+  if (sub->waiters)
+    cupsd_wake_waiters(sub);
+
  /*
-  * Deliver the event...
+  * Queue the event for the notifier; cupsdSendNotifications writes all of the
+  * queued events together...
   */
 
   if (sub->recipient)
-  {
-    for (;;)
-    {
-      if (sub->pipe < 0)
-	cupsd_start_notifier(sub);
-
-      cupsdLogMessage(CUPSD_LOG_DEBUG2, "sub->pipe=%d", sub->pipe);
-
-      if (sub->pipe < 0)
-	break;
-
-      event->attrs->state = IPP_STATE_IDLE;
-
-      while ((state = ippWriteFile(sub->pipe, event->attrs)) != IPP_STATE_DATA)
-	if (state == IPP_STATE_ERROR)
-	  break;
-
-      if (state == IPP_STATE_ERROR)
-      {
-	if (errno == EPIPE)
-	{
-	 /*
-	  * Notifier died, try restarting it...
-	  */
-
-	  cupsdLogMessage(CUPSD_LOG_WARN,
-			  "Notifier for subscription %d (%s) went away, "
-			  "retrying!",
-			  sub->id, sub->recipient);
-	  cupsdEndProcess(sub->pid, 0);
-
-	  close(sub->pipe);
-	  sub->pipe = -1;
-	  continue;
-	}
-
-	cupsdLogMessage(CUPSD_LOG_ERROR,
-			"Unable to send event for subscription %d (%s)!",
-			sub->id, sub->recipient);
-      }
-
-     /*
-      * If we get this far, break out of the loop...
-      */
-
-      break;
-    }
-  }
+    cupsd_queue_notification(sub, event);
 
  /*
   * Bump the event sequence number...
@@ -1615,6 +1943,52 @@ cupsd_start_notifier(
 }
 
 
+/*
+ * 'cupsd_unindex_subscription()' - Remove a subscription from the event,
+ *                                  printer, and job indices.
+ *
+ * The caller must hold a write lock on SubscriptionsLock.
+ */
+
+static void
+cupsd_unindex_subscription(
+    cupsd_subscription_t *sub)		/* I - Subscription */
+{
+  int	i;				/* Looping var */
+
+
+  if (sub->dest)
+  {
+    cupsArrayRemove(sub->dest->subscriptions, sub);
+
+    if (cupsArrayGetCount(sub->dest->subscriptions) == 0)
+    {
+      cupsArrayDelete(sub->dest->subscriptions);
+      sub->dest->subscriptions = NULL;
+    }
+  }
+  else
+  {
+    for (i = 0; i < CUPSD_EVENT_BITS; i ++)
+    {
+      if (sub->mask & (1 << i))
+        cupsArrayRemove(event_subscriptions[i], sub);
+    }
+  }
+
+  if (sub->job)
+  {
+    cupsArrayRemove(sub->job->subscriptions, sub);
+
+    if (cupsArrayGetCount(sub->job->subscriptions) == 0)
+    {
+      cupsArrayDelete(sub->job->subscriptions);
+      sub->job->subscriptions = NULL;
+    }
+  }
+}
+
+
 /*
  * 'cupsd_update_notifier()' - Read messages from notifiers.
  */
@@ -1636,3 +2010,135 @@ cupsd_update_notifier(void)
       break;
   }
 }
+
+
+/*
+ * 'cupsd_wake_waiters()' - Wake the clients waiting for events from a
+ *                          subscription.
+ *
+ * The responses are sent by cupsdCheckNotifyWaits once control returns to the
+ * main loop.
+ */
+
+static void
+cupsd_wake_waiters(
+    cupsd_subscription_t *sub)		/* I - Subscription */
+{
+  cupsd_client_t	*con;		/* Waiting client */
+  time_t		curtime;	/* Current time */
+
+
+  curtime = time(NULL);
+
+  for (con = (cupsd_client_t *)cupsArrayGetFirst(sub->waiters);
+       con;
+       con = (cupsd_client_t *)cupsArrayGetNext(sub->waiters))
+  {
+    if (con->notify_wait <= curtime)
+      continue;
+
+    cupsArrayRemove(NotifyWaits, con);
+    con->notify_wait = curtime;
+    cupsArrayAdd(NotifyWaits, con);
+  }
+}
+
+
+/*
+ * 'cupsd_write_buffer()' - Add encoded event data to the output buffer.
+ */
+
+static ssize_t				/* O - Bytes added or -1 on error */
+cupsd_write_buffer(
+    cupsd_subscription_t *sub,		/* I - Subscription */
+    ipp_uchar_t		 *buffer,	/* I - Data */
+    size_t		 bytes)		/* I - Number of bytes */
+{
+  if ((sub->output_len + bytes) > sub->output_size)
+  {
+    char	*output;		/* New output buffer */
+    size_t	size;			/* New size */
+
+    for (size = sub->output_size ? sub->output_size : 4096; size < (sub->output_len + bytes); size *= 2);
+
+    if ((output = realloc(sub->output, size)) == NULL)
+      return (-1);
+
+    sub->output      = output;
+    sub->output_size = size;
+  }
+
+  memcpy(sub->output + sub->output_len, buffer, bytes);
+  sub->output_len += bytes;
+
+  return ((ssize_t)bytes);
+}
+
+
+/*
+ * 'cupsd_write_notifier()' - Write buffered events to the notifier.
+ *
+ * When the notifier pipe is full, the rest of the buffer is written once the
+ * pipe is writable again.
+ */
+
+static void
+cupsd_write_notifier(
+    cupsd_subscription_t *sub)		/* I - Subscription */
+{
+  ssize_t	bytes;			/* Bytes written */
+  int		restarted = 0;		/* Restarted the notifier? */
+
+
+  while (sub->pipe >= 0 && sub->output_pos < sub->output_len)
+  {
+    if ((bytes = write(sub->pipe, sub->output + sub->output_pos, sub->output_len - sub->output_pos)) < 0)
+    {
+      if (errno == EINTR)
+        continue;
+
+      if (errno == EAGAIN || errno == EWOULDBLOCK)
+      {
+        cupsdAddSelect(sub->pipe, NULL, (cupsd_selfunc_t)cupsd_write_notifier, sub);
+        return;
+      }
+
+      cupsdRemoveSelect(sub->pipe);
+      close(sub->pipe);
+      sub->pipe = -1;
+
+      if (errno == EPIPE && !restarted)
+      {
+       /*
+	* Notifier died, try restarting it and sending everything again...
+	*/
+
+	cupsdLogMessage(CUPSD_LOG_WARN, "Notifier for subscription %d (%s) went away, retrying!", sub->id, sub->recipient);
+	cupsdEndProcess(sub->pid, 0);
+
+	cupsd_start_notifier(sub);
+
+	sub->output_pos = 0;
+	restarted       = 1;
+	continue;
+      }
+
+      cupsdLogMessage(CUPSD_LOG_ERROR, "Unable to send event for subscription %d (%s)!", sub->id, sub->recipient);
+      break;
+    }
+
+    sub->output_pos += (size_t)bytes;
+  }
+
+  if (sub->pipe >= 0)
+    cupsdRemoveSelect(sub->pipe);
+
+  if (sub->output_dropped)
+  {
+    cupsdLogMessage(CUPSD_LOG_INFO, "Dropped %d event(s) for subscription %d (%s) while the notifier was not reading.", sub->output_dropped, sub->id, sub->recipient);
+    sub->output_dropped = 0;
+  }
+
+  sub->output_len = 0;
+  sub->output_pos = 0;
+}
@@ -70,9 +70,10 @@ typedef enum
 
 typedef struct cupsd_event_s		/**** Event structure ****/
 {
+  int			use;		/* Number of subscriptions using event */
   cupsd_eventmask_t	event;		/* Event */
   time_t		time;		/* Time of event */
-  ipp_t			*attrs;		/* Notification message */
+  ipp_t			*attrs;		/* Common notification attributes */
   cupsd_printer_t	*dest;		/* Associated printer, if any */
   cupsd_job_t		*job;		/* Associated job, if any */
 } cupsd_event_t;
@@ -98,6 +99,13 @@ typedef struct cupsd_subscription_s	/**** Subscription structure ****/
   int			first_event_id,	/* First event-id in cache */
 			next_event_id;	/* Next event-id to use */
   cups_array_t		*events;	/* Cached events */
+  cups_array_t		*waiters;	/* Clients waiting for events */
+  cups_array_t		*pending;	/* Events waiting for the notifier */
+  char			*output;	/* Encoded events for the notifier */
+  size_t		output_size,	/* Size of output buffer */
+			output_len,	/* Bytes in output buffer */
+			output_pos;	/* Bytes written to the notifier */
+  int			output_dropped;	/* Events dropped while the notifier is stalled */
 } cupsd_subscription_t;
 
 
@@ -140,6 +148,9 @@ VAR cupsd_statbuf_t *NotifierStatusBuffer VALUE(NULL);
 
 extern void	cupsdAddEvent(cupsd_eventmask_t event, cupsd_printer_t *dest,
 		              cupsd_job_t *job, const char *text, ...);
+extern void	cupsdAddEventAttrs(ipp_t *ipp, cupsd_subscription_t *sub,
+		                   cupsd_event_t *event, int sequence,
+				   int quickcopy);
 extern cupsd_subscription_t *
 		cupsdAddSubscription(unsigned mask, cupsd_printer_t *dest,
 		                     cupsd_job_t *job, const char *uri,
@@ -157,4 +168,5 @@ extern void	cupsdExpireSubscriptions(cupsd_printer_t *dest,
 		                         cupsd_job_t *job);
 extern void	cupsdLoadAllSubscriptions(void);
 extern void	cupsdSaveAllSubscriptions(void);
+extern void	cupsdSendNotifications(void);
 extern void	cupsdStopAllNotifiers(void);
@@ -52,13 +52,13 @@ cupsdCleanDirty(void)
   {
     cupsd_job_t	*job;			/* Current job */
 
-    cupsdSaveAllJobs();
-
     for (job = (cupsd_job_t *)cupsArrayFirst(Jobs);
          job;
 	 job = (cupsd_job_t *)cupsArrayNext(Jobs))
       if (job->dirty)
         cupsdSaveJob(job);
+
+    cupsdSaveJobJournal();
   }
 
   if (DirtyFiles & CUPSD_DIRTY_SUBSCRIPTIONS)
@@ -955,6 +955,8 @@ sysUpdate(void)
               job->cancel_time = time(NULL) + ippGetInteger(cancel_after, 0);
             else
               job->cancel_time = time(NULL) + MaxJobTime;
+
+            cupsdUpdateJobDeadline(job);
           }
         }
       }
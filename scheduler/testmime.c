@@ -23,11 +23,16 @@
 
 static bool	add_ppd_filter(mime_t *mime, mime_type_t *filtertype, const char *filter);
 static void	add_ppd_filters(mime_t *mime, ppd_file_t *ppd);
+static void	check_type(mime_t *mime, const char *s, const char *expected);
 static void	get_file_types(mime_t *mime, mime_type_t *dst);
 static void	print_rules(mime_magic_t *rules);
+static void	test_cache(void);
 static void	test_filter(mime_t *mime, mime_type_t *src, size_t srcsize, mime_type_t *dst);
+static void	test_filters(void);
+static void	test_rules(void);
 static void	type_dir(mime_t *mime, const char *dirname);
 static mime_type_t *type_file(mime_t *mime, const char *filename);
+static mime_type_t *type_string(mime_t *mime, const char *s);
 
 
 //
@@ -189,6 +194,10 @@ main(int  argc,				// I - Number of command-line args
 
     type_dir(mime, "../doc");
 
+    test_rules();
+    test_filters();
+    test_cache();
+
     // Make sure we have dummy filters for common conversions...
     mimeAddFilter(mime, mimeType(mime, "application", "pdf"), mimeType(mime, "application", "vnd.cups-pdf"), 100, "pdftopdf");
     mimeAddFilter(mime, mimeType(mime, "application", "pdf"), mimeType(mime, "application", "postscript"), 100, "pdftops");
@@ -352,6 +361,48 @@ add_ppd_filters(mime_t     *mime,	// I - MIME database
 }
 
 
+//
+// 'check_type()' - Check the compiled and uncompiled MIME media type of a
+//                  string.
+//
+
+static void
+check_type(mime_t     *mime,		// I - MIME database
+           const char *s,		// I - File contents
+           const char *expected)	// I - Expected type or `NULL` for none
+{
+  mime_type_t	*type,			// Type from compiled rules
+		*utype;			// Type from uncompiled rules
+  cups_file_t	*fp;			// Test file
+  char		filename[1024];		// Test filename
+
+
+  if ((fp = cupsCreateTempFile("testmime", NULL, filename, sizeof(filename))) == NULL)
+  {
+    testEndMessage(false, "%s", cupsGetErrorString());
+    return;
+  }
+
+  cupsFilePuts(fp, s);
+
+  // Pad the file so that "contains" matches are not at the end...
+  cupsFilePuts(fp, "                ");
+  cupsFileClose(fp);
+
+  type  = mimeFileType(mime, filename, NULL, NULL);
+  utype = _mimeFileTypeUncompiled(mime, filename, NULL, NULL);
+
+  unlink(filename);
+
+  if (type != utype)
+    testEndMessage(false, "%s, uncompiled %s", type ? type->type : "none", utype ? utype->type : "none");
+  else if (expected)
+    testEndMessage(type && !strcmp(type->type, expected), "%s", type ? type->type : "none");
+  else
+    testEndMessage(!type, "%s", type ? type->type : "none");
+}
+
+
 //
 // 'get_file_types()' - Get the list of source types for a given destination type.
 //
@@ -546,6 +597,127 @@ print_rules(mime_magic_t *rules)	// I - Rules to print
 }
 
 
+//
+// 'test_cache()' - Test the MIME database cache file.
+//
+
+static void
+test_cache(void)
+{
+  mime_t	*mime;			// MIME database
+  mime_type_t	*type;			// File type
+  cups_file_t	*fp;			// Test file
+  struct stat	info;			// Cache file information
+  ino_t		inode;			// Original cache file inode
+  char		dirname[1024],		// Test directory
+		cachefile[1024],	// Cache file
+		filename[1024];		// Test filename
+
+
+  // Create a directory with some types and filters...
+  testBegin("mimeLoadCache(setup)");
+  if ((fp = cupsCreateTempFile("testmime", NULL, dirname, sizeof(dirname))) == NULL)
+  {
+    testEndMessage(false, "%s", cupsGetErrorString());
+    return;
+  }
+
+  cupsFileClose(fp);
+  unlink(dirname);
+
+  if (mkdir(dirname, 0700))
+  {
+    testEndMessage(false, "%s: %s", dirname, strerror(errno));
+    return;
+  }
+
+  snprintf(cachefile, sizeof(cachefile), "%s/mime.cache", dirname);
+  snprintf(filename, sizeof(filename), "%s/local.types", dirname);
+  fp = cupsFileOpen(filename, "w");
+  cupsFilePuts(fp, "test/a string(0,AB) + (contains(0,64,needle) regex(0,\"[0-9]+\"))\n");
+  cupsFileClose(fp);
+
+  snprintf(filename, sizeof(filename), "%s/local.convs", dirname);
+  fp = cupsFileOpen(filename, "w");
+  cupsFilePuts(fp, "test/a application/octet-stream 10 -\n");
+  cupsFileClose(fp);
+
+  testEnd(true);
+
+  // The first load writes the cache file...
+  testBegin("mimeLoadCache(\"%s\")", dirname);
+  mime = mimeNew();
+  mimeAddType(mime, "application", "octet-stream");
+  mimeLoadCache(mime, cachefile, dirname, dirname);
+
+  if (stat(cachefile, &info))
+  {
+    testEndMessage(false, "%s: %s", cachefile, strerror(errno));
+    mimeDelete(mime);
+    goto cleanup;
+  }
+
+  inode = info.st_ino;
+
+  testEndMessage(mimeNumTypes(mime) == 2 && mimeNumFilters(mime) == 1, "%d types, %d filters", mimeNumTypes(mime), mimeNumFilters(mime));
+  mimeDelete(mime);
+
+  // The second load uses it as-is...
+  testBegin("mimeLoadCache(\"%s\")", dirname);
+  mime = mimeNew();
+  mimeAddType(mime, "application", "octet-stream");
+  mimeLoadCache(mime, cachefile, dirname, dirname);
+
+  if (stat(cachefile, &info))
+    testEndMessage(false, "%s: %s", cachefile, strerror(errno));
+  else if (info.st_ino != inode)
+    testEndMessage(false, "cache file was rewritten");
+  else
+    testEndMessage(mimeNumTypes(mime) == 2 && mimeNumFilters(mime) == 1, "%d types, %d filters", mimeNumTypes(mime), mimeNumFilters(mime));
+
+  // Make sure the cached rules work...
+  testBegin("mimeFileType(\"AB 42\")");
+  type = type_string(mime, "AB 42");
+  testEndMessage(type && !strcmp(type->type, "a"), "%s", type ? type->type : "none");
+
+  mimeDelete(mime);
+
+  // Changing a types file must update the cache...
+  snprintf(filename, sizeof(filename), "%s/local.types", dirname);
+  fp = cupsFileOpen(filename, "a");
+  cupsFilePuts(fp, "test/b string(0,XY)\n");
+  cupsFileClose(fp);
+
+  testBegin("mimeLoadCache(\"%s\")", dirname);
+  mime = mimeNew();
+  mimeAddType(mime, "application", "octet-stream");
+  mimeLoadCache(mime, cachefile, dirname, dirname);
+
+  if (stat(cachefile, &info))
+    testEndMessage(false, "%s: %s", cachefile, strerror(errno));
+  else if (info.st_ino == inode)
+    testEndMessage(false, "cache file was not rewritten");
+  else
+    testEndMessage(mimeNumTypes(mime) == 3 && mimeNumFilters(mime) == 1, "%d types, %d filters", mimeNumTypes(mime), mimeNumFilters(mime));
+
+  testBegin("mimeFileType(\"XY\")");
+  type = type_string(mime, "XY");
+  testEndMessage(type && !strcmp(type->type, "b"), "%s", type ? type->type : "none");
+
+  mimeDelete(mime);
+
+  cleanup:
+
+  // Clean up...
+  snprintf(filename, sizeof(filename), "%s/local.types", dirname);
+  unlink(filename);
+  snprintf(filename, sizeof(filename), "%s/local.convs", dirname);
+  unlink(filename);
+  unlink(cachefile);
+  rmdir(dirname);
+}
+
+
 //
 // 'test_filter()' - Test filtering.
 //
@@ -591,6 +763,229 @@ test_filter(mime_t      *mime,		// I - MIME database
 }
 
 
+//
+// 'test_filters()' - Test the cached filter paths and source types.
+//
+
+static void
+test_filters(void)
+{
+  mime_t	*mime;			// MIME database
+  mime_type_t	*a, *b, *c, *d,		// Source types
+		*p;			// Printer type
+  mime_filter_t	*filter;		// Direct filter
+  cups_array_t	*filters,		// Filters
+		*types;			// Source types
+  int		cost;			// Cost of filters
+
+
+  mime = mimeNew();
+  a    = mimeAddType(mime, "test", "a");
+  b    = mimeAddType(mime, "test", "b");
+  c    = mimeAddType(mime, "test", "c");
+  d    = mimeAddType(mime, "test", "d");
+  p    = mimeAddType(mime, "printer", "test");
+
+  mimeAddFilter(mime, a, b, 10, "atob");
+  mimeAddFilter(mime, b, c, 10, "btoc");
+  mimeAddFilter(mime, c, p, 10, "ctop");
+  if ((filter = mimeAddFilter(mime, a, p, 20, "atop")) != NULL)
+    filter->maxsize = 100;
+
+  // Small files use the direct filter...
+  testBegin("mimeFilter2(test/a, 50, printer/test)");
+  filters = mimeFilter2(mime, a, 50, p, &cost);
+  testEndMessage(cupsArrayGetCount(filters) == 1 && cost == 20, "%d filters, cost %d", (int)cupsArrayGetCount(filters), cost);
+  cupsArrayDelete(filters);
+
+  // Large files go through test/b and test/c...
+  testBegin("mimeFilter2(test/a, 500, printer/test)");
+  filters = mimeFilter2(mime, a, 500, p, &cost);
+  testEndMessage(cupsArrayGetCount(filters) == 3 && cost == 30, "%d filters, cost %d", (int)cupsArrayGetCount(filters), cost);
+  cupsArrayDelete(filters);
+
+  // Adding a filter must update the cached filter paths...
+  testBegin("mimeAddFilter(test/b, printer/test)");
+  testEnd(mimeAddFilter(mime, b, p, 5, "btop") != NULL);
+
+  testBegin("mimeFilter2(test/a, 50, printer/test)");
+  filters = mimeFilter2(mime, a, 50, p, &cost);
+  testEndMessage(cupsArrayGetCount(filters) == 2 && cost == 15, "%d filters, cost %d", (int)cupsArrayGetCount(filters), cost);
+  cupsArrayDelete(filters);
+
+  testBegin("mimeFilter2(test/a, 500, printer/test)");
+  filters = mimeFilter2(mime, a, 500, p, &cost);
+  testEndMessage(cupsArrayGetCount(filters) == 2 && cost == 15, "%d filters, cost %d", (int)cupsArrayGetCount(filters), cost);
+  cupsArrayDelete(filters);
+
+  // So must deleting one...
+  mimeDeleteFilter(mime, mimeFilterLookup(mime, b, p));
+
+  testBegin("mimeDeleteFilter(test/b, printer/test)");
+  testEnd(mimeFilterLookup(mime, b, p) == NULL);
+
+  testBegin("mimeFilter2(test/a, 500, printer/test)");
+  filters = mimeFilter2(mime, a, 500, p, &cost);
+  testEndMessage(cupsArrayGetCount(filters) == 3 && cost == 30, "%d filters, cost %d", (int)cupsArrayGetCount(filters), cost);
+  cupsArrayDelete(filters);
+
+  // The source types include everything that can reach printer/test...
+  testBegin("mimeGetFilterTypes(printer/test)");
+  types = mimeGetFilterTypes(mime, p, NULL);
+  testEndMessage(cupsArrayGetCount(types) == 3, "%d types", (int)cupsArrayGetCount(types));
+  cupsArrayDelete(types);
+
+  // Adding a filter must update the cached source types...
+  testBegin("mimeAddFilter(test/d, test/a)");
+  testEnd(mimeAddFilter(mime, d, a, 10, "dtoa") != NULL);
+
+  testBegin("mimeGetFilterTypes(printer/test)");
+  types = mimeGetFilterTypes(mime, p, NULL);
+  testEndMessage(cupsArrayGetCount(types) == 4 && cupsArrayFind(types, d), "%d types", (int)cupsArrayGetCount(types));
+  cupsArrayDelete(types);
+
+  testBegin("mimeFilter(test/d, printer/test)");
+  filters = mimeFilter(mime, d, p, &cost);
+  testEndMessage(cupsArrayGetCount(filters) == 2 && cost == 30, "%d filters, cost %d", (int)cupsArrayGetCount(filters), cost);
+  cupsArrayDelete(filters);
+
+  mimeDelete(mime);
+}
+
+
+//
+// 'test_rules()' - Test the compiled type detection rules.
+//
+// Every file is also typed without the compiled rules, and both results must
+// match.
+//
+
+static void
+test_rules(void)
+{
+  mime_t	*mime;			// MIME database
+
+
+  testBegin("mimeAddTypeRule(test/...)");
+  mime = mimeNew();
+  testEnd(!mimeAddTypeRule(mimeAddType(mime, "test", "string"), "string(0,AB)") &&
+          !mimeAddTypeRule(mimeAddType(mime, "test", "contains"), "contains(0,64,needle)") &&
+          !mimeAddTypeRule(mimeAddType(mime, "test", "both"), "string(0,AB) + contains(0,64,needle) priority(150)") &&
+          !mimeAddTypeRule(mimeAddType(mime, "test", "istring"), "istring(0,xyz) + !contains(0,64,needle)") &&
+          !mimeAddTypeRule(mimeAddType(mime, "test", "range"), "contains(4,8,xyz)") &&
+          !mimeAddTypeRule(mimeAddType(mime, "test", "char"), "char(0,0x1b) + char(1,E)") &&
+          !mimeAddTypeRule(mimeAddType(mime, "test", "short"), "short(0,0x4d4d)") &&
+          !mimeAddTypeRule(mimeAddType(mime, "test", "shorthigh"), "short(0,0xfffe)") &&
+          !mimeAddTypeRule(mimeAddType(mime, "test", "int"), "int(0,0x89504e47)") &&
+          !mimeAddTypeRule(mimeAddType(mime, "test", "printable"), "string(0,P:) + printable(2,8)") &&
+          !mimeAddTypeRule(mimeAddType(mime, "test", "ascii"), "string(0,A:) + ascii(2,8)") &&
+          !mimeAddTypeRule(mimeAddType(mime, "test", "regex"), "string(0,R:) + regex(2,\"[0-9]+x\")") &&
+          !mimeAddTypeRule(mimeAddType(mime, "test", "or"), "string(0,O1),string(0,O2)") &&
+          !mimeAddTypeRule(mimeAddType(mime, "test", "tree"), "(string(0,T1) + char(2,X)),(string(0,T2) + !char(2,X))") &&
+          !mimeAddTypeRule(mimeAddType(mime, "test", "notfirst"), "!char(0,Z) + string(1,only)"));
+
+  // string, contains, and istring rules...
+  testBegin("mimeFileType(string)");
+  check_type(mime, "AB", "string");
+
+  testBegin("mimeFileType(string + contains)");
+  check_type(mime, "AB needle", "both");
+
+  testBegin("mimeFileType(contains)");
+  check_type(mime, "zz needle", "contains");
+
+  testBegin("mimeFileType(istring)");
+  check_type(mime, "XYZ", "istring");
+
+  testBegin("mimeFileType(istring + !contains)");
+  check_type(mime, "xyz needle", "contains");
+
+  // contains only matches inside its range...
+  testBegin("mimeFileType(contains at start of range)");
+  check_type(mime, "0123xyz", "range");
+
+  testBegin("mimeFileType(contains at end of range)");
+  check_type(mime, "01234567xyz", "range");
+
+  testBegin("mimeFileType(contains after range)");
+  check_type(mime, "0123456789xyz", NULL);
+
+  testBegin("mimeFileType(contains after 64 bytes)");
+  check_type(mime, "0123456789012345678901234567890123456789012345678901234567890needle", NULL);
+
+  // char, short, and int rules...
+  testBegin("mimeFileType(char)");
+  check_type(mime, "\033E", "char");
+
+  testBegin("mimeFileType(char mismatch)");
+  check_type(mime, "\033F", NULL);
+
+  testBegin("mimeFileType(short)");
+  check_type(mime, "MM", "short");
+
+  testBegin("mimeFileType(short with high bit)");
+  check_type(mime, "\377\376", NULL);
+
+  testBegin("mimeFileType(int)");
+  check_type(mime, "\211PNG", "int");
+
+  // printable and ascii rules...
+  testBegin("mimeFileType(printable)");
+  check_type(mime, "P:caf\351 ok", "printable");
+
+  testBegin("mimeFileType(printable mismatch)");
+  check_type(mime, "P:\001\002\003\004\005\006\007", NULL);
+
+  testBegin("mimeFileType(ascii)");
+  check_type(mime, "A:plain ok", "ascii");
+
+  testBegin("mimeFileType(ascii mismatch)");
+  check_type(mime, "A:caf\351 ok", NULL);
+
+  // regex rules...
+  testBegin("mimeFileType(regex)");
+  check_type(mime, "R:123x", "regex");
+
+  testBegin("mimeFileType(regex mismatch)");
+  check_type(mime, "R:abcx", NULL);
+
+  // OR rules and trees...
+  testBegin("mimeFileType(first OR rule)");
+  check_type(mime, "O1", "or");
+
+  testBegin("mimeFileType(second OR rule)");
+  check_type(mime, "O2", "or");
+
+  testBegin("mimeFileType(first AND group)");
+  check_type(mime, "T1X", "tree");
+
+  testBegin("mimeFileType(second AND group)");
+  check_type(mime, "T2Y", "tree");
+
+  testBegin("mimeFileType(first AND group mismatch)");
+  check_type(mime, "T1Y", NULL);
+
+  testBegin("mimeFileType(second AND group mismatch)");
+  check_type(mime, "T2X", NULL);
+
+  // Negated rules can match any first byte...
+  testBegin("mimeFileType(!char)");
+  check_type(mime, "Xonly", "notfirst");
+
+  testBegin("mimeFileType(!char mismatch)");
+  check_type(mime, "Zonly", NULL);
+
+  // Adding a type must update the compiled rules...
+  testBegin("mimeAddTypeRule(test/f)");
+  testEnd(!mimeAddTypeRule(mimeAddType(mime, "test", "f"), "string(0,zz) priority(200)"));
+
+  testBegin("mimeFileType(\"zz needle\")");
+  check_type(mime, "zz needle", "f");
+
+  mimeDelete(mime);
+}
+
+
 //
 // 'type_dir()' - Show the MIME types for a given directory.
 //
@@ -649,3 +1044,32 @@ type_file(mime_t     *mime,		// I - MIME database
 
   return (src);
 }
+
+//
+// 'type_string()' - Determine the MIME media type of a string.
+//
+
+static mime_type_t *			// O - MIME media type or `NULL`
+type_string(mime_t     *mime,		// I - MIME database
+            const char *s)		// I - File contents
+{
+  mime_type_t	*type;			// MIME type
+  cups_file_t	*fp;			// Test file
+  char		filename[1024];		// Test filename
+
+
+  if ((fp = cupsCreateTempFile("testmime", NULL, filename, sizeof(filename))) == NULL)
+    return (NULL);
+
+  cupsFilePuts(fp, s);
+
+  // Pad the file so that "contains" matches are not at the end...
+  cupsFilePuts(fp, "                ");
+  cupsFileClose(fp);
+
+  type = mimeFileType(mime, filename, NULL, NULL);
+
+  unlink(filename);
+
+  return (type);
+}
@@ -0,0 +1,299 @@
+//
+// Select benchmark for the CUPS scheduler.
+//
+// Copyright © 2026 by OpenPrinting.
+//
+// Licensed under Apache License v2.0.  See the file "LICENSE" for more information.
+//
+// Usage:
+//
+//   ./testselect [-c CONNECTIONS] [-l LOOPS] [-r READY] [BACKEND ...]
+//
+// Each loop writes a byte to READY of the CONNECTIONS socket pairs and then
+// calls cupsdDoSelect() until the read callbacks have read all of them.  The
+// default is to compare the "poll", "epoll", and "io_uring" backends.  Each
+// backend is also checked to make sure that removing and closing a file
+// descriptor closes the connection.
+//
+
+#define _MAIN_C_
+#include "cupsd.h"
+#include <sys/resource.h>
+#include <sys/socket.h>
+
+
+//
+// Local globals...
+//
+
+static int	num_pairs = 0;		// Number of socket pairs
+static int	(*pairs)[2] = NULL;	// Socket pairs
+static int	num_read = 0;		// Number of bytes read
+
+
+//
+// Local functions...
+//
+
+static void	read_cb(void *data);
+static int	run_test(const char *backend, int loops, int ready);
+static int	test_remove(const char *backend);
+static void	usage(void) _CUPS_NORETURN;
+
+
+//
+// 'main()' - Time cupsdDoSelect() with each backend.
+//
+
+int					// O - Exit status
+main(int  argc,				// I - Number of command-line arguments
+     char *argv[])			// I - Command-line arguments
+{
+  int		i,			// Looping var
+		loops = 1000,		// Number of loops
+		ready = 10,		// Number of ready connections per loop
+		num_backends = 0,	// Number of backends
+		status = 0;		// Exit status
+  const char	*backends[10];		// Backends to test
+  struct rlimit	limit;			// File descriptor limit
+
+
+  num_pairs = 1000;
+
+  for (i = 1; i < argc; i ++)
+  {
+    if (!strcmp(argv[i], "-c"))
+    {
+      if (++ i >= argc || (num_pairs = atoi(argv[i])) < 1)
+        usage();
+    }
+    else if (!strcmp(argv[i], "-l"))
+    {
+      if (++ i >= argc || (loops = atoi(argv[i])) < 1)
+        usage();
+    }
+    else if (!strcmp(argv[i], "-r"))
+    {
+      if (++ i >= argc || (ready = atoi(argv[i])) < 1)
+        usage();
+    }
+    else if (argv[i][0] == '-' || num_backends >= (int)(sizeof(backends) / sizeof(backends[0])))
+      usage();
+    else
+      backends[num_backends ++] = argv[i];
+  }
+
+  if (num_backends == 0)
+  {
+    backends[num_backends ++] = "poll";
+    backends[num_backends ++] = "epoll";
+    backends[num_backends ++] = "io_uring";
+  }
+
+  if (ready > num_pairs)
+    ready = num_pairs;
+
+  // Create the socket pairs...
+  getrlimit(RLIMIT_NOFILE, &limit);
+  if (limit.rlim_cur < (rlim_t)(2 * num_pairs + 64) && limit.rlim_max >= (rlim_t)(2 * num_pairs + 64))
+  {
+    limit.rlim_cur = (rlim_t)(2 * num_pairs + 64);
+    setrlimit(RLIMIT_NOFILE, &limit);
+  }
+
+  MaxFDs = 2 * num_pairs + 64;
+
+  if ((pairs = calloc((size_t)num_pairs, sizeof(pairs[0]))) == NULL)
+  {
+    perror("testselect: Unable to allocate socket pairs");
+    return (1);
+  }
+
+  for (i = 0; i < num_pairs; i ++)
+  {
+    if (socketpair(AF_LOCAL, SOCK_STREAM, 0, pairs[i]))
+    {
+      fprintf(stderr, "testselect: Unable to create socket pair %d: %s\n", i + 1, strerror(errno));
+      return (1);
+    }
+  }
+
+  printf("testselect: %d connections, %d loops, %d ready connections per loop\n", num_pairs, loops, ready);
+
+  // Run the tests...
+  for (i = 0; i < num_backends; i ++)
+  {
+    if (run_test(backends[i], loops, ready) || test_remove(backends[i]))
+      status = 1;
+  }
+
+  return (status);
+}
+
+
+//
+// 'cupsdLogMessage()' - Log a message (stub).
+//
+
+int					// O - 1 on success, 0 on error
+cupsdLogMessage(int        level,	// I - Log level
+                const char *message,	// I - printf-style message string
+		...)			// I - Additional args as needed
+{
+  va_list	ap;			// Argument pointer
+
+
+  if (level > CUPSD_LOG_DEBUG)
+    return (1);
+
+  va_start(ap, message);
+  fputs("    ", stdout);
+  vprintf(message, ap);
+  putchar('\n');
+  va_end(ap);
+
+  return (1);
+}
+
+
+//
+// 'read_cb()' - Read a byte from a socket.
+//
+
+static void
+read_cb(void *data)			// I - Socket pair
+{
+  int	*pair = (int *)data;		// Socket pair
+  char	buffer[256];			// Read buffer
+  ssize_t bytes;			// Bytes read
+
+
+  if ((bytes = read(pair[0], buffer, sizeof(buffer))) > 0)
+    num_read += (int)bytes;
+}
+
+
+//
+// 'run_test()' - Time a backend.
+//
+
+static int				// O - 0 on success, 1 on error
+run_test(const char *backend,		// I - Backend name
+         int        loops,		// I - Number of loops
+	 int        ready)		// I - Number of ready connections per loop
+{
+  int		i,			// Looping var
+		loop,			// Current loop
+		calls = 0;		// Number of cupsdDoSelect calls
+  double	start,			// Start time
+		end;			// End time
+
+
+  printf("%s:\n", backend);
+
+  cupsdStartSelect(backend);
+
+  for (i = 0; i < num_pairs; i ++)
+    cupsdAddSelect(pairs[i][0], read_cb, NULL, pairs[i]);
+
+  start    = cupsGetClock();
+  num_read = 0;
+
+  for (loop = 0; loop < loops; loop ++)
+  {
+    for (i = 0; i < ready; i ++)
+    {
+      if (write(pairs[(loop * ready + i) % num_pairs][1], "", 1) < 0)
+      {
+        perror("testselect: Unable to write");
+        break;
+      }
+    }
+
+    while (num_read < (loop + 1) * ready)
+    {
+      calls ++;
+
+      if (cupsdDoSelect(1) < 0)
+      {
+        printf("    FAIL (cupsdDoSelect: %s)\n", strerror(errno));
+        cupsdStopSelect();
+        return (1);
+      }
+    }
+  }
+
+  end = cupsGetClock();
+
+  for (i = 0; i < num_pairs; i ++)
+    cupsdRemoveSelect(pairs[i][0]);
+
+  cupsdStopSelect();
+
+  printf("    %d events in %.3f seconds, %d cupsdDoSelect calls, %.1f us/call, %.0f events/s\n", num_read, end - start, calls, 1000000.0 * (end - start) / calls, num_read / (end - start));
+
+  return (0);
+}
+
+
+//
+// 'test_remove()' - Make sure a removed and closed file descriptor is closed.
+//
+
+static int				// O - 0 on success, 1 on error
+test_remove(const char *backend)	// I - Backend name
+{
+  int		pair[2];		// Socket pair
+  char		buffer[256];		// Read buffer
+  ssize_t	bytes;			// Bytes read
+  int		status = 0;		// Return status
+
+
+  if (socketpair(AF_LOCAL, SOCK_STREAM, 0, pair))
+  {
+    printf("    FAIL (socketpair: %s)\n", strerror(errno));
+    return (1);
+  }
+
+  fcntl(pair[1], F_SETFL, O_NONBLOCK);
+
+  cupsdStartSelect(backend);
+
+  // Add the socket and let the backend start watching it...
+  cupsdAddSelect(pair[0], read_cb, NULL, pair);
+
+  if (cupsdDoSelect(0) < 0)
+    status = 1;
+
+  // Then remove and close it; the peer must see end-of-file...
+  cupsdRemoveSelect(pair[0]);
+  close(pair[0]);
+
+  if (status)
+    printf("    remove: FAIL (%s)\n", strerror(errno));
+  else if ((bytes = read(pair[1], buffer, sizeof(buffer))) != 0)
+  {
+    printf("    remove: FAIL (read returned %d: %s)\n", (int)bytes, bytes < 0 ? strerror(errno) : "data");
+    status = 1;
+  }
+  else
+    puts("    remove: PASS");
+
+  cupsdStopSelect();
+
+  close(pair[1]);
+
+  return (status);
+}
+
+
+//
+// 'usage()' - Show program usage.
+//
+
+static void
+usage(void)
+{
+  puts("Usage: ./testselect [-c CONNECTIONS] [-l LOOPS] [-r READY] [BACKEND ...]");
+  exit(1);
+}
@@ -0,0 +1,542 @@
+//
+// Streamed Print-Job test program for the CUPS scheduler.
+//
+// Copyright © 2026 by OpenPrinting.
+//
+// Licensed under Apache License v2.0.  See the file "LICENSE" for more information.
+//
+// Usage:
+//
+//   ./teststream [PRINTER]
+//
+// The scheduler must be running with "StreamJobs Yes".  A generic PostScript
+// queue called PRINTER ("Stream" by default) that prints to /dev/null is
+// added, printed to, and then deleted.  The tests cover a Print-Job request
+// that goes over the printer's quota while the document is received (the job
+// must be aborted), one that completes normally, one that is truncated before
+// the whole document has been sent (the job must be aborted), and one with an
+// HTTP error that must only be sent once the whole document has been received.
+//
+
+#include <cups/cups.h>
+#include <cups/test-internal.h>
+#include <cups/string-private.h>
+
+
+//
+// Constants...
+//
+
+#define TEST_LENGTH	262144		// Length of test document
+#define TEST_PARTIAL	65536		// Bytes sent for truncated document
+#define TEST_QUOTA	128		// "job-k-limit" for over-quota document
+
+
+//
+// Local functions...
+//
+
+static bool		add_printer(http_t *http, const char *printer, const char *auth_info_required, int k_limit);
+static bool		delete_printer(http_t *http, const char *printer);
+static int		find_job(http_t *http, const char *printer, const char *name);
+static ipp_t		*new_print_job(const char *printer, const char *name);
+static http_status_t	send_print_job(http_t *http, const char *printer, ipp_t *request, size_t bytes, bool *deferred, ipp_t **response);
+static ipp_jstate_t	wait_job(http_t *http, int job_id, int *koctets);
+static void		wait_printer(http_t *http, const char *printer);
+
+
+//
+// 'main()' - Test streamed Print-Job requests.
+//
+
+int					// O - Exit status
+main(int  argc,				// I - Number of command-line arguments
+     char *argv[])			// I - Command-line arguments
+{
+  const char	*printer = "Stream";	// Printer name
+  http_t	*http,			// Connection to scheduler
+		*other;			// Connection for aborted documents
+  http_status_t	status;			// HTTP status
+  ipp_t		*response;		// IPP response
+  ipp_jstate_t	state;			// Job state
+  int		i,			// Looping var
+		job_id,			// Job ID
+		koctets;		// job-k-octets value
+  bool		deferred,		// Was the error sent after the document?
+		ret = true;		// Return value
+
+
+  if (argc > 2 || (argc == 2 && argv[1][0] == '-'))
+  {
+    puts("Usage: ./teststream [PRINTER]");
+    return (1);
+  }
+  else if (argc == 2)
+    printer = argv[1];
+
+  testBegin("httpConnect2(%s:%d)", cupsGetServer(), ippGetPort());
+  if ((http = httpConnect2(cupsGetServer(), ippGetPort(), NULL, AF_UNSPEC, cupsGetEncryption(), 1, 30000, NULL)) == NULL)
+  {
+    testEndMessage(false, "%s", cupsGetErrorString());
+    return (1);
+  }
+  testEnd(true);
+
+  testBegin("CUPS-Add-Modify-Printer(%s)", printer);
+  if (!add_printer(http, printer, "none", TEST_QUOTA))
+  {
+    testEndMessage(false, "%s", cupsGetErrorString());
+    httpClose(http);
+    return (1);
+  }
+  testEnd(true);
+
+  // Over-quota document, run first since the printer has no jobs to count
+  // against the quota yet...
+  testBegin("Print-Job(teststream-quota)");
+  if ((other = httpConnect2(cupsGetServer(), ippGetPort(), NULL, AF_UNSPEC, cupsGetEncryption(), 1, 30000, NULL)) == NULL)
+  {
+    testEndMessage(false, "%s", cupsGetErrorString());
+    ret = false;
+  }
+  else
+  {
+    status = send_print_job(other, printer, new_print_job(printer, "teststream-quota"), TEST_LENGTH, NULL, NULL);
+    httpClose(other);
+
+    if (status != HTTP_STATUS_REQUEST_TOO_LARGE)
+    {
+      testEndMessage(false, "Got %s, expected %s", httpStatusString(status), httpStatusString(HTTP_STATUS_REQUEST_TOO_LARGE));
+      ret = false;
+    }
+    else if ((job_id = find_job(http, printer, "teststream-quota")) <= 0)
+    {
+      testEndMessage(false, "Job not found");
+      ret = false;
+    }
+    else if ((state = wait_job(http, job_id, NULL)) != IPP_JSTATE_ABORTED)
+    {
+      testEndMessage(false, "job-state is %s, expected aborted", ippEnumString("job-state", (int)state));
+      ret = false;
+    }
+    else
+    {
+      testEndMessage(true, "job %d", job_id);
+    }
+  }
+
+  testBegin("CUPS-Add-Modify-Printer(%s)", printer);
+  wait_printer(http, printer);
+  if (!add_printer(http, printer, "none", 0))
+  {
+    testEndMessage(false, "%s", cupsGetErrorString());
+    ret = false;
+  }
+  else
+  {
+    testEnd(true);
+  }
+
+  // Complete document...
+  testBegin("Print-Job(teststream-complete)");
+  status = send_print_job(http, printer, new_print_job(printer, "teststream-complete"), TEST_LENGTH, &deferred, &response);
+  if (status != HTTP_STATUS_OK || ippGetStatusCode(response) != IPP_STATUS_OK)
+  {
+    testEndMessage(false, "%s, %s", httpStatusString(status), response ? ippErrorString(ippGetStatusCode(response)) : "no response");
+    ret = false;
+  }
+  else if ((job_id = ippGetInteger(ippFindAttribute(response, "job-id", IPP_TAG_INTEGER), 0)) <= 0)
+  {
+    testEndMessage(false, "No job-id in response");
+    ret = false;
+  }
+  else if ((state = wait_job(http, job_id, &koctets)) != IPP_JSTATE_COMPLETED)
+  {
+    testEndMessage(false, "job-state is %s, expected completed", ippEnumString("job-state", (int)state));
+    ret = false;
+  }
+  else if (koctets != TEST_LENGTH / 1024)
+  {
+    testEndMessage(false, "job-k-octets is %d, expected %d", koctets, TEST_LENGTH / 1024);
+    ret = false;
+  }
+  else
+  {
+    testEndMessage(true, "job %d", job_id);
+  }
+
+  ippDelete(response);
+
+  // Truncated document...
+  testBegin("Print-Job(teststream-truncated)");
+  if ((other = httpConnect2(cupsGetServer(), ippGetPort(), NULL, AF_UNSPEC, cupsGetEncryption(), 1, 30000, NULL)) == NULL)
+  {
+    testEndMessage(false, "%s", cupsGetErrorString());
+    ret = false;
+  }
+  else
+  {
+    send_print_job(other, printer, new_print_job(printer, "teststream-truncated"), TEST_PARTIAL, NULL, NULL);
+    httpClose(other);
+
+    for (i = 0; i < 30 && (job_id = find_job(http, printer, "teststream-truncated")) <= 0; i ++)
+      sleep(1);
+
+    if (job_id <= 0)
+    {
+      testEndMessage(false, "Job not found");
+      ret = false;
+    }
+    else if ((state = wait_job(http, job_id, NULL)) != IPP_JSTATE_ABORTED)
+    {
+      testEndMessage(false, "job-state is %s, expected aborted", ippEnumString("job-state", (int)state));
+      ret = false;
+    }
+    else
+    {
+      testEndMessage(true, "job %d", job_id);
+    }
+  }
+
+  // Deferred HTTP error, "negotiate" authentication requires a username...
+  testBegin("Print-Job(teststream-unauthorized)");
+  wait_printer(http, printer);
+  if (!add_printer(http, printer, "negotiate", 0))
+  {
+    testEndMessage(false, "%s", cupsGetErrorString());
+    ret = false;
+  }
+  else if ((status = send_print_job(http, printer, new_print_job(printer, "teststream-unauthorized"), TEST_LENGTH, &deferred, &response)) != HTTP_STATUS_UNAUTHORIZED)
+  {
+    testEndMessage(false, "Got %s, expected %s", httpStatusString(status), httpStatusString(HTTP_STATUS_UNAUTHORIZED));
+    ret = false;
+  }
+  else if (!deferred)
+  {
+    testEndMessage(false, "Error sent before the document was received");
+    ret = false;
+  }
+  else
+  {
+    testEnd(true);
+  }
+
+  ippDelete(response);
+
+  // Clean up...
+  testBegin("CUPS-Delete-Printer(%s)", printer);
+  httpClose(http);
+
+  if ((http = httpConnect2(cupsGetServer(), ippGetPort(), NULL, AF_UNSPEC, cupsGetEncryption(), 1, 30000, NULL)) == NULL || !delete_printer(http, printer))
+  {
+    testEndMessage(false, "%s", cupsGetErrorString());
+    ret = false;
+  }
+  else
+  {
+    testEnd(true);
+  }
+
+  httpClose(http);
+
+  return (ret ? 0 : 1);
+}
+
+
+//
+// 'add_printer()' - Add or modify the test printer.
+//
+
+static bool				// O - `true` on success, `false` on error
+add_printer(
+    http_t     *http,			// I - Connection to scheduler
+    const char *printer,		// I - Printer name
+    const char *auth_info_required,	// I - Value for "auth-info-required"
+    int        k_limit)			// I - Value for "job-k-limit"
+{
+  ipp_t		*request;		// IPP request
+  char		uri[HTTP_MAX_URI];	// Printer URI
+
+
+  httpAssembleURIf(HTTP_URI_CODING_ALL, uri, sizeof(uri), "ipp", NULL, "localhost", ippGetPort(), "/printers/%s", printer);
+
+  request = ippNewRequest(IPP_OP_CUPS_ADD_MODIFY_PRINTER);
+  ippAddString(request, IPP_TAG_OPERATION, IPP_TAG_URI, "printer-uri", NULL, uri);
+  ippAddString(request, IPP_TAG_OPERATION, IPP_TAG_NAME, "requesting-user-name", NULL, cupsGetUser());
+  ippAddString(request, IPP_TAG_OPERATION, IPP_TAG_NAME, "ppd-name", NULL, "drv:///sample.drv/generic.ppd");
+  ippAddString(request, IPP_TAG_PRINTER, IPP_TAG_URI, "device-uri", NULL, "file:///dev/null");
+  ippAddString(request, IPP_TAG_PRINTER, IPP_TAG_KEYWORD, "auth-info-required", NULL, auth_info_required);
+  ippAddInteger(request, IPP_TAG_PRINTER, IPP_TAG_INTEGER, "job-k-limit", k_limit);
+  ippAddBoolean(request, IPP_TAG_PRINTER, "printer-is-accepting-jobs", 1);
+  ippAddInteger(request, IPP_TAG_PRINTER, IPP_TAG_ENUM, "printer-state", IPP_PSTATE_IDLE);
+
+  ippDelete(cupsDoRequest(http, request, "/admin/"));
+
+  return (cupsGetError() == IPP_STATUS_OK);
+}
+
+
+//
+// 'delete_printer()' - Delete the test printer and its jobs.
+//
+
+static bool				// O - `true` on success, `false` on error
+delete_printer(http_t     *http,	// I - Connection to scheduler
+               const char *printer)	// I - Printer name
+{
+  ipp_t		*request;		// IPP request
+  char		uri[HTTP_MAX_URI];	// Printer URI
+
+
+  httpAssembleURIf(HTTP_URI_CODING_ALL, uri, sizeof(uri), "ipp", NULL, "localhost", ippGetPort(), "/printers/%s", printer);
+
+  request = ippNewRequest(IPP_OP_CUPS_DELETE_PRINTER);
+  ippAddString(request, IPP_TAG_OPERATION, IPP_TAG_URI, "printer-uri", NULL, uri);
+  ippAddString(request, IPP_TAG_OPERATION, IPP_TAG_NAME, "requesting-user-name", NULL, cupsGetUser());
+
+  ippDelete(cupsDoRequest(http, request, "/admin/"));
+
+  return (cupsGetError() == IPP_STATUS_OK);
+}
+
+
+//
+// 'find_job()' - Find a job by name.
+//
+
+static int				// O - Job ID or 0 if not found
+find_job(http_t     *http,		// I - Connection to scheduler
+         const char *printer,		// I - Printer name
+         const char *name)		// I - Job name
+{
+  ipp_t			*request,	// IPP request
+			*response;	// IPP response
+  ipp_attribute_t	*attr;		// Current attribute
+  int			job_id,		// Current job ID
+			found = 0;	// Matching job ID
+  bool			matched;	// Does the job-name match?
+  char			uri[HTTP_MAX_URI];
+					// Printer URI
+  static const char * const requested[] =
+  {					// Requested attributes
+    "job-id",
+    "job-name"
+  };
+
+
+  httpAssembleURIf(HTTP_URI_CODING_ALL, uri, sizeof(uri), "ipp", NULL, "localhost", ippGetPort(), "/printers/%s", printer);
+
+  request = ippNewRequest(IPP_OP_GET_JOBS);
+  ippAddString(request, IPP_TAG_OPERATION, IPP_TAG_URI, "printer-uri", NULL, uri);
+  ippAddString(request, IPP_TAG_OPERATION, IPP_TAG_NAME, "requesting-user-name", NULL, cupsGetUser());
+  ippAddString(request, IPP_TAG_OPERATION, IPP_TAG_KEYWORD, "which-jobs", NULL, "all");
+  ippAddStrings(request, IPP_TAG_OPERATION, IPP_TAG_KEYWORD, "requested-attributes", (int)(sizeof(requested) / sizeof(requested[0])), NULL, requested);
+
+  response = cupsDoRequest(http, request, "/");
+
+  for (attr = ippGetFirstAttribute(response); attr; attr = ippGetNextAttribute(response))
+  {
+    // Skip to the next job...
+    while (attr && ippGetGroupTag(attr) != IPP_TAG_JOB)
+      attr = ippGetNextAttribute(response);
+
+    if (!attr)
+      break;
+
+    // Get the job-id and job-name attributes for this job...
+    for (job_id = 0, matched = false; attr && ippGetGroupTag(attr) == IPP_TAG_JOB; attr = ippGetNextAttribute(response))
+    {
+      if (!strcmp(ippGetName(attr), "job-id"))
+        job_id = ippGetInteger(attr, 0);
+      else if (!strcmp(ippGetName(attr), "job-name"))
+        matched = !strcmp(ippGetString(attr, 0, NULL), name);
+    }
+
+    if (matched)
+      found = job_id;
+  }
+
+  ippDelete(response);
+
+  return (found);
+}
+
+
+//
+// 'new_print_job()' - Create a Print-Job request for the test printer.
+//
+
+static ipp_t *				// O - IPP request
+new_print_job(const char *printer,	// I - Printer name
+              const char *name)		// I - Job name
+{
+  ipp_t		*request;		// IPP request
+  char		uri[HTTP_MAX_URI];	// Printer URI
+
+
+  httpAssembleURIf(HTTP_URI_CODING_ALL, uri, sizeof(uri), "ipp", NULL, "localhost", ippGetPort(), "/printers/%s", printer);
+
+  request = ippNewRequest(IPP_OP_PRINT_JOB);
+  ippAddString(request, IPP_TAG_OPERATION, IPP_TAG_URI, "printer-uri", NULL, uri);
+  ippAddString(request, IPP_TAG_OPERATION, IPP_TAG_NAME, "requesting-user-name", NULL, cupsGetUser());
+  ippAddString(request, IPP_TAG_OPERATION, IPP_TAG_NAME, "job-name", NULL, name);
+  ippAddString(request, IPP_TAG_OPERATION, IPP_TAG_MIMETYPE, "document-format", NULL, "application/postscript");
+
+  return (request);
+}
+
+
+//
+// 'send_print_job()' - Send a Print-Job request with a TEST_LENGTH byte
+//                      document.
+//
+// Only "bytes" bytes of the document are sent.  The response is only read when
+// the whole document has been sent.
+//
+
+static http_status_t			// O - HTTP status
+send_print_job(http_t     *http,	// I - Connection to scheduler
+               const char *printer,	// I - Printer name
+               ipp_t      *request,	// I - IPP request
+               size_t     bytes,	// I - Number of document bytes to send
+               bool       *deferred,	// O - `true` if the whole document was accepted
+               ipp_t      **response)	// O - IPP response
+{
+  http_status_t	status;			// HTTP status
+  char		resource[256],		// Printer resource
+		buffer[8192];		// Document data
+  size_t	i,			// Looping var
+		sent;			// Bytes sent
+
+
+  if (deferred)
+    *deferred = false;
+  if (response)
+    *response = NULL;
+
+  // The document is a PostScript program that only contains comments...
+  for (i = 0; i < sizeof(buffer); i ++)
+    buffer[i] = (i & 63) == 0 ? '%' : (i & 63) == 63 ? '\n' : (char)('A' + i % 26);
+
+  snprintf(resource, sizeof(resource), "/printers/%s", printer);
+
+  status = cupsSendRequest(http, request, resource, ippGetLength(request) + TEST_LENGTH);
+  ippDelete(request);
+
+  for (sent = 0; status == HTTP_STATUS_CONTINUE && sent < bytes; sent += sizeof(buffer))
+    status = cupsWriteRequestData(http, buffer, sizeof(buffer));
+
+  if (sent < TEST_LENGTH)
+    return (status);
+
+  if (status == HTTP_STATUS_CONTINUE && deferred)
+    *deferred = true;
+
+  while (status == HTTP_STATUS_CONTINUE)
+    status = httpUpdate(http);
+
+  if (status == HTTP_STATUS_OK && response)
+  {
+    *response = ippNew();
+
+    if (ippRead(http, *response) != IPP_STATE_DATA)
+    {
+      ippDelete(*response);
+      *response = NULL;
+    }
+  }
+  else
+  {
+    httpFlush(http);
+  }
+
+  return (status);
+}
+
+
+//
+// 'wait_job()' - Wait up to 30 seconds for a job to finish.
+//
+
+static ipp_jstate_t			// O - Job state
+wait_job(http_t *http,			// I - Connection to scheduler
+         int    job_id,			// I - Job ID
+         int    *koctets)		// O - "job-k-octets" value
+{
+  ipp_t		*request,		// IPP request
+		*response;		// IPP response
+  ipp_jstate_t	state = IPP_JSTATE_PENDING;
+					// Job state
+  int		i;			// Looping var
+  char		uri[HTTP_MAX_URI];	// Job URI
+  static const char * const requested[] =
+  {					// Requested attributes
+    "job-k-octets",
+    "job-state"
+  };
+
+
+  httpAssembleURIf(HTTP_URI_CODING_ALL, uri, sizeof(uri), "ipp", NULL, "localhost", ippGetPort(), "/jobs/%d", job_id);
+
+  for (i = 0; i < 30 && state < IPP_JSTATE_CANCELED; i ++)
+  {
+    if (i)
+      sleep(1);
+
+    request = ippNewRequest(IPP_OP_GET_JOB_ATTRIBUTES);
+    ippAddString(request, IPP_TAG_OPERATION, IPP_TAG_URI, "job-uri", NULL, uri);
+    ippAddString(request, IPP_TAG_OPERATION, IPP_TAG_NAME, "requesting-user-name", NULL, cupsGetUser());
+    ippAddStrings(request, IPP_TAG_OPERATION, IPP_TAG_KEYWORD, "requested-attributes", (int)(sizeof(requested) / sizeof(requested[0])), NULL, requested);
+
+    response = cupsDoRequest(http, request, "/");
+    state    = (ipp_jstate_t)ippGetInteger(ippFindAttribute(response, "job-state", IPP_TAG_ENUM), 0);
+
+    if (koctets)
+      *koctets = ippGetInteger(ippFindAttribute(response, "job-k-octets", IPP_TAG_INTEGER), 0);
+
+    ippDelete(response);
+  }
+
+  return (state);
+}
+
+
+//
+// 'wait_printer()' - Wait up to 30 seconds for the printer to stop processing.
+//
+// Modifying a printer restarts its current job, even an aborted job whose
+// filters have not exited yet.
+//
+
+static void
+wait_printer(http_t     *http,		// I - Connection to scheduler
+             const char *printer)	// I - Printer name
+{
+  ipp_t		*request,		// IPP request
+		*response;		// IPP response
+  ipp_pstate_t	state;			// Printer state
+  int		i;			// Looping var
+  char		uri[HTTP_MAX_URI];	// Printer URI
+
+
+  httpAssembleURIf(HTTP_URI_CODING_ALL, uri, sizeof(uri), "ipp", NULL, "localhost", ippGetPort(), "/printers/%s", printer);
+
+  for (i = 0; i < 30; i ++)
+  {
+    if (i)
+      sleep(1);
+
+    request = ippNewRequest(IPP_OP_GET_PRINTER_ATTRIBUTES);
+    ippAddString(request, IPP_TAG_OPERATION, IPP_TAG_URI, "printer-uri", NULL, uri);
+    ippAddString(request, IPP_TAG_OPERATION, IPP_TAG_NAME, "requesting-user-name", NULL, cupsGetUser());
+    ippAddString(request, IPP_TAG_OPERATION, IPP_TAG_KEYWORD, "requested-attributes", NULL, "printer-state");
+
+    response = cupsDoRequest(http, request, "/");
+    state    = (ipp_pstate_t)ippGetInteger(ippFindAttribute(response, "printer-state", IPP_TAG_ENUM), 0);
+
+    ippDelete(response);
+
+    if (state != IPP_PSTATE_PROCESSING)
+      break;
+  }
+}
@@ -0,0 +1,327 @@
+/*
+ * Job trace routines for the CUPS scheduler.
+ *
+ * Copyright © 2026 by OpenPrinting.
+ *
+ * Licensed under Apache License v2.0.  See the file "LICENSE" for more
+ * information.
+ *
+ * Job traces record when each stage of a job ran - spooling, auto-typing,
+ * filter planning, starting the job, and each filter and backend process -
+ * and are written to "RequestRoot/tNNNNN.json" in the Chrome trace-event
+ * format so they can be loaded into a trace viewer.
+ */
+
+/*
+ * Include necessary headers...
+ */
+
+#include "cupsd.h"
+
+
+/*
+ * Local types...
+ */
+
+typedef struct cupsd_tracespan_s	/**** Job trace span ****/
+{
+  char		phase;			/* 'B' = open, 'X' = complete,
+					 * 'i' = instant */
+  const char	*cat;			/* Category */
+  char		*name,			/* Name of span */
+		*message;		/* Message or NULL */
+  int		tid;			/* Thread (process) ID, 0 for cupsd */
+  double	start,			/* Start time in seconds */
+		end;			/* End time in seconds */
+} cupsd_tracespan_t;
+
+
+/*
+ * Local functions...
+ */
+
+static cups_json_t	*add_event(cups_json_t *events, cups_json_t *after,
+			           int id, cupsd_tracespan_t *span, double now);
+static void		add_span(cupsd_job_t *job, char phase, const char *cat,
+			         const char *name, int tid, double start,
+				 double end, const char *message);
+
+
+/*
+ * 'cupsdAddJobTrace()' - Add a completed span or instant event to a job trace.
+ *
+ * An "end" time of 0.0 records an instant event at the "start" time.
+ */
+
+void
+cupsdAddJobTrace(cupsd_job_t *job,	/* I - Job */
+                 const char  *cat,	/* I - Category */
+		 const char  *name,	/* I - Name of span */
+		 int         tid,	/* I - Process ID or 0 for cupsd */
+		 double      start,	/* I - Start time */
+		 double      end,	/* I - End time or 0.0 for an instant */
+		 const char  *message)	/* I - Message or NULL */
+{
+  add_span(job, end > 0.0 ? 'X' : 'i', cat, name, tid, start, end, message);
+}
+
+
+/*
+ * 'cupsdBeginJobTrace()' - Start a span in a job trace.
+ */
+
+void
+cupsdBeginJobTrace(cupsd_job_t *job,	/* I - Job */
+                   const char  *cat,	/* I - Category */
+		   const char  *name,	/* I - Name of span */
+		   int         tid)	/* I - Process ID or 0 for cupsd */
+{
+  add_span(job, 'B', cat, name, tid, cupsGetClock(), 0.0, NULL);
+}
+
+
+/*
+ * 'cupsdEndJobTrace()' - End the most recent open span for a process.
+ */
+
+void
+cupsdEndJobTrace(cupsd_job_t *job,	/* I - Job */
+                 int         tid)	/* I - Process ID or 0 for cupsd */
+{
+  cupsd_tracespan_t	*span;		/* Current span */
+
+
+  if (!job->trace)
+    return;
+
+  for (span = (cupsd_tracespan_t *)cupsArrayLast(job->trace);
+       span;
+       span = (cupsd_tracespan_t *)cupsArrayPrev(job->trace))
+  {
+    if (span->phase == 'B' && span->tid == tid)
+    {
+      span->phase = 'X';
+      span->end   = cupsGetClock();
+      break;
+    }
+  }
+}
+
+
+/*
+ * 'cupsdFreeJobTrace()' - Free the trace for a job.
+ */
+
+void
+cupsdFreeJobTrace(cupsd_job_t *job)	/* I - Job */
+{
+  cupsd_tracespan_t	*span;		/* Current span */
+
+
+  if (!job->trace)
+    return;
+
+  for (span = (cupsd_tracespan_t *)cupsArrayFirst(job->trace);
+       span;
+       span = (cupsd_tracespan_t *)cupsArrayNext(job->trace))
+  {
+    free(span->name);
+    free(span->message);
+    free(span);
+  }
+
+  cupsArrayDelete(job->trace);
+  job->trace = NULL;
+}
+
+
+/*
+ * 'cupsdSaveJobTrace()' - Write the trace for a job.
+ *
+ * Spans that are still open are written as ending now.
+ */
+
+void
+cupsdSaveJobTrace(cupsd_job_t *job)	/* I - Job */
+{
+  cupsd_tracespan_t	*span;		/* Current span */
+  cups_json_t		*json,		/* Trace object */
+			*events,	/* traceEvents array */
+			*event,		/* Current event */
+			*args;		/* Event arguments */
+  cups_file_t		*fp;		/* Trace file */
+  char			*s,		/* JSON string */
+			filename[1024],	/* Trace filename */
+			title[256];	/* Process or thread name */
+  double		now = cupsGetClock();
+					/* Current time */
+
+
+  if (!job->trace)
+    return;
+
+  json   = cupsJSONNew(NULL, NULL, CUPS_JTYPE_OBJECT);
+  events = cupsJSONNew(json, cupsJSONNewKey(json, NULL, "traceEvents"), CUPS_JTYPE_ARRAY);
+
+ /*
+  * Name the job "process" and the cupsd "thread", then add a name for each
+  * filter and backend process followed by the spans themselves...
+  */
+
+  snprintf(title, sizeof(title), "Job %d", job->id);
+  event = cupsJSONNew(events, NULL, CUPS_JTYPE_OBJECT);
+  cupsJSONNewString(event, cupsJSONNewKey(event, NULL, "name"), "process_name");
+  cupsJSONNewString(event, cupsJSONNewKey(event, NULL, "ph"), "M");
+  cupsJSONNewNumber(event, cupsJSONNewKey(event, NULL, "pid"), job->id);
+  args = cupsJSONNew(event, cupsJSONNewKey(event, NULL, "args"), CUPS_JTYPE_OBJECT);
+  cupsJSONNewString(args, cupsJSONNewKey(args, NULL, "name"), title);
+
+  event = cupsJSONNew(events, event, CUPS_JTYPE_OBJECT);
+  cupsJSONNewString(event, cupsJSONNewKey(event, NULL, "name"), "thread_name");
+  cupsJSONNewString(event, cupsJSONNewKey(event, NULL, "ph"), "M");
+  cupsJSONNewNumber(event, cupsJSONNewKey(event, NULL, "pid"), job->id);
+  cupsJSONNewNumber(event, cupsJSONNewKey(event, NULL, "tid"), 0);
+  args = cupsJSONNew(event, cupsJSONNewKey(event, NULL, "args"), CUPS_JTYPE_OBJECT);
+  cupsJSONNewString(args, cupsJSONNewKey(args, NULL, "name"), "cupsd");
+
+  for (span = (cupsd_tracespan_t *)cupsArrayFirst(job->trace);
+       span;
+       span = (cupsd_tracespan_t *)cupsArrayNext(job->trace))
+  {
+    if (span->tid && span->phase != 'i')
+    {
+      snprintf(title, sizeof(title), "%s %s (PID %d)", span->cat, span->name, span->tid);
+      event = cupsJSONNew(events, event, CUPS_JTYPE_OBJECT);
+      cupsJSONNewString(event, cupsJSONNewKey(event, NULL, "name"), "thread_name");
+      cupsJSONNewString(event, cupsJSONNewKey(event, NULL, "ph"), "M");
+      cupsJSONNewNumber(event, cupsJSONNewKey(event, NULL, "pid"), job->id);
+      cupsJSONNewNumber(event, cupsJSONNewKey(event, NULL, "tid"), span->tid);
+      args = cupsJSONNew(event, cupsJSONNewKey(event, NULL, "args"), CUPS_JTYPE_OBJECT);
+      cupsJSONNewString(args, cupsJSONNewKey(args, NULL, "name"), title);
+    }
+
+    event = add_event(events, event, job->id, span, now);
+  }
+
+  cupsJSONNewString(json, cupsJSONNewKey(json, NULL, "displayTimeUnit"), "ms");
+
+ /*
+  * Write the trace file...
+  */
+
+  s = cupsJSONExportString(json);
+  cupsJSONDelete(json);
+
+  if (!s)
+  {
+    cupsdLogJob(job, CUPSD_LOG_ERROR, "Unable to create job trace: %s", strerror(errno));
+    return;
+  }
+
+  snprintf(filename, sizeof(filename), "%s/t%05d.json", RequestRoot, job->id);
+
+  if ((fp = cupsdCreateConfFile(filename, ConfigFilePerm & 0600)) != NULL)
+  {
+    cupsFilePuts(fp, s);
+    cupsFilePutChar(fp, '\n');
+
+    if (!cupsdCloseCreatedConfFile(fp, filename))
+      cupsdLogJob(job, CUPSD_LOG_DEBUG, "Saved job trace \"%s\" with %d spans.", filename, cupsArrayCount(job->trace));
+  }
+
+  free(s);
+}
+
+
+/*
+ * 'add_event()' - Add a trace event for a span.
+ */
+
+static cups_json_t *			/* O - New event */
+add_event(cups_json_t       *events,	/* I - traceEvents array */
+          cups_json_t       *after,	/* I - Previous event */
+          int               id,		/* I - Job ID */
+          cupsd_tracespan_t *span,	/* I - Span */
+	  double            now)	/* I - Current time */
+{
+  cups_json_t	*event,			/* Event object */
+		*args;			/* Event arguments */
+  char		phase[2];		/* Event phase */
+
+
+  phase[0] = span->phase == 'i' ? 'i' : 'X';
+  phase[1] = '\0';
+
+  event = cupsJSONNew(events, after, CUPS_JTYPE_OBJECT);
+  cupsJSONNewString(event, cupsJSONNewKey(event, NULL, "name"), span->name);
+  cupsJSONNewString(event, cupsJSONNewKey(event, NULL, "cat"), span->cat);
+  cupsJSONNewString(event, cupsJSONNewKey(event, NULL, "ph"), phase);
+  cupsJSONNewNumber(event, cupsJSONNewKey(event, NULL, "ts"), span->start * 1000000.0);
+
+  if (span->phase == 'i')
+    cupsJSONNewString(event, cupsJSONNewKey(event, NULL, "s"), "t");
+  else
+    cupsJSONNewNumber(event, cupsJSONNewKey(event, NULL, "dur"), ((span->phase == 'B' ? now : span->end) - span->start) * 1000000.0);
+
+  cupsJSONNewNumber(event, cupsJSONNewKey(event, NULL, "pid"), id);
+  cupsJSONNewNumber(event, cupsJSONNewKey(event, NULL, "tid"), span->tid);
+
+  if (span->message || span->phase == 'B')
+  {
+    args = cupsJSONNew(event, cupsJSONNewKey(event, NULL, "args"), CUPS_JTYPE_OBJECT);
+
+    if (span->message)
+      cupsJSONNewString(args, cupsJSONNewKey(args, NULL, "message"), span->message);
+    if (span->phase == 'B')
+      cupsJSONNew(args, cupsJSONNewKey(args, NULL, "running"), CUPS_JTYPE_TRUE);
+  }
+
+  return (event);
+}
+
+
+/*
+ * 'add_span()' - Add a span to a job trace.
+ */
+
+static void
+add_span(cupsd_job_t *job,		/* I - Job */
+         char        phase,		/* I - Span phase */
+         const char  *cat,		/* I - Category */
+	 const char  *name,		/* I - Name of span */
+	 int         tid,		/* I - Process ID or 0 for cupsd */
+	 double      start,		/* I - Start time */
+	 double      end,		/* I - End time */
+	 const char  *message)		/* I - Message or NULL */
+{
+  cupsd_tracespan_t	*span;		/* New span */
+
+
+ /*
+  * Create the trace when the first span is added, and stop recording once a
+  * job has a lot of spans (page events from large jobs, for example)...
+  */
+
+  if (!job->trace)
+  {
+    if (!TraceJobs || (job->trace = cupsArrayNew(NULL, NULL)) == NULL)
+      return;
+  }
+  else if (cupsArrayCount(job->trace) >= CUPSD_TRACE_MAX)
+    return;
+
+  if ((span = calloc(1, sizeof(cupsd_tracespan_t))) == NULL)
+    return;
+
+  span->phase = phase;
+  span->cat   = cat;
+  span->name  = strdup(name);
+  span->tid   = tid;
+  span->start = start;
+  span->end   = end;
+
+  if (message)
+    span->message = strdup(message);
+
+  cupsArrayAdd(job->trace, span);
+}
@@ -0,0 +1,36 @@
+/*
+ * Job trace definitions for the CUPS scheduler.
+ *
+ * Copyright © 2026 by OpenPrinting.
+ *
+ * Licensed under Apache License v2.0.  See the file "LICENSE" for more
+ * information.
+ */
+
+/*
+ * Constants...
+ */
+
+#define CUPSD_TRACE_MAX		4096	/* Maximum number of spans per job */
+
+
+/*
+ * Globals...
+ */
+
+VAR int			TraceJobs	VALUE(FALSE);
+					/* Record job traces? */
+
+
+/*
+ * Prototypes...
+ */
+
+extern void	cupsdAddJobTrace(cupsd_job_t *job, const char *cat,
+		                 const char *name, int tid, double start,
+				 double end, const char *message);
+extern void	cupsdBeginJobTrace(cupsd_job_t *job, const char *cat,
+		                   const char *name, int tid);
+extern void	cupsdEndJobTrace(cupsd_job_t *job, int tid);
+extern void	cupsdFreeJobTrace(cupsd_job_t *job);
+extern void	cupsdSaveJobTrace(cupsd_job_t *job);
@@ -19,12 +19,48 @@
 // Local types...
 //
 
+typedef struct _mime_acnode_s		// Node in "contains" pattern automaton
+{
+  int		child,			// First child node
+		sibling,		// Next sibling node
+		fail,			// Node for the longest proper suffix
+		output,			// Next suffix node that ends patterns
+		rules;			// First rule using this pattern or -1
+  unsigned char	ch;			// Character leading to this node
+} _mime_acnode_t;
+
+typedef struct _mime_acrule_s		// Compiled "contains" rule
+{
+  mime_magic_t	*rule;			// Rule
+  int		next;			// Next rule with the same pattern or -1
+} _mime_acrule_t;
+
+typedef struct _mime_index_s		// Compiled type detection rules
+{
+  int		num_types;		// Number of types with rules
+  mime_type_t	**types;		// Types in priority order
+  int		num_any,		// Number of types that match any first byte
+		*any,			// Types that match any first byte
+		first[257],		// Start of types for each first byte
+		*bytes;			// Types for each first byte
+  int		num_nodes,		// Number of automaton nodes
+		alloc_nodes;		// Allocated automaton nodes
+  _mime_acnode_t *nodes;		// Automaton nodes
+  int		root[256];		// Transitions from the root node
+  int		num_rules,		// Number of "contains" rules
+		alloc_rules;		// Allocated "contains" rules
+  _mime_acrule_t *rules;		// "contains" rules
+} _mime_index_t;
+
 typedef struct _mime_filebuf_s		// File buffer for MIME typing
 {
   cups_file_t	*fp;			// File pointer
   int		offset,			// Offset in file
 		length;			// Length of buffered data
   unsigned char	buffer[MIME_MAX_BUFFER];// Buffered data
+  _mime_index_t	*index;			// Compiled type detection rules
+  int		scanned;		// Length of scanned data or 0
+  char		*contains;		// Results of "contains" rules
 } _mime_filebuf_t;
 
 
@@ -32,8 +68,16 @@ typedef struct _mime_filebuf_s		// File buffer for MIME typing
 // Local functions...
 //
 
+static int	mime_add_pattern(_mime_index_t *index, mime_magic_t *rule);
+static int	mime_check_contains(_mime_filebuf_t *fb, mime_magic_t *rule);
 static int	mime_check_rules(const char *filename, _mime_filebuf_t *fb, mime_magic_t *rules);
-static void	mime_delete_rules(mime_magic_t *rules);
+static int	mime_compare_ranks(mime_type_t **a, mime_type_t **b);
+static int	mime_compile_patterns(_mime_index_t *index, mime_magic_t *rules);
+static _mime_index_t *mime_compile_types(mime_t *mime);
+static mime_type_t *mime_file_type(mime_t *mime, const char *pathname, const char *filename, int *compression, int compiled);
+static int	mime_first_bytes(mime_magic_t *rules, unsigned char *bytes);
+static void	mime_load_buffer(_mime_filebuf_t *fb, int offset);
+static int	mime_next_node(_mime_index_t *index, int node, int ch);
 static int	mime_patmatch(const char *s, const char *pat);
 
 
@@ -84,6 +128,9 @@ mimeAddType(mime_t     *mime,		// I - MIME database
     return (NULL);
   }
 
+  // Adding a type or rules to a type invalidates the compiled type rules...
+  _mimeDeleteIndex(mime);
+
   // See if the type already exists; if so, return the existing type...
   if ((temp = mimeType(mime, super, type)) != NULL)
   {
@@ -453,6 +500,7 @@ mimeAddTypeRule(mime_type_t *mt,	// I - Type to add to
 	    temp->length = MIME_MAX_BUFFER;
 	    if (regcomp(&(temp->value.rev), value[1], REG_NOSUB | REG_EXTENDED))
 	      return (-1);
+	    temp->regex = strdup(value[1]);
 	    break;
 	case MIME_MAGIC_STRING :
 	case MIME_MAGIC_ISTRING :
@@ -529,91 +577,95 @@ _mimeCompareTypes(mime_type_t *a,	// I - First type
 
 
 //
-// 'mimeFileType()' - Determine the type of a file.
+// '_mimeDeleteIndex()' - Delete the compiled type detection rules.
+//
+// The rules are compiled again the next time @link mimeFileType@ is called.
 //
 
-mime_type_t *				// O - Type of file
-mimeFileType(mime_t     *mime,		// I - MIME database
-             const char *pathname,	// I - Name of file to check on disk
-	     const char *filename,	// I - Original filename or NULL
-	     int        *compression)	// O - Is the file compressed?
+void
+_mimeDeleteIndex(mime_t *mime)		// I - MIME database
 {
-  _mime_filebuf_t	fb;		// File buffer
-  const char		*base;		// Base filename of file
-  mime_type_t		*type,		// File type
-			*best;		// Best match
+  _mime_index_t	*index;			// Compiled type rules
 
 
-  MIME_DEBUG("mimeFileType(mime=%p, pathname=\"%s\", filename=\"%s\", compression=%p)\n", (void *)mime, pathname, filename, (void *)compression);
+  if (!mime || (index = mime->index) == NULL)
+    return;
 
-  // Range check input parameters...
-  if (!mime || !pathname)
-  {
-    MIME_DEBUG("mimeFileType: Returning NULL.\n");
-    return (NULL);
-  }
+  MIME_DEBUG("_mimeDeleteIndex(mime=%p)\n", (void *)mime);
 
-  // Try to open the file...
-  if ((fb.fp = cupsFileOpen(pathname, "r")) == NULL)
-  {
-    MIME_DEBUG("mimeFileType: Unable to open \"%s\": %s\n", pathname, strerror(errno));
-    MIME_DEBUG("mimeFileType: Returning NULL.\n");
-    return (NULL);
-  }
+  free(index->types);
+  free(index->any);
+  free(index->bytes);
+  free(index->nodes);
+  free(index->rules);
+  free(index);
 
-  // Then preload the first MIME_MAX_BUFFER bytes of the file into the file
-  // buffer, returning an error if we can't read anything...
-  fb.offset = 0;
-  fb.length = (int)cupsFileRead(fb.fp, (char *)fb.buffer, MIME_MAX_BUFFER);
+  mime->index = NULL;
+}
 
-  if (fb.length <= 0)
-  {
-    MIME_DEBUG("mimeFileType: Unable to read from \"%s\": %s\n", pathname, strerror(errno));
-    MIME_DEBUG("mimeFileType: Returning NULL.\n");
 
-    cupsFileClose(fb.fp);
+//
+// '_mimeDeleteRules()' - Free all memory for the given rule tree.
+//
 
-    return (NULL);
-  }
+void
+_mimeDeleteRules(mime_magic_t *rules)	// I - Rules to free
+{
+  mime_magic_t	*next;			// Next rule to free
 
-  // Figure out the base filename (without directory portion)...
-  if (filename)
-  {
-    if ((base = strrchr(filename, '/')) != NULL)
-      base ++;
-    else
-      base = filename;
-  }
-  else if ((base = strrchr(pathname, '/')) != NULL)
-  {
-    base ++;
-  }
-  else
-  {
-    base = pathname;
-  }
 
-  // Then check it against all known types...
-  for (type = (mime_type_t *)cupsArrayFirst(mime->types), best = NULL; type; type = (mime_type_t *)cupsArrayNext(mime->types))
+  MIME_DEBUG("_mimeDeleteRules(rules=%p)\n", (void *)rules);
+
+  // Free the rules list, descending recursively to free any child rules.
+  while (rules != NULL)
   {
-    if (mime_check_rules(base, &fb, type->rules))
+    next = rules->next;
+
+    if (rules->child != NULL)
+      _mimeDeleteRules(rules->child);
+
+    if (rules->op == MIME_MAGIC_REGEX)
     {
-      if (!best || type->priority > best->priority)
-        best = type;
+      regfree(&(rules->value.rev));
+      free(rules->regex);
     }
-  }
 
-  // Finally, close the file and return a match (if any)...
-  if (compression)
-  {
-    *compression = cupsFileCompression(fb.fp);
-    MIME_DEBUG("mimeFileType: *compression=%d\n", *compression);
+    free(rules);
+    rules = next;
   }
+}
 
-  cupsFileClose(fb.fp);
 
-  MIME_DEBUG("mimeFileType: Returning %p(%s/%s).\n", (void *)best, best ? best->super : "???", best ? best->type : "???");
-  return (best);
+//
+// 'mimeFileType()' - Determine the type of a file.
+//
+
+mime_type_t *				// O - Type of file
+mimeFileType(mime_t     *mime,		// I - MIME database
+             const char *pathname,	// I - Name of file to check on disk
+	     const char *filename,	// I - Original filename or NULL
+	     int        *compression)	// O - Is the file compressed?
+{
+  return (mime_file_type(mime, pathname, filename, compression, 1));
+}
+
+
+//
+// '_mimeFileTypeUncompiled()' - Determine the type of a file by checking the
+//                               rules of every type.
+//
+// This is the reference for the compiled type detection rules and is only used
+// by the unit tests.
+//
+
+mime_type_t *				// O - Type of file
+_mimeFileTypeUncompiled(
+    mime_t     *mime,			// I - MIME database
+    const char *pathname,		// I - Name of file to check on disk
+    const char *filename,		// I - Original filename or NULL
+    int        *compression)		// O - Is the file compressed?
+{
+  return (mime_file_type(mime, pathname, filename, compression, 0));
 }
 
 
@@ -627,7 +679,7 @@ _mimeFreeType(mime_type_t *t,		// I - File type
 {
   (void)data;
 
-  mime_delete_rules(t->rules);
+  _mimeDeleteRules(t->rules);
   free(t);
 }
 
@@ -664,6 +716,136 @@ mimeType(mime_t     *mime,		// I - MIME database
 }
 
 
+//
+// 'mime_add_pattern()' - Add a "contains" rule to the pattern automaton.
+//
+
+static int				// O - 1 on success, 0 on error
+mime_add_pattern(_mime_index_t *index,	// I - Compiled type rules
+                 mime_magic_t  *rule)	// I - "contains" rule
+{
+  int			i,		// Looping var
+			node,		// Current node
+			child;		// Child node
+  unsigned char		ch;		// Current character
+  _mime_acnode_t	*temp;		// New nodes
+  _mime_acrule_t	*rtemp;		// New rules
+
+
+  // Find or add the nodes for each character in the pattern...
+  for (i = 0, node = 0; i < rule->length; i ++, node = child)
+  {
+    ch = (unsigned char)rule->value.stringv[i];
+
+    for (child = index->nodes[node].child; child; child = index->nodes[child].sibling)
+    {
+      if (index->nodes[child].ch == ch)
+        break;
+    }
+
+    if (child)
+      continue;
+
+    if (index->num_nodes >= index->alloc_nodes)
+    {
+      if ((temp = realloc(index->nodes, (size_t)(index->alloc_nodes + 256) * sizeof(_mime_acnode_t))) == NULL)
+        return (0);
+
+      index->nodes       = temp;
+      index->alloc_nodes += 256;
+    }
+
+    child = index->num_nodes ++;
+
+    memset(index->nodes + child, 0, sizeof(_mime_acnode_t));
+    index->nodes[child].sibling = index->nodes[node].child;
+    index->nodes[child].rules   = -1;
+    index->nodes[child].ch      = ch;
+    index->nodes[node].child    = child;
+  }
+
+  // Then add the rule to the last node...
+  if (index->num_rules >= index->alloc_rules)
+  {
+    if ((rtemp = realloc(index->rules, (size_t)(index->alloc_rules + 64) * sizeof(_mime_acrule_t))) == NULL)
+      return (0);
+
+    index->rules       = rtemp;
+    index->alloc_rules += 64;
+  }
+
+  index->rules[index->num_rules].rule = rule;
+  index->rules[index->num_rules].next = index->nodes[node].rules;
+  index->nodes[node].rules            = index->num_rules ++;
+
+  rule->pattern = index->num_rules;
+
+  return (1);
+}
+
+
+//
+// 'mime_check_contains()' - Check a compiled "contains" rule.
+//
+// The first time a compiled rule is checked, the buffer is scanned once for
+// all of the "contains" patterns and the result of every "contains" rule is
+// saved.
+//
+
+static int				// O - 1 if match, 0 if no match
+mime_check_contains(
+    _mime_filebuf_t *fb,		// I - File to check
+    mime_magic_t    *rule)		// I - "contains" rule
+{
+  _mime_index_t	*index = fb->index;	// Compiled type rules
+  int		i,			// Looping var
+		node,			// Current node
+		out,			// Node with matching patterns
+		r,			// Current rule
+		start,			// Start of match
+		region;			// Region to look at
+  mime_magic_t	*temp;			// Rule for match
+
+
+  if (fb->length <= 0)
+    return (0);
+
+  if (fb->scanned != fb->length)
+  {
+    MIME_DEBUG("mime_check_contains: Scanning %d bytes for %d patterns.\n", fb->length, index->num_rules);
+
+    memset(fb->contains, 0, (size_t)index->num_rules);
+
+    for (i = 0, node = 0; i < fb->length; i ++)
+    {
+      node = mime_next_node(index, node, fb->buffer[i]);
+
+      for (out = index->nodes[node].rules >= 0 ? node : index->nodes[node].output; out; out = index->nodes[out].output)
+      {
+        for (r = index->nodes[out].rules; r >= 0; r = index->rules[r].next)
+        {
+          // Use the same region as mime_check_rules() does...
+          temp  = index->rules[r].rule;
+          start = i + 1 - temp->length;
+
+	  if (fb->length > temp->region)
+	    region = temp->region - temp->length;
+	  else
+	    region = fb->length - temp->length;
+
+          if (start >= temp->offset && start < (temp->offset + region))
+            fb->contains[r] = 1;
+        }
+      }
+    }
+
+    fb->scanned = fb->length;
+  }
+
+  return ((rule->offset + rule->length) <= fb->length && fb->contains[rule->pattern - 1]);
+}
+
+
 //
 // 'mime_check_rules()' - Check each rule in a list.
 //
@@ -986,6 +1168,17 @@ mime_check_rules(
 	  break;
 
       case MIME_MAGIC_CONTAINS :
+          // Use the compiled pattern when the rule looks at the beginning of
+	  // the file...
+          if (rules->pattern && fb->index && (rules->offset == 0 || (fb->offset == 0 && fb->length > 0 && (rules->offset + rules->region) <= fb->length)))
+          {
+            if (fb->offset != 0 || fb->length <= 0)
+              mime_load_buffer(fb, 0);
+
+            result = mime_check_contains(fb, rules);
+            break;
+          }
+
           // Load the buffer if necessary...
           if (fb->offset < 0 || rules->offset < fb->offset || (rules->offset + rules->region) > (fb->offset + fb->length))
 	  {
@@ -1054,31 +1247,576 @@ mime_check_rules(
 
 
 //
-// 'mime_delete_rules()' - Free all memory for the given rule tree.
+// 'mime_compare_ranks()' - Compare two types by priority.
+//
+// Types with the same priority stay in the same order as mimeFileType() used
+// to check them.
 //
 
-static void
-mime_delete_rules(mime_magic_t *rules)	// I - Rules to free
+static int				// O - Result of comparison
+mime_compare_ranks(mime_type_t **a,	// I - First type
+                   mime_type_t **b)	// I - Second type
 {
-  mime_magic_t	*next;			// Next rule to free
+  if ((*a)->priority != (*b)->priority)
+    return ((*b)->priority - (*a)->priority);
+  else
+    return (_mimeCompareTypes(*a, *b, NULL));
+}
 
 
-  MIME_DEBUG("mime_delete_rules(rules=%p)\n", (void *)rules);
+//
+// 'mime_compile_patterns()' - Add the "contains" rules in a rule tree.
+//
 
-  // Free the rules list, descending recursively to free any child rules.
-  while (rules != NULL)
+static int				// O - 1 on success, 0 on error
+mime_compile_patterns(
+    _mime_index_t *index,		// I - Compiled type rules
+    mime_magic_t  *rules)		// I - Rules
+{
+  for (; rules; rules = rules->next)
   {
-    next = rules->next;
+    if (rules->op == MIME_MAGIC_CONTAINS)
+    {
+      rules->pattern = 0;
 
-    if (rules->child != NULL)
-      mime_delete_rules(rules->child);
+      if (rules->length > 0 && !mime_add_pattern(index, rules))
+        return (0);
+    }
+    else if (rules->child && !mime_compile_patterns(index, rules->child))
+    {
+      return (0);
+    }
+  }
 
-    if (rules->op == MIME_MAGIC_REGEX)
-      regfree(&(rules->value.rev));
+  return (1);
+}
 
-    free(rules);
-    rules = next;
+
+//
+// 'mime_compile_types()' - Compile the type detection rules.
+//
+// The types are sorted by priority and indexed by the first bytes they can
+// match, so mimeFileType() only checks the types that can match a file and
+// stops at the first match.  All of the "contains" patterns are added to a
+// single Aho-Corasick automaton so they are found with one pass over the
+// buffer.
+//
+
+static _mime_index_t *			// O - Compiled type rules or `NULL` on error
+mime_compile_types(mime_t *mime)	// I - MIME database
+{
+  _mime_index_t	*index;			// Compiled type rules
+  mime_type_t	*type;			// Current type
+  int		i,			// Looping var
+		b,			// Current byte
+		count,			// Number of bytes
+		node,			// Current node
+		child,			// Child node
+		head,			// Head of node queue
+		tail,			// Tail of node queue
+		*queue = NULL,		// Node queue
+		fill[256];		// Next type for each first byte
+  unsigned char	(*sets)[32] = NULL;	// First bytes for each type
+  char		*any = NULL;		// Type matches any first byte?
+
+
+  MIME_DEBUG("mime_compile_types(mime=%p)\n", (void *)mime);
+
+  if ((index = calloc(1, sizeof(_mime_index_t))) == NULL)
+    return (NULL);
+
+  // Add the root node of the "contains" automaton...
+  if ((index->nodes = calloc(256, sizeof(_mime_acnode_t))) == NULL)
+    goto error;
+
+  index->num_nodes      = 1;
+  index->alloc_nodes    = 256;
+  index->nodes[0].rules = -1;
+
+  // Sort the types with rules by priority and add their "contains" rules...
+  if ((index->types = calloc((size_t)cupsArrayGetCount(mime->types) + 1, sizeof(mime_type_t *))) == NULL)
+    goto error;
+
+  for (type = (mime_type_t *)cupsArrayGetFirst(mime->types); type; type = (mime_type_t *)cupsArrayGetNext(mime->types))
+  {
+    if (!type->rules)
+      continue;
+
+    if (!mime_compile_patterns(index, type->rules))
+      goto error;
+
+    index->types[index->num_types ++] = type;
   }
+
+  qsort(index->types, (size_t)index->num_types, sizeof(mime_type_t *), (int (*)(const void *, const void *))mime_compare_ranks);
+
+  // Link each node to the node for its longest proper suffix...
+  if ((queue = calloc((size_t)index->num_nodes, sizeof(int))) == NULL)
+    goto error;
+
+  for (child = index->nodes[0].child, tail = 0; child; child = index->nodes[child].sibling)
+  {
+    index->root[index->nodes[child].ch] = child;
+    queue[tail ++]                      = child;
+  }
+
+  for (head = 0; head < tail; head ++)
+  {
+    node = queue[head];
+
+    for (child = index->nodes[node].child; child; child = index->nodes[child].sibling)
+    {
+      int fail = mime_next_node(index, index->nodes[node].fail, index->nodes[child].ch);
+					// Suffix node
+
+      index->nodes[child].fail   = fail;
+      index->nodes[child].output = index->nodes[fail].rules >= 0 ? fail : index->nodes[fail].output;
+      queue[tail ++]             = child;
+    }
+  }
+
+  // Index the types by the first bytes they can match...
+  if ((sets = calloc((size_t)index->num_types + 1, sizeof(sets[0]))) == NULL || (any = calloc((size_t)index->num_types + 1, 1)) == NULL || (index->any = calloc((size_t)index->num_types + 1, sizeof(int))) == NULL)
+    goto error;
+
+  memset(fill, 0, sizeof(fill));
+
+  for (i = 0; i < index->num_types; i ++)
+  {
+    if (mime_first_bytes(index->types[i]->rules, sets[i]))
+    {
+      for (b = 0, count = 0; b < 256; b ++)
+      {
+	if (sets[i][b / 8] & (1 << (b & 7)))
+	  count ++;
+      }
+    }
+    else
+    {
+      count = 256;
+    }
+
+    if (count > 128)
+    {
+      // Check types that can match most bytes for every file...
+      any[i]                        = 1;
+      index->any[index->num_any ++] = i;
+      continue;
+    }
+
+    for (b = 0; b < 256; b ++)
+    {
+      if (sets[i][b / 8] & (1 << (b & 7)))
+        fill[b] ++;
+    }
+  }
+
+  for (b = 0, count = 0; b < 256; b ++)
+  {
+    index->first[b] = count;
+    count           += fill[b];
+    fill[b]         = index->first[b];
+  }
+
+  index->first[256] = count;
+
+  if ((index->bytes = calloc((size_t)count + 1, sizeof(int))) == NULL)
+    goto error;
+
+  for (i = 0; i < index->num_types; i ++)
+  {
+    if (any[i])
+      continue;
+
+    for (b = 0; b < 256; b ++)
+    {
+      if (sets[i][b / 8] & (1 << (b & 7)))
+        index->bytes[fill[b] ++] = i;
+    }
+  }
+
+  MIME_DEBUG("mime_compile_types: %d types, %d match any first byte, %d \"contains\" rules, %d nodes.\n", index->num_types, index->num_any, index->num_rules, index->num_nodes);
+
+  free(queue);
+  free(sets);
+  free(any);
+
+  return (index);
+
+  // If we get here, there was an error...
+  error:
+
+  MIME_DEBUG("mime_compile_types: Unable to compile rules: %s\n", strerror(errno));
+
+  free(queue);
+  free(sets);
+  free(any);
+
+  free(index->types);
+  free(index->any);
+  free(index->bytes);
+  free(index->nodes);
+  free(index->rules);
+  free(index);
+
+  return (NULL);
+}
+
+
+//
+// 'mime_file_type()' - Determine the type of a file with or without the
+//                      compiled type detection rules.
+//
+
+static mime_type_t *			// O - Type of file
+mime_file_type(mime_t     *mime,	// I - MIME database
+               const char *pathname,	// I - Name of file to check on disk
+	       const char *filename,	// I - Original filename or NULL
+	       int        *compression,	// O - Is the file compressed?
+	       int        compiled)	// I - Use the compiled rules?
+{
+  _mime_filebuf_t	fb;		// File buffer
+  const char		*base;		// Base filename of file
+  mime_type_t		*type,		// File type
+			*best;		// Best match
+  _mime_index_t		*index;		// Compiled type rules
+  int			i,		// Looping var
+			anyidx,		// Index into "any" types
+			byteidx,	// Index into first byte types
+			lastidx;	// Last first byte type
+
+
+  MIME_DEBUG("mime_file_type(mime=%p, pathname=\"%s\", filename=\"%s\", compression=%p, compiled=%d)\n", (void *)mime, pathname, filename, (void *)compression, compiled);
+
+  // Range check input parameters...
+  if (!mime || !pathname)
+  {
+    MIME_DEBUG("mime_file_type: Returning NULL.\n");
+    return (NULL);
+  }
+
+  // Try to open the file...
+  if ((fb.fp = cupsFileOpen(pathname, "r")) == NULL)
+  {
+    MIME_DEBUG("mime_file_type: Unable to open \"%s\": %s\n", pathname, strerror(errno));
+    MIME_DEBUG("mime_file_type: Returning NULL.\n");
+    return (NULL);
+  }
+
+  // Then preload the first MIME_MAX_BUFFER bytes of the file into the file
+  // buffer, returning an error if we can't read anything...
+  fb.offset = 0;
+  fb.length = (int)cupsFileRead(fb.fp, (char *)fb.buffer, MIME_MAX_BUFFER);
+
+  if (fb.length <= 0)
+  {
+    MIME_DEBUG("mime_file_type: Unable to read from \"%s\": %s\n", pathname, strerror(errno));
+    MIME_DEBUG("mime_file_type: Returning NULL.\n");
+
+    cupsFileClose(fb.fp);
+
+    return (NULL);
+  }
+
+  // Figure out the base filename (without directory portion)...
+  if (filename)
+  {
+    if ((base = strrchr(filename, '/')) != NULL)
+      base ++;
+    else
+      base = filename;
+  }
+  else if ((base = strrchr(pathname, '/')) != NULL)
+  {
+    base ++;
+  }
+  else
+  {
+    base = pathname;
+  }
+
+  // Then check it against the types that can match the first byte of the
+  // file, in priority order.  The first match is the best match...
+  //
+  // Callers may only hold a read lock on the database, so compile the rules
+  // under the index mutex - the index is only freed by functions that change
+  // the database, which need the write lock...
+  if (compiled)
+  {
+    cupsMutexLock(&mime->index_mutex);
+    if (!mime->index)
+      mime->index = mime_compile_types(mime);
+    index = mime->index;
+    cupsMutexUnlock(&mime->index_mutex);
+  }
+  else
+  {
+    index = NULL;
+  }
+
+  fb.index    = NULL;
+  fb.scanned  = 0;
+  fb.contains = NULL;
+  best        = NULL;
+
+  if (index && index->num_rules > 0 && (fb.contains = calloc((size_t)index->num_rules, 1)) != NULL)
+    fb.index = index;
+
+  if (index)
+  {
+    anyidx  = 0;
+    byteidx = index->first[fb.buffer[0]];
+    lastidx = index->first[fb.buffer[0] + 1];
+
+    while (anyidx < index->num_any || byteidx < lastidx)
+    {
+      if (byteidx >= lastidx || (anyidx < index->num_any && index->any[anyidx] < index->bytes[byteidx]))
+        i = index->any[anyidx ++];
+      else
+        i = index->bytes[byteidx ++];
+
+      type = index->types[i];
+
+      // Start each type with the beginning of the file so the result does not
+      // depend on the rules of the types checked before it...
+      if (fb.offset != 0 || fb.length <= 0)
+        mime_load_buffer(&fb, 0);
+
+      if (mime_check_rules(base, &fb, type->rules))
+      {
+        best = type;
+        break;
+      }
+    }
+  }
+  else
+  {
+    for (type = (mime_type_t *)cupsArrayFirst(mime->types); type; type = (mime_type_t *)cupsArrayNext(mime->types))
+    {
+      if (mime_check_rules(base, &fb, type->rules))
+      {
+	if (!best || type->priority > best->priority)
+	  best = type;
+      }
+    }
+  }
+
+  // Finally, close the file and return a match (if any)...
+  if (compression)
+  {
+    *compression = cupsFileCompression(fb.fp);
+    MIME_DEBUG("mime_file_type: *compression=%d\n", *compression);
+  }
+
+  cupsFileClose(fb.fp);
+  free(fb.contains);
+
+  MIME_DEBUG("mime_file_type: Returning %p(%s/%s).\n", (void *)best, best ? best->super : "???", best ? best->type : "???");
+  return (best);
+}
+
+
+//
+// 'mime_first_bytes()' - Get the first bytes a list of rules can match.
+//
+// This follows the logic of mime_check_rules().  Rules that don't look at
+// the first byte of the file, or are inverted, can match any first byte.
+//
+
+static int				// O - 1 if limited to "bytes", 0 for any byte
+mime_first_bytes(mime_magic_t  *rules,	// I - Rules
+                 unsigned char *bytes)	// O - Bitmap of first bytes
+{
+  int		logic,			// Logic to apply
+		limited,		// Limited to "bytes"?
+		rlimited,		// Rule is limited to "rbytes"?
+		i;			// Looping var
+  unsigned char	rbytes[32];		// First bytes for rule
+
+
+  memset(bytes, 0, 32);
+
+  if (rules == NULL)
+    return (1);
+
+  if (rules->parent == NULL)
+    logic = MIME_MAGIC_OR;
+  else
+    logic = rules->parent->op;
+
+  limited = logic != MIME_MAGIC_AND;
+
+  for (; rules; rules = rules->next)
+  {
+    memset(rbytes, 0, sizeof(rbytes));
+    rlimited = 0;
+
+    if (!rules->invert)
+    {
+      switch (rules->op)
+      {
+	case MIME_MAGIC_STRING :
+	case MIME_MAGIC_ISTRING :
+	    if (rules->offset == 0 && rules->length > 0)
+	    {
+	      i        = rules->value.stringv[0] & 255;
+	      rlimited = 1;
+
+	      rbytes[i / 8] |= (unsigned char)(1 << (i & 7));
+
+	      if (rules->op == MIME_MAGIC_ISTRING && _cups_isalpha(i))
+	      {
+	        i ^= 0x20;
+		rbytes[i / 8] |= (unsigned char)(1 << (i & 7));
+	      }
+	    }
+	    break;
+
+	case MIME_MAGIC_CHAR :
+	    if (rules->offset == 0)
+	    {
+	      i        = rules->value.charv;
+	      rlimited = 1;
+
+	      rbytes[i / 8] |= (unsigned char)(1 << (i & 7));
+	    }
+	    break;
+
+	case MIME_MAGIC_SHORT :
+	    if (rules->offset == 0)
+	    {
+	      // mime_check_rules() compares a signed short, so values with the
+	      // high bit set never match...
+	      rlimited = 1;
+
+	      if (rules->value.shortv < 0x8000)
+	      {
+		i = rules->value.shortv >> 8;
+		rbytes[i / 8] |= (unsigned char)(1 << (i & 7));
+	      }
+	    }
+	    break;
+
+	case MIME_MAGIC_INT :
+	    if (rules->offset == 0)
+	    {
+	      i        = (int)(rules->value.intv >> 24);
+	      rlimited = 1;
+
+	      rbytes[i / 8] |= (unsigned char)(1 << (i & 7));
+	    }
+	    break;
+
+	case MIME_MAGIC_ASCII :
+	case MIME_MAGIC_PRINTABLE :
+	    if (rules->offset == 0 && rules->length > 0)
+	    {
+	      rlimited = 1;
+
+	      for (i = 0; i < 256; i ++)
+	      {
+		if ((i >= 32 && i <= 126) || (i >= 8 && i <= 13) || i == 26 || i == 27 || (i >= 128 && rules->op == MIME_MAGIC_PRINTABLE))
+		  rbytes[i / 8] |= (unsigned char)(1 << (i & 7));
+	      }
+	    }
+	    break;
+
+	case MIME_MAGIC_MATCH :
+	case MIME_MAGIC_LOCALE :
+	case MIME_MAGIC_CONTAINS :
+	case MIME_MAGIC_REGEX :
+	    break;
+
+	default :
+	    if (rules->child != NULL)
+	      rlimited = mime_first_bytes(rules->child, rbytes);
+	    else
+	      rlimited = 1;
+	    break;
+      }
+    }
+
+    // Combine the bytes for this rule with the others...
+    if (logic == MIME_MAGIC_OR)
+    {
+      if (!rlimited)
+        return (0);
+
+      for (i = 0; i < 32; i ++)
+        bytes[i] |= rbytes[i];
+    }
+    else if (logic == MIME_MAGIC_AND)
+    {
+      if (rlimited && !limited)
+      {
+        memcpy(bytes, rbytes, 32);
+        limited = 1;
+      }
+      else if (rlimited)
+      {
+	for (i = 0; i < 32; i ++)
+	  bytes[i] &= rbytes[i];
+      }
+    }
+    else
+    {
+      // Other logic uses the result of the last rule...
+      memcpy(bytes, rbytes, 32);
+      limited = rlimited;
+    }
+  }
+
+  return (limited);
+}
+
+
+//
+// 'mime_load_buffer()' - Load the file buffer at the given offset.
+//
+
+static void
+mime_load_buffer(_mime_filebuf_t *fb,	// I - File buffer
+                 int             offset)// I - Offset in file
+{
+  if (cupsFileSeek(fb->fp, offset) < 0)
+  {
+    fb->length = 0;
+    fb->offset = 0;
+  }
+  else
+  {
+    fb->length = (int)cupsFileRead(fb->fp, (char *)fb->buffer, sizeof(fb->buffer));
+    fb->offset = offset;
+  }
+
+  MIME_DEBUG("mime_load_buffer: Loaded %d bytes at offset %d.\n", fb->length, fb->offset);
+}
+
+
+//
+// 'mime_next_node()' - Get the next node in the "contains" automaton.
+//
+
+static int				// O - Next node
+mime_next_node(_mime_index_t *index,	// I - Compiled type rules
+               int           node,	// I - Current node
+	       int           ch)	// I - Next character
+{
+  int	child;				// Child node
+
+
+  while (node)
+  {
+    for (child = index->nodes[node].child; child; child = index->nodes[child].sibling)
+    {
+      if (index->nodes[child].ch == ch)
+        return (child);
+    }
+
+    node = index->nodes[node].fail;
+  }
+
+  return (index->root[ch]);
 }
 
 
@@ -483,6 +483,7 @@ LogLevel $loglevel
 LogTimeFormat usecs
 PreserveJobHistory $jobhistory
 PreserveJobFiles $jobfiles
+StreamJobs Yes
 <Policy default>
 <Limit All>
 Order Allow,Deny
@@ -780,6 +781,24 @@ for file in 5*.sh; do
 	fi
 done
 
+#
+# Run the streamed Print-Job tests...
+#
+
+./waitjobs.sh 1800
+
+echo $ac_n "Performing streaming tests: $ac_c"
+echo "" >>$strfile
+echo "`date '+[%d/%b/%Y:%H:%M:%S %z]'` \"teststream\":" >>$strfile
+
+$runcups ../scheduler/teststream >>$strfile 2>&1
+if test $? != 0; then
+	echo FAIL
+	fail=`expr $fail + 1`
+else
+	echo PASS
+fi
+
 #
 # Restart the server...
 #
@@ -1028,9 +1047,16 @@ fi
 # 2 requests (Create-Job, Send-Document) * number of jobs (2 - one for undefined
 # low limit, one for undefined upper limit)
 
+# Number of requests from teststream - total 7 in 'expected':
+# - 3 CUPS-Add-Modify-Printer requests (with a quota, without a quota, and
+#   with "negotiate" authentication)
+# - 3 Print-Job requests (over quota, complete, and unauthorized) - the
+#   truncated Print-Job request is never finished so it is not logged
+# - 1 CUPS-Delete-Printer request
+
 # Requests logged
 count=`wc -l $BASE/log/access_log | awk '{print $1}'`
-expected=`expr 35 + 18 + 30 + $pjobs \* 8 + $pprinters \* $pjobs \* 4 + 2 + 2 + 5 + 4`
+expected=`expr 35 + 18 + 30 + $pjobs \* 8 + $pprinters \* $pjobs \* 4 + 2 + 2 + 5 + 4 + 7`
 if test $count != $expected; then
 	echo "FAIL: $count requests logged, expected $expected."
 	echo "    <p>FAIL: $count requests logged, expected $expected.</p>" >>$strfile
@@ -1098,12 +1124,12 @@ else
 	echo "    <p>PASS: $count critical messages.</p>" >>$strfile
 fi
 
-# Error log messages
+# Error log messages, including the 2 jobs aborted by teststream
 count=`$GREP '^E ' $BASE/log/error_log | $GREP -v 'Unknown default SystemGroup' | wc -l | awk '{print $1}'`
-if test $count != 33; then
-	echo "FAIL: $count error messages, expected 33."
+if test $count != 35; then
+	echo "FAIL: $count error messages, expected 35."
 	$GREP '^E ' $BASE/log/error_log
-	echo "    <p>FAIL: $count error messages, expected 33.</p>" >>$strfile
+	echo "    <p>FAIL: $count error messages, expected 35.</p>" >>$strfile
 	echo "    <pre>" >>$strfile
 	$GREP '^E ' $BASE/log/error_log | sed -e '1,$s/&/&amp;/g' -e '1,$s/</&lt;/g' >>$strfile
 	echo "    </pre>" >>$strfile